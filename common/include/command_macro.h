@@ -0,0 +1,100 @@
+/**
+ * @file command_macro.h
+ * @brief Header for command_macro.c file.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-17
+ */
+#ifndef COMMAND_MACRO_H_
+#define COMMAND_MACRO_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Other includes */
+#include "command_table.h"
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define COMMAND_MACRO_MAX_MACROS 8          /*!< Maximum number of macros */
+#define COMMAND_MACRO_NAME_LENGTH 12        /*!< Maximum length of the name of a macro, without the terminator */
+#define COMMAND_MACRO_BODY_LENGTH 64        /*!< Maximum length of the commands of a macro, without the terminator */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Macro: a name and the commands it runs, separated by `COMMAND_SEPARATOR`. Both are copies, null terminated.
+ */
+typedef struct
+{
+    char name[COMMAND_MACRO_NAME_LENGTH + 1];   /*!< Name typed to run the macro */
+    char body[COMMAND_MACRO_BODY_LENGTH + 1];   /*!< Commands of the macro */
+    uint8_t body_length;                        /*!< Length of `body` */
+} command_macro_t;
+
+/**
+ * @brief Macros defined at run time, kept in RAM in the order they were defined.
+ */
+typedef struct
+{
+    command_macro_t macros[COMMAND_MACRO_MAX_MACROS];   /*!< Macros. Only the first `count` are in use */
+    uint32_t count;                                     /*!< Number of macros */
+} command_macro_table_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Initialize a table of macros, with no macros.
+ *
+ * @param p_macros pointer to the table.
+ */
+void command_macro_init(command_macro_table_t *p_macros);
+
+/**
+ * @brief Define a macro, or replace the commands of the macro with that name.
+ *
+ * @param p_macros pointer to the table.
+ * @param name name of the macro. It is copied.
+ * @param body commands of the macro. They are copied.
+ * @return true the macro has been defined.
+ * @return false the name or the commands are empty or too long, or the table is full.
+ */
+bool command_macro_define(command_macro_table_t *p_macros, command_slice_t name, command_slice_t body);
+
+/**
+ * @brief Delete a macro. The macros defined after it move down one position.
+ *
+ * @param p_macros pointer to the table.
+ * @param name name of the macro.
+ * @return true the macro has been deleted.
+ * @return false there is no macro with that name.
+ */
+bool command_macro_remove(command_macro_table_t *p_macros, command_slice_t name);
+
+/**
+ * @brief Find a macro by its name.
+ *
+ * @param p_macros pointer to the table.
+ * @param name name of the macro.
+ * @return const command_macro_t* pointer to the macro, or NULL if there is no macro with that name.
+ */
+const command_macro_t *command_macro_find(const command_macro_table_t *p_macros, command_slice_t name);
+
+/**
+ * @brief Get the number of macros.
+ *
+ * @param p_macros pointer to the table.
+ * @return uint32_t number of macros.
+ */
+uint32_t command_macro_get_count(const command_macro_table_t *p_macros);
+
+/**
+ * @brief Get a macro by its position, to list them.
+ *
+ * @param p_macros pointer to the table.
+ * @param index position of the macro, from 0 to command_macro_get_count() - 1.
+ * @return const command_macro_t* pointer to the macro, or NULL if `index` is out of the table.
+ */
+const command_macro_t *command_macro_get(const command_macro_table_t *p_macros, uint32_t index);
+
+#endif /* COMMAND_MACRO_H_ */
@@ -0,0 +1,246 @@
+/**
+ * @file command_table.h
+ * @brief Header for command_table.c file.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-17
+ */
+#ifndef COMMAND_TABLE_H_
+#define COMMAND_TABLE_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define COMMAND_TABLE_SLOTS 128             /*!< Slots of the hash table. Power of 2, and at least four times the number of commands so that a seed is always found */
+#define COMMAND_TABLE_MAX_COMMANDS (COMMAND_TABLE_SLOTS / 4) /*!< Maximum number of commands of a table */
+#define COMMAND_TABLE_MAX_SEEDS 65536       /*!< Seeds tried before giving up on a hash with no collisions */
+#define COMMAND_TABLE_EMPTY_SLOT 0xFF       /*!< Value of a slot with no command */
+#define COMMAND_MAX_ARGS 2                  /*!< Maximum number of arguments of a command */
+#define COMMAND_MAX_TOKENS (COMMAND_MAX_ARGS + 1) /*!< Maximum number of tokens of a command line: the name and its arguments */
+#define COMMAND_QUOTE '"'                   /*!< Character that starts and ends an argument with spaces */
+#define COMMAND_SEPARATOR ';'               /*!< Character that separates the commands of a line, unless it is between quotes */
+
+/* Enums */
+/**
+ * @brief Type of an argument of a command.
+ *
+ */
+enum COMMAND_ARG
+{
+    COMMAND_ARG_NONE = 0,   /*!< No more arguments */
+    COMMAND_ARG_INT,        /*!< Signed decimal integer */
+    COMMAND_ARG_DOUBLE,     /*!< Decimal number */
+    COMMAND_ARG_STRING,     /*!< Any word, interpreted by the handler */
+};
+
+/**
+ * @brief Result of running a command line.
+ *
+ */
+enum COMMAND_RESULT
+{
+    COMMAND_OK = 0,             /*!< The command has been executed */
+    COMMAND_EMPTY,              /*!< The line has no tokens */
+    COMMAND_NOT_FOUND,          /*!< There is no command with that name */
+    COMMAND_WRONG_ARGS,         /*!< The arguments do not match the schema of the command */
+    COMMAND_WRONG_QUOTES,       /*!< A quote is not closed, or is not followed by a space */
+    COMMAND_TOO_MANY_TOKENS,    /*!< The line has more than `COMMAND_MAX_TOKENS` tokens */
+};
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Piece of a line: where it starts and its length. It is not null terminated and it is not a copy.
+ */
+typedef struct
+{
+    const char *p_start;        /*!< First character */
+    uint32_t length;            /*!< Number of characters */
+} command_slice_t;
+
+/**
+ * @brief Argument of a command, already checked against the schema of the command.
+ */
+typedef struct
+{
+    bool present;               /*!< Flag to indicate that the argument has been given. Only false for optional arguments */
+    int32_t int_value;          /*!< Value of a `COMMAND_ARG_INT` argument */
+    double double_value;        /*!< Value of a `COMMAND_ARG_DOUBLE` argument */
+    command_slice_t text;       /*!< Text of the argument, whatever its type, without the quotes. Valid while the line is */
+} command_arg_t;
+
+/**
+ * @brief Function that executes a command.
+ *
+ * @param p_context pointer given to command_table_execute(), usually the FSM that owns the table.
+ * @param p_args pointer to the `COMMAND_MAX_ARGS` arguments, of the types of the schema. The ones not given are not `present`.
+ */
+typedef void (*command_handler_t)(void *p_context, const command_arg_t *p_args);
+
+/**
+ * @brief Command: name, handler, schema of its arguments and help.
+ */
+typedef struct
+{
+    const char *p_name;                     /*!< Name typed to run the command */
+    command_handler_t handler;              /*!< Function that executes the command */
+    uint8_t arg_types[COMMAND_MAX_ARGS];    /*!< One of `COMMAND_ARG` for each argument. `COMMAND_ARG_NONE` ends the list */
+    uint8_t required_args;                  /*!< Number of arguments that must be given. The rest are optional */
+    const char *p_summary;                  /*!< Short description for the pages of `help` */
+    const char *p_help;                     /*!< Long description for `help <command>`. The arguments are described from the schema */
+} command_t;
+
+/**
+ * @brief Table of commands with a perfect hash of their names.
+ *
+ * The seed of the hash is searched when the table is initialized, so that each name gets a slot of its own: a lookup
+ * hashes the name and compares it with the only command that can have it, whatever the number of commands.
+ */
+typedef struct
+{
+    const command_t *p_commands;            /*!< Commands, in the order of the help */
+    uint32_t count;                         /*!< Number of commands */
+    uint32_t seed;                          /*!< Seed of the hash with no collisions */
+    uint8_t slots[COMMAND_TABLE_SLOTS];     /*!< Index of the command of each slot, or `COMMAND_TABLE_EMPTY_SLOT` */
+} command_table_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Initialize a table of commands, searching a seed of the hash with no collisions.
+ *
+ * @param p_table pointer to the table.
+ * @param p_commands pointer to the commands. They must outlive the table.
+ * @param count number of commands, at most `COMMAND_TABLE_MAX_COMMANDS`.
+ * @return true the table is ready.
+ * @return false there are too many commands, two commands with the same name, or no seed has been found.
+ */
+bool command_table_init(command_table_t *p_table, const command_t *p_commands, uint32_t count);
+
+/**
+ * @brief Split a line into tokens separated by spaces, tabs or carriage returns, without copying it.
+ *
+ * A token that starts with `COMMAND_QUOTE` goes on until the next one, spaces included, and does not include the quotes.
+ *
+ * @param p_line pointer to the line. It does not need to be null terminated.
+ * @param length length of the line.
+ * @param p_tokens pointer to store the tokens, pointing into the line.
+ * @param max_tokens maximum number of tokens to store.
+ * @param p_count pointer to store the number of tokens complete, also when the line is wrong.
+ * @return uint32_t `COMMAND_OK`, `COMMAND_WRONG_QUOTES` or `COMMAND_TOO_MANY_TOKENS`.
+ */
+uint32_t command_tokenize(const char *p_line, uint32_t length, command_slice_t *p_tokens, uint32_t max_tokens, uint32_t *p_count);
+
+/**
+ * @brief Take the next command of a line with several commands separated by `COMMAND_SEPARATOR`, without copying it.
+ *
+ * A separator between quotes is part of the command, so that an argument can hold several commands.
+ *
+ * @param p_rest pointer to the part of the line not taken yet. It is moved past the command and its separator.
+ * @param p_command pointer to store the command, which can be empty.
+ * @return true a command has been taken.
+ * @return false the line has no more commands.
+ */
+bool command_split(command_slice_t *p_rest, command_slice_t *p_command);
+
+/**
+ * @brief Convert a token to an integer: an optional sign and decimal digits, with nothing else.
+ *
+ * @param slice token.
+ * @param p_value pointer to store the value.
+ * @return true the token is an integer that fits in `int32_t`.
+ * @return false the token is not an integer, or it does not fit.
+ */
+bool command_slice_to_int(command_slice_t slice, int32_t *p_value);
+
+/**
+ * @brief Convert a token to a number: an optional sign, decimal digits and an optional decimal point, with at least one digit.
+ *
+ * @param slice token.
+ * @param p_value pointer to store the value.
+ * @return true the token is a number.
+ * @return false the token is not a number.
+ */
+bool command_slice_to_double(command_slice_t slice, double *p_value);
+
+/**
+ * @brief Compare a token with a string.
+ *
+ * @param slice token.
+ * @param p_text string, null terminated.
+ * @return true the token and the string are the same.
+ * @return false they are different.
+ */
+bool command_slice_equals(command_slice_t slice, const char *p_text);
+
+/**
+ * @brief Find a command by its name: a hash and a comparison.
+ *
+ * @param p_table pointer to the table.
+ * @param name name of the command.
+ * @return const command_t* pointer to the command, or NULL if there is no command with that name.
+ */
+const command_t *command_table_find(const command_table_t *p_table, command_slice_t name);
+
+/**
+ * @brief Find a command by its name comparing it with every command in order, as a chain of `strcmp()` does. Only to measure the hash.
+ *
+ * @param p_table pointer to the table.
+ * @param name name of the command.
+ * @return const command_t* pointer to the command, or NULL if there is no command with that name.
+ */
+const command_t *command_table_find_linear(const command_table_t *p_table, command_slice_t name);
+
+/**
+ * @brief Get the number of commands of the table.
+ *
+ * @param p_table pointer to the table.
+ * @return uint32_t number of commands.
+ */
+uint32_t command_table_get_count(const command_table_t *p_table);
+
+/**
+ * @brief Get a command by its position in the table, to list them.
+ *
+ * @param p_table pointer to the table.
+ * @param index position of the command, from 0 to command_table_get_count() - 1.
+ * @return const command_t* pointer to the command, or NULL if `index` is out of the table.
+ */
+const command_t *command_table_get(const command_table_t *p_table, uint32_t index);
+
+/**
+ * @brief Check the arguments of a command against its schema and convert them.
+ *
+ * @param p_command pointer to the command.
+ * @param p_tokens pointer to the arguments, without the name of the command.
+ * @param count number of arguments.
+ * @param p_args pointer to store the `COMMAND_MAX_ARGS` arguments.
+ * @return true the arguments match the schema.
+ * @return false an argument is missing, not expected, or not a number of the type expected.
+ */
+bool command_parse_args(const command_t *p_command, const command_slice_t *p_tokens, uint32_t count, command_arg_t *p_args);
+
+/**
+ * @brief Describe the arguments of a command from its schema, such as "Parameters: an integer, a word (optional)."
+ *
+ * @param p_command pointer to the command.
+ * @param p_text pointer to store the description, null terminated.
+ * @param size size of `p_text`.
+ */
+void command_get_args_help(const command_t *p_command, char *p_text, uint32_t size);
+
+/**
+ * @brief Split a line, find its command, check its arguments and execute it.
+ *
+ * @param p_table pointer to the table.
+ * @param p_context pointer given to the handler.
+ * @param p_line pointer to the line. It does not need to be null terminated, and it must not change until the handler returns.
+ * @param length length of the line.
+ * @param pp_command pointer to store the command found, or NULL if there is none. It can be NULL.
+ * @return uint32_t one of `COMMAND_RESULT`.
+ */
+uint32_t command_table_execute(const command_table_t *p_table, void *p_context, const char *p_line, uint32_t length, const command_t **pp_command);
+
+#endif /* COMMAND_TABLE_H_ */
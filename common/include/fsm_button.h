@@ -17,6 +17,8 @@
 
 /* Other includes */
 #include "fsm.h"
+#include "fsm_index.h"
+#include "port_system.h"
 #include <stm32f446xx.h>
 
 /* Defines and enums ----------------------------------------------------------*/
@@ -39,8 +41,9 @@ enum FSM_BUTTON
  * @brief FSM Button strutcture.
  * @param f 
  * @param debounce_time
- * @param next_timeout
+ * @param debounce_timer
  * @param tick_pressed
+ * @param last_edge_ms
  * @param duration
  * @param button_id
  *
@@ -48,9 +51,11 @@ enum FSM_BUTTON
 typedef struct
 {
     fsm_t f;
+    fsm_index_t index;
     uint32_t debounce_time;
-    uint32_t next_timeout;
+    port_system_timer_t debounce_timer; /*!< Timer of the debounce time. It posts `SYSTEM_EVENT_BUTTON` when it expires */
     uint32_t tick_pressed;
+    uint32_t last_edge_ms;              /*!< Time of the last edge taken. The edges until the debounce time after it are bounces */
     uint32_t duration;
     uint32_t button_id;
 } fsm_button_t;
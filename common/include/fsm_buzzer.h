@@ -16,32 +16,45 @@
 
 /* Other includes */
 #include <fsm.h>
+#include "fsm_index.h"
 #include "melodies.h"
+#include "melody_view.h"
 
 /* HW dependent includes */
+#include "port_buzzer.h"
 
 
 /* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define BUZZER_SPEED_ONE (1UL << 16)                       /*!< Player speed 1.0 in Q16.16 fixed point */
+#define BUZZER_SPEED_MIN (BUZZER_SPEED_ONE / 10)           /*!< Minimum player speed (0.1) in Q16.16 */
+#define BUZZER_SPEED_MAX (BUZZER_SPEED_ONE * 10)           /*!< Maximum player speed (10.0) in Q16.16 */
+
 /* Typedefs --------------------------------------------------------------------*/
 
 /**
  * @brief FSM Buzzer strutcture
  * @param f 
- * @param p_melody
- * @param note_index
+ * @param view
+ * @param iterator
  * @param buzzer_id
  * @param user_action
  * @param player_speed
+ * @param duration_scale
+ * @param sequencer
  * 
  */
 typedef struct
 {
     fsm_t f;
-    melody_t * p_melody;
-    uint32_t note_index;
+    fsm_index_t index;          /*!< Index of the transitions of each state. It must follow `f` */
+    melody_view_t view;         /*!< Melody to play and how: direction, transposition and tempo */
+    melody_iterator_t iterator; /*!< Next note of `view` */
     uint8_t buzzer_id;
     uint8_t user_action;
-    double player_speed;
+    uint32_t player_speed;      /*!< Player speed in Q16.16 fixed point */
+    uint32_t duration_scale;    /*!< 1 / player_speed with `MELODY_VIEW_SCALE_SHIFT` fractional bits, so a note duration is a multiplication */
+    bool sequencer;             /*!< Flag to play the melodies with the DMA sequencer of the PORT instead of note by note */
 } fsm_buzzer_t;
 
 /* Enums */
@@ -56,7 +69,9 @@ enum FSM_BUZZER
   PLAY_NOTE,            //
   PAUSE_NOTE,           //
   WAIT_NOTE,            //
-  WAIT_MELODY           //
+  WAIT_MELODY,          //
+  SEQUENCE,             // The DMA sequencer plays the melody
+  SEQUENCE_PAUSE        // The DMA sequencer is paused in the middle of a note
 };
 
 /**
@@ -72,20 +87,82 @@ enum USER_ACTIONS
 
 /* Function prototypes and explanation -------------------------------------------------*/
 /**
- * @brief Set melody to queue.
+ * @brief Set melody to queue. It is played as it is: forwards, not transposed and at its tempo.
  * 
  * @param p_this pointer to a FSM with a FSM buzzer in it.
  * @param p_melody pointer to a melody that is going to be queued
  */
 void fsm_buzzer_set_melody (fsm_t *p_this, const melody_t *p_melody);
-//void fsm_buzzer_set_reverse_melody (fsm_t *p_this, const melody_t *p_melody);
+
+/**
+ * @brief Set melody to queue, to be played from the last note to the first one. The melody is not copied.
+ * 
+ * @param p_this pointer to a FSM with a FSM buzzer in it.
+ * @param p_melody pointer to a melody that is going to be queued
+ */
+void fsm_buzzer_set_reverse_melody (fsm_t *p_this, const melody_t *p_melody);
+
+/**
+ * @brief Transpose the queued melody. It applies from the next note, and until another melody is queued.
+ * 
+ * @param p_this pointer to a FSM with a FSM buzzer in it.
+ * @param semitones semitones to add to each note, limited to +/- MELODY_VIEW_TRANSPOSE_MAX.
+ */
+void fsm_buzzer_set_transpose (fsm_t *p_this, int32_t semitones);
+
+/**
+ * @brief Set the tempo of the queued melody. It applies from the next note, and until another melody is queued.
+ * 
+ * Unlike the speed, which is kept for all the melodies, the tempo belongs to the queued melody.
+ * 
+ * @param p_this pointer to a FSM with a FSM buzzer in it.
+ * @param tempo tempo in Q16.16 fixed point (MELODY_VIEW_TEMPO_ONE is 1.0), limited to MELODY_VIEW_TEMPO_MIN - MELODY_VIEW_TEMPO_MAX.
+ */
+void fsm_buzzer_set_tempo (fsm_t *p_this, uint32_t tempo);
+
+/**
+ * @brief Set speed that the media player should play at. It is limited
+ * to the range BUZZER_SPEED_MIN - BUZZER_SPEED_MAX.
+ * 
+ * @param p_this pointer to a FSM with a FSM buzzer in it.
+ * @param speed speed that the media player should play at, in Q16.16 fixed point (BUZZER_SPEED_ONE is 1.0).
+ */
+void fsm_buzzer_set_speed (fsm_t *p_this, uint32_t speed);
+
+/**
+ * @brief Enable or disable the measurement of the gaps between consecutive notes. Enabling it clears the statistics.
+ * 
+ * @param p_this pointer to a FSM with a FSM buzzer in it.
+ * @param enable true to measure the gaps.
+ */
+void fsm_buzzer_set_gap_measurement (fsm_t *p_this, bool enable);
+
 /**
- * @brief Set speed that the media player should play at.
+ * @brief Get the statistics of the gaps between consecutive notes.
  * 
  * @param p_this pointer to a FSM with a FSM buzzer in it.
- * @param speed speed that the media player should play at.
+ * @param p_stats pointer to store the statistics.
  */
-void fsm_buzzer_set_speed (fsm_t *p_this, double speed);
+void fsm_buzzer_get_gap_stats (fsm_t *p_this, port_buzzer_gap_stats_t *p_stats);
+
+/**
+ * @brief Enable or disable the DMA sequencer. With it, the notes are fed to the timers by DMA from a buffer that is
+ * refilled every BUZZER_SEQUENCER_HALF_LENGTH notes, so the CPU can sleep while the melody plays. Changes of
+ * transposition, tempo and speed are heard from the next refill. It applies from the next melody that starts.
+ * 
+ * @param p_this pointer to a FSM with a FSM buzzer in it.
+ * @param enable true to use the sequencer.
+ */
+void fsm_buzzer_set_sequencer (fsm_t *p_this, bool enable);
+
+/**
+ * @brief Check whether the DMA sequencer is enabled.
+ * 
+ * @param p_this pointer to a FSM with a FSM buzzer in it.
+ * @return true the sequencer is enabled
+ * @return false the melodies are played note by note
+ */
+bool fsm_buzzer_get_sequencer (fsm_t *p_this);
 
 /**
  * @brief Set action that the media player should do
@@ -103,6 +180,24 @@ void fsm_buzzer_set_action (fsm_t *p_this, uint8_t action);
  */
 uint8_t fsm_buzzer_get_action (fsm_t *p_this);
 
+/**
+ * @brief Get the index of the next note of the melody, counted in the direction it is played.
+ * 
+ * With the DMA sequencer, it is the next note to be handed to the sequencer, a few notes ahead of the one sounding.
+ * 
+ * @param p_this pointer to a FSM with a FSM buzzer in it.
+ * @return uint32_t index of the next note.
+ */
+uint32_t fsm_buzzer_get_note_index (fsm_t *p_this);
+
+/**
+ * @brief Get the player speed.
+ * 
+ * @param p_this pointer to a FSM with a FSM buzzer in it.
+ * @return uint32_t player speed in Q16.16 fixed point.
+ */
+uint32_t fsm_buzzer_get_speed (fsm_t *p_this);
+
 /**
  * @brief Creates a new FSM buzzer.
  * 
@@ -120,11 +215,12 @@ fsm_t * fsm_buzzer_new (uint32_t buzzer_id);
 void fsm_buzzer_init (fsm_t *p_this, uint32_t buzzer_id);
 
 /**
- * @brief Check whether the MEDIA player is playing a song or not.
+ * @brief Check whether the MEDIA player is playing a song or not. A song played by the DMA sequencer only counts
+ * as activity when the FSM has something to do: refill the buffer or end the song.
  * 
  * @param p_this pointer to a FSM with a FSM buzzer in it.
  * @return true Currently playing
- * @return false Currently not playing
+ * @return false Currently not playing, or the sequencer plays on its own
  */
 bool fsm_buzzer_check_activity (fsm_t *p_this);
 
@@ -0,0 +1,103 @@
+/**
+ * @file fsm_index.h
+ * @brief Header for fsm_index.c file.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-10
+ */
+#ifndef FSM_INDEX_H_
+#define FSM_INDEX_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Other includes */
+#include <fsm.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define FSM_INDEX_MAX_STATES 16          /*!< Maximum number of states of an indexed FSM */
+#define FSM_INDEX_MAX_TRANSITIONS 64     /*!< Maximum number of transitions of an indexed FSM */
+#define FSM_INDEX_MAX_SHARED_GUARDS 4    /*!< Maximum number of shared guards of an indexed FSM */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Counters of an indexed FSM, to compare it with the linear scan of `fsm_fire()`.
+ */
+typedef struct
+{
+    uint32_t fires;             /*!< Calls to `fsm_index_fire()` */
+    uint32_t rows_linear;       /*!< Rows that `fsm_fire()` would have compared: up to the one taken, or all of them */
+    uint32_t guard_calls;       /*!< Guards called: only the rows of the current state */
+    uint32_t shared_hits;       /*!< Shared guards answered with the result already computed in the same fire */
+} fsm_index_stats_t;
+
+/**
+ * @brief Index of the transition table of a FSM: the rows of each state, in the order of the table.
+ *
+ * The FSM structure must have the index right after its `fsm_t`, so that it can be found from the `fsm_t` pointer
+ * (see `fsm_indexed_t`).
+ */
+typedef struct
+{
+    const fsm_trans_t *p_tt;                            /*!< Transition table */
+    uint8_t states_count;                               /*!< Number of states: highest state + 1 */
+    uint8_t first[FSM_INDEX_MAX_STATES + 1];            /*!< Position in `rows` of the first row of each state. The rows of state s are first[s] .. first[s + 1] - 1 */
+    uint8_t rows[FSM_INDEX_MAX_TRANSITIONS];            /*!< Rows of the table, grouped by origin state */
+    uint32_t shared_fire[FSM_INDEX_MAX_SHARED_GUARDS];  /*!< Fire in which each shared guard was computed */
+    bool shared_value[FSM_INDEX_MAX_SHARED_GUARDS];     /*!< Result of each shared guard in that fire */
+    fsm_index_stats_t stats;                            /*!< Counters */
+} fsm_index_t;
+
+/**
+ * @brief Beginning of every indexed FSM structure.
+ */
+typedef struct
+{
+    fsm_t f;            /*!< FSM of the library */
+    fsm_index_t index;  /*!< Index of its transition table */
+} fsm_indexed_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Build the index of the transition table of a FSM. Call it after `fsm_init()`.
+ *
+ * The table is read once, so this is the only place where all its rows are visited.
+ *
+ * @param p_this pointer to a FSM whose structure starts like `fsm_indexed_t`.
+ * @param p_tt transition table, ended by a row with a negative origin state.
+ */
+void fsm_index_init(fsm_t *p_this, const fsm_trans_t *p_tt);
+
+/**
+ * @brief Fire a FSM, as `fsm_fire()` does, but only visiting the rows of the current state.
+ *
+ * @param p_this pointer to an indexed FSM.
+ * @return int 1 if a transition has been taken, 0 if not.
+ */
+int fsm_index_fire(fsm_t *p_this);
+
+/**
+ * @brief Evaluate a guard that is used in several rows only once per fire.
+ *
+ * The first call in a fire calls `guard` and stores its result in `slot`. The next calls in the same fire return it.
+ *
+ * @param p_this pointer to an indexed FSM.
+ * @param slot slot of the guard, from 0 to FSM_INDEX_MAX_SHARED_GUARDS - 1.
+ * @param guard guard to evaluate.
+ * @return true the guard is true.
+ * @return false the guard is false.
+ */
+bool fsm_index_shared_guard(fsm_t *p_this, uint32_t slot, fsm_input_func_t guard);
+
+/**
+ * @brief Get the counters of an indexed FSM.
+ *
+ * @param p_this pointer to an indexed FSM.
+ * @param p_stats pointer to store the counters.
+ */
+void fsm_index_get_stats(fsm_t *p_this, fsm_index_stats_t *p_stats);
+
+#endif /* FSM_INDEX_H_ */
@@ -12,13 +12,20 @@
 /* Standard C includes */
 #include <stdint.h>
 #include <fsm.h>
+#include "fsm_index.h"
 
 /* Other includes */
 #include "melodies.h"
+#include "melody_pool.h"
+#include "port_system.h"
+#include "command_macro.h"
 
 /* Defines and enums ----------------------------------------------------------*/
 /* Defines */
-#define MELODIES_MEMORY_SIZE 11     /*!< Size of the memory of melodies*/
+#define JUKEBOX_LOAD_TIMEOUT_MS 2000        /*!< Time without data to abort the upload of a melody */
+#define JUKEBOX_LOAD_CHUNK_LENGTH 32        /*!< Maximum bytes of an upload processed each time the FSM is fired */
+#define JUKEBOX_BAUD_CONFIRM_MS 5000        /*!< Time to receive `baud ok` at a new baud rate before going back to the old one */
+#define JUKEBOX_BAUD_BENCH_BLOCKS 16        /*!< Blocks of 128 bytes sent by `baud bench` */
 
 /* Enums */
 /**
@@ -31,15 +38,58 @@ enum FSM_JUKEBOX
   START_UP,
   WAIT_COMMAND,
   SLEEP_WHILE_OFF,
-  SLEEP_WHILE_ON
+  SLEEP_WHILE_ON,
+  LOAD_MELODY
+};
+
+/**
+ * @brief Opcodes of the binary packets. The payloads are little endian. Every reply starts with one of `JUKEBOX_PACKET_RESULT`.
+ * 
+ * Unless said otherwise, the reply is followed by the status: action of the player (`USER_ACTIONS`), state of the jukebox
+ * (`FSM_JUKEBOX`), melody (u16), next note (u16), notes of the melody (u16) and speed in hundredths (u16).
+ */
+enum JUKEBOX_OPCODE
+{
+  JUKEBOX_OP_STATUS = 0x01,   /*!< No payload */
+  JUKEBOX_OP_PLAY,            /*!< No payload */
+  JUKEBOX_OP_STOP,            /*!< No payload */
+  JUKEBOX_OP_PAUSE,           /*!< No payload */
+  JUKEBOX_OP_NEXT,            /*!< No payload */
+  JUKEBOX_OP_SELECT,          /*!< Melody (u16) */
+  JUKEBOX_OP_SPEED,           /*!< Speed in hundredths (u16), 10 to 1000 */
+  JUKEBOX_OP_INFO,            /*!< Melody (u16). Reply: notes (u16) and name, instead of the status */
+  JUKEBOX_OP_COMMAND,         /*!< Text commands, with no end of line. Their answers are sent as text before the reply */
+};
+
+/**
+ * @brief Result of a binary packet, first byte of its reply.
+ * 
+ */
+enum JUKEBOX_PACKET_RESULT
+{
+  JUKEBOX_PACKET_OK = 0,          /*!< The packet has been executed */
+  JUKEBOX_PACKET_WRONG_OPCODE,    /*!< There is no such opcode */
+  JUKEBOX_PACKET_WRONG_PAYLOAD,   /*!< The payload is too short, too long or out of range */
+  JUKEBOX_PACKET_NOT_FOUND,       /*!< There is no melody with that index */
+  JUKEBOX_PACKET_WRONG_FRAME,     /*!< The frame is not COBS or its CRC is wrong. The reply has opcode `PACKET_REPLY` and ID 0 */
 };
 
 /* Typedefs ------------------------------------------------------------------*/
+/**
+ * @brief Function that writes a chunk of a long answer, such as one melody of `list`.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param index number of the chunk, from 0.
+ * @param p_chunk pointer to store the chunk, null terminated.
+ * @param size size of `p_chunk`.
+ * @return uint32_t length of the chunk. It can be 0, to skip it.
+ */
+typedef uint32_t (*fsm_jukebox_chunk_t)(void *p_context, uint32_t index, char *p_chunk, uint32_t size);
 
 /**
  * @brief FSM Jukebox strutcture.
  * @param f 
- * @param melodies
+ * @param p_catalog
  * @param melody_idx
  * @param p_melody
  * @param on_off_press_time_ms
@@ -48,14 +98,19 @@ enum FSM_JUKEBOX
  * @param next_song_press_time_ms
  * @param speed
  * @param p_fsm_keypad
+ * @param p_pool
+ * @param load_timer
+ * @param baud_timer
+ * @param baud_previous
  * 
  */
 typedef struct
 {
     fsm_t f;
-    melody_t melodies [MELODIES_MEMORY_SIZE];
-    uint8_t melody_idx;
-    char * p_melody;
+    fsm_index_t index;
+    const melody_catalog_t * p_catalog;
+    uint32_t melody_idx;
+    const char * p_melody;
     fsm_t * p_fsm_button;
     uint32_t on_off_press_time_ms;
     fsm_t * p_fsm_usart;
@@ -65,6 +120,23 @@ typedef struct
 
     // v5
     fsm_t * p_fsm_keypad;
+
+    melody_pool_t * p_pool;
+    port_system_timer_t load_timer; /*!< Timeout of the upload of a melody. It posts `SYSTEM_EVENT_JUKEBOX` when it expires */
+    port_system_timer_t baud_timer; /*!< Time to confirm a new baud rate. It posts `SYSTEM_EVENT_JUKEBOX` when it expires */
+    uint32_t baud_previous;         /*!< Baud rate to go back to if the new one is not confirmed, or 0 */
+
+    uint32_t loop_iterations;   /*!< Iterations of the main loop at the last `loop` command */
+    uint32_t loop_wakeups;      /*!< Wakeups of the main loop at the last `loop` command */
+    uint64_t loop_awake_cycles; /*!< CPU cycles awake at the last `loop` command */
+    uint32_t loop_ms;           /*!< Time of the last `loop` command */
+
+    command_macro_table_t macros;   /*!< Macros defined with the `macro` command */
+    uint32_t macro_depth;           /*!< Number of macros being run, one inside the other */
+
+    fsm_jukebox_chunk_t response;   /*!< Writer of the chunks of the answer being sent, or NULL */
+    uint32_t response_index;        /*!< Next chunk of the answer */
+    uint32_t response_count;        /*!< Number of chunks of the answer */
   } fsm_jukebox_t;
 
 /* Function prototypes and explanation ---------------------------------------*/
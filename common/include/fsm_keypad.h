@@ -10,6 +10,8 @@
 #define FSM_KEYPAD_H_
 
 #include "fsm.h"
+#include "fsm_index.h"
+#include "port_system.h"
 #include <stdint.h>
 
 /* Defines and enums ----------------------------------------------------------*/
@@ -17,6 +19,7 @@
 enum {
     STATE_WAIT_KEY=0,   /*!< INITIAL STATUS. Waiting for key status*/
     STATE_KEY_PRESSED,  /*!< Key being pressed status*/
+    STATE_WAIT_SCAN,    /*!< A row interrupted but no key was found: waiting for the scan timer before unmasking the rows again*/
 };
 
 /* Typedefs --------------------------------------------------------------------*/
@@ -26,12 +29,15 @@ enum {
  * @param keypad_id
  * @param last_key
  * @param key_received
+ * @param scan_timer
  */
 typedef struct {
     fsm_t f;  
+    fsm_index_t index;
     uint32_t keypad_id;
     char last_key;
     bool key_received;
+    port_system_timer_t scan_timer; /*!< Timer of the scans while a key is down, or before unmasking the rows after a scan with no key. It posts `SYSTEM_EVENT_KEYPAD` when it expires */
 } fsm_keypad_t;
 
 /* Function prototypes and explanation -------------------------------------------------*/
@@ -69,11 +75,11 @@ bool fsm_keypad_check_key_received(fsm_t *p_this);
 char fsm_keypad_get_key(fsm_t *p_this);
 
 /**
- * @brief Check the current status of the keypad.
+ * @brief Check if the keypad has activity, that is, a key is being pressed.
  * 
  * @param p_this pointer to a FSM with a FSM keypad in it.
- * @return true if the status is STATE_WAIT_KEY
- * @return false if the status is different from STATE_WAIT_KEY
+ * @return true if the status is STATE_KEY_PRESSED or STATE_WAIT_SCAN
+ * @return false if the status is STATE_WAIT_KEY
  */
 bool fsm_keypad_check_activity(fsm_t * p_this);
 
@@ -16,6 +16,7 @@
 
 /* Other includes */
 #include <fsm.h>
+#include "fsm_index.h"
 #include "port_usart.h"
 
 
@@ -29,18 +30,17 @@
  * @brief FSM USART structure.
  * @param f 
  * @param data_received
- * @param in_data
- * @param out_data
  * @param usart_id
+ * @param baud_next
  * 
  */
 typedef struct
 {
     fsm_t f;
+    fsm_index_t index;
     bool data_received;
-    char in_data[USART_INPUT_BUFFER_LENGTH];
-    char out_data[USART_OUTPUT_BUFFER_LENGTH];
     uint32_t usart_id;
+    uint32_t baud_next;     /*!< Baud rate to change to once the messages queued have been sent, or 0 */
 } fsm_usart_t;
 
 /* Enums */
@@ -81,23 +81,57 @@ void fsm_usart_init(fsm_t *p_this, uint32_t usart_id);
 bool fsm_usart_check_data_received(fsm_t *p_this);
 
 /**
- * @brief Copy the received data to the p_data array.
+ * @brief Get the line received, without copying it. It stays in the RX ring until fsm_usart_reset_input_data() is called.
  * 
  * @param p_this pointer to a FSM with a FSM USART in it.
- * @param p_data pointer to an array where we will copy the received data.
+ * @param pp_line pointer to store the address of the line. It is not null terminated.
+ * @return uint32_t length of the line, without the end of line.
  */
-void fsm_usart_get_in_data(fsm_t *p_this, char *p_data);
+uint32_t fsm_usart_get_line(fsm_t *p_this, const char **pp_line);
 
 /**
- * @brief Copy the data from the p_data array to send it.
+ * @brief Queue a copy of a string to send it, without waiting. Only its length is copied, so the array can be reused straight away.
  * 
  * @param p_this pointer to a FSM with a FSM USART in it.
- * @param p_data pointer to an array where we will copy the sent data from.
+ * @param p_data pointer to the null terminated string to send.
+ * @return true the string has been queued.
+ * @return false the TX queue is full. The string is dropped.
  */
-void fsm_usart_set_out_data(fsm_t *p_this, char *p_data);
+bool fsm_usart_set_out_data(fsm_t *p_this, const char *p_data);
 
 /**
- * @brief Resets the input data buffer.
+ * @brief Check whether a copy of a message of some length can be queued now.
+ * 
+ * @param p_this pointer to a FSM with a FSM USART in it.
+ * @param length length of the message.
+ * @return true the message fits in the TX queue.
+ * @return false the TX queue is too full: the message would be dropped.
+ */
+bool fsm_usart_check_tx_room(fsm_t *p_this, uint32_t length);
+
+/**
+ * @brief Queue a copy of binary data to send it, without waiting.
+ * 
+ * @param p_this pointer to a FSM with a FSM USART in it.
+ * @param p_data pointer to the data.
+ * @param length number of bytes to send.
+ * @return true the data has been queued.
+ * @return false the TX queue is full. The data is dropped.
+ */
+bool fsm_usart_send_data(fsm_t *p_this, const uint8_t *p_data, uint32_t length);
+
+/**
+ * @brief Queue a string that does not change, such as a string literal, to send it without copying it and without waiting.
+ * 
+ * @param p_this pointer to a FSM with a FSM USART in it.
+ * @param p_data pointer to the null terminated string to send. It must not change until it has been sent.
+ * @return true the string has been queued.
+ * @return false the TX queue is full. The string is dropped.
+ */
+bool fsm_usart_send_const(fsm_t *p_this, const char *p_data);
+
+/**
+ * @brief Releases the line received, so the next one can be taken.
  * 
  * @param p_this pointer to a FSM with a FSM USART in it.
  */
@@ -120,24 +154,106 @@ bool fsm_usart_check_activity(fsm_t *p_this);
 void fsm_usart_disable_rx_interrupt(fsm_t *p_this);
 
 /**
- * @brief Disable the TX interrupt for the USART.
+ * @brief Enable the RX interrupt for the USART.
+ * 
+ * @param p_this pointer to a FSM with a FSM USART in it.
+ */
+void fsm_usart_enable_rx_interrupt(fsm_t *p_this);
+
+/**
+ * @brief Start receiving binary data: every byte received is kept, with no end of line, and read with `fsm_usart_read_raw()`.
+ * 
+ * The sender is paused and resumed with XOFF/XON so that no byte is lost.
  * 
  * @param p_this pointer to a FSM with a FSM USART in it.
  */
-void fsm_usart_disable_tx_interrupt(fsm_t *p_this);
+void fsm_usart_enable_raw_rx(fsm_t *p_this);
 
 /**
- * @brief Enable the RX interrupt for the USART.
+ * @brief Go back to receiving commands. The bytes received after the binary data are read as commands.
  * 
  * @param p_this pointer to a FSM with a FSM USART in it.
  */
-void fsm_usart_enable_rx_interrupt(fsm_t *p_this);
+void fsm_usart_disable_raw_rx(fsm_t *p_this);
+
+/**
+ * @brief Read the binary data received. It is kept until it is released with `fsm_usart_release_raw()`.
+ * 
+ * @param p_this pointer to a FSM with a FSM USART in it.
+ * @param p_data pointer to an array where we will copy the received data.
+ * @param max_length maximum number of bytes to copy.
+ * @return uint32_t number of bytes copied.
+ */
+uint32_t fsm_usart_read_raw(fsm_t *p_this, uint8_t *p_data, uint32_t max_length);
+
+/**
+ * @brief Release the first bytes of binary data read, once they have been used. The rest is read again.
+ * 
+ * @param p_this pointer to a FSM with a FSM USART in it.
+ * @param length number of bytes used.
+ */
+void fsm_usart_release_raw(fsm_t *p_this, uint32_t length);
+
+/**
+ * @brief Check whether binary data has been lost.
+ * 
+ * @param p_this pointer to a FSM with a FSM USART in it.
+ * @return true data has been lost because the sender did not stop on XOFF.
+ * @return false no data has been lost.
+ */
+bool fsm_usart_check_raw_overrun(fsm_t *p_this);
+
+/**
+ * @brief Check whether there is binary data left to read, or a paused sender waiting for the reads to resume it.
+ * 
+ * @param p_this pointer to a FSM with a FSM USART in it.
+ * @return true `fsm_usart_read_raw()` must be called again, even if no new byte arrives.
+ * @return false all the data received has been read.
+ */
+bool fsm_usart_check_raw_pending(fsm_t *p_this);
+
+/**
+ * @brief Check whether a baud rate can be used.
+ * 
+ * @param p_this pointer to a FSM with a FSM USART in it.
+ * @param baud baud rate asked for.
+ * @param p_actual pointer to store the baud rate really given by the clock of the USART. It can be NULL.
+ * @return true the baud rate can be used.
+ * @return false the baud rate is out of range or too far from any the clock can give.
+ */
+bool fsm_usart_check_baud(fsm_t *p_this, uint32_t baud, uint32_t *p_actual);
+
+/**
+ * @brief Change the baud rate once all the messages queued so far have been sent, so they are received at the old one.
+ * 
+ * @param p_this pointer to a FSM with a FSM USART in it.
+ * @param baud new baud rate.
+ * @return true the baud rate will be changed.
+ * @return false the baud rate can't be used.
+ */
+bool fsm_usart_set_baud(fsm_t *p_this, uint32_t baud);
+
+/**
+ * @brief Get the baud rate in use, or the one it is going to change to.
+ * 
+ * @param p_this pointer to a FSM with a FSM USART in it.
+ * @return uint32_t baud rate.
+ */
+uint32_t fsm_usart_get_baud(fsm_t *p_this);
+
+/**
+ * @brief Get the statistics of the transmission since the last reset.
+ * 
+ * @param p_this pointer to a FSM with a FSM USART in it.
+ * @param p_stats pointer to store the statistics.
+ */
+void fsm_usart_get_tx_stats(fsm_t *p_this, port_usart_tx_stats_t *p_stats);
 
 /**
- * @brief Enable the TX interrupt for the USART.
+ * @brief Reset the statistics of the transmission.
  * 
  * @param p_this pointer to a FSM with a FSM USART in it.
  */
-void fsm_usart_enable_tx_interrupt(fsm_t *p_this);
+void fsm_usart_reset_tx_stats(fsm_t *p_this);
 
 #endif /* FSM_USART_H_ */
@@ -12,74 +12,112 @@
 #include <stdint.h>
 
 /* Defines and enums ----------------------------------------------------------*/
-#define SILENCE 0 /*!< Silence note */
-
-// 3rd Octave (Tercera Octava)
-#define DO3 130.813   /*!< DO3 note frequency */
-#define DOs3 138.591  /*!< DO#3 note frequency */
-#define RE3 146.832   /*!< RE3 note frequency */
-#define REs3 155.563  /*!< RE#3 note frequency */
-#define MI3 164.814   /*!< MI3 note frequency */
-#define FA3 174.614   /*!< FA3 note frequency */
-#define FAs3 184.997  /*!< FA#3 note frequency */
-#define SOL3 195.998  /*!< SOL3 note frequency */
-#define SOLs3 207.652 /*!< SOL#3 note frequency */
-#define LA3 220.000   /*!< LA3 note frequency */
-#define LAs3 233.082  /*!< LA#3 note frequency */
-#define SI3 246.942   /*!< SI3 note frequency */
-
-// 4th Octave (Cuarta Octava)
-#define DO4 261.626   /*!< DO4 note frequency */
-#define DOs4 277.183  /*!< DO#4 note frequency */
-#define RE4 293.665   /*!< RE4 note frequency */
-#define REs4 311.127  /*!< RE#4 note frequency */
-#define MI4 329.628   /*!< MI4 note frequency */
-#define FA4 349.228   /*!< FA4 note frequency */
-#define FAs4 369.994  /*!< FA#4 note frequency */
-#define SOL4 391.995  /*!< SOL4 note frequency */
-#define SOLs4 415.305 /*!< SOL#4 note frequency */
-#define LA4 440.000   /*!< LA4 note frequency */
-#define LAs4 466.164  /*!< LA#4 note frequency */
-#define SI4 493.883   /*!< SI4 note frequency */
-
-// 5th Octave (Quinta Octava)
-#define DO5 523.251   /*!< DO5 note frequency */
-#define DOs5 554.365  /*!< DO#5 note frequency */
-#define RE5 587.330   /*!< RE5 note frequency */
-#define REs5 622.254  /*!< RE#5 note frequency */
-#define MI5 659.255   /*!< MI5 note frequency */
-#define FA5 698.456   /*!< FA5 note frequency */
-#define FAs5 739.989  /*!< FA#5 note frequency */
-#define SOL5 783.991  /*!< SOL5 note frequency */
-#define SOLs5 830.609 /*!< SOL#5 note frequency */
-#define LA5 880.000   /*!< LA5 note frequency */
-#define LAs5 932.328  /*!< LA#5 note frequency */
-#define SI5 987.767   /*!< SI5 note frequency */
-
-// 6th Octave (Quinta Octava)
-#define DO6 1046.502  /*!< DO6 note frequency */
-#define DOs6 1108.73  /*!< DO#6 note frequency */
-#define RE6 1174.66   /*!< RE6 note frequency */
-#define REs6 1244.508  /*!< RE#6 note frequency */
-#define MI6 1318.51   /*!< MI6 note frequency */
-#define FA6 1396.912   /*!< FA6 note frequency */
-#define FAs6 1479.978  /*!< FA#6 note frequency */
-#define SOL6 1567.982  /*!< SOL6 note frequency */
-#define SOLs6 1661.218 /*!< SOL#6 note frequency */
-#define LA6 1760.000  /*!< LA6 note frequency */
-#define LAs6 1864.656  /*!< LA#6 note frequency */
-#define SI6 1975.534   /*!< SI6 note frequency */
+#define NOTE_MIDI_DO3 48 /*!< MIDI note number of DO3, the lowest note of the table */
+/**
+ * @brief List of the notes the buzzer can play, from DO3 to SI6, as X(name, frequency in Hz).
+ *
+ * The list is expanded into the `NOTES` enum below and into the timer lookup table of `port_buzzer.c`,
+ * so the frequencies are only written here.
+ */
+#define MELODIES_NOTES(X) \
+    /* 3rd Octave (Tercera Octava) */ \
+    X(DO3,   130.813)   /*!< DO3 note frequency */ \
+    X(DOs3,  138.591)   /*!< DO#3 note frequency */ \
+    X(RE3,   146.832)   /*!< RE3 note frequency */ \
+    X(REs3,  155.563)   /*!< RE#3 note frequency */ \
+    X(MI3,   164.814)   /*!< MI3 note frequency */ \
+    X(FA3,   174.614)   /*!< FA3 note frequency */ \
+    X(FAs3,  184.997)   /*!< FA#3 note frequency */ \
+    X(SOL3,  195.998)   /*!< SOL3 note frequency */ \
+    X(SOLs3, 207.652)   /*!< SOL#3 note frequency */ \
+    X(LA3,   220.000)   /*!< LA3 note frequency */ \
+    X(LAs3,  233.082)   /*!< LA#3 note frequency */ \
+    X(SI3,   246.942)   /*!< SI3 note frequency */ \
+    /* 4th Octave (Cuarta Octava) */ \
+    X(DO4,   261.626)   /*!< DO4 note frequency */ \
+    X(DOs4,  277.183)   /*!< DO#4 note frequency */ \
+    X(RE4,   293.665)   /*!< RE4 note frequency */ \
+    X(REs4,  311.127)   /*!< RE#4 note frequency */ \
+    X(MI4,   329.628)   /*!< MI4 note frequency */ \
+    X(FA4,   349.228)   /*!< FA4 note frequency */ \
+    X(FAs4,  369.994)   /*!< FA#4 note frequency */ \
+    X(SOL4,  391.995)   /*!< SOL4 note frequency */ \
+    X(SOLs4, 415.305)   /*!< SOL#4 note frequency */ \
+    X(LA4,   440.000)   /*!< LA4 note frequency */ \
+    X(LAs4,  466.164)   /*!< LA#4 note frequency */ \
+    X(SI4,   493.883)   /*!< SI4 note frequency */ \
+    /* 5th Octave (Quinta Octava) */ \
+    X(DO5,   523.251)   /*!< DO5 note frequency */ \
+    X(DOs5,  554.365)   /*!< DO#5 note frequency */ \
+    X(RE5,   587.330)   /*!< RE5 note frequency */ \
+    X(REs5,  622.254)   /*!< RE#5 note frequency */ \
+    X(MI5,   659.255)   /*!< MI5 note frequency */ \
+    X(FA5,   698.456)   /*!< FA5 note frequency */ \
+    X(FAs5,  739.989)   /*!< FA#5 note frequency */ \
+    X(SOL5,  783.991)   /*!< SOL5 note frequency */ \
+    X(SOLs5, 830.609)   /*!< SOL#5 note frequency */ \
+    X(LA5,   880.000)   /*!< LA5 note frequency */ \
+    X(LAs5,  932.328)   /*!< LA#5 note frequency */ \
+    X(SI5,   987.767)   /*!< SI5 note frequency */ \
+    /* 6th Octave (Sexta Octava) */ \
+    X(DO6,   1046.502)  /*!< DO6 note frequency */ \
+    X(DOs6,  1108.73)   /*!< DO#6 note frequency */ \
+    X(RE6,   1174.66)   /*!< RE6 note frequency */ \
+    X(REs6,  1244.508)  /*!< RE#6 note frequency */ \
+    X(MI6,   1318.51)   /*!< MI6 note frequency */ \
+    X(FA6,   1396.912)  /*!< FA6 note frequency */ \
+    X(FAs6,  1479.978)  /*!< FA#6 note frequency */ \
+    X(SOL6,  1567.982)  /*!< SOL6 note frequency */ \
+    X(SOLs6, 1661.218)  /*!< SOL#6 note frequency */ \
+    X(LA6,   1760.000)  /*!< LA6 note frequency */ \
+    X(LAs6,  1864.656)  /*!< LA#6 note frequency */ \
+    X(SI6,   1975.534)  /*!< SI6 note frequency */
+
+/**
+ * @brief Notes of a melody. Each note is stored as its MIDI note number, or SILENCE.
+ */
+enum NOTES
+{
+  SILENCE = 0,                        /*!< Silence note */
+  NOTE_BEFORE_DO3 = NOTE_MIDI_DO3 - 1, /*!< Placeholder so that DO3 gets its MIDI note number */
+#define NOTE_ENUM_ENTRY(name, hz) name,
+  MELODIES_NOTES(NOTE_ENUM_ENTRY)
+#undef NOTE_ENUM_ENTRY
+};
+
+#define NOTE_LOWEST DO3                               /*!< Lowest note of the table */
+#define NOTE_HIGHEST SI6                              /*!< Highest note of the table */
+#define NOTES_COUNT (NOTE_HIGHEST - NOTE_LOWEST + 1)  /*!< Number of notes in the table */
+
+/**
+ * @brief Type of the blob of a melody: `length` notes, then `length` duration indexes, then the name.
+ * All its members are bytes, so there is no padding between them.
+ */
+#define MELODY_BLOB_T(length, name_string) struct { uint8_t notes[length]; uint8_t durations[length]; char name[sizeof(name_string)]; }
+
+/**
+ * @brief Initializer of the `melody_t` header of a blob declared with MELODY_BLOB_T.
+ * The length is taken from the blob itself, so it can not get out of sync with the notes.
+ */
+#define MELODY_FROM_BLOB(blob, p_table)   {.melody_length = sizeof((blob).notes),                            \
+                                           .name_offset = sizeof((blob).notes) + sizeof((blob).durations), \
+                                           .p_data = (const uint8_t *)&(blob),                             \
+                                           .p_durations = (p_table)}
 
 /* Typedefs --------------------------------------------------------------------*/
 /**
  * @brief Structure to define the Buzzer melody player FSM.
+ *
+ * The melody is stored in a single blob of `2 * melody_length + strlen(name) + 1` bytes:
+ * the notes (one byte each), then the duration of each note as an index into `p_durations`
+ * (one byte each), then the name. Use the `melody_get_*()` functions to read it.
  */
 typedef struct
 {
-    char *p_name;           /*!< Pointer to the name of the melody to play */
-    double *p_notes;        /*!< Pointer to the notes of the melody */
-    uint16_t *p_durations;  /*!< Pointer to the duration of each note of the melody in milliseconds */
-    uint16_t melody_length; /*!< Length of the melody to play */
+    uint16_t melody_length;       /*!< Length of the melody to play */
+    uint16_t name_offset;         /*!< Offset of the name of the melody in the blob */
+    const uint8_t *p_data;        /*!< Pointer to the blob of the melody */
+    const uint16_t *p_durations;  /*!< Pointer to the table of durations in milliseconds the blob indexes */
 } melody_t;
 
 // Melodies must be defined in melodies.c, and declared here as extern
@@ -116,4 +154,87 @@ extern const melody_t halloween_theme;
 // Outro
 extern const melody_t outro;
 
+struct melody_pool; // See melody_pool.h
+
+/**
+ * @brief Catalog of melodies: a table of pointers to the melodies and its size, followed by the melodies of a generated
+ * catalog and by the melodies of a pool in RAM.
+ *
+ * Both the table and the melodies live in flash, so the RAM used does not depend on the number of melodies.
+ */
+typedef struct melody_catalog
+{
+    const melody_t *const *p_melodies;          /*!< Table of pointers to the melodies */
+    uint32_t count;                             /*!< Number of melodies in the table */
+    const struct melody_catalog *p_generated;   /*!< Catalog written by tools/melody_compiler.py, listed after the table. NULL if none */
+    const struct melody_pool *p_pool;           /*!< Pool with the melodies uploaded at run time, listed after the rest. NULL if none */
+} melody_catalog_t;
+
+// Catalog with all the melodies of melodies.c, in the order shown by the jukebox
+extern const melody_catalog_t melodies_catalog;
+
+// Catalog of the file written by `tools/melody_compiler.py --catalog`, if one is linked. It is added to melodies_catalog
+extern const melody_catalog_t melodies_generated;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Get the number of notes of a melody.
+ *
+ * @param p_melody pointer to the melody.
+ * @return uint16_t number of notes of the melody.
+ */
+uint16_t melody_get_length(const melody_t *p_melody);
+
+/**
+ * @brief Get the name of a melody.
+ *
+ * @param p_melody pointer to the melody.
+ * @return const char* name of the melody.
+ */
+const char *melody_get_name(const melody_t *p_melody);
+
+/**
+ * @brief Get a note of a melody.
+ *
+ * @param p_melody pointer to the melody.
+ * @param index index of the note, from 0 to melody_get_length() - 1.
+ * @return uint8_t note (MIDI note number or SILENCE).
+ */
+uint8_t melody_get_note(const melody_t *p_melody, uint32_t index);
+
+/**
+ * @brief Get the duration of a note of a melody.
+ *
+ * @param p_melody pointer to the melody.
+ * @param index index of the note, from 0 to melody_get_length() - 1.
+ * @return uint16_t duration of the note in milliseconds.
+ */
+uint16_t melody_get_duration(const melody_t *p_melody, uint32_t index);
+
+/**
+ * @brief Get the number of melodies of a catalog.
+ *
+ * @param p_catalog pointer to the catalog.
+ * @return uint32_t number of melodies.
+ */
+uint32_t melody_catalog_get_count(const melody_catalog_t *p_catalog);
+
+/**
+ * @brief Get the number of melodies of a catalog that live in flash: the ones of its table and of its generated catalog.
+ * The melodies of its pool are listed after them.
+ *
+ * @param p_catalog pointer to the catalog.
+ * @return uint32_t number of melodies in flash.
+ */
+uint32_t melody_catalog_get_flash_count(const melody_catalog_t *p_catalog);
+
+/**
+ * @brief Get a melody of a catalog.
+ *
+ * @param p_catalog pointer to the catalog.
+ * @param index index of the melody, from 0 to melody_catalog_get_count() - 1.
+ * @return const melody_t* pointer to the melody, or NULL if `index` is out of the catalog.
+ */
+const melody_t *melody_catalog_get(const melody_catalog_t *p_catalog, uint32_t index);
+
 #endif /* MELODIES_H_ */
\ No newline at end of file
@@ -0,0 +1,153 @@
+/**
+ * @file melody_pool.h
+ * @brief Header for melody_pool.c file.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-03
+ */
+#ifndef MELODY_POOL_H_
+#define MELODY_POOL_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Other includes */
+#include "melodies.h"
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define MELODY_POOL_SIZE 4096               /*!< Size in bytes of the RAM arena for uploaded melodies */
+#define MELODY_POOL_MAX_MELODIES 8          /*!< Maximum number of uploaded melodies */
+#define MELODY_POOL_NAME_LENGTH 32          /*!< Maximum length of the name of an uploaded melody, including the terminator */
+#define MELODY_POOL_MAX_DURATIONS 256       /*!< Maximum number of different durations of an uploaded melody */
+#define MELODY_POOL_NAME_END '\n'           /*!< Character that ends the name of an uploaded melody */
+
+/* Enums */
+/**
+ * @brief Result of feeding bytes to an upload.
+ *
+ */
+enum MELODY_POOL_LOAD
+{
+    MELODY_POOL_LOAD_BUSY = 0,  /*!< The upload needs more bytes */
+    MELODY_POOL_LOAD_DONE,      /*!< The melody has been uploaded and added to the pool */
+    MELODY_POOL_LOAD_ERROR,     /*!< The upload has been aborted: invalid note or too many durations */
+};
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Pool of melodies uploaded at run time.
+ *
+ * The melodies are stored one after the other in `arena`, with the same layout as the melodies in flash: notes, duration indexes
+ * and name, followed by their own table of durations. Deleting a melody moves the following ones down, so the free space is always
+ * at the end of the arena.
+ *
+ * An upload is a stream of bytes: the name ended by `MELODY_POOL_NAME_END`, and then, for each note, the note (MIDI number or SILENCE)
+ * and its duration in milliseconds (2 bytes, little endian).
+ */
+typedef struct melody_pool
+{
+    melody_t melodies[MELODY_POOL_MAX_MELODIES];      /*!< Headers of the uploaded melodies, in upload order */
+    uint16_t sizes[MELODY_POOL_MAX_MELODIES];         /*!< Bytes of the arena used by each melody */
+    uint32_t count;                                   /*!< Number of uploaded melodies */
+    uint32_t used;                                    /*!< Bytes of the arena in use */
+
+    // Upload in progress
+    bool loading;                                     /*!< Flag to indicate that there is an upload in progress */
+    uint16_t load_length;                             /*!< Number of notes of the upload */
+    bool load_name_done;                              /*!< Flag to indicate that the whole name has been received */
+    uint16_t load_name_length;                        /*!< Characters of the name received so far */
+    uint32_t load_byte_idx;                           /*!< Bytes of the notes received so far */
+    uint16_t load_duration;                           /*!< First byte of the duration being received */
+    uint16_t load_durations_count;                    /*!< Number of different durations of the upload */
+    uint16_t load_durations[MELODY_POOL_MAX_DURATIONS]; /*!< Different durations of the upload, copied to the arena at the end */
+
+    uint16_t arena[MELODY_POOL_SIZE / 2];             /*!< Storage of the melodies. Halfwords to keep the tables of durations aligned */
+} melody_pool_t;
+
+/* Global variables */
+/**
+ * @brief Pool of uploaded melodies, part of the catalog `melodies_catalog`.
+ */
+extern melody_pool_t melody_pool;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Get the number of melodies of the pool.
+ *
+ * @param p_pool pointer to the pool.
+ * @return uint32_t number of melodies.
+ */
+uint32_t melody_pool_get_count(const melody_pool_t *p_pool);
+
+/**
+ * @brief Get a melody of the pool.
+ *
+ * @param p_pool pointer to the pool.
+ * @param index index of the melody in the pool, from 0 to melody_pool_get_count() - 1.
+ * @return const melody_t* pointer to the melody, or NULL if `index` is out of the pool.
+ */
+const melody_t *melody_pool_get(const melody_pool_t *p_pool, uint32_t index);
+
+/**
+ * @brief Get the free bytes of the pool.
+ *
+ * @param p_pool pointer to the pool.
+ * @return uint32_t free bytes of the arena.
+ */
+uint32_t melody_pool_get_free(const melody_pool_t *p_pool);
+
+/**
+ * @brief Start the upload of a melody.
+ *
+ * Space for the worst case (all durations different and the longest name) is reserved until the upload ends.
+ *
+ * @param p_pool pointer to the pool.
+ * @param melody_length number of notes of the melody.
+ * @return true the upload can start.
+ * @return false there is not enough space, no free slot, another upload in progress or `melody_length` is 0.
+ */
+bool melody_pool_load_begin(melody_pool_t *p_pool, uint32_t melody_length);
+
+/**
+ * @brief Feed the bytes received to the upload in progress.
+ *
+ * @param p_pool pointer to the pool.
+ * @param p_data pointer to the bytes received.
+ * @param length number of bytes.
+ * @param p_used pointer to store the number of bytes consumed. Bytes after the end of the upload are not consumed.
+ * @return uint32_t one of `MELODY_POOL_LOAD`.
+ */
+uint32_t melody_pool_load_data(melody_pool_t *p_pool, const uint8_t *p_data, uint32_t length, uint32_t *p_used);
+
+/**
+ * @brief Abort the upload in progress, if any.
+ *
+ * @param p_pool pointer to the pool.
+ */
+void melody_pool_load_abort(melody_pool_t *p_pool);
+
+/**
+ * @brief Check whether there is an upload in progress.
+ *
+ * @param p_pool pointer to the pool.
+ * @return true there is an upload in progress.
+ * @return false there is no upload in progress.
+ */
+bool melody_pool_is_loading(const melody_pool_t *p_pool);
+
+/**
+ * @brief Delete a melody of the pool and move the following ones down to keep the free space together.
+ *
+ * The melodies after the deleted one change their index and address, so they must not be playing.
+ *
+ * @param p_pool pointer to the pool.
+ * @param index index of the melody in the pool.
+ * @return true the melody has been deleted.
+ * @return false `index` is out of the pool or there is an upload in progress.
+ */
+bool melody_pool_delete(melody_pool_t *p_pool, uint32_t index);
+
+#endif /* MELODY_POOL_H_ */
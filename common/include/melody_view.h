@@ -0,0 +1,122 @@
+/**
+ * @file melody_view.h
+ * @brief Header for melody_view.c file.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-05
+ */
+#ifndef MELODY_VIEW_H_
+#define MELODY_VIEW_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Other includes */
+#include "melodies.h"
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define MELODY_VIEW_TEMPO_ONE (1UL << 16)                       /*!< Original tempo (1.0) in Q16.16 fixed point */
+#define MELODY_VIEW_TEMPO_MIN (MELODY_VIEW_TEMPO_ONE / 10)      /*!< Minimum tempo (0.1) in Q16.16 */
+#define MELODY_VIEW_TEMPO_MAX (MELODY_VIEW_TEMPO_ONE * 10)      /*!< Maximum tempo (10.0) in Q16.16 */
+#define MELODY_VIEW_TRANSPOSE_MAX 24                            /*!< Maximum transposition in semitones, up or down */
+#define MELODY_VIEW_SCALE_SHIFT 28                              /*!< Fractional bits of a duration scale: as many as fit in 32 bits for the slowest factor, 0.1 */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Way of playing a melody without copying it: direction, transposition and tempo.
+ *
+ * Notes that go out of DO3..SI6 when transposed are moved back into that range by octaves.
+ */
+typedef struct
+{
+    const melody_t *p_melody;   /*!< Melody to play */
+    bool reverse;               /*!< Flag to play the melody from the last note to the first one */
+    int8_t transpose;           /*!< Semitones added to each note */
+    uint32_t tempo;             /*!< Tempo in Q16.16: 2.0 plays the melody twice as fast */
+    uint32_t duration_scale;    /*!< 1 / tempo with `MELODY_VIEW_SCALE_SHIFT` fractional bits, so a note duration is a multiplication */
+} melody_view_t;
+
+/**
+ * @brief Position in a melody view.
+ */
+typedef struct
+{
+    const melody_view_t *p_view;    /*!< View to read */
+    uint32_t index;                 /*!< Index of the next note, counted in the direction of the view */
+} melody_iterator_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Initialize a view that plays a melody as it is.
+ *
+ * @param p_view pointer to the view.
+ * @param p_melody pointer to the melody. It can be NULL (no melody).
+ */
+void melody_view_init(melody_view_t *p_view, const melody_t *p_melody);
+
+/**
+ * @brief Get the scale of the durations of a speed or tempo factor: its rounded reciprocal with `MELODY_VIEW_SCALE_SHIFT`
+ * fractional bits, which keep the error of a note of a minute under 1 us.
+ *
+ * It is only computed when the factor changes, so scaling a duration is a multiplication.
+ *
+ * @param factor speed or tempo in Q16.16, from 0.1 (`MELODY_VIEW_TEMPO_MIN`) on, so that the scale fits in 32 bits.
+ * @return uint32_t 1 / factor with `MELODY_VIEW_SCALE_SHIFT` fractional bits.
+ */
+uint32_t melody_view_get_duration_scale(uint32_t factor);
+
+/**
+ * @brief Scale a duration by a scale got with melody_view_get_duration_scale(), rounded.
+ *
+ * @param duration_us duration in microseconds.
+ * @param duration_scale scale with `MELODY_VIEW_SCALE_SHIFT` fractional bits.
+ * @return uint32_t scaled duration in microseconds, saturated to UINT32_MAX (more than 71 minutes).
+ */
+uint32_t melody_view_scale_duration(uint32_t duration_us, uint32_t duration_scale);
+
+/**
+ * @brief Set the tempo of a view.
+ *
+ * @param p_view pointer to the view.
+ * @param tempo tempo in Q16.16. It is limited to `MELODY_VIEW_TEMPO_MIN` .. `MELODY_VIEW_TEMPO_MAX`.
+ */
+void melody_view_set_tempo(melody_view_t *p_view, uint32_t tempo);
+
+/**
+ * @brief Set the transposition of a view.
+ *
+ * @param p_view pointer to the view.
+ * @param semitones semitones to add to each note. It is limited to +/- `MELODY_VIEW_TRANSPOSE_MAX`.
+ */
+void melody_view_set_transpose(melody_view_t *p_view, int32_t semitones);
+
+/**
+ * @brief Start reading a view from its first note.
+ *
+ * @param p_iterator pointer to the iterator.
+ * @param p_view pointer to the view. It must outlive the iterator.
+ */
+void melody_iterator_init(melody_iterator_t *p_iterator, const melody_view_t *p_view);
+
+/**
+ * @brief Check whether there are notes left.
+ *
+ * @param p_iterator pointer to the iterator.
+ * @return true there are notes left.
+ * @return false the view has no melody or all the notes have been read.
+ */
+bool melody_iterator_has_next(const melody_iterator_t *p_iterator);
+
+/**
+ * @brief Read the next note of the view. Call only if `melody_iterator_has_next()`.
+ *
+ * @param p_iterator pointer to the iterator.
+ * @param p_note pointer to store the note (MIDI note number or SILENCE), already transposed.
+ * @param p_duration_us pointer to store the duration of the note in microseconds, already scaled by the tempo.
+ */
+void melody_iterator_next(melody_iterator_t *p_iterator, uint8_t *p_note, uint32_t *p_duration_us);
+
+#endif /* MELODY_VIEW_H_ */
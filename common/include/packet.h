@@ -0,0 +1,127 @@
+/**
+ * @file packet.h
+ * @brief Header for packet.c file.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-17
+ */
+#ifndef PACKET_H_
+#define PACKET_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define PACKET_DELIMITER 0x00               /*!< Byte that starts and ends a frame. COBS removes it from the packet */
+#define PACKET_MAX_PAYLOAD 48               /*!< Maximum length of the payload of a packet */
+#define PACKET_HEADER_LENGTH 2              /*!< Opcode and request ID */
+#define PACKET_CRC_LENGTH 2                 /*!< CRC16 of the header and the payload, little endian */
+#define PACKET_MAX_LENGTH (PACKET_HEADER_LENGTH + PACKET_MAX_PAYLOAD + PACKET_CRC_LENGTH)   /*!< Maximum length of a packet before COBS */
+#define PACKET_MAX_FRAME_LENGTH (PACKET_MAX_LENGTH + PACKET_MAX_LENGTH / 254 + 3)           /*!< Maximum length of a frame: a COBS code every 254 bytes, one more and the two delimiters */
+#define PACKET_CRC_INIT 0xFFFF              /*!< Initial value of the CRC16 (CCITT, polynomial 0x1021) */
+#define PACKET_REPLY 0x80                   /*!< Bit set in the opcode of a reply */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Packet, decoded: opcode, request ID and payload. The ID of a reply is the one of its request.
+ *
+ * On the wire, the opcode, the ID, the payload and the CRC16 of the three are encoded with COBS, so they have no `PACKET_DELIMITER`,
+ * and sent between two `PACKET_DELIMITER`.
+ */
+typedef struct
+{
+    uint8_t opcode;                         /*!< What to do, or what is replied to with `PACKET_REPLY` */
+    uint8_t id;                             /*!< Request ID chosen by the host, to match the replies */
+    uint8_t length;                         /*!< Length of the payload */
+    uint8_t payload[PACKET_MAX_PAYLOAD];    /*!< Fields of the packet, little endian */
+} packet_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Compute the CRC16 (CCITT, polynomial 0x1021, not reflected) of some bytes.
+ *
+ * @param p_data pointer to the bytes.
+ * @param length number of bytes.
+ * @param crc CRC of the bytes before, or `PACKET_CRC_INIT`.
+ * @return uint16_t CRC.
+ */
+uint16_t packet_crc16(const uint8_t *p_data, uint32_t length, uint16_t crc);
+
+/**
+ * @brief Encode some bytes with COBS, so the result has no `PACKET_DELIMITER`.
+ *
+ * @param p_data pointer to the bytes.
+ * @param length number of bytes.
+ * @param p_out pointer to store the result. It must hold `length` + `length` / 254 + 1 bytes.
+ * @return uint32_t length of the result.
+ */
+uint32_t packet_cobs_encode(const uint8_t *p_data, uint32_t length, uint8_t *p_out);
+
+/**
+ * @brief Decode some bytes encoded with COBS.
+ *
+ * @param p_data pointer to the bytes, without delimiters.
+ * @param length number of bytes.
+ * @param p_out pointer to store the result.
+ * @param size size of `p_out`.
+ * @param p_length pointer to store the length of the result.
+ * @return true the bytes have been decoded.
+ * @return false the bytes are not COBS, or the result does not fit.
+ */
+bool packet_cobs_decode(const uint8_t *p_data, uint32_t length, uint8_t *p_out, uint32_t size, uint32_t *p_length);
+
+/**
+ * @brief Decode a frame and check its CRC.
+ *
+ * @param p_frame pointer to the frame, without delimiters.
+ * @param length length of the frame.
+ * @param p_packet pointer to store the packet.
+ * @return true the packet is valid.
+ * @return false the frame is not COBS, is too short or too long, or its CRC is wrong.
+ */
+bool packet_decode(const uint8_t *p_frame, uint32_t length, packet_t *p_packet);
+
+/**
+ * @brief Encode a packet with its CRC, between two delimiters.
+ *
+ * @param p_packet pointer to the packet.
+ * @param p_frame pointer to store the frame. It must hold `PACKET_MAX_FRAME_LENGTH` bytes.
+ * @return uint32_t length of the frame.
+ */
+uint32_t packet_encode(const packet_t *p_packet, uint8_t *p_frame);
+
+/**
+ * @brief Add a byte at the end of the payload.
+ *
+ * @param p_packet pointer to the packet.
+ * @param value byte.
+ * @return true the byte has been added.
+ * @return false the payload is full.
+ */
+bool packet_put_u8(packet_t *p_packet, uint8_t value);
+
+/**
+ * @brief Add a 16 bit field at the end of the payload, little endian.
+ *
+ * @param p_packet pointer to the packet.
+ * @param value field.
+ * @return true the field has been added.
+ * @return false the payload is full.
+ */
+bool packet_put_u16(packet_t *p_packet, uint16_t value);
+
+/**
+ * @brief Read a 16 bit field of the payload, little endian.
+ *
+ * @param p_packet pointer to the packet.
+ * @param offset position of the field in the payload.
+ * @param p_value pointer to store the field.
+ * @return true the field has been read.
+ * @return false the payload is too short.
+ */
+bool packet_get_u16(const packet_t *p_packet, uint32_t offset, uint16_t *p_value);
+
+#endif /* PACKET_H_ */
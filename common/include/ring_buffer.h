@@ -0,0 +1,159 @@
+/**
+ * @file ring_buffer.h
+ * @brief Header for ring_buffer.c file.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-12
+ */
+#ifndef RING_BUFFER_H_
+#define RING_BUFFER_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define RING_BUFFER_IS_POWER_OF_TWO(n) ((n) != 0 && ((n) & ((n) - 1)) == 0) /*!< Check that a capacity can be masked */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Lock-free ring buffer for one producer and one consumer, for example an ISR and a FSM.
+ *
+ * `head` is only written by the producer and `tail` only by the consumer. Both count elements from the start and are masked
+ * to index the storage, so the buffer can be completely full and the number of elements is always `head - tail`.
+ * The element is copied before `head` is stored (release) and `head` is loaded (acquire) before the element is read,
+ * so no other synchronization is needed. The consumer must not call the functions of the producer, and the other way round.
+ */
+typedef struct
+{
+    uint8_t *p_storage;         /*!< Storage of `capacity` elements */
+    uint32_t element_size;      /*!< Bytes of each element */
+    uint32_t mask;              /*!< Capacity - 1. The capacity is a power of two */
+    _Atomic uint32_t head;      /*!< Elements pushed. Written by the producer */
+    _Atomic uint32_t tail;      /*!< Elements popped. Written by the consumer */
+    uint32_t dropped;           /*!< Elements that could not be pushed because the buffer was full. Written by the producer */
+} ring_buffer_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Initialize an empty ring buffer. Neither the producer nor the consumer may be using it.
+ *
+ * @param p_ring pointer to the ring buffer.
+ * @param p_storage storage of `capacity * element_size` bytes.
+ * @param element_size bytes of each element.
+ * @param capacity number of elements. It must be a power of two.
+ * @return true the ring buffer has been initialized.
+ * @return false `capacity` is not a power of two.
+ */
+bool ring_buffer_init(ring_buffer_t *p_ring, void *p_storage, uint32_t element_size, uint32_t capacity);
+
+/**
+ * @brief Add an element. Producer only.
+ *
+ * @param p_ring pointer to the ring buffer.
+ * @param p_element pointer to the element to copy.
+ * @return true the element has been added.
+ * @return false the buffer is full. The element is counted as dropped.
+ */
+bool ring_buffer_push(ring_buffer_t *p_ring, const void *p_element);
+
+/**
+ * @brief Get the free elements that follow one another in the storage after the last element, to write them in place. Producer only.
+ *
+ * The elements written are added with ring_buffer_produce().
+ *
+ * @param p_ring pointer to the ring buffer.
+ * @param pp_element pointer to store the address of the first free element.
+ * @return uint32_t number of free elements up to the oldest element or to the end of the storage, whichever comes first.
+ */
+uint32_t ring_buffer_get_free_span(ring_buffer_t *p_ring, void **pp_element);
+
+/**
+ * @brief Add elements already written in the storage by the hardware, for example a DMA in circular mode, or in the
+ * span got with ring_buffer_get_free_span(). Producer only.
+ *
+ * The hardware does not wait for the consumer, so it may have overwritten elements not read yet. In that case the
+ * number of elements is greater than the capacity until the consumer calls ring_buffer_discard().
+ *
+ * @param p_ring pointer to the ring buffer.
+ * @param count number of elements written after the last ones added.
+ * @return true the elements have been added.
+ * @return false elements not read have been overwritten. They are counted as dropped.
+ */
+bool ring_buffer_produce(ring_buffer_t *p_ring, uint32_t count);
+
+/**
+ * @brief Read an element without removing it. Consumer only.
+ *
+ * @param p_ring pointer to the ring buffer.
+ * @param index position of the element: 0 is the oldest one.
+ * @param p_element pointer to copy the element to.
+ * @return true the element has been read.
+ * @return false there are not so many elements.
+ */
+bool ring_buffer_peek(ring_buffer_t *p_ring, uint32_t index, void *p_element);
+
+/**
+ * @brief Remove the oldest element. Consumer only.
+ *
+ * @param p_ring pointer to the ring buffer.
+ * @param p_element pointer to copy the element to, or NULL to discard it.
+ * @return true an element has been removed.
+ * @return false the buffer is empty.
+ */
+bool ring_buffer_pop(ring_buffer_t *p_ring, void *p_element);
+
+/**
+ * @brief Get the elements that follow one another in the storage from a position, to read them without copying. Consumer only.
+ *
+ * @param p_ring pointer to the ring buffer.
+ * @param index position of the first element: 0 is the oldest one.
+ * @param pp_element pointer to store the address of the first element.
+ * @return uint32_t number of elements from the first one to the last one or to the end of the storage, whichever comes first.
+ */
+uint32_t ring_buffer_get_span(ring_buffer_t *p_ring, uint32_t index, void **pp_element);
+
+/**
+ * @brief Remove the oldest elements. Consumer only.
+ *
+ * @param p_ring pointer to the ring buffer.
+ * @param count number of elements to remove. It is limited to the number of elements.
+ */
+void ring_buffer_consume(ring_buffer_t *p_ring, uint32_t count);
+
+/**
+ * @brief Remove all the elements. Consumer only.
+ *
+ * @param p_ring pointer to the ring buffer.
+ */
+void ring_buffer_discard(ring_buffer_t *p_ring);
+
+/**
+ * @brief Get the number of elements. From the consumer it is a lower bound, and from the producer an upper bound.
+ *
+ * @param p_ring pointer to the ring buffer.
+ * @return uint32_t number of elements.
+ */
+uint32_t ring_buffer_get_count(ring_buffer_t *p_ring);
+
+/**
+ * @brief Check whether the buffer is empty.
+ *
+ * @param p_ring pointer to the ring buffer.
+ * @return true there are no elements.
+ * @return false there are elements.
+ */
+bool ring_buffer_is_empty(ring_buffer_t *p_ring);
+
+/**
+ * @brief Get the number of elements dropped because the buffer was full.
+ *
+ * @param p_ring pointer to the ring buffer.
+ * @return uint32_t number of elements dropped since the initialization.
+ */
+uint32_t ring_buffer_get_dropped(const ring_buffer_t *p_ring);
+
+#endif /* RING_BUFFER_H_ */
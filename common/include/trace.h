@@ -0,0 +1,100 @@
+/**
+ * @file trace.h
+ * @brief Header for trace.c file.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-17
+ */
+#ifndef TRACE_H_
+#define TRACE_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#define TRACE_RING_LENGTH 64            /*!< Records kept until the main loop sends them. Power of 2 */
+#define TRACE_MAX_ARGS 2                /*!< Arguments of a record */
+#define TRACE_RECORD_WORDS (2 + TRACE_MAX_ARGS) /*!< Words of a record: header, cycles and arguments */
+#define TRACE_DRAIN_RECORDS 8           /*!< Records sent at most in each call to trace_drain() from the main loop */
+
+/**
+ * @brief Format of each trace message: its ID and the printf() format of its arguments, which can only be integers or
+ * characters. tools/trace_decode.py reads this list to print the records, so the order is the ID: add new messages at the end.
+ */
+#define TRACE_FORMATS(X)                                            \
+    X(TRACE_JUKEBOX_ON, "Jukebox ON\n")                             \
+    X(TRACE_JUKEBOX_OFF, "Jukebox OFF\n")                           \
+    X(TRACE_PLAYING, "Playing: melody %lu\n")                       \
+    X(TRACE_PLAYING_REVERSED, "Playing reversed: melody %lu\n")     \
+    X(TRACE_STOPPED, "Stopped\n")                                   \
+    X(TRACE_PAUSED, "Paused\n")                                     \
+    X(TRACE_TRANSPOSED, "Transposed: %ld semitones\n")              \
+    X(TRACE_BAUD_REVERTED, "Baud: back to %lu\n")                   \
+    X(TRACE_KEY_PRESSED, "Key pressed: [%c].\n")                    \
+    X(TRACE_KEY_RELEASED, "Key let go.\n")
+
+/* Enums */
+/**
+ * @brief ID of a trace message, as listed in `TRACE_FORMATS`.
+ *
+ */
+enum TRACE_ID
+{
+#define TRACE_ID_ENTRY(id, format) id,
+    TRACE_FORMATS(TRACE_ID_ENTRY)
+#undef TRACE_ID_ENTRY
+    TRACE_ID_COUNT, /*!< Number of messages */
+};
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Trace record: what trace_emit() stores and trace_drain() sends, word by word, through the ITM.
+ */
+typedef struct
+{
+    uint32_t header;                    /*!< `TRACE_ID` in the low half and the sequence number in the high half. A gap in the sequence means records dropped */
+    uint32_t cycles;                    /*!< DWT cycle count when the record was emitted */
+    uint32_t args[TRACE_MAX_ARGS];      /*!< Arguments of the format. The ones not used are 0 */
+} trace_record_t;
+
+/* Function prototypes and explanation -------------------------------------------------*/
+/**
+ * @brief Initialize the trace with no records. Call it once, after port_system_init().
+ */
+void trace_init(void);
+
+/**
+ * @brief Store a trace message to be sent later: a few stores, with no formatting and no waiting for the ITM.
+ *
+ * The ring has one producer, so it must only be called from the main loop, not from the ISRs.
+ *
+ * @param id one of `TRACE_ID`.
+ * @param arg0 first argument of the format, or 0.
+ * @param arg1 second argument of the format, or 0.
+ * @return true the record has been stored.
+ * @return false the ring is full. The record is dropped.
+ */
+bool trace_emit(uint32_t id, uint32_t arg0, uint32_t arg1);
+
+/**
+ * @brief Send the oldest records through the ITM as long as its FIFO has room. Call it from the main loop when it is idle.
+ *
+ * A record half sent is finished in the next call, so that its words are not mixed with another one.
+ *
+ * @param max_records maximum number of records to send.
+ * @return true all the records have been sent.
+ * @return false some records are waiting for the ITM.
+ */
+bool trace_drain(uint32_t max_records);
+
+/**
+ * @brief Get the number of records dropped because the ring was full.
+ *
+ * @return uint32_t records dropped since the initialization.
+ */
+uint32_t trace_get_dropped(void);
+
+#endif /* TRACE_H_ */
@@ -0,0 +1,97 @@
+/**
+ * @file command_macro.c
+ * @brief Macros: named lists of commands defined at run time and kept in RAM.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-17
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C libraries */
+#include <stddef.h> // NULL
+#include <string.h> // memcpy, memmove
+
+/* Other libraries */
+#include "command_macro.h"
+
+/* Private functions */
+/**
+ * @brief Get the position of a macro.
+ *
+ * @param p_macros pointer to the table.
+ * @param name name of the macro.
+ * @return int32_t position of the macro, or -1 if there is no macro with that name.
+ */
+static int32_t _get_index(const command_macro_table_t *p_macros, command_slice_t name)
+{
+    for (uint32_t i = 0; i < p_macros->count; i++)
+    {
+        if (command_slice_equals(name, p_macros->macros[i].name))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Public functions */
+void command_macro_init(command_macro_table_t *p_macros)
+{
+    p_macros->count = 0;
+}
+
+bool command_macro_define(command_macro_table_t *p_macros, command_slice_t name, command_slice_t body)
+{
+    if (name.length == 0 || name.length > COMMAND_MACRO_NAME_LENGTH || body.length == 0 || body.length > COMMAND_MACRO_BODY_LENGTH)
+    {
+        return false;
+    }
+
+    // 1. A macro with the same name is replaced, otherwise a new one is added at the end
+    int32_t index = _get_index(p_macros, name);
+    if (index < 0)
+    {
+        if (p_macros->count >= COMMAND_MACRO_MAX_MACROS)
+        {
+            return false;
+        }
+        index = p_macros->count++;
+    }
+
+    // 2. The slices point into the line received, which is reused, so they are copied
+    command_macro_t *p_macro = &p_macros->macros[index];
+    memcpy(p_macro->name, name.p_start, name.length);
+    p_macro->name[name.length] = '\0';
+    memcpy(p_macro->body, body.p_start, body.length);
+    p_macro->body[body.length] = '\0';
+    p_macro->body_length = body.length;
+    return true;
+}
+
+bool command_macro_remove(command_macro_table_t *p_macros, command_slice_t name)
+{
+    int32_t index = _get_index(p_macros, name);
+    if (index < 0)
+    {
+        return false;
+    }
+    memmove(&p_macros->macros[index], &p_macros->macros[index + 1], (p_macros->count - index - 1) * sizeof(command_macro_t));
+    p_macros->count--;
+    return true;
+}
+
+const command_macro_t *command_macro_find(const command_macro_table_t *p_macros, command_slice_t name)
+{
+    int32_t index = _get_index(p_macros, name);
+    return (index < 0) ? NULL : &p_macros->macros[index];
+}
+
+uint32_t command_macro_get_count(const command_macro_table_t *p_macros)
+{
+    return p_macros->count;
+}
+
+const command_macro_t *command_macro_get(const command_macro_table_t *p_macros, uint32_t index)
+{
+    return (index < p_macros->count) ? &p_macros->macros[index] : NULL;
+}
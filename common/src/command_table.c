@@ -0,0 +1,377 @@
+/**
+ * @file command_table.c
+ * @brief Table of commands with a perfect hash of their names, a tokenizer that does not copy the line, and argument schemas.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-17
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C libraries */
+#include <stddef.h> // NULL
+#include <string.h> // strlen, strcmp, memcmp, memset
+#include <stdio.h>  // snprintf
+
+/* Other libraries */
+#include "command_table.h"
+
+/* Private functions */
+/**
+ * @brief Get the slot of a name: FNV-1a of the name with the seed mixed in the offset basis, folded to the slots.
+ *
+ * @param name name.
+ * @param seed seed of the hash.
+ * @return uint32_t slot, from 0 to `COMMAND_TABLE_SLOTS` - 1.
+ */
+static uint32_t _hash(command_slice_t name, uint32_t seed)
+{
+    uint32_t hash = 2166136261U ^ seed;
+    for (uint32_t i = 0; i < name.length; i++)
+    {
+        hash ^= (uint8_t)name.p_start[i];
+        hash *= 16777619U;
+    }
+    return (hash ^ (hash >> 16)) & (COMMAND_TABLE_SLOTS - 1);
+}
+
+/**
+ * @brief Get a null terminated string as a slice.
+ *
+ * @param p_text string.
+ * @return command_slice_t slice of the whole string.
+ */
+static command_slice_t _slice(const char *p_text)
+{
+    command_slice_t slice = {.p_start = p_text, .length = strlen(p_text)};
+    return slice;
+}
+
+/**
+ * @brief Check whether a character separates tokens.
+ *
+ * @param c character.
+ * @return true it is a space, a tab or a carriage return.
+ * @return false it is part of a token.
+ */
+static bool _is_separator(char c)
+{
+    return (c == ' ' || c == '\t' || c == '\r');
+}
+
+/**
+ * @brief Try to place every command in a slot of its own with a seed.
+ *
+ * @param p_table pointer to the table.
+ * @param seed seed of the hash.
+ * @return true there has been no collision.
+ * @return false two names share a slot.
+ */
+static bool _place_commands(command_table_t *p_table, uint32_t seed)
+{
+    memset(p_table->slots, COMMAND_TABLE_EMPTY_SLOT, sizeof(p_table->slots));
+    for (uint32_t i = 0; i < p_table->count; i++)
+    {
+        uint32_t slot = _hash(_slice(p_table->p_commands[i].p_name), seed);
+        if (p_table->slots[slot] != COMMAND_TABLE_EMPTY_SLOT)
+        {
+            return false;
+        }
+        p_table->slots[slot] = i;
+    }
+    return true;
+}
+
+/* Public functions */
+bool command_table_init(command_table_t *p_table, const command_t *p_commands, uint32_t count)
+{
+    p_table->p_commands = p_commands;
+    p_table->count = count;
+    memset(p_table->slots, COMMAND_TABLE_EMPTY_SLOT, sizeof(p_table->slots));
+    if (count > COMMAND_TABLE_MAX_COMMANDS)
+    {
+        return false;
+    }
+
+    // 1. Names must be different, or no seed can separate them
+    for (uint32_t i = 0; i < count; i++)
+    {
+        for (uint32_t j = i + 1; j < count; j++)
+        {
+            if (!strcmp(p_commands[i].p_name, p_commands[j].p_name))
+            {
+                return false;
+            }
+        }
+    }
+
+    // 2. With three quarters of the slots free, more than one seed in a hundred has no collisions. With half of them, only one in 18000
+    for (uint32_t seed = 0; seed < COMMAND_TABLE_MAX_SEEDS; seed++)
+    {
+        if (_place_commands(p_table, seed))
+        {
+            p_table->seed = seed;
+            return true;
+        }
+    }
+    memset(p_table->slots, COMMAND_TABLE_EMPTY_SLOT, sizeof(p_table->slots));
+    return false;
+}
+
+uint32_t command_tokenize(const char *p_line, uint32_t length, command_slice_t *p_tokens, uint32_t max_tokens, uint32_t *p_count)
+{
+    uint32_t i = 0;
+    *p_count = 0;
+    while (true)
+    {
+        // 1. Skip the separators
+        while (i < length && _is_separator(p_line[i]))
+        {
+            i++;
+        }
+        if (i >= length)
+        {
+            return COMMAND_OK;
+        }
+        if (*p_count >= max_tokens)
+        {
+            return COMMAND_TOO_MANY_TOKENS;
+        }
+
+        // 2. A quoted token ends at the next quote, which must be followed by a separator or the end of the line
+        command_slice_t *p_token = &p_tokens[*p_count];
+        if (p_line[i] == COMMAND_QUOTE)
+        {
+            const char *p_end = memchr(p_line + i + 1, COMMAND_QUOTE, length - i - 1);
+            if (p_end == NULL || (p_end + 1 < p_line + length && !_is_separator(p_end[1])))
+            {
+                return COMMAND_WRONG_QUOTES;
+            }
+            p_token->p_start = p_line + i + 1;
+            p_token->length = p_end - p_token->p_start;
+            i = p_end - p_line + 1;
+            (*p_count)++;
+            continue;
+        }
+
+        // 3. Any other token ends at a separator
+        p_token->p_start = p_line + i;
+        while (i < length && !_is_separator(p_line[i]))
+        {
+            if (p_line[i] == COMMAND_QUOTE)
+            {
+                return COMMAND_WRONG_QUOTES;    // A quote in the middle of a word
+            }
+            i++;
+        }
+        p_token->length = p_line + i - p_token->p_start;
+        (*p_count)++;   // Only the tokens complete are counted, so the name is valid even if an argument is not
+    }
+}
+
+bool command_split(command_slice_t *p_rest, command_slice_t *p_command)
+{
+    bool quoted = false;
+    uint32_t i = 0;
+    if (p_rest->length == 0)
+    {
+        return false;
+    }
+    while (i < p_rest->length && (quoted || p_rest->p_start[i] != COMMAND_SEPARATOR))
+    {
+        quoted ^= (p_rest->p_start[i] == COMMAND_QUOTE);
+        i++;
+    }
+    p_command->p_start = p_rest->p_start;
+    p_command->length = i;
+    i += (i < p_rest->length);  // The separator belongs to no command
+    p_rest->p_start += i;
+    p_rest->length -= i;
+    return true;
+}
+
+bool command_slice_to_int(command_slice_t slice, int32_t *p_value)
+{
+    uint32_t i = 0;
+    bool negative = false;
+    uint32_t magnitude = 0;
+    uint32_t limit = INT32_MAX;
+    if (i < slice.length && (slice.p_start[i] == '-' || slice.p_start[i] == '+'))
+    {
+        negative = (slice.p_start[i++] == '-');
+        limit += negative;                          // INT32_MIN has one more unit than INT32_MAX
+    }
+    if (i >= slice.length)
+    {
+        return false;
+    }
+    for (; i < slice.length; i++)
+    {
+        uint32_t digit = (uint8_t)slice.p_start[i] - '0';
+        if (digit > 9 || magnitude > (limit - digit) / 10)
+        {
+            return false;
+        }
+        magnitude = magnitude * 10 + digit;
+    }
+    *p_value = negative ? (int32_t)(0U - magnitude) : (int32_t)magnitude;
+    return true;
+}
+
+bool command_slice_to_double(command_slice_t slice, double *p_value)
+{
+    uint32_t i = 0;
+    bool negative = false;
+    bool point = false;
+    uint32_t digits = 0;
+    double value = 0.0;
+    double scale = 1.0;
+    if (i < slice.length && (slice.p_start[i] == '-' || slice.p_start[i] == '+'))
+    {
+        negative = (slice.p_start[i++] == '-');
+    }
+    for (; i < slice.length; i++)
+    {
+        char c = slice.p_start[i];
+        if (c == '.' && !point)
+        {
+            point = true;
+        }
+        else if (c >= '0' && c <= '9')
+        {
+            value = value * 10.0 + (c - '0');
+            scale = point ? scale * 10.0 : scale;
+            digits++;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    if (digits == 0)
+    {
+        return false;
+    }
+    *p_value = (negative ? -value : value) / scale;
+    return true;
+}
+
+bool command_slice_equals(command_slice_t slice, const char *p_text)
+{
+    return (strlen(p_text) == slice.length && !memcmp(slice.p_start, p_text, slice.length));
+}
+
+const command_t *command_table_find(const command_table_t *p_table, command_slice_t name)
+{
+    uint8_t index = p_table->slots[_hash(name, p_table->seed)];
+    if (index == COMMAND_TABLE_EMPTY_SLOT || !command_slice_equals(name, p_table->p_commands[index].p_name))
+    {
+        return NULL;    // A name that is not a command may fall in the slot of one
+    }
+    return &p_table->p_commands[index];
+}
+
+const command_t *command_table_find_linear(const command_table_t *p_table, command_slice_t name)
+{
+    for (uint32_t i = 0; i < p_table->count; i++)
+    {
+        if (command_slice_equals(name, p_table->p_commands[i].p_name))
+        {
+            return &p_table->p_commands[i];
+        }
+    }
+    return NULL;
+}
+
+uint32_t command_table_get_count(const command_table_t *p_table)
+{
+    return p_table->count;
+}
+
+const command_t *command_table_get(const command_table_t *p_table, uint32_t index)
+{
+    return (index < p_table->count) ? &p_table->p_commands[index] : NULL;
+}
+
+bool command_parse_args(const command_t *p_command, const command_slice_t *p_tokens, uint32_t count, command_arg_t *p_args)
+{
+    memset(p_args, 0, COMMAND_MAX_ARGS * sizeof(command_arg_t));
+
+    // 1. Missing or unexpected arguments
+    if (count < p_command->required_args || count > COMMAND_MAX_ARGS || (count > 0 && p_command->arg_types[count - 1] == COMMAND_ARG_NONE))
+    {
+        return false;
+    }
+
+    // 2. The whole text of each argument must be of the type expected
+    for (uint32_t i = 0; i < count; i++)
+    {
+        command_arg_t *p_arg = &p_args[i];
+        p_arg->present = true;
+        p_arg->text = p_tokens[i];
+        if ((p_command->arg_types[i] == COMMAND_ARG_INT && !command_slice_to_int(p_tokens[i], &p_arg->int_value)) ||
+            (p_command->arg_types[i] == COMMAND_ARG_DOUBLE && !command_slice_to_double(p_tokens[i], &p_arg->double_value)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void command_get_args_help(const command_t *p_command, char *p_text, uint32_t size)
+{
+    static const char *p_types[] = {[COMMAND_ARG_INT] = "an integer", [COMMAND_ARG_DOUBLE] = "a number", [COMMAND_ARG_STRING] = "a word"};
+    uint32_t length;
+    if (p_command->arg_types[0] == COMMAND_ARG_NONE)
+    {
+        snprintf(p_text, size, "No parameter needed.");
+        return;
+    }
+    length = snprintf(p_text, size, (COMMAND_MAX_ARGS > 1 && p_command->arg_types[1] != COMMAND_ARG_NONE) ? "Parameters:" : "Parameter:");
+    for (uint32_t i = 0; i < COMMAND_MAX_ARGS && p_command->arg_types[i] != COMMAND_ARG_NONE && length < size; i++)
+    {
+        length += snprintf(p_text + length, size - length, "%s %s%s", (i > 0) ? "," : "", p_types[p_command->arg_types[i]], (i >= p_command->required_args) ? " (optional)" : "");
+    }
+    if (length < size)
+    {
+        snprintf(p_text + length, size - length, ".");
+    }
+}
+
+uint32_t command_table_execute(const command_table_t *p_table, void *p_context, const char *p_line, uint32_t length, const command_t **pp_command)
+{
+    command_slice_t tokens[COMMAND_MAX_TOKENS];
+    command_arg_t args[COMMAND_MAX_ARGS];
+    uint32_t count;
+    const command_t *p_command = NULL;
+    uint32_t result = command_tokenize(p_line, length, tokens, COMMAND_MAX_TOKENS, &count);
+
+    // 1. The command, if the line could be split
+    if (count > 0)
+    {
+        p_command = command_table_find(p_table, tokens[0]);
+    }
+    if (pp_command != NULL)
+    {
+        *pp_command = p_command;
+    }
+    if (result != COMMAND_OK)
+    {
+        return result;
+    }
+    if (count == 0)
+    {
+        return COMMAND_EMPTY;
+    }
+    if (p_command == NULL)
+    {
+        return COMMAND_NOT_FOUND;
+    }
+
+    // 2. Its arguments
+    if (!command_parse_args(p_command, tokens + 1, count - 1, args))
+    {
+        return COMMAND_WRONG_ARGS;
+    }
+    p_command->handler(p_context, args);
+    return COMMAND_OK;
+}
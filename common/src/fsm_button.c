@@ -13,7 +13,7 @@
 
 /* State machine input or transition functions */
 /**
- * @brief Return if the button has been pressed
+ * @brief Return if the next edge of the button is a press
  * 
  * @param p_this pointer to a FSM with a FSM button in it.
  * @return true if the button has been pressed
@@ -22,10 +22,11 @@
 static bool check_button_pressed(fsm_t *p_this)
 {
     fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
-    return port_button_is_pressed(p_fsm->button_id);
+    port_button_edge_t edge;
+    return (port_button_peek_edge(p_fsm->button_id, 0, &edge) && edge.pressed);
 }
 /**
- * @brief Return if the button has been released
+ * @brief Return if the next edge of the button is a release
  * 
  * @param p_this pointer to a FSM with a FSM button in it.
  * @return true if the button has been released
@@ -34,10 +35,11 @@ static bool check_button_pressed(fsm_t *p_this)
 static bool check_button_released(fsm_t *p_this)
 {
     fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
-    return !port_button_is_pressed(p_fsm->button_id);
+    port_button_edge_t edge;
+    return (port_button_peek_edge(p_fsm->button_id, 0, &edge) && !edge.pressed);
 }
 /**
- * @brief Check in the time (in ms) is higher than the debounce time
+ * @brief Check if the debounce time has passed, that is, its timer has expired
  * 
  * @param p_this pointer to a FSM with a FSM button in it.
  * @return true if the debounce time has already passed
@@ -46,36 +48,65 @@ static bool check_button_released(fsm_t *p_this)
 static bool check_timeout(fsm_t *p_this)
 {
     fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
-    if (port_button_get_tick() > p_fsm->next_timeout)
-        return true;
-    else
-        return false;
+    return !port_system_timer_is_running(&p_fsm->debounce_timer);
 }
 
 /* State machine output or action functions */
 /**
- * @brief Store the System tick (in ms) when the button has been pressed.
+ * @brief Take the press edge, store its System tick (in ms), and start the timer of the debounce time.
  * 
  * @param p_this pointer to a FSM with a FSM button in it.
  */
 static void do_store_tick_pressed(fsm_t *p_this)
 {
     fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
-    uint32_t current = port_button_get_tick();
-    p_fsm->tick_pressed = current;
-    p_fsm->next_timeout = current + p_fsm->debounce_time;
+    port_button_edge_t edge;
+    port_button_pop_edge(p_fsm->button_id, &edge);
+    p_fsm->tick_pressed = edge.time_ms;
+    p_fsm->last_edge_ms = edge.time_ms;
+    port_system_timer_start(&p_fsm->debounce_timer, p_fsm->debounce_time, 0);
 }
 /**
- * @brief  Store the time (in ms) the button has been pressed.
+ * @brief Take the release edge, store the time (in ms) the button has been pressed, and start the timer of the debounce time.
+ * 
+ * The duration is measured between the edges, so it does not depend on how late the FSM runs.
  * 
  * @param p_this pointer to a FSM with a FSM button in it.
  */
 static void do_set_duration(fsm_t *p_this)
 {
     fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
-    uint32_t current = port_button_get_tick();
-    p_fsm->duration = current - p_fsm->tick_pressed;
-    p_fsm->next_timeout = current + p_fsm->debounce_time;
+    port_button_edge_t edge;
+    port_button_pop_edge(p_fsm->button_id, &edge);
+    p_fsm->duration = edge.time_ms - p_fsm->tick_pressed;
+    p_fsm->last_edge_ms = edge.time_ms;
+    port_system_timer_start(&p_fsm->debounce_timer, p_fsm->debounce_time, 0);
+}
+/**
+ * @brief Drop the bounces: the edges received during the debounce time after the last edge taken.
+ * 
+ * Edges alternate, so if the last of them goes back to the level of the edge taken they all cancel out. Otherwise the button
+ * really changed its level during the debounce time, and that last edge is kept to be taken next.
+ * 
+ * @param p_this pointer to a FSM with a FSM button in it.
+ */
+static void do_drop_bounces(fsm_t *p_this)
+{
+    fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
+    port_button_edge_t edge;
+    uint32_t bounces = 0;
+    while (port_button_peek_edge(p_fsm->button_id, bounces, &edge) && (edge.time_ms - p_fsm->last_edge_ms) < p_fsm->debounce_time)
+    {
+        bounces++;
+    }
+    if (bounces % 2 == 1)
+    {
+        bounces--; // An odd number of edges changes the level
+    }
+    while (bounces-- > 0)
+    {
+        port_button_pop_edge(p_fsm->button_id, NULL);
+    }
 }
 
 /**
@@ -84,9 +115,9 @@ static void do_set_duration(fsm_t *p_this)
  */
 fsm_trans_t fsm_trans_button[] = {
     {BUTTON_RELEASED, check_button_pressed, BUTTON_PRESSED_WAIT, do_store_tick_pressed},
-    {BUTTON_PRESSED_WAIT, check_timeout, BUTTON_PRESSED, NULL},
+    {BUTTON_PRESSED_WAIT, check_timeout, BUTTON_PRESSED, do_drop_bounces},
     {BUTTON_PRESSED, check_button_released, BUTTON_RELEASED_WAIT, do_set_duration},
-    {BUTTON_RELEASED_WAIT, check_timeout, BUTTON_RELEASED, NULL},
+    {BUTTON_RELEASED_WAIT, check_timeout, BUTTON_RELEASED, do_drop_bounces},
     {-1, NULL, -1, NULL}};
 
 /* Other auxiliary functions */
@@ -113,11 +144,14 @@ void fsm_button_init(fsm_t *p_this, uint32_t debounce_time, uint32_t button_id)
 {
     fsm_button_t *p_fsm = (fsm_button_t *)(p_this);
     fsm_init(p_this, fsm_trans_button);
+    fsm_index_init(p_this, fsm_trans_button);
 
     p_fsm->debounce_time = debounce_time;
     p_fsm->button_id = button_id;
     p_fsm->tick_pressed = 0;
+    p_fsm->last_edge_ms = 0;
     p_fsm->duration = 0;
+    port_system_timer_init(&p_fsm->debounce_timer, SYSTEM_EVENT_BUTTON, NULL, NULL);
     port_button_init(button_id);
 }
 
@@ -14,22 +14,60 @@
 #include "port_buzzer.h"
 #include "fsm_buzzer.h"
 #include "melodies.h"
+#include "melody_view.h"
 
 /* Private functions */
 
+/**
+ * @brief Scales the duration of a note by the player speed.
+ * 
+ * @param p_fsm Pointer to a fsm_buzzer
+ * @param duration_us Duration of the note in us at speed 1
+ * @return uint32_t Duration of the note in us at the player speed
+ */
+static uint32_t _scale_duration(fsm_buzzer_t * p_fsm, uint32_t duration_us){
+    // Scaled by 1/speed and rounded
+    return melody_view_scale_duration(duration_us, p_fsm->duration_scale);
+}
+
 /**
  * @brief Method to set the frecuency of the PWM and the duration of the note dpending
  * of the player speed.
  * 
  * @param p_this Pointer to a struct that contins a fsm_buzzer
- * @param freq Frecuency of the note
- * @param duration Duration of the note
+ * @param note Note to play (MIDI note number or SILENCE)
+ * @param duration_us Duration of the note in us
  */
-static void _start_note(fsm_t * p_this, double 	freq, uint32_t duration){
+static void _start_note(fsm_t * p_this, uint8_t note, uint32_t duration_us){
     fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
-    double dur=(double)duration/(p_fsm->player_speed);
-    port_buzzer_set_note_frequency(p_fsm->buzzer_id, freq);
-    port_buzzer_set_note_duration(p_fsm->buzzer_id, dur);
+    port_buzzer_set_note(p_fsm->buzzer_id, note);
+    port_buzzer_set_note_duration(p_fsm->buzzer_id, _scale_duration(p_fsm, duration_us));
+}
+
+/**
+ * @brief Fills a half of the sequencer buffer with the next notes of the view, and with padding after the last one.
+ * 
+ * @param p_fsm Pointer to a fsm_buzzer
+ * @param half Half of the buffer (0 or 1)
+ */
+static void _fill_sequencer_half(fsm_buzzer_t * p_fsm, uint32_t half){
+    bool last = false;
+    for (uint32_t i = half * BUZZER_SEQUENCER_HALF_LENGTH; i < (half + 1) * BUZZER_SEQUENCER_HALF_LENGTH; i++)
+    {
+        uint8_t note = SILENCE;
+        uint32_t duration_us = BUZZER_SEQUENCER_PAD_US;
+        if (melody_iterator_has_next(&p_fsm->iterator))
+        {
+            melody_iterator_next(&p_fsm->iterator, &note, &duration_us);
+            duration_us = _scale_duration(p_fsm, duration_us);
+        }
+        else
+        {
+            last = true;
+        }
+        port_buzzer_sequencer_set_record(p_fsm->buzzer_id, i, note, duration_us);
+    }
+    port_buzzer_sequencer_set_half_done(p_fsm->buzzer_id, half, last);
 }
 
 /* State machine input or transition functions */
@@ -43,7 +81,7 @@ static void _start_note(fsm_t * p_this, double 	freq, uint32_t duration){
  */
 static bool check_end_melody(fsm_t * p_this){
     fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
-    return (p_fsm->note_index>=p_fsm->p_melody->melody_length);
+    return !melody_iterator_has_next(&p_fsm->iterator);
 //    if(p_fsm->note_index<p_fsm->p_melody->melody_length)
 //        return true;
 //    else
@@ -59,7 +97,7 @@ static bool check_end_melody(fsm_t * p_this){
  */
 static bool check_melody_start(fsm_t * p_this){
     fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
-    return (p_fsm->p_melody!=NULL && p_fsm->user_action==PLAY);
+    return (p_fsm->view.p_melody!=NULL && p_fsm->user_action==PLAY);
 //    if(p_fsm->p_melody!=NULL && check_resume(p_this))
 //        return true;
 //    else
@@ -141,6 +179,70 @@ static bool check_resume(fsm_t * p_this){
 }
 
 
+/**
+ * @brief Checks if the next note can be queued: the player is playing, there is a next note and the
+ * PORT has room for it.
+ * 
+ * @param p_this Pointer to a struct that contins a fsm_buzzer
+ * @return true the next note can be queued
+ * @return false the next note can't be queued
+ */
+static bool check_queue_note(fsm_t * p_this){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    return (p_fsm->user_action==PLAY && melody_iterator_has_next(&p_fsm->iterator) && port_buzzer_get_queue_free(p_fsm->buzzer_id));
+}
+
+
+/**
+ * @brief Checks if the melody has to be played by the sequencer: the sequencer is enabled, there is a
+ * melody and user action is play.
+ * 
+ * @param p_this Pointer to a struct that contins a fsm_buzzer
+ * @return true the melody has to start in the sequencer
+ * @return false the sequencer is disabled, there isn't a melody or user action isn't play
+ */
+static bool check_sequence_start(fsm_t * p_this){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    return (p_fsm->sequencer && check_melody_start(p_this));
+}
+
+/**
+ * @brief Checks if another melody (or the same one from the start) has been set while the sequencer plays.
+ * The sequencer has always read the first note, so an iterator at the start means that it has been reset.
+ * 
+ * @param p_this Pointer to a struct that contins a fsm_buzzer
+ * @return true the sequencer has to start again
+ * @return false the sequencer goes on
+ */
+static bool check_sequence_restart(fsm_t * p_this){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    return (p_fsm->iterator.index == 0 && check_melody_start(p_this));
+}
+
+/**
+ * @brief Checks if a half of the sequencer buffer has been played and has to be refilled.
+ * 
+ * @param p_this Pointer to a struct that contins a fsm_buzzer
+ * @return true there is a half to refill
+ * @return false there is no half to refill
+ */
+static bool check_sequence_refill(fsm_t * p_this){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    return (port_buzzer_sequencer_get_free_half(p_fsm->buzzer_id) >= 0);
+}
+
+/**
+ * @brief Checks if the sequencer has played the whole melody.
+ * 
+ * @param p_this Pointer to a struct that contins a fsm_buzzer
+ * @return true the melody has ended
+ * @return false the melody hasn't ended
+ */
+static bool check_sequence_end(fsm_t * p_this){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    return port_buzzer_sequencer_get_end(p_fsm->buzzer_id);
+}
+
 /* State machine output or action functions */
 
 /**
@@ -153,33 +255,49 @@ static bool check_resume(fsm_t * p_this){
 static void do_end_melody(fsm_t * p_this){
     fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
     port_buzzer_stop(p_fsm->buzzer_id);// 1. Call the corresponding function from PORT that stops the PWM and the timer
-    p_fsm->note_index=0;    // 2. Reset the index of the melody
+    melody_iterator_init(&p_fsm->iterator, &p_fsm->view);    // 2. Reset the index of the melody
     p_fsm->user_action=STOP; //3 Update the action of the player
 }
 
 /**
- * @brief Starts a song, first gets the frequency and duration of the first note,
- * then calls the fuction _start_note with this frequency and duration and increments
- * by one note index.
+ * @brief Starts a song, first gets the note and duration of the first note from
+ * the view, then calls the fuction _start_note with this note and duration.
  * 
  * @param p_this Pointer to a struct that contins a fsm_buzzer
  */
 static void do_melody_start(fsm_t * p_this){
     fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
-    double freq = p_fsm->p_melody->p_notes[0];
-    uint16_t duration = p_fsm->p_melody->p_durations[0];
-    _start_note(p_this, freq, duration);
-    p_fsm->note_index++;
+    uint8_t note;
+    uint32_t duration_us;
+    melody_iterator_init(&p_fsm->iterator, &p_fsm->view);
+    melody_iterator_next(&p_fsm->iterator, &note, &duration_us);
+    _start_note(p_this, note, duration_us);
 }
 
 /**
- * @brief Ends current note by calling port_buzzer_stop to stop the PWM and the timer.
+ * @brief Queues the next note of the view while the current one is playing, so that the timer
+ * interrupt starts it with no gap.
+ * 
+ * > 1. Read the next note on a copy of the iterator \n
+ * > 2. Queue it in the PORT. Only if it has been queued, move the iterator. If the current note
+ * has just ended, the note will be started by `do_play_note()` instead \n
  * 
- * @param p_this Pointer to a struct that contins a fsm_buzzer 
+ * @param p_this Pointer to a struct that contins a fsm_buzzer
  */
-static void do_note_end(fsm_t * p_this){
+static void do_queue_note(fsm_t * p_this){
     fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
-    port_buzzer_stop(p_fsm->buzzer_id);// 1. Call the corresponding function from PORT that stops the PWM and the timer
+    uint8_t note;
+    uint32_t duration_us;
+
+    // 1.
+    melody_iterator_t next = p_fsm->iterator;
+    melody_iterator_next(&next, &note, &duration_us);
+
+    // 2.
+    if (port_buzzer_queue_note(p_fsm->buzzer_id, note, _scale_duration(p_fsm, duration_us)))
+    {
+        p_fsm->iterator = next;
+    }
 }
 
 /**
@@ -193,18 +311,17 @@ static void do_pause(fsm_t * p_this){
 }
 
 /**
- * @brief Plays a new note, by geting the frequency and duration of the current
- * note, then calls the fuction _start_note with this frequency and duration 
- * and increments by one note index.
+ * @brief Plays a new note, by geting the note and duration of the next
+ * note from the view, then calls the fuction _start_note with this note and duration.
  * 
  * @param p_this Pointer to a struct that contins a fsm_buzzer
  */
 static void do_play_note(fsm_t * p_this){
     fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
-    double freq = p_fsm->p_melody->p_notes[p_fsm->note_index];
-    uint16_t duration = p_fsm->p_melody->p_durations[p_fsm->note_index];
-    _start_note(p_this, freq, duration);
-    p_fsm->note_index++;
+    uint8_t note;
+    uint32_t duration_us;
+    melody_iterator_next(&p_fsm->iterator, &note, &duration_us);
+    _start_note(p_this, note, duration_us);
 }
 
 /**
@@ -225,7 +342,56 @@ static void do_player_start(fsm_t * p_this){
 static void do_player_stop(fsm_t * p_this){
     fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
     port_buzzer_stop(p_fsm->buzzer_id);// 1. Call the corresponding function from PORT that stops the PWM and the timer
-    p_fsm->note_index=0;
+    melody_iterator_init(&p_fsm->iterator, &p_fsm->view);
+}
+
+/**
+ * @brief Starts a song in the sequencer: the first note is started by the PORT, and the following
+ * ones are written in the whole sequencer buffer before starting.
+ * 
+ * @param p_this Pointer to a struct that contins a fsm_buzzer
+ */
+static void do_sequence_start(fsm_t * p_this){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    uint8_t note;
+    uint32_t duration_us;
+    port_buzzer_stop(p_fsm->buzzer_id);
+    melody_iterator_init(&p_fsm->iterator, &p_fsm->view);
+    melody_iterator_next(&p_fsm->iterator, &note, &duration_us);
+    _fill_sequencer_half(p_fsm, 0);
+    _fill_sequencer_half(p_fsm, 1);
+    port_buzzer_sequencer_start(p_fsm->buzzer_id, note, _scale_duration(p_fsm, duration_us));
+}
+
+/**
+ * @brief Refills the half of the sequencer buffer that has been played with the next notes.
+ * Transposition, tempo and speed changes are heard from these notes.
+ * 
+ * @param p_this Pointer to a struct that contins a fsm_buzzer
+ */
+static void do_sequence_refill(fsm_t * p_this){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    _fill_sequencer_half(p_fsm, port_buzzer_sequencer_get_free_half(p_fsm->buzzer_id));
+}
+
+/**
+ * @brief Pauses the sequencer in the middle of the note.
+ * 
+ * @param p_this Pointer to a struct that contins a fsm_buzzer
+ */
+static void do_sequence_pause(fsm_t * p_this){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    port_buzzer_sequencer_pause(p_fsm->buzzer_id);
+}
+
+/**
+ * @brief Resumes the sequencer where it was paused.
+ * 
+ * @param p_this Pointer to a struct that contins a fsm_buzzer
+ */
+static void do_sequence_resume(fsm_t * p_this){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    port_buzzer_sequencer_resume(p_fsm->buzzer_id);
 }
 
 /* fsm_trans_t */
@@ -234,14 +400,24 @@ static void do_player_stop(fsm_t * p_this){
  * 
  */
 static fsm_trans_t fsm_trans_buzzer[] = {
+    {WAIT_START, check_sequence_start, SEQUENCE, do_sequence_start},
     {WAIT_START, check_player_start, WAIT_NOTE, do_player_start},
-    {WAIT_NOTE, check_note_end, PLAY_NOTE, do_note_end},
+    {WAIT_NOTE, check_note_end, PLAY_NOTE, NULL}, // The PORT stops the timers when there is no note queued
+    {WAIT_NOTE, check_queue_note, WAIT_NOTE, do_queue_note},
     {PLAY_NOTE, check_play_note, WAIT_NOTE, do_play_note},
     {PLAY_NOTE, check_player_stop, WAIT_START, do_player_stop},
     {PLAY_NOTE, check_pause, PAUSE_NOTE, do_pause},
     {PLAY_NOTE, check_end_melody, WAIT_MELODY, do_end_melody},
     {PAUSE_NOTE, check_resume, PLAY_NOTE, NULL},
+    {WAIT_MELODY, check_sequence_start, SEQUENCE, do_sequence_start},
     {WAIT_MELODY, check_melody_start, WAIT_NOTE, do_melody_start},
+    {SEQUENCE, check_player_stop, WAIT_START, do_player_stop},
+    {SEQUENCE, check_sequence_restart, SEQUENCE, do_sequence_start},
+    {SEQUENCE, check_sequence_end, WAIT_MELODY, do_end_melody},
+    {SEQUENCE, check_pause, SEQUENCE_PAUSE, do_sequence_pause},
+    {SEQUENCE, check_sequence_refill, SEQUENCE, do_sequence_refill},
+    {SEQUENCE_PAUSE, check_player_stop, WAIT_START, do_player_stop},
+    {SEQUENCE_PAUSE, check_resume, SEQUENCE, do_sequence_resume},
     {-1, NULL, -1, NULL}
 };
 
@@ -251,34 +427,60 @@ static fsm_trans_t fsm_trans_buzzer[] = {
 
 void fsm_buzzer_set_melody(fsm_t * p_this, const melody_t * p_melody){
     fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
-    p_fsm->p_melody=(melody_t *)p_melody;
+    melody_view_init(&p_fsm->view, p_melody);
+    melody_iterator_init(&p_fsm->iterator, &p_fsm->view);
+    port_system_event_post(SYSTEM_EVENT_BUZZER);
+}
+
+void fsm_buzzer_set_reverse_melody(fsm_t * p_this, const melody_t * p_melody){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    fsm_buzzer_set_melody(p_this, p_melody);
+    p_fsm->view.reverse = true;
 }
 
-/*void fsm_buzzer_set_reverse_melody(fsm_t * p_this, const melody_t * p_melody){
+void fsm_buzzer_set_transpose(fsm_t * p_this, int32_t semitones){
     fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
-    // Creamos nuevo melody_t*
-    melody_t *p_reversed_melody = (melody_t *)malloc(sizeof(melody_t));
+    melody_view_set_transpose(&p_fsm->view, semitones);
+}
 
-    p_reversed_melody->p_name = p_melody->p_name;
-    p_reversed_melody->melody_length = p_melody->melody_length;
+void fsm_buzzer_set_tempo(fsm_t * p_this, uint32_t tempo){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    melody_view_set_tempo(&p_fsm->view, tempo);
+}
 
-    // Asignar memoria para los arrays invertidos de notas y duraciones
-    p_reversed_melody->p_notes = (double *)malloc(p_melody->melody_length * sizeof(int));
-    p_reversed_melody->p_durations = (uint16_t *)malloc(p_melody->melody_length * sizeof(int));
 
-    // Invertir los arrays
-    for (size_t i = 0; i < p_melody->melody_length; ++i) {
-        p_reversed_melody->p_notes[i] = p_melody->p_notes[p_melody->melody_length - 1 - i];
-        p_reversed_melody->p_durations[i] = p_melody->p_durations[p_melody->melody_length - 1 - i];
-    }
+void fsm_buzzer_set_speed(fsm_t * p_this, uint32_t speed){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    if (speed < BUZZER_SPEED_MIN)
+        speed = BUZZER_SPEED_MIN;
+    if (speed > BUZZER_SPEED_MAX)
+        speed = BUZZER_SPEED_MAX;
+    p_fsm->player_speed=speed;
+    p_fsm->duration_scale=melody_view_get_duration_scale(speed); // Only done when the speed changes, not on every note
+}
 
-    p_fsm->p_melody = p_reversed_melody;
-}*/
 
+void fsm_buzzer_set_gap_measurement(fsm_t * p_this, bool enable){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    port_buzzer_set_gap_measurement(p_fsm->buzzer_id, enable);
+}
 
-void fsm_buzzer_set_speed(fsm_t * p_this, double speed){
+
+void fsm_buzzer_get_gap_stats(fsm_t * p_this, port_buzzer_gap_stats_t *p_stats){
     fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
-    p_fsm->player_speed=speed;
+    port_buzzer_get_gap_stats(p_fsm->buzzer_id, p_stats);
+}
+
+
+void fsm_buzzer_set_sequencer(fsm_t * p_this, bool enable){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    p_fsm->sequencer=enable;
+}
+
+
+bool fsm_buzzer_get_sequencer(fsm_t * p_this){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    return p_fsm->sequencer;
 }
 
 
@@ -286,7 +488,8 @@ void fsm_buzzer_set_action(fsm_t * p_this, uint8_t action){
     fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
     p_fsm->user_action=action;
     if (p_fsm->user_action==STOP)
-        p_fsm->note_index=0;
+        melody_iterator_init(&p_fsm->iterator, &p_fsm->view);
+    port_system_event_post(SYSTEM_EVENT_BUZZER);
 }
 
 
@@ -295,6 +498,16 @@ uint8_t fsm_buzzer_get_action(fsm_t * p_this){
     return p_fsm->user_action;
 }
 
+uint32_t fsm_buzzer_get_note_index(fsm_t * p_this){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    return p_fsm->iterator.index;
+}
+
+uint32_t fsm_buzzer_get_speed(fsm_t * p_this){
+    fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    return p_fsm->player_speed;
+}
+
 
 fsm_t *fsm_buzzer_new(uint32_t buzzer_id)
 {
@@ -307,18 +520,23 @@ void fsm_buzzer_init(fsm_t *p_this, uint32_t buzzer_id)
 {
     fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
     fsm_init(p_this, fsm_trans_buzzer);
+    fsm_index_init(p_this, fsm_trans_buzzer);
 
 
     p_fsm->buzzer_id = buzzer_id;
-    p_fsm->p_melody = NULL;
-    p_fsm->note_index = 0;
+    melody_view_init(&p_fsm->view, NULL);
+    melody_iterator_init(&p_fsm->iterator, &p_fsm->view);
     p_fsm->user_action = STOP;
-    p_fsm->player_speed = 1.0;
+    p_fsm->sequencer = false;
+    fsm_buzzer_set_speed(p_this, BUZZER_SPEED_ONE);
     port_buzzer_init(buzzer_id);
 }
 
 bool fsm_buzzer_check_activity(fsm_t * p_this)
 {
     fsm_buzzer_t *p_fsm = (fsm_buzzer_t *)(p_this);
+    // The sequencer plays on its own: the CPU can sleep until a half of the buffer has to be refilled or the melody ends
+    if (p_fsm->f.current_state == SEQUENCE)
+        return (check_sequence_refill(p_this) || check_sequence_end(p_this));
     return (p_fsm->user_action == PLAY);
 }
\ No newline at end of file
@@ -0,0 +1,103 @@
+/**
+ * @file fsm_index.c
+ * @brief Per-state index of the transition tables of the FSMs, so that a fire only visits the rows of the current state.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-10
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C libraries */
+#include <stddef.h> // NULL
+#include <string.h> // memset
+
+/* Other libraries */
+#include "fsm_index.h"
+
+/* Public functions */
+void fsm_index_init(fsm_t *p_this, const fsm_trans_t *p_tt)
+{
+    fsm_index_t *p_index = &((fsm_indexed_t *)p_this)->index;
+    memset(p_index, 0, sizeof(*p_index));
+    p_index->p_tt = p_tt;
+
+    // 1. Count the rows of each state
+    uint8_t count[FSM_INDEX_MAX_STATES] = {0};
+    uint32_t rows_count = 0;
+    for (const fsm_trans_t *p_t = p_tt; p_t->orig_state >= 0 && rows_count < FSM_INDEX_MAX_TRANSITIONS; p_t++, rows_count++)
+    {
+        if (p_t->orig_state < FSM_INDEX_MAX_STATES)
+        {
+            count[p_t->orig_state]++;
+            if (p_t->orig_state >= p_index->states_count)
+            {
+                p_index->states_count = p_t->orig_state + 1;
+            }
+        }
+    }
+
+    // 2. Where the rows of each state start
+    for (uint32_t s = 0; s < p_index->states_count; s++)
+    {
+        p_index->first[s + 1] = p_index->first[s] + count[s];
+    }
+
+    // 3. Place the rows. They are taken in the order of the table, so the priority between them is kept
+    uint8_t next[FSM_INDEX_MAX_STATES];
+    memcpy(next, p_index->first, sizeof(next));
+    for (uint32_t i = 0; i < rows_count; i++)
+    {
+        int state = p_tt[i].orig_state;
+        if (state < FSM_INDEX_MAX_STATES)
+        {
+            p_index->rows[next[state]++] = i;
+        }
+    }
+}
+
+int fsm_index_fire(fsm_t *p_this)
+{
+    fsm_index_t *p_index = &((fsm_indexed_t *)p_this)->index;
+    int state = p_this->current_state;
+    p_index->stats.fires++;
+    if (state < 0 || state >= p_index->states_count)
+    {
+        return 0;
+    }
+
+    for (uint32_t i = p_index->first[state]; i < p_index->first[state + 1]; i++)
+    {
+        const fsm_trans_t *p_t = &p_index->p_tt[p_index->rows[i]];
+        p_index->stats.guard_calls++;
+        if (p_t->in(p_this))
+        {
+            p_index->stats.rows_linear += p_index->rows[i] + 1;
+            p_this->current_state = p_t->dest_state;
+            if (p_t->out)
+            {
+                p_t->out(p_this);
+            }
+            return 1;
+        }
+    }
+    p_index->stats.rows_linear += p_index->first[p_index->states_count];
+    return 0;
+}
+
+bool fsm_index_shared_guard(fsm_t *p_this, uint32_t slot, fsm_input_func_t guard)
+{
+    fsm_index_t *p_index = &((fsm_indexed_t *)p_this)->index;
+    if (p_index->shared_fire[slot] == p_index->stats.fires)
+    {
+        p_index->stats.shared_hits++;
+        return p_index->shared_value[slot];
+    }
+    p_index->shared_fire[slot] = p_index->stats.fires;
+    p_index->shared_value[slot] = guard(p_this);
+    return p_index->shared_value[slot];
+}
+
+void fsm_index_get_stats(fsm_t *p_this, fsm_index_stats_t *p_stats)
+{
+    *p_stats = ((fsm_indexed_t *)p_this)->index.stats;
+}
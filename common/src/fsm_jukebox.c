@@ -9,8 +9,9 @@
 /* Includes ------------------------------------------------------------------*/
 // Standard C includes
 #include <stdlib.h>
-#include <string.h> // strcmp
+#include <string.h> // strlen, memchr
 #include <stdio.h>  // sprintf
+#include <math.h>   // isfinite
 
 // Other includes
 #include <fsm.h>
@@ -20,6 +21,10 @@
 #include "fsm_buzzer.h"
 #include "port_system.h"
 #include "port_usart.h"
+#include "command_table.h"
+#include "command_macro.h"
+#include "packet.h"
+#include "trace.h"
 
 // v5
 #include "fsm_keypad.h"
@@ -27,274 +32,978 @@
 
 /* Defines ------------------------------------------------------------------*/
 #define MAX(a, b) ((a) > (b) ? (a) : (b)) /*!< Macro to get the maximum of two values. */
+#define MIN(a, b) ((a) < (b) ? (a) : (b)) /*!< Macro to get the minimum of two values. */
+#define CYCLES_TO_NS(cycles) ((uint32_t)((uint64_t)(cycles) * 1000U / (SYSTEM_CORE_CLOCK_HZ / 1000000U))) /*!< Macro to convert CPU cycles to ns. */
+#define JUKEBOX_SHARED_GUARD_ACTIVITY 0 /*!< Slot of the shared guard of the activity of the components. */
+#define JUKEBOX_HELP_PAGE_LENGTH 4 /*!< Commands in each page of `help`. */
+#define JUKEBOX_ARGS_HELP_LENGTH 64 /*!< Length of the description of the arguments of a command, made from its schema. */
+#define JUKEBOX_CHUNK_LENGTH 80 /*!< Maximum length of a chunk of a long answer, such as a melody of `list`. */
+#define JUKEBOX_CHUNKS_PER_FIRE 4 /*!< Chunks of a long answer queued per fire, so the other transitions are not delayed. */
+#define JUKEBOX_MACRO_MAX_DEPTH 4 /*!< Macros that can run inside each other, so that a macro that runs itself ends. */
+
+/* Private variables */
+static command_table_t jukebox_command_table; /*!< Perfect hash of the names of `jukebox_commands`, made by fsm_jukebox_init() */
+
+/**
+ * @brief Block of 128 bytes sent `JUKEBOX_BAUD_BENCH_BLOCKS` times by `baud bench`, without copying it.
+ */
+static const char baud_bench_block[] = "0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDE\n";
 
 /* Private functions */
 /**
- * @brief Parse the message received by the USART.
+ * @brief Executes the commands of a line, separated by `COMMAND_SEPARATOR`, in order. It stops at the first wrong one.
  * 
- * Given data received by the USART, this function parses the message and extracts the command and the parameter (if available).
+ * @param p_fsm_jukebox pointer to a FSM with a FSM jukebox in it.
+ * @param p_line pointer to the line. It is not null terminated.
+ * @param length length of the line.
+ * @return true all the commands have been executed.
+ * @return false a command is wrong, and the ones after it have not been executed.
+ */
+static bool _execute_line(fsm_jukebox_t * p_fsm_jukebox, const char * p_line, uint32_t length);
+
+/**
+ * @brief sets the song to the next one in the jukebox and plays it.
  * 
- * > 1. Split the message by space using function `strtok()` \n
- * > 2. If there's a token (command), copy it to the `p_command` variable. Otherwise, return `false` \n
- * > 3. Extract the parameter (if available). To do so, get the next token using function `strtok()`. If there's a token, copy it to the `p_param` variable. Otherwise, copy an empty string to the `p_param` variable \n
- * > 4. Return `true` indicating that the message has been parsed correctly \n
+ * @param p_fsm_jukebox pointer to a FSM with a FSM jukebox in it.
+ */
+void _set_next_song(fsm_jukebox_t * p_fsm_jukebox)
+{
+    // 1.
+    fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, STOP);
+
+    // 2.
+    p_fsm_jukebox->melody_idx++;
+    if(p_fsm_jukebox->melody_idx >= melody_catalog_get_count(p_fsm_jukebox->p_catalog)){
+        p_fsm_jukebox->melody_idx=0;
+    }
+
+    // 3.
+    const melody_t *p_melody = melody_catalog_get(p_fsm_jukebox->p_catalog, p_fsm_jukebox->melody_idx);
+    p_fsm_jukebox->p_melody=melody_get_name(p_melody);
+
+    // 4.
+    trace_emit(TRACE_PLAYING, p_fsm_jukebox->melody_idx, 0);
+
+    // 5.
+    fsm_buzzer_set_melody(p_fsm_jukebox->p_fsm_buzzer, p_melody);
+    
+    // 6.
+    fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, PLAY);
+}
+
+/**
+ * @brief Queue a message formatted by a command. It is not printed through the ITM, which would wait for each character.
  * 
- * @param p_message Pointer to the message received by the USART.
- * @param p_command Pointer to store the command extracted from the message. 
- * @param p_param Pointer to store the parameter extracted from the message. 
- * @return true if the message has been parsed correctly 
- * @return false if the message has not been parsed correctly 
+ * @param p_fsm_jukebox pointer to a FSM with a FSM jukebox in it.
+ * @param p_msg message, null terminated.
  */
-bool _parse_message(char *p_message, char *p_command, char *p_param)
+static void _reply(fsm_jukebox_t * p_fsm_jukebox, const char *p_msg)
 {
-    char *p_token = strtok(p_message, " "); // Split the message by space
+    fsm_usart_set_out_data(p_fsm_jukebox->p_fsm_usart, p_msg);
+}
 
-    // If there's a token (command), copy it to the command variable
-    if (p_token != NULL)
+/**
+ * @brief Start sending a long answer, a chunk at a time as the TX queue drains, so it takes the same memory whatever its length.
+ * 
+ * @param p_fsm_jukebox pointer to a FSM with a FSM jukebox in it.
+ * @param response function that writes each chunk.
+ * @param count number of chunks.
+ */
+static void _respond(fsm_jukebox_t * p_fsm_jukebox, fsm_jukebox_chunk_t response, uint32_t count)
+{
+    if (p_fsm_jukebox->response != NULL)
     {
-        strcpy(p_command, p_token);
+        // Only one answer at a time, so its chunks are not mixed with the ones of another
+        fsm_usart_send_const(p_fsm_jukebox->p_fsm_usart, "Error: An answer is still being sent\n");
+        return;
     }
-    else
+    p_fsm_jukebox->response = response;
+    p_fsm_jukebox->response_index = 0;
+    p_fsm_jukebox->response_count = count;
+}
+
+/**
+ * @brief Write a chunk of `list`: a melody, and the end of line after the last one.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param index number of the melody, or the number of melodies for the end of line.
+ * @param p_chunk pointer to store the chunk.
+ * @param size size of `p_chunk`.
+ * @return uint32_t length of the chunk.
+ */
+static uint32_t _list_chunk(void *p_context, uint32_t index, char *p_chunk, uint32_t size)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    const melody_t *p_melody = melody_catalog_get(p_fsm_jukebox->p_catalog, index);
+    if (p_melody == NULL)
     {
-        // No command found, you might return an error or handle it as needed
-        // The USART driver of the computer sends an empty at initialization, so we will ignore it
-        return false;
+        // The end, or a melody unloaded while the list was being sent
+        return (index + 1 == p_fsm_jukebox->response_count) ? snprintf(p_chunk, size, "\n") : 0;
     }
+    return snprintf(p_chunk, size, "%s [%ld]: %s |", (index == 0) ? "|" : "", index, melody_get_name(p_melody));
+}
 
-    // Extract the parameter (if available)
-    p_token = strtok(NULL, " "); // Get the next token
+/**
+ * @brief Write a chunk of `help all`: the title, a command, or the end of line after the last one.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param index 0 for the title, the number of the command plus 1, or the number of commands plus 1 for the end of line.
+ * @param p_chunk pointer to store the chunk.
+ * @param size size of `p_chunk`.
+ * @return uint32_t length of the chunk.
+ */
+static uint32_t _help_chunk(void *p_context, uint32_t index, char *p_chunk, uint32_t size)
+{
+    const command_t *p_command = command_table_get(&jukebox_command_table, index - 1);
+    if (index == 0)
+    {
+        return snprintf(p_chunk, size, "List of commands:");
+    }
+    if (p_command == NULL)
+    {
+        return snprintf(p_chunk, size, " \n");
+    }
+    return snprintf(p_chunk, size, " '%s' %s |", p_command->p_name, p_command->p_summary);
+}
 
-    if (p_token != NULL)
+/**
+ * @brief Select a melody and play it from its first note.
+ * 
+ * @param p_fsm_jukebox pointer to a FSM with a FSM jukebox in it.
+ * @param melody_selected id of the melody.
+ * @param reverse flag to play it from the last note to the first one.
+ */
+static void _play_melody(fsm_jukebox_t * p_fsm_jukebox, uint32_t melody_selected, bool reverse)
+{
+    const melody_t *p_melody = melody_catalog_get(p_fsm_jukebox->p_catalog, melody_selected);
+    if (p_melody == NULL)
     {
-        strcpy(p_param, p_token);
+        fsm_usart_send_const(p_fsm_jukebox->p_fsm_usart, "Error: Melody not found\n");
+        return;
+    }
+    fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, STOP);
+    p_fsm_jukebox->melody_idx = melody_selected;
+    if (reverse)
+    {
+        fsm_buzzer_set_reverse_melody(p_fsm_jukebox->p_fsm_buzzer, p_melody);
     }
     else
     {
-        strcpy(p_param, " "); // NO param found
+        fsm_buzzer_set_melody(p_fsm_jukebox->p_fsm_buzzer, p_melody);
     }
-    return true;
+    p_fsm_jukebox->p_melody = melody_get_name(p_melody);
+    fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, PLAY);
+    trace_emit(reverse ? TRACE_PLAYING_REVERSED : TRACE_PLAYING, melody_selected, 0);
 }
 
+/* Commands: the handlers of the table `jukebox_commands`. The context is the jukebox FSM */
 /**
- * @brief sets the song to the next one in the jukebox and plays it.
+ * @brief `play`: play the current melody, or resume it.
  * 
- * @param p_fsm_jukebox pointer to a FSM with a FSM jukebox in it.
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (none).
  */
-void _set_next_song(fsm_jukebox_t * p_fsm_jukebox)
+static void _command_play(void *p_context, const command_arg_t *p_args)
 {
-    // 1.
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, PLAY);
+    trace_emit(TRACE_PLAYING, p_fsm_jukebox->melody_idx, 0);
+}
+
+/**
+ * @brief `stop`: stop the current melody.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (none).
+ */
+static void _command_stop(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
     fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, STOP);
+    trace_emit(TRACE_STOPPED, 0, 0);
+}
 
-    // 2.
-    p_fsm_jukebox->melody_idx++;
-    if(p_fsm_jukebox->melody_idx >= MELODIES_MEMORY_SIZE){
-        p_fsm_jukebox->melody_idx=0;
-    }
+/**
+ * @brief `pause`: pause the current melody.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (none).
+ */
+static void _command_pause(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, PAUSE);
+    trace_emit(TRACE_PAUSED, 0, 0);
+}
 
-    // 3.
-    if(p_fsm_jukebox->melodies[p_fsm_jukebox->melody_idx].melody_length <= 0){
-        p_fsm_jukebox->melody_idx=0;
+/**
+ * @brief `speed <x>`: change the speed of the player.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (double).
+ */
+static void _command_speed(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    double speed = p_args[0].double_value * BUZZER_SPEED_ONE;
+    if (!isfinite(speed))
+    {
+        fsm_usart_send_const(p_fsm_jukebox->p_fsm_usart, "Error: Wrong speed\n");
+        return;
     }
-    p_fsm_jukebox->p_melody=p_fsm_jukebox->melodies[p_fsm_jukebox->melody_idx].p_name;
+    speed = MIN(MAX(speed, BUZZER_SPEED_MIN), BUZZER_SPEED_MAX); // Clamped before the conversion, which is undefined out of range
+    fsm_buzzer_set_speed(p_fsm_jukebox->p_fsm_buzzer, (uint32_t)(speed + 0.5));
+}
 
-    // 4.
-    printf("Playing: %s\n", p_fsm_jukebox->p_melody);
+/**
+ * @brief `next`: play the melody after the current one.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (none).
+ */
+static void _command_next(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    _set_next_song(p_fsm_jukebox);
+}
 
-    // 5.
-    fsm_buzzer_set_melody(p_fsm_jukebox->p_fsm_buzzer, p_fsm_jukebox->melodies+p_fsm_jukebox->melody_idx);
-    
-    // 6.
-    fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, PLAY);
+/**
+ * @brief `select <id>`: play a melody.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (integer).
+ */
+static void _command_select(void *p_context, const command_arg_t *p_args)
+{
+    _play_melody(p_context, (uint32_t)p_args[0].int_value, false);
 }
 
 /**
- * @brief Executes the command.
+ * @brief `info [id]`: show the name of a melody, or of the current one.
  * 
- * @param p_fsm_jukebox pointer to a FSM with a FSM jukebox in it.
- * @param p_command Pointer that contains the command extracted from the message.
- * @param p_param Pointer that contains the parameter extracted from the message.
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (optional integer).
  */
-void _execute_command(fsm_jukebox_t * p_fsm_jukebox, char * p_command, char * p_param)
+static void _command_info(void *p_context, const command_arg_t *p_args)
 {
-    // https://sdg2dieupm.github.io/jukebox/fsm_jukebox_execute_command.png
-    if (!strcmp(p_command, "play"))
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    char msg[USART_OUTPUT_BUFFER_LENGTH];
+    if (p_args[0].present)
     {
-        fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, PLAY);
-        printf("Playing: %s\n", p_fsm_jukebox->p_melody);
+        const melody_t *p_melody = melody_catalog_get(p_fsm_jukebox->p_catalog, (uint32_t)p_args[0].int_value);
+        if (p_melody != NULL)
+        {
+            snprintf(msg, sizeof(msg), "[%ld]: %s\n", p_args[0].int_value, melody_get_name(p_melody));
+        }
+        else
+        {
+            snprintf(msg, sizeof(msg), "Error: Melody not found\n");
+        }
     }
-    else if (!strcmp(p_command, "stop"))
+    else
     {
-        fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, STOP);
-        printf("Stopped\n");
+        snprintf(msg, sizeof(msg), "Playing: %s\n", p_fsm_jukebox->p_melody);
+    }
+    _reply(p_fsm_jukebox, msg);
+}
+
+/**
+ * @brief `list`: show the id and name of every melody.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (none).
+ */
+static void _command_list(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    // A melody per chunk, and the end of line
+    _respond(p_fsm_jukebox, _list_chunk, melody_catalog_get_count(p_fsm_jukebox->p_catalog) + 1);
+}
+
+/**
+ * @brief `load <notes>`: start the upload of a melody.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (integer).
+ */
+static void _command_load(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    char msg[USART_OUTPUT_BUFFER_LENGTH];
+    uint32_t melody_length = (p_args[0].int_value > 0) ? (uint32_t)p_args[0].int_value : 0;
+    if (melody_pool_load_begin(p_fsm_jukebox->p_pool, melody_length))
+    {
+        fsm_usart_enable_raw_rx(p_fsm_jukebox->p_fsm_usart);
+        port_system_timer_start(&p_fsm_jukebox->load_timer, JUKEBOX_LOAD_TIMEOUT_MS, 0);
+        sprintf(msg, "Load: send the name and %ld notes\n", melody_length);
     }
-    else if (!strcmp(p_command, "pause"))
+    else
     {
-        fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, PAUSE);
-        printf("Paused\n");
+        sprintf(msg, "Error: Melody can't be loaded (%ld bytes free)\n", melody_pool_get_free(p_fsm_jukebox->p_pool));
     }
-    else if (!strcmp(p_command, "speed"))
+    fsm_usart_set_out_data(p_fsm_jukebox->p_fsm_usart, msg);
+}
+
+/**
+ * @brief `unload <id>`: delete an uploaded melody.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (integer).
+ */
+static void _command_unload(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    char msg[USART_OUTPUT_BUFFER_LENGTH];
+    uint32_t melody_selected = (uint32_t)p_args[0].int_value;
+    uint32_t first_loaded = melody_catalog_get_flash_count(p_fsm_jukebox->p_catalog);
+    if (p_args[0].int_value < 0 || melody_selected < first_loaded || melody_selected >= melody_catalog_get_count(p_fsm_jukebox->p_catalog))
     {
-        double param = atof(p_param);
-        double speed = MAX(param, 0.1);
-        fsm_buzzer_set_speed(p_fsm_jukebox->p_fsm_buzzer, speed);
+        sprintf(msg, "Error: Melody not found\n");
     }
-    else if (!strcmp(p_command, "next"))
+    else if (melody_pool_is_loading(p_fsm_jukebox->p_pool))
     {
-        _set_next_song(p_fsm_jukebox);
-        printf("Playing: %s\n", p_fsm_jukebox->p_melody);
+        // The upload in progress is stored after the last melody, so the pool can't be compacted under it
+        sprintf(msg, "Error: Melody can't be unloaded during an upload\n");
     }
-    else if (!strcmp(p_command, "select"))
+    else
     {
-        uint32_t melody_selected =atoi(p_param);
-        if (p_fsm_jukebox->melodies[melody_selected].melody_length != 0)
+        // The melodies after the deleted one are moved, so the current one can't keep playing
+        if (p_fsm_jukebox->melody_idx >= melody_selected)
         {
             fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, STOP);
-            p_fsm_jukebox->melody_idx=melody_selected;
-            fsm_buzzer_set_melody(p_fsm_jukebox->p_fsm_buzzer, p_fsm_jukebox->melodies+p_fsm_jukebox->melody_idx);
-            p_fsm_jukebox->p_melody=p_fsm_jukebox->melodies[p_fsm_jukebox->melody_idx].p_name;
-            fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, PLAY);
-            printf("Playing: %s\n", p_fsm_jukebox->p_melody);
+            p_fsm_jukebox->melody_idx = 0;
+            fsm_buzzer_set_melody(p_fsm_jukebox->p_fsm_buzzer, melody_catalog_get(p_fsm_jukebox->p_catalog, 0));
+            p_fsm_jukebox->p_melody = melody_get_name(melody_catalog_get(p_fsm_jukebox->p_catalog, 0));
+        }
+        if (melody_pool_delete(p_fsm_jukebox->p_pool, melody_selected - first_loaded))
+        {
+            sprintf(msg, "Unloaded [%ld]\n", melody_selected);
         }
         else
         {
-            char msg[USART_OUTPUT_BUFFER_LENGTH];
             sprintf(msg, "Error: Melody not found\n");
-            fsm_usart_set_out_data(p_fsm_jukebox->p_fsm_usart, msg);
         }
-        
     }
-    else if (!strcmp(p_command, "info"))
+    fsm_usart_set_out_data(p_fsm_jukebox->p_fsm_usart, msg);
+}
+
+/**
+ * @brief `pool`: show the uploaded melodies and the free memory.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (none).
+ */
+static void _command_pool(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    char msg[USART_OUTPUT_BUFFER_LENGTH];
+    sprintf(msg, "Pool: %ld melodies, %ld bytes free\n", melody_pool_get_count(p_fsm_jukebox->p_pool), melody_pool_get_free(p_fsm_jukebox->p_pool));
+    fsm_usart_set_out_data(p_fsm_jukebox->p_fsm_usart, msg);
+}
+
+/**
+ * @brief `reverse [id]`: play a melody, or the current one, from the last note to the first one.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (optional integer).
+ */
+static void _command_reverse(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    _play_melody(p_fsm_jukebox, p_args[0].present ? (uint32_t)p_args[0].int_value : p_fsm_jukebox->melody_idx, true); // Current one by default
+}
+
+/**
+ * @brief `transpose <semitones>`: transpose the current melody.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (integer).
+ */
+static void _command_transpose(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    fsm_buzzer_set_transpose(p_fsm_jukebox->p_fsm_buzzer, p_args[0].int_value); // Limited to +/- 24 by the view
+    trace_emit(TRACE_TRANSPOSED, p_args[0].int_value, 0);
+}
+
+/**
+ * @brief `tempo <x>`: change the tempo of the current melody.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (double).
+ */
+static void _command_tempo(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    double tempo = p_args[0].double_value * MELODY_VIEW_TEMPO_ONE;
+    if (!isfinite(tempo))
     {
-        char msg[USART_OUTPUT_BUFFER_LENGTH];
-        if (p_param[0]!=' ')
+        fsm_usart_send_const(p_fsm_jukebox->p_fsm_usart, "Error: Wrong tempo\n");
+        return;
+    }
+    tempo = MIN(MAX(tempo, MELODY_VIEW_TEMPO_MIN), MELODY_VIEW_TEMPO_MAX); // Clamped before the conversion, which is undefined out of range
+    fsm_buzzer_set_tempo(p_fsm_jukebox->p_fsm_buzzer, (uint32_t)(tempo + 0.5));
+}
+
+/**
+ * @brief `gaps [on|off]`: start or stop measuring the gaps between notes, or show their statistics.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (optional word).
+ */
+static void _command_gaps(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    char msg[USART_OUTPUT_BUFFER_LENGTH];
+    if (p_args[0].present && (command_slice_equals(p_args[0].text, "on") || command_slice_equals(p_args[0].text, "off")))
+    {
+        fsm_buzzer_set_gap_measurement(p_fsm_jukebox->p_fsm_buzzer, p_args[0].text.p_start[1] == 'n');
+        sprintf(msg, "Gap measurement %.*s\n", (int)p_args[0].text.length, p_args[0].text.p_start);
+    }
+    else
+    {
+        port_buzzer_gap_stats_t stats;
+        fsm_buzzer_get_gap_stats(p_fsm_jukebox->p_fsm_buzzer, &stats);
+        uint32_t avg_cycles = (stats.count > 0) ? (uint32_t)(stats.total_cycles / stats.count) : 0;
+        sprintf(msg, "Gaps: %ld, min %ld ns, avg %ld ns, max %ld ns, %ld late\n", stats.count, CYCLES_TO_NS(stats.min_cycles), CYCLES_TO_NS(avg_cycles), CYCLES_TO_NS(stats.max_cycles), stats.late_count);
+    }
+    _reply(p_fsm_jukebox, msg);
+}
+
+/**
+ * @brief `sequencer [on|off]`: play the melodies by DMA or note by note, or show the mode.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (optional word).
+ */
+static void _command_sequencer(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    char msg[USART_OUTPUT_BUFFER_LENGTH];
+    if (p_args[0].present && (command_slice_equals(p_args[0].text, "on") || command_slice_equals(p_args[0].text, "off")))
+    {
+        fsm_buzzer_set_sequencer(p_fsm_jukebox->p_fsm_buzzer, p_args[0].text.p_start[1] == 'n');
+    }
+    sprintf(msg, "Sequencer %s\n", fsm_buzzer_get_sequencer(p_fsm_jukebox->p_fsm_buzzer) ? "on" : "off");
+    _reply(p_fsm_jukebox, msg);
+}
+
+/**
+ * @brief `loop`: show the iterations and wakeups of the main loop since the previous `loop`.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (none).
+ */
+static void _command_loop(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    char msg[USART_OUTPUT_BUFFER_LENGTH];
+    port_system_loop_stats_t stats;
+    port_system_get_loop_stats(&stats);
+    uint32_t now = port_system_get_millis();
+    uint32_t elapsed_ms = (now - p_fsm_jukebox->loop_ms > 0) ? now - p_fsm_jukebox->loop_ms : 1;
+    uint32_t iterations = stats.iterations - p_fsm_jukebox->loop_iterations;
+    uint32_t wakeups = stats.wakeups - p_fsm_jukebox->loop_wakeups;
+    uint32_t awake_permille = (uint32_t)((stats.awake_cycles - p_fsm_jukebox->loop_awake_cycles) * 1000 / ((uint64_t)elapsed_ms * (SYSTEM_CORE_CLOCK_HZ / 1000U)));
+    awake_permille = (awake_permille > 1000) ? 1000 : awake_permille;
+    uint32_t current_ua = SYSTEM_SLEEP_CURRENT_UA + (SYSTEM_RUN_CURRENT_UA - SYSTEM_SLEEP_CURRENT_UA) * awake_permille / 1000;
+    sprintf(msg, "Loop: %ld iterations (%ld/s), %ld wakeups (%ld/s) in %ld ms. Awake %ld.%ld%%, about %ld uA\n", iterations, (uint32_t)((uint64_t)iterations * 1000 / elapsed_ms), wakeups, (uint32_t)((uint64_t)wakeups * 1000 / elapsed_ms), elapsed_ms, awake_permille / 10, awake_permille % 10, current_ua);
+    p_fsm_jukebox->loop_iterations = stats.iterations;
+    p_fsm_jukebox->loop_wakeups = stats.wakeups;
+    p_fsm_jukebox->loop_awake_cycles = stats.awake_cycles;
+    p_fsm_jukebox->loop_ms = now;
+    _reply(p_fsm_jukebox, msg);
+}
+
+/**
+ * @brief `fsm`: show the rows of the transition tables checked per fire.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (none).
+ */
+static void _command_fsm(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    char msg[USART_OUTPUT_BUFFER_LENGTH];
+    fsm_t *p_fsms[] = {p_fsm_jukebox->p_fsm_button, p_fsm_jukebox->p_fsm_usart, p_fsm_jukebox->p_fsm_buzzer, p_fsm_jukebox->p_fsm_keypad, &p_fsm_jukebox->f};
+    const char *p_names[] = {"button", "usart", "buzzer", "keypad", "jukebox"};
+    uint32_t length = sprintf(msg, "Rows per 100 fires (linear/indexed):");
+    uint32_t shared_hits = 0;
+    for (uint32_t i = 0; i < sizeof(p_fsms) / sizeof(p_fsms[0]); i++)
+    {
+        fsm_index_stats_t stats;
+        fsm_index_get_stats(p_fsms[i], &stats);
+        uint32_t fires = (stats.fires > 0) ? stats.fires : 1;
+        length += sprintf(msg + length, " %s %ld/%ld", p_names[i], (uint32_t)((uint64_t)stats.rows_linear * 100 / fires), (uint32_t)((uint64_t)stats.guard_calls * 100 / fires));
+        shared_hits += stats.shared_hits;
+    }
+    sprintf(msg + length, ". Shared guards reused: %ld\n", shared_hits);
+    _reply(p_fsm_jukebox, msg);
+}
+
+/**
+ * @brief `baud [rate|ok|bench]`: change the baud rate, confirm it, measure it, or show it.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (optional word).
+ */
+static void _command_baud(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    char msg[USART_OUTPUT_BUFFER_LENGTH];
+    int32_t baud = 0;
+    uint32_t actual;
+    if (p_args[0].present && command_slice_equals(p_args[0].text, "ok"))
+    {
+        // The command has been received at the new baud rate, so the link works
+        if (p_fsm_jukebox->baud_previous != 0)
         {
-            uint32_t melody_selected =atoi(p_param);
-            if (p_fsm_jukebox->melodies[melody_selected].melody_length != 0 && melody_selected<MELODIES_MEMORY_SIZE)
-            {
-                sprintf(msg, "[%ld]: %s\n",melody_selected , p_fsm_jukebox->melodies[melody_selected].p_name);
-                printf("[%ld]: %s\n",melody_selected , p_fsm_jukebox->melodies[melody_selected].p_name);
-                fsm_usart_set_out_data(p_fsm_jukebox->p_fsm_usart, msg);
-            }
-            else
-            {
-                sprintf(msg, "Error: Melody not found\n");
-                printf("Error: Melody not found\n");
-                fsm_usart_set_out_data(p_fsm_jukebox->p_fsm_usart, msg);
-            }
+            port_system_timer_stop(&p_fsm_jukebox->baud_timer);
+            p_fsm_jukebox->baud_previous = 0;
         }
-        else{
-            sprintf(msg, "Playing: %s\n", p_fsm_jukebox->p_melody);
-            printf("Playing: %s\n", p_fsm_jukebox->p_melody);
-            fsm_usart_set_out_data(p_fsm_jukebox->p_fsm_usart, msg);
+        sprintf(msg, "Baud: %ld\n", fsm_usart_get_baud(p_fsm_jukebox->p_fsm_usart));
+    }
+    else if (p_args[0].present && command_slice_equals(p_args[0].text, "bench"))
+    {
+        // The blocks are literals, so the CPU load is the one of the queue and the DMA interrupt, not of the copies
+        fsm_usart_reset_tx_stats(p_fsm_jukebox->p_fsm_usart);
+        for (uint32_t i = 0; i < JUKEBOX_BAUD_BENCH_BLOCKS; i++)
+        {
+            fsm_usart_send_const(p_fsm_jukebox->p_fsm_usart, baud_bench_block);
         }
-        
+        sprintf(msg, "Bench: %d bytes queued, 'baud' shows the result\n", JUKEBOX_BAUD_BENCH_BLOCKS * (int)(sizeof(baud_bench_block) - 1));
+    }
+    else if (!p_args[0].present)
+    {
+        port_usart_tx_stats_t stats;
+        fsm_usart_get_tx_stats(p_fsm_jukebox->p_fsm_usart, &stats);
+        uint32_t bytes = (stats.bytes > 0) ? stats.bytes : 1;
+        uint64_t busy_cycles = (stats.busy_cycles > 0) ? stats.busy_cycles : 1;
+        uint32_t cycles_per_byte_x100 = (uint32_t)(stats.cpu_cycles * 100 / bytes);
+        fsm_usart_check_baud(p_fsm_jukebox->p_fsm_usart, fsm_usart_get_baud(p_fsm_jukebox->p_fsm_usart), &actual);
+        sprintf(msg, "Baud: %ld (%ld real). Sent %ld bytes at %ld B/s, %ld.%02ld CPU cycles per byte\n", fsm_usart_get_baud(p_fsm_jukebox->p_fsm_usart), actual, stats.bytes, (uint32_t)((uint64_t)stats.bytes * SYSTEM_CORE_CLOCK_HZ / busy_cycles), cycles_per_byte_x100 / 100, cycles_per_byte_x100 % 100);
+    }
+    else if (p_fsm_jukebox->baud_previous == 0 && command_slice_to_int(p_args[0].text, &baud) && baud > 0 && fsm_usart_check_baud(p_fsm_jukebox->p_fsm_usart, baud, &actual))
+    {
+        // The answer is sent at the old baud rate. The new one is kept only if 'baud ok' is received with it in time
+        sprintf(msg, "Baud: %ld (%ld real). Send 'baud ok' at the new rate within %d ms\n", baud, actual, JUKEBOX_BAUD_CONFIRM_MS);
+        _reply(p_fsm_jukebox, msg);
+        p_fsm_jukebox->baud_previous = fsm_usart_get_baud(p_fsm_jukebox->p_fsm_usart);
+        fsm_usart_set_baud(p_fsm_jukebox->p_fsm_usart, baud);
+        port_system_timer_start(&p_fsm_jukebox->baud_timer, JUKEBOX_BAUD_CONFIRM_MS, 0);
+        return;
+    }
+    else
+    {
+        sprintf(msg, "Error: Baud rate not supported (%d to %d)\n", USART_BAUD_MIN, USART_BAUD_MAX);
     }
-    else if(!strcmp(p_command, "list")){
-        char msg1[USART_OUTPUT_BUFFER_LENGTH];
-        sprintf(msg1, "|");
-        for (size_t i = 0; i < MELODIES_MEMORY_SIZE; i++)
+    _reply(p_fsm_jukebox, msg);
+}
+
+/**
+ * @brief `dispatch`: measure the lookup of every command by its hash and by a chain of comparisons.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (none).
+ */
+static void _command_dispatch(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    char msg[USART_OUTPUT_BUFFER_LENGTH];
+    uint32_t hash_min = UINT32_MAX, hash_max = 0, linear_min = UINT32_MAX, linear_max = 0;
+    for (uint32_t i = 0; i < command_table_get_count(&jukebox_command_table); i++)
+    {
+        const char *p_name = command_table_get(&jukebox_command_table, i)->p_name;
+        command_slice_t name = {.p_start = p_name, .length = strlen(p_name)};
+        uint32_t start = port_system_get_cycles();
+        command_table_find(&jukebox_command_table, name);
+        uint32_t cycles = port_system_get_cycles() - start;
+        hash_min = (cycles < hash_min) ? cycles : hash_min;
+        hash_max = (cycles > hash_max) ? cycles : hash_max;
+
+        start = port_system_get_cycles();
+        command_table_find_linear(&jukebox_command_table, name);
+        cycles = port_system_get_cycles() - start;
+        linear_min = (cycles < linear_min) ? cycles : linear_min;
+        linear_max = (cycles > linear_max) ? cycles : linear_max;
+    }
+    sprintf(msg, "Dispatch: %ld commands in %d slots. Cycles per lookup: hash %ld to %ld, linear %ld to %ld\n", command_table_get_count(&jukebox_command_table), COMMAND_TABLE_SLOTS, hash_min, hash_max, linear_min, linear_max);
+    _reply(p_fsm_jukebox, msg);
+}
+
+/**
+ * @brief `macro [name ["commands"]]`: define, show, delete or list the macros.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (optional word, optional word).
+ */
+static void _command_macro(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    char msg[USART_OUTPUT_BUFFER_LENGTH];
+    command_slice_t name = p_args[0].text;
+    const command_macro_t *p_macro = p_args[0].present ? command_macro_find(&p_fsm_jukebox->macros, name) : NULL;
+    if (!p_args[0].present)
+    {
+        uint32_t length = snprintf(msg, sizeof(msg), "Macros: %ld of %d.", command_macro_get_count(&p_fsm_jukebox->macros), COMMAND_MACRO_MAX_MACROS);
+        for (uint32_t i = 0; i < command_macro_get_count(&p_fsm_jukebox->macros) && length < sizeof(msg); i++)
         {
-            char msg2[USART_OUTPUT_BUFFER_LENGTH];
-            sprintf(msg2, " [%d]: %s |",i , p_fsm_jukebox->melodies[i].p_name);
-            printf("|%s\n", msg2);
-            strcat(msg1,msg2);
+            length += snprintf(msg + length, sizeof(msg) - length, " '%s'", command_macro_get(&p_fsm_jukebox->macros, i)->name);
         }
-        strcat(msg1, "\n");
-        fsm_usart_set_out_data(p_fsm_jukebox->p_fsm_usart, msg1);
+        length = (length < sizeof(msg) - 1) ? length : sizeof(msg) - 2;
+        snprintf(msg + length, sizeof(msg) - length, "\n");
     }
-    else if(!strcmp(p_command, "help")){
-        char msg[USART_OUTPUT_BUFFER_LENGTH];
-        
-        if (!strcmp(p_param, "1"))
+    else if (!p_args[1].present)
+    {
+        if (p_macro != NULL)
         {
-            sprintf(msg, "List of commands: 'play' to play current song | 'stop' to stop current song | 'pause' to pause current song | \n");
-            printf("\nList of commands:\n+'play' to play current song.\n+'stop' to stop current song.\n+'pause' to pause current song.\n\n");
+            snprintf(msg, sizeof(msg), "%s = \"%s\"\n", p_macro->name, p_macro->body);
         }
-        else if (!strcmp(p_param, "2"))
+        else
         {
-            sprintf(msg, "List of commands: 'speed' to change the player speed | 'next' to play the next song | 'select' to select a specific song | \n");
-            printf("List of commands:\n+'speed' to change the player speed.\n+'next' to play the next song.\n+'select' to select a specific song.\n\n");
+            snprintf(msg, sizeof(msg), "Error: No macro '%.*s'\n", (int)name.length, name.p_start);
         }
-        else if (!strcmp(p_param, "3"))
+    }
+    else if (p_fsm_jukebox->macro_depth > 0)
+    {
+        // The commands of the macro being run would change under it
+        snprintf(msg, sizeof(msg), "Error: Macros can't be changed by a macro\n");
+    }
+    else if (p_args[1].text.length == 0)
+    {
+        bool removed = command_macro_remove(&p_fsm_jukebox->macros, name);
+        snprintf(msg, sizeof(msg), removed ? "Macro '%.*s' deleted\n" : "Error: No macro '%.*s'\n", (int)name.length, name.p_start);
+    }
+    else if (command_table_find(&jukebox_command_table, name) != NULL || memchr(name.p_start, ' ', name.length) != NULL || memchr(name.p_start, '\t', name.length) != NULL)
+    {
+        snprintf(msg, sizeof(msg), "Error: '%.*s' is a command or has spaces\n", (int)name.length, name.p_start);
+    }
+    else if (command_macro_define(&p_fsm_jukebox->macros, name, p_args[1].text))
+    {
+        snprintf(msg, sizeof(msg), "Macro '%.*s' defined\n", (int)name.length, name.p_start);
+    }
+    else
+    {
+        snprintf(msg, sizeof(msg), "Error: Up to %d macros, names of %d characters and commands of %d\n", COMMAND_MACRO_MAX_MACROS, COMMAND_MACRO_NAME_LENGTH, COMMAND_MACRO_BODY_LENGTH);
+    }
+    _reply(p_fsm_jukebox, msg);
+}
+
+/**
+ * @brief `help [page|all|command]`: show a page of the list of commands, all of them, or the help of a command, all made from the table.
+ * 
+ * @param p_context pointer to a FSM with a FSM jukebox in it.
+ * @param p_args pointer to the arguments (optional word).
+ */
+static void _command_help(void *p_context, const command_arg_t *p_args)
+{
+    fsm_jukebox_t *p_fsm_jukebox = p_context;
+    char msg[USART_OUTPUT_BUFFER_LENGTH];
+    uint32_t count = command_table_get_count(&jukebox_command_table);
+    uint32_t pages = (count + JUKEBOX_HELP_PAGE_LENGTH - 1) / JUKEBOX_HELP_PAGE_LENGTH;
+    int32_t page = 0;
+    const command_t *p_command = p_args[0].present ? command_table_find(&jukebox_command_table, p_args[0].text) : NULL;
+
+    if (p_command != NULL)
+    {
+        // The help is queued as it is, the description of the arguments comes from the schema
+        char args_help[JUKEBOX_ARGS_HELP_LENGTH];
+        command_get_args_help(p_command, args_help, sizeof(args_help));
+        snprintf(msg, sizeof(msg), "%s command: ", p_command->p_name);
+        fsm_usart_set_out_data(p_fsm_jukebox->p_fsm_usart, msg);
+        fsm_usart_send_const(p_fsm_jukebox->p_fsm_usart, p_command->p_help);
+        snprintf(msg, sizeof(msg), " %s\n", args_help);
+        fsm_usart_set_out_data(p_fsm_jukebox->p_fsm_usart, msg);
+    }
+    else if (p_args[0].present && command_slice_equals(p_args[0].text, "all"))
+    {
+        // The title, a command per chunk, and the end of line
+        _respond(p_fsm_jukebox, _help_chunk, count + 2);
+    }
+    else if (p_args[0].present && command_slice_to_int(p_args[0].text, &page) && page >= 1 && (uint32_t)page <= pages)
+    {
+        uint32_t length = snprintf(msg, sizeof(msg), "List of commands:");
+        for (uint32_t i = (uint32_t)(page - 1) * JUKEBOX_HELP_PAGE_LENGTH; i < (uint32_t)page * JUKEBOX_HELP_PAGE_LENGTH && i < count; i++)
         {
-            sprintf(msg, "List of commands: 'info' to get information about a song | 'list' to see the list of songs | \n");
-            printf("List of commands:\n+'info' to get information about a song.\n+'list' to see the list of songs.\n\n");
+            p_command = command_table_get(&jukebox_command_table, i);
+            length += snprintf(msg + length, sizeof(msg) - length, " '%s' %s |", p_command->p_name, p_command->p_summary);
+            length = (length < sizeof(msg)) ? length : sizeof(msg) - 1;
         }
-        else if (!strcmp(p_param, "play"))
+        snprintf(msg + length, sizeof(msg) - length, " \n");
+        _reply(p_fsm_jukebox, msg);
+    }
+    else
+    {
+        snprintf(msg, sizeof(msg), "List of commands: Type 'help _'. Choose a page as the parameter. Pages go 1-%ld, or 'help all' for all of them. For more specific help with a certain command, type 'help command', for example, 'help play' if you want help with the play command.\n", pages);
+        _reply(p_fsm_jukebox, msg);
+    }
+}
+
+/**
+ * @brief Commands of the jukebox, in the order of the pages of `help`.
+ * 
+ */
+static const command_t jukebox_commands[] = {
+    {"play", _command_play, {COMMAND_ARG_NONE}, 0, "to play current song",
+     "'play' to play current song."},
+    {"stop", _command_stop, {COMMAND_ARG_NONE}, 0, "to stop current song",
+     "'stop' to stop current song. After being stopped, it can't be resumed with play, it will just restart."},
+    {"pause", _command_pause, {COMMAND_ARG_NONE}, 0, "to pause current song",
+     "'pause' to pause current song. After being paused, it can be resumed with play."},
+    {"speed", _command_speed, {COMMAND_ARG_DOUBLE}, 1, "to change the player speed",
+     "'speed' to change the speed of the current player (0.1 is the minimum and 10 the maximum), to the value of the parameter."},
+    {"next", _command_next, {COMMAND_ARG_NONE}, 0, "to play the next song",
+     "'next' to play the next song."},
+    {"select", _command_select, {COMMAND_ARG_INT}, 1, "to select a specific song",
+     "'select' to change the current song. The parameter is the id of the song."},
+    {"info", _command_info, {COMMAND_ARG_INT}, 0, "to get information about a song",
+     "'info' to get information about either the current song or other. The parameter is the id of the song we want the info of. If there's no parameter, it gives info of the current song."},
+    {"list", _command_list, {COMMAND_ARG_NONE}, 0, "to see the list of songs",
+     "'list' to get a list of all songs and their ids. It is sent a song at a time, as the previous ones are sent, so other commands wait until it ends."},
+    {"load", _command_load, {COMMAND_ARG_INT}, 1, "to upload a song",
+     "'load' to upload a song. The parameter is the number of notes. Then send the name ended by a new line and, for each note, its MIDI number and its duration in ms (2 bytes, little endian). Use XON/XOFF flow control."},
+    {"unload", _command_unload, {COMMAND_ARG_INT}, 1, "to delete an uploaded song",
+     "'unload' to delete an uploaded song. The parameter is the id of the song."},
+    {"pool", _command_pool, {COMMAND_ARG_NONE}, 0, "to see the memory for uploads",
+     "'pool' to see the number of uploaded songs and the free memory for uploads."},
+    {"reverse", _command_reverse, {COMMAND_ARG_INT}, 0, "to play a song backwards",
+     "'reverse' to play a song from the last note to the first one. The parameter is the id of the song. If there's no parameter, it reverses the current song."},
+    {"transpose", _command_transpose, {COMMAND_ARG_INT}, 1, "to transpose the current song",
+     "'transpose' to move the current song up or down (-24 to 24). The parameter is the number of semitones. It lasts until another song is selected."},
+    {"tempo", _command_tempo, {COMMAND_ARG_DOUBLE}, 1, "to change the tempo of the current song",
+     "'tempo' to change the tempo of the current song (0.1 is the minimum and 10 the maximum). It lasts until another song is selected."},
+    {"gaps", _command_gaps, {COMMAND_ARG_STRING}, 0, "to measure the gaps between notes",
+     "'gaps on' starts measuring the silence between notes, 'gaps off' stops it and 'gaps' shows the number of gaps, their min, average and max length and how many notes were late."},
+    {"sequencer", _command_sequencer, {COMMAND_ARG_STRING}, 0, "to play songs by DMA",
+     "'sequencer on' plays the next songs by DMA, so the jukebox sleeps while they play, 'sequencer off' plays them note by note and 'sequencer' shows the mode."},
+    {"loop", _command_loop, {COMMAND_ARG_NONE}, 0, "to count the iterations of the main loop",
+     "'loop' shows how many times the main loop has run and woken up since the last 'loop', and how many times per second, the time awake and the estimated current."},
+    {"fsm", _command_fsm, {COMMAND_ARG_NONE}, 0, "to count the transitions checked",
+     "'fsm' shows, for each FSM, the rows of its table that a linear search would compare and the rows really checked per 100 fires, and how many times a shared guard was reused."},
+    {"baud", _command_baud, {COMMAND_ARG_STRING}, 0, "to change the baud rate",
+     "'baud 115200' changes the baud rate (1200 to 921600) after the answer, and goes back to the old one unless 'baud ok' is received at the new one within 5 s. 'baud bench' sends 2048 bytes and 'baud' shows the baud rate, the bytes per second and the CPU cycles per byte sent."},
+    {"dispatch", _command_dispatch, {COMMAND_ARG_NONE}, 0, "to time the lookup of the commands",
+     "'dispatch' shows the CPU cycles to find each command by the hash of its name and by comparing it with every command in order."},
+    {"macro", _command_macro, {COMMAND_ARG_STRING, COMMAND_ARG_STRING}, 0, "to name a list of commands",
+     "'macro party \"select 7; speed 1.5; play\"' defines the macro 'party', and typing 'party' runs its commands. 'macro party' shows them, 'macro party \"\"' deletes it and 'macro' lists the macros. Macros are kept in RAM until the jukebox is reset."},
+    {"help", _command_help, {COMMAND_ARG_STRING}, 0, "to see this help",
+     "'help' followed by a page shows the commands of the page, 'help all' shows all of them, and 'help' followed by a command, its help."},
+};
+
+/**
+ * @brief Executes the command, or the macro with its name.
+ * 
+ * The line is split where it is, in the RX buffer of the USART, the command is found by the perfect hash of its name in `jukebox_command_table`, and its arguments are checked against its schema.
+ * 
+ * @param p_fsm_jukebox pointer to a FSM with a FSM jukebox in it.
+ * @param p_line pointer to the command. It is not null terminated.
+ * @param length length of the command.
+ * @return true the command has been executed, or the line is empty.
+ * @return false the command is wrong.
+ */
+static bool _execute_command(fsm_jukebox_t * p_fsm_jukebox, const char * p_line, uint32_t length)
+{
+    const command_t *p_found;
+    char msg[USART_OUTPUT_BUFFER_LENGTH];
+    char args_help[JUKEBOX_ARGS_HELP_LENGTH];
+    command_slice_t tokens[COMMAND_MAX_TOKENS];
+    uint32_t count;
+    const command_macro_t *p_macro;
+    switch (command_table_execute(&jukebox_command_table, p_fsm_jukebox, p_line, length, &p_found))
+    {
+    case COMMAND_OK:
+    case COMMAND_EMPTY:
+        // The USART driver of the computer sends an empty line at initialization, so it is ignored
+        return true;
+    case COMMAND_NOT_FOUND:
+        // A name alone can be a macro
+        p_macro = (command_tokenize(p_line, length, tokens, COMMAND_MAX_TOKENS, &count) == COMMAND_OK && count == 1) ? command_macro_find(&p_fsm_jukebox->macros, tokens[0]) : NULL;
+        if (p_macro == NULL)
         {
-            sprintf(msg, "play command: 'play' to play current song. No parameter needed.\n");
-            printf("play command:\n'play' to play current song.\n No parameter needed.\n\n");
+            fsm_usart_send_const(p_fsm_jukebox->p_fsm_usart, "Error: Command not found\n");
+            return false;
         }
-        else if (!strcmp(p_param, "stop"))
+        if (p_fsm_jukebox->macro_depth >= JUKEBOX_MACRO_MAX_DEPTH)
         {
-            sprintf(msg, "stop command: 'stop' to stop current song. After being stopped, it can't be resumed with play, it will just restart. No parameter needed.\n");
-            printf("stop command:\n'stop' to stop current song. After being stopped, it can't be resumed with play, it will just restart.\n No parameter needed.\n\n");
+            fsm_usart_send_const(p_fsm_jukebox->p_fsm_usart, "Error: Too many macros inside each other\n");
+            return false;
         }
-        else if (!strcmp(p_param, "pause"))
+        p_fsm_jukebox->macro_depth++;
+        bool done = _execute_line(p_fsm_jukebox, p_macro->body, p_macro->body_length);
+        p_fsm_jukebox->macro_depth--;
+        return done;
+    case COMMAND_WRONG_QUOTES:
+        fsm_usart_send_const(p_fsm_jukebox->p_fsm_usart, "Error: Quotes must be closed and followed by a space\n");
+        return false;
+    default:
+        // Wrong arguments, or more than the command can take
+        if (p_found == NULL)
         {
-            sprintf(msg, "pause command: 'pause' to pause current song. After being paused, it can be resumed with play. No parameter needed.\n");
-            printf("pause command:\n'pause' to pause current song. After being paused, it can be resumed with play.\nNo parameter needed.\n\n");
+            fsm_usart_send_const(p_fsm_jukebox->p_fsm_usart, "Error: Command not found\n");
+            return false;
         }
-        else if (!strcmp(p_param, "speed"))
+        command_get_args_help(p_found, args_help, sizeof(args_help));
+        snprintf(msg, sizeof(msg), "Error: Wrong parameter for '%s'. %s\n", p_found->p_name, args_help);
+        _reply(p_fsm_jukebox, msg);
+        return false;
+    }
+}
+
+static bool _execute_line(fsm_jukebox_t * p_fsm_jukebox, const char * p_line, uint32_t length)
+{
+    command_slice_t rest = {.p_start = p_line, .length = length};
+    command_slice_t command;
+    while (command_split(&rest, &command))
+    {
+        if (!_execute_command(p_fsm_jukebox, command.p_start, command.length))
         {
-            sprintf(msg, "speed command: 'speed' to change the speed of the current player (0.1 is the minimum). The parameter is a double that we will set the player speed to.\n");
-            printf("speed command:\n'speed' to change the speed of the current player (0.1 is the minimum).\nThe parameter is a double that we will set the player speed to.\n\n");
+            // The commands after a wrong one could depend on it
+            if (rest.length > 0)
+            {
+                fsm_usart_send_const(p_fsm_jukebox->p_fsm_usart, "Error: The commands after it have not been run\n");
+            }
+            return false;
         }
-        else if (!strcmp(p_param, "next"))
+    }
+    return true;
+}
+
+/**
+ * @brief Add the status of the player to the payload of a reply.
+ * 
+ * @param p_fsm_jukebox pointer to a FSM with a FSM jukebox in it.
+ * @param p_reply pointer to the reply.
+ */
+static void _put_status(fsm_jukebox_t * p_fsm_jukebox, packet_t * p_reply)
+{
+    const melody_t *p_melody = melody_catalog_get(p_fsm_jukebox->p_catalog, p_fsm_jukebox->melody_idx);
+    packet_put_u8(p_reply, fsm_buzzer_get_action(p_fsm_jukebox->p_fsm_buzzer));
+    packet_put_u8(p_reply, p_fsm_jukebox->f.current_state);
+    packet_put_u16(p_reply, p_fsm_jukebox->melody_idx);
+    packet_put_u16(p_reply, fsm_buzzer_get_note_index(p_fsm_jukebox->p_fsm_buzzer));
+    packet_put_u16(p_reply, (p_melody != NULL) ? melody_get_length(p_melody) : 0);
+    packet_put_u16(p_reply, (uint16_t)(((uint64_t)fsm_buzzer_get_speed(p_fsm_jukebox->p_fsm_buzzer) * 100 + BUZZER_SPEED_ONE / 2) / BUZZER_SPEED_ONE));
+}
+
+/**
+ * @brief Executes a binary packet and queues its reply.
+ * 
+ * The actions are the ones of the text commands, but they answer with fields instead of text, so the host does not parse them.
+ * 
+ * @param p_fsm_jukebox pointer to a FSM with a FSM jukebox in it.
+ * @param p_frame pointer to the frame, without its delimiters.
+ * @param length length of the frame.
+ */
+static void _execute_packet(fsm_jukebox_t * p_fsm_jukebox, const uint8_t * p_frame, uint32_t length)
+{
+    packet_t request;
+    packet_t reply = {.length = 0};
+    uint8_t frame[PACKET_MAX_FRAME_LENGTH];
+    uint16_t value = 0;
+    uint8_t result = JUKEBOX_PACKET_OK;
+    bool status = true;
+
+    // 1. A frame that can't be trusted can't be matched with a request either
+    if (length == 0)
+    {
+        return;     // Two delimiters in a row
+    }
+    if (!packet_decode(p_frame, length, &request))
+    {
+        reply.opcode = PACKET_REPLY;
+        reply.id = 0;
+        packet_put_u8(&reply, JUKEBOX_PACKET_WRONG_FRAME);
+        fsm_usart_send_data(p_fsm_jukebox->p_fsm_usart, frame, packet_encode(&reply, frame));
+        return;
+    }
+    reply.opcode = request.opcode | PACKET_REPLY;
+    reply.id = request.id;
+    bool has_u16 = packet_get_u16(&request, 0, &value) && request.length == 2;
+
+    // 2. The action
+    switch (request.opcode)
+    {
+    case JUKEBOX_OP_STATUS:
+        break;
+    case JUKEBOX_OP_PLAY:
+        fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, PLAY);
+        break;
+    case JUKEBOX_OP_STOP:
+        fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, STOP);
+        break;
+    case JUKEBOX_OP_PAUSE:
+        fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, PAUSE);
+        break;
+    case JUKEBOX_OP_NEXT:
+        _set_next_song(p_fsm_jukebox);
+        break;
+    case JUKEBOX_OP_SELECT:
+        if (!has_u16)
         {
-            sprintf(msg, "next command: 'next' to play the next song. No parameter needed.\n");
-            printf("next command:\n'next' to play the next song.\nNo parameter needed.\n\n");
+            result = JUKEBOX_PACKET_WRONG_PAYLOAD;
         }
-        else if (!strcmp(p_param, "info"))
+        else if (melody_catalog_get(p_fsm_jukebox->p_catalog, value) == NULL)
         {
-            sprintf(msg, "info command: 'info' to get information about either the current song or other. The parameter is the id(an integer) of the song we want the info of. If there's no parameter, it gives info of the current song.\n");
-            printf("info command:\n'info' to get information about either the current song or other.\nThe parameter is the id(an integer) of the song we want the info of. If there's no parameter, it gives info of the current song.\n\n");
+            result = JUKEBOX_PACKET_NOT_FOUND;
         }
-        else if (!strcmp(p_param, "list"))
+        else
         {
-            sprintf(msg, "list command: 'list' to get a list of all songs and their ids. No parameter needed.\n");
-            printf("list command:\n'list' to get a list of all songs and their ids.\nNo parameter needed.\n\n");
+            _play_melody(p_fsm_jukebox, value, false);
         }
-        else if (p_param[0]=='s')
+        break;
+    case JUKEBOX_OP_SPEED:
+        if (!has_u16 || value < 10 || value > 1000)
         {
-            sprintf(msg, "select command: 'select' to change the current song. The parameter is an integer that we will set the song id to.\n");
-            printf("select command:\n'select' to change the current song.\nThe parameter is an integer that we will set the song id to.\n\n");
+            result = JUKEBOX_PACKET_WRONG_PAYLOAD;
         }
         else
         {
-            sprintf(msg, "List of commands: Type 'help _'. Choose a page as the parameter. Pages go 1-3. For more specific help with a certain command, type 'help command', for example, 'help play' if you want help with the play command.\n");
-            printf("\nList of commands:\nType 'help _'. Choose a page as the parameter. Pages go 1-3.\nFor more specific help with a certain command, type 'help command', for example, 'help play' if you want help with the play command.\n\n");
+            fsm_buzzer_set_speed(p_fsm_jukebox->p_fsm_buzzer, (uint32_t)(((uint64_t)value * BUZZER_SPEED_ONE) / 100));
         }
-        fsm_usart_set_out_data(p_fsm_jukebox->p_fsm_usart, msg);
-    }
-    /*else if (!strcmp(p_command, "reverse")){
-        uint32_t melody_selected =atoi(p_param);
-        if (p_fsm_jukebox->melodies[melody_selected].melody_length != 0)
+        break;
+    case JUKEBOX_OP_INFO:
+        status = false;
+        if (!has_u16)
         {
-            fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, STOP);
-            p_fsm_jukebox->melody_idx=melody_selected;
-            fsm_buzzer_set_reverse_melody(p_fsm_jukebox->p_fsm_buzzer, p_fsm_jukebox->melodies+p_fsm_jukebox->melody_idx);
-            p_fsm_jukebox->p_melody=p_fsm_jukebox->melodies[p_fsm_jukebox->melody_idx].p_name;
-            fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, PLAY);
+            result = JUKEBOX_PACKET_WRONG_PAYLOAD;
+        }
+        else if (melody_catalog_get(p_fsm_jukebox->p_catalog, value) == NULL)
+        {
+            result = JUKEBOX_PACKET_NOT_FOUND;
         }
         else
         {
-            char msg[USART_OUTPUT_BUFFER_LENGTH];
-            sprintf(msg, "Error: Melody not found\n");
-            fsm_usart_set_out_data(p_fsm_jukebox->p_fsm_usart, msg);
+            const melody_t *p_melody = melody_catalog_get(p_fsm_jukebox->p_catalog, value);
+            const char *p_name = melody_get_name(p_melody);
+            packet_put_u8(&reply, JUKEBOX_PACKET_OK);
+            packet_put_u16(&reply, melody_get_length(p_melody));
+            for (uint32_t i = 0; p_name[i] != '\0' && packet_put_u8(&reply, p_name[i]); i++)
+            {
+                // The name is cut to the payload
+            }
         }
-    }*/
-    else
+        break;
+    case JUKEBOX_OP_COMMAND:
+        _execute_line(p_fsm_jukebox, (const char *)request.payload, request.length);
+        break;
+    default:
+        result = JUKEBOX_PACKET_WRONG_OPCODE;
+        status = false;
+        break;
+    }
+
+    // 3. The reply
+    if (reply.length == 0)
     {
-        // Set USART out data "Error: Command not found\n"
-        char msg[USART_OUTPUT_BUFFER_LENGTH];
-        sprintf(msg, "Error: Command not found\n");
-        fsm_usart_set_out_data(p_fsm_jukebox->p_fsm_usart, msg);
+        packet_put_u8(&reply, result);
+        if (status && result == JUKEBOX_PACKET_OK)
+        {
+            _put_status(p_fsm_jukebox, &reply);
+        }
     }
-    return;
+    fsm_usart_send_data(p_fsm_jukebox->p_fsm_usart, frame, packet_encode(&reply, frame));
 }
 
-
 /* State machine input or transition functions */
 
 /**
@@ -351,8 +1060,21 @@ static bool check_melody_finished(fsm_t * p_this)
 static bool check_command_received(fsm_t * p_this)
 {
     fsm_jukebox_t *p_fsm = (fsm_jukebox_t *)(p_this);
-    // 1.
-    return fsm_usart_check_data_received(p_fsm->p_fsm_usart);
+    // 1. The next command waits for the long answer being sent, so the answers are not mixed
+    return (p_fsm->response == NULL && fsm_usart_check_data_received(p_fsm->p_fsm_usart));
+}
+
+/**
+ * @brief Checks if a long answer is being sent and there is room in the TX queue for its next chunk.
+ * 
+ * @param p_this pointer to a FSM with a FSM jukebox in it.
+ * @return true A chunk can be queued.
+ * @return false There is no answer being sent, or the TX queue is too full.
+ */
+static bool check_response_room(fsm_t * p_this)
+{
+    fsm_jukebox_t *p_fsm = (fsm_jukebox_t *)(p_this);
+    return (p_fsm->response != NULL && fsm_usart_check_tx_room(p_fsm->p_fsm_usart, JUKEBOX_CHUNK_LENGTH));
 }
 
 /**
@@ -372,17 +1094,31 @@ static bool check_next_song_button(fsm_t * p_this)
     return (duration > 0 && duration > p_fsm->next_song_press_time_ms && duration < p_fsm->on_off_press_time_ms);
 }
 
+/**
+ * @brief Gets the activity of the components of the jukebox.
+ * 
+ * @param p_this pointer to a FSM with a FSM jukebox in it.
+ * @return true There is activity, we can't sleep.
+ * @return false There is no activity, we can sleep.
+ */
+static bool _get_activity(fsm_t * p_this)
+{
+    fsm_jukebox_t *p_fsm = (fsm_jukebox_t *)(p_this);
+    return (fsm_button_check_activity(p_fsm->p_fsm_button) || fsm_usart_check_activity(p_fsm->p_fsm_usart) || fsm_buzzer_check_activity(p_fsm->p_fsm_buzzer) || /*v5*/ fsm_keypad_check_activity(p_fsm->p_fsm_keypad) || p_fsm->baud_previous != 0 || p_fsm->response != NULL);
+}
+
 /**
  * @brief Checks if there is any kind of activity with the components of the jukebox.
  * 
+ * The sleep states check it in two rows, so it is only evaluated once per fire.
+ * 
  * @param p_this pointer to a FSM with a FSM jukebox in it.
  * @return true There is activity, we can't sleep.
  * @return false There is no activity, we can sleep.
  */
 static bool check_activity(fsm_t * p_this)	
 {
-    fsm_jukebox_t *p_fsm = (fsm_jukebox_t *)(p_this);
-    return (fsm_button_check_activity(p_fsm->p_fsm_button) || fsm_usart_check_activity(p_fsm->p_fsm_usart) || fsm_buzzer_check_activity(p_fsm->p_fsm_buzzer) || /*v5*/ fsm_keypad_check_activity(p_fsm->p_fsm_keypad));
+    return fsm_index_shared_guard(p_this, JUKEBOX_SHARED_GUARD_ACTIVITY, _get_activity);
 }
 
 /**
@@ -410,8 +1146,65 @@ static bool check_key_received(fsm_t * p_this){
     return fsm_keypad_check_key_received(p_fsm->p_fsm_keypad);
 }
 
+/**
+ * @brief Checks if a melody is being uploaded.
+ * 
+ * @param p_this pointer to a FSM with a FSM jukebox in it.
+ * @return true A melody is being uploaded.
+ * @return false No melody is being uploaded.
+ */
+static bool check_loading(fsm_t * p_this)
+{
+    fsm_jukebox_t *p_fsm = (fsm_jukebox_t *)(p_this);
+    // 1.
+    return melody_pool_is_loading(p_fsm->p_pool);
+}
+
+/**
+ * @brief Checks if the upload of a melody has finished, either correctly or not.
+ * 
+ * @param p_this pointer to a FSM with a FSM jukebox in it.
+ * @return true The upload has finished.
+ * @return false The upload is still in progress.
+ */
+static bool check_load_finished(fsm_t * p_this)
+{
+    // 1.
+    return !check_loading(p_this);
+}
+
+
+/**
+ * @brief Checks if a new baud rate has not been confirmed in time.
+ * 
+ * @param p_this pointer to a FSM with a FSM jukebox in it.
+ * @return true The time to confirm the baud rate is over.
+ * @return false There is no new baud rate to confirm, or there is still time.
+ */
+static bool check_baud_timeout(fsm_t * p_this)
+{
+    fsm_jukebox_t *p_fsm = (fsm_jukebox_t *)(p_this);
+    // 1.
+    return (p_fsm->baud_previous != 0 && !port_system_timer_is_running(&p_fsm->baud_timer));
+}
+
 
 /* State machine output or action functions */
+/**
+ * @brief Goes back to the baud rate in use before the last `baud` command, which has not been confirmed.
+ * 
+ * @param p_this pointer to a FSM with a FSM jukebox in it.
+ */
+static void do_revert_baud(fsm_t * p_this)
+{
+    fsm_jukebox_t *p_fsm = (fsm_jukebox_t *)(p_this);
+    // 1.
+    port_system_timer_stop(&p_fsm->baud_timer);
+    fsm_usart_set_baud(p_fsm->p_fsm_usart, p_fsm->baud_previous);
+    trace_emit(TRACE_BAUD_REVERTED, p_fsm->baud_previous, 0);
+    p_fsm->baud_previous = 0;
+}
+
 /**
  * @brief Turns on the jukebox and sets it up with speed 1, melody 0, enabling the usart rx, and playing the intro scale.
  * 
@@ -427,13 +1220,13 @@ static void do_start_up(fsm_t * p_this)
     fsm_usart_enable_rx_interrupt(p_fsm->p_fsm_usart);
 
     // 3.
-    printf("Jukebox ON\n");
+    trace_emit(TRACE_JUKEBOX_ON, 0, 0);
 
     // 4.
-    fsm_buzzer_set_speed(p_fsm->p_fsm_buzzer, 1.0);
+    fsm_buzzer_set_speed(p_fsm->p_fsm_buzzer, BUZZER_SPEED_ONE);
 
     // 5.
-    fsm_buzzer_set_melody(p_fsm->p_fsm_buzzer,p_fsm->melodies);
+    fsm_buzzer_set_melody(p_fsm->p_fsm_buzzer, &scale_melody);
 
     // 6.
     fsm_buzzer_set_action(p_fsm->p_fsm_buzzer, PLAY);
@@ -451,7 +1244,7 @@ static void do_start_jukebox(fsm_t * p_this)
     p_fsm->melody_idx=0;
 
     // 2.
-    p_fsm->p_melody = p_fsm->melodies[p_fsm->melody_idx].p_name;
+    p_fsm->p_melody = melody_get_name(melody_catalog_get(p_fsm->p_catalog, p_fsm->melody_idx));
 }
 
 /**
@@ -466,17 +1259,30 @@ static void do_stop_jukebox(fsm_t * p_this)
     fsm_button_reset_duration(p_fsm->p_fsm_button);
 
     // 2.
-    fsm_usart_disable_rx_interrupt(p_fsm->p_fsm_usart);
-    fsm_usart_disable_tx_interrupt(p_fsm->p_fsm_usart);
+    fsm_usart_disable_rx_interrupt(p_fsm->p_fsm_usart); // The messages already queued are still sent
 
     // 3.
-    printf("Jukebox OFF\n");
+    trace_emit(TRACE_JUKEBOX_OFF, 0, 0);
 
     // 4.
     fsm_buzzer_set_action(p_fsm->p_fsm_buzzer, STOP);
 
+    // 5. Abort the upload in progress, if any
+    if (melody_pool_is_loading(p_fsm->p_pool))
+    {
+        melody_pool_load_abort(p_fsm->p_pool);
+        fsm_usart_disable_raw_rx(p_fsm->p_fsm_usart);
+    }
+
+    // 6. A baud rate not confirmed is not kept, and a long answer is not finished
+    if (p_fsm->baud_previous != 0)
+    {
+        do_revert_baud(p_this);
+    }
+    p_fsm->response = NULL;
+
     //v5. Add outro song
-    fsm_buzzer_set_melody(p_fsm->p_fsm_buzzer,p_fsm->melodies+MELODIES_MEMORY_SIZE-1);
+    fsm_buzzer_set_melody(p_fsm->p_fsm_buzzer, &outro);
     fsm_buzzer_set_action(p_fsm->p_fsm_buzzer, PLAY);
 
 }
@@ -496,6 +1302,28 @@ static void do_load_next_song(fsm_t * p_this)
     fsm_button_reset_duration(p_fsm->p_fsm_button);
 }
 
+/**
+ * @brief Queues the next chunks of the long answer being sent, as many as fit up to `JUKEBOX_CHUNKS_PER_FIRE`.
+ * 
+ * @param p_this pointer to a FSM with a FSM jukebox in it.
+ */
+static void do_send_response(fsm_t * p_this)
+{
+    fsm_jukebox_t *p_fsm = (fsm_jukebox_t *)(p_this);
+    char chunk[JUKEBOX_CHUNK_LENGTH];
+    for (uint32_t i = 0; i < JUKEBOX_CHUNKS_PER_FIRE && p_fsm->response_index < p_fsm->response_count && fsm_usart_check_tx_room(p_fsm->p_fsm_usart, JUKEBOX_CHUNK_LENGTH); i++)
+    {
+        if (p_fsm->response(p_fsm, p_fsm->response_index++, chunk, sizeof(chunk)) > 0)
+        {
+            fsm_usart_set_out_data(p_fsm->p_fsm_usart, chunk);
+        }
+    }
+    if (p_fsm->response_index >= p_fsm->response_count)
+    {
+        p_fsm->response = NULL;
+    }
+}
+
 /**
  * @brief Reads the command that has been inputted.
  * 
@@ -504,25 +1332,38 @@ static void do_load_next_song(fsm_t * p_this)
 static void do_read_command(fsm_t * p_this)
 {
     fsm_jukebox_t *p_fsm = (fsm_jukebox_t *)(p_this);
-    // 1.
-    char p_message[USART_INPUT_BUFFER_LENGTH];
-    char p_command[USART_INPUT_BUFFER_LENGTH];
-    char p_param[USART_INPUT_BUFFER_LENGTH];
+    // 1. The line stays in the RX buffer until it is released, so it is parsed in place
+    const char *p_line;
+    uint32_t length = fsm_usart_get_line(p_fsm->p_fsm_usart, &p_line);
 
-    // 2.
-    fsm_usart_get_in_data(p_fsm->p_fsm_usart, p_message);
+    // 2. A binary frame starts with its delimiter, which no text command has
+    if (length > 0 && p_line[0] == USART_FRAME_CHAR)
+    {
+        _execute_packet(p_fsm, (const uint8_t *)p_line + 1, length - 1);
+    }
+    else
+    {
+        _execute_line(p_fsm, p_line, length);
+    }
 
     // 3.
-    _parse_message(p_message,p_command,p_param);
-
-    // 4.
-    _execute_command(p_fsm, p_command, p_param);
-
-    // 5.
     fsm_usart_reset_input_data(p_fsm->p_fsm_usart);
+}
 
-    // 6. opcional?¿
-    memset(p_message, 0, USART_INPUT_BUFFER_LENGTH); // creo que esta bien?¿
+/**
+ * @brief Sleep until the next interrupt in the states of no activity, with the polling loop only.
+ *
+ * The event loop sleeps in port_system_event_wait(), after sending the trace, so the actions must not sleep inside the fire.
+ * The polling loop only sleeps here: the trace is sent first, or its records would stay in RAM while the CPU sleeps.
+ */
+static void _sleep(void)
+{
+#if !MAIN_EVENT_LOOP
+    if (trace_drain(TRACE_DRAIN_RECORDS))
+    {
+        port_system_sleep();
+    }
+#endif
 }
 
 /**
@@ -533,7 +1374,7 @@ static void do_read_command(fsm_t * p_this)
 static void do_sleep_off(fsm_t * p_this)
 {
     // 1.
-    port_system_sleep();
+    _sleep();
 }
 
 /**
@@ -544,7 +1385,7 @@ static void do_sleep_off(fsm_t * p_this)
 static void do_sleep_wait_command(fsm_t * p_this)
 {
     // 1.
-    port_system_sleep();
+    _sleep();
 }
 
 /**
@@ -555,7 +1396,7 @@ static void do_sleep_wait_command(fsm_t * p_this)
 static void do_sleep_while_off(fsm_t * p_this)
 {
     // 1.
-    port_system_sleep();
+    _sleep();
 }
 
 /**
@@ -566,7 +1407,7 @@ static void do_sleep_while_off(fsm_t * p_this)
 static void do_sleep_while_on(fsm_t * p_this)
 {
     // 1.
-    port_system_sleep();
+    _sleep();
 }
 
 /**
@@ -579,12 +1420,13 @@ static void do_read_key(fsm_t * p_this){
     char key = fsm_keypad_get_key(p_fsm_jukebox->p_fsm_keypad);
     char *key2=&key;
     uint32_t melody_selected =atoi(key2);
-        if (p_fsm_jukebox->melodies[melody_selected].melody_length != 0)
+    const melody_t *p_melody = melody_catalog_get(p_fsm_jukebox->p_catalog, melody_selected);
+        if (p_melody != NULL)
         {
             fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, STOP);
             p_fsm_jukebox->melody_idx=melody_selected;
-            fsm_buzzer_set_melody(p_fsm_jukebox->p_fsm_buzzer, p_fsm_jukebox->melodies+p_fsm_jukebox->melody_idx);
-            p_fsm_jukebox->p_melody=p_fsm_jukebox->melodies[p_fsm_jukebox->melody_idx].p_name;
+            fsm_buzzer_set_melody(p_fsm_jukebox->p_fsm_buzzer, p_melody);
+            p_fsm_jukebox->p_melody=melody_get_name(p_melody);
             fsm_buzzer_set_action(p_fsm_jukebox->p_fsm_buzzer, PLAY);
         }
         else
@@ -595,6 +1437,85 @@ static void do_read_key(fsm_t * p_this){
         }
 }
 
+/**
+ * @brief Wait for more bytes of the upload. The bytes left in the ring after a chunk get no interrupt while the sender is
+ * paused by XOFF, so the jukebox is fired again by itself until they are read and the XON is sent.
+ * 
+ * @param p_fsm_jukebox pointer to a FSM jukebox.
+ */
+static void _wait_load_data(fsm_jukebox_t *p_fsm_jukebox)
+{
+    if (fsm_usart_check_raw_pending(p_fsm_jukebox->p_fsm_usart))
+    {
+        port_system_event_post(SYSTEM_EVENT_JUKEBOX);
+    }
+}
+
+/**
+ * @brief Stores the bytes of the melody being uploaded, and goes back to commands when the upload ends.
+ * 
+ * > 1. Read the bytes received, up to `JUKEBOX_LOAD_CHUNK_LENGTH` so that the other FSMs are not delayed \n
+ * > 2. Abort if bytes have been lost or if no byte has been received for `JUKEBOX_LOAD_TIMEOUT_MS` \n
+ * > 3. Give the bytes to the pool and release the ones it has used. If the upload has not finished, wait for more, firing again at once while bytes are left \n
+ * > 4. Go back to receiving commands and send the result. The bytes after the last note stay in the ring and are read as commands \n
+ * 
+ * @param p_this pointer to a FSM with a FSM jukebox in it.
+ */
+static void do_load_melody(fsm_t * p_this)
+{
+    fsm_jukebox_t *p_fsm = (fsm_jukebox_t *)(p_this);
+    uint8_t data[JUKEBOX_LOAD_CHUNK_LENGTH];
+    char msg[USART_OUTPUT_BUFFER_LENGTH];
+
+    // 1.
+    uint32_t length = fsm_usart_read_raw(p_fsm->p_fsm_usart, data, JUKEBOX_LOAD_CHUNK_LENGTH);
+
+    // 2.
+    if (fsm_usart_check_raw_overrun(p_fsm->p_fsm_usart))
+    {
+        melody_pool_load_abort(p_fsm->p_pool);
+        fsm_usart_release_raw(p_fsm->p_fsm_usart, length);
+        sprintf(msg, "Error: Data lost, use XON/XOFF flow control\n");
+    }
+    else if (length == 0)
+    {
+        if (port_system_timer_is_running(&p_fsm->load_timer))
+        {
+            _wait_load_data(p_fsm);
+            return;
+        }
+        melody_pool_load_abort(p_fsm->p_pool);
+        sprintf(msg, "Error: Load timeout\n");
+    }
+    // 3.
+    else
+    {
+        uint32_t used;
+        port_system_timer_start(&p_fsm->load_timer, JUKEBOX_LOAD_TIMEOUT_MS, 0);
+        uint32_t result = melody_pool_load_data(p_fsm->p_pool, data, length, &used);
+        fsm_usart_release_raw(p_fsm->p_fsm_usart, (result == MELODY_POOL_LOAD_ERROR) ? length : used); // The chunk of a wrong upload is not a command
+        if (result == MELODY_POOL_LOAD_BUSY)
+        {
+            _wait_load_data(p_fsm);
+            return;
+        }
+        if (result == MELODY_POOL_LOAD_DONE)
+        {
+            uint32_t melody_idx = melody_catalog_get_count(p_fsm->p_catalog) - 1;
+            sprintf(msg, "Loaded [%ld]: %s\n", melody_idx, melody_get_name(melody_catalog_get(p_fsm->p_catalog, melody_idx)));
+        }
+        else
+        {
+            sprintf(msg, "Error: Invalid note or more than %d different durations\n", MELODY_POOL_MAX_DURATIONS);
+        }
+    }
+
+    // 4.
+    port_system_timer_stop(&p_fsm->load_timer);
+    fsm_usart_disable_raw_rx(p_fsm->p_fsm_usart);
+    fsm_usart_set_out_data(p_fsm->p_fsm_usart, msg);
+}
+
 /* fsm_trans_t */
 
 /**
@@ -607,13 +1528,19 @@ static fsm_trans_t fsm_trans_jukebox[] = {
     {SLEEP_WHILE_OFF, check_activity, OFF, NULL},
     {OFF, check_on, START_UP, do_start_up},
     {START_UP, check_melody_finished, WAIT_COMMAND, do_start_jukebox},
+    {WAIT_COMMAND, check_loading, LOAD_MELODY, NULL},
     {WAIT_COMMAND, check_next_song_button, WAIT_COMMAND, do_load_next_song},
     {WAIT_COMMAND, check_command_received, WAIT_COMMAND, do_read_command},
+    {WAIT_COMMAND, check_baud_timeout, WAIT_COMMAND, do_revert_baud},
     {WAIT_COMMAND, check_key_received,WAIT_COMMAND, do_read_key}, //v5
+    {WAIT_COMMAND, check_response_room, WAIT_COMMAND, do_send_response},
     {WAIT_COMMAND, check_no_activity, SLEEP_WHILE_ON, do_sleep_wait_command},
     {SLEEP_WHILE_ON, check_no_activity, SLEEP_WHILE_ON, do_sleep_while_on},
     {SLEEP_WHILE_ON, check_activity, WAIT_COMMAND, NULL},
     {WAIT_COMMAND, check_off, OFF, do_stop_jukebox},
+    {LOAD_MELODY, check_off, OFF, do_stop_jukebox},
+    {LOAD_MELODY, check_load_finished, WAIT_COMMAND, NULL},
+    {LOAD_MELODY, check_loading, LOAD_MELODY, do_load_melody},
     {-1, NULL, -1, NULL}
 };
 
@@ -632,6 +1559,7 @@ void fsm_jukebox_init(fsm_t *p_this, fsm_t *p_fsm_button, uint32_t on_off_press_
     fsm_jukebox_t *p_fsm = (fsm_jukebox_t *)(p_this);
     // 1.
     fsm_init(p_this, fsm_trans_jukebox); 
+    fsm_index_init(p_this, fsm_trans_jukebox);
 
     // 2.
     p_fsm->p_fsm_button = p_fsm_button;
@@ -647,21 +1575,25 @@ void fsm_jukebox_init(fsm_t *p_this, fsm_t *p_fsm_button, uint32_t on_off_press_
     p_fsm->melody_idx = 0;
 
     // 4.
-    memset(p_fsm->melodies,0,sizeof(p_fsm->melodies));
-
-    // 5.
-    p_fsm->melodies[0] = scale_melody;
-    p_fsm->melodies[1] = tetris_melody;
-    p_fsm->melodies[2] = happy_birthday_melody;
-
-    // v.5
-    p_fsm->melodies[3] = march_of_the_toreadors;
-    p_fsm->melodies[4] = careless_whispers;
-    p_fsm->melodies[5] = legend_of_zelda_main;
-    p_fsm->melodies[6] = imperial_march;
-    p_fsm->melodies[7] = mario_bros_main;
-    p_fsm->melodies[8] = pokemon_main;
-    p_fsm->melodies[9] = halloween_theme;
-    p_fsm->melodies[10] = outro;
+    p_fsm->p_catalog = &melodies_catalog;
+    p_fsm->p_pool = &melody_pool;
+    if (!command_table_init(&jukebox_command_table, jukebox_commands, sizeof(jukebox_commands) / sizeof(jukebox_commands[0])))
+    {
+        // Too many commands, a repeated name or no seed: a bug of jukebox_commands. Stopped here rather than answering "Command not found" to everything
+        printf("Error: the command table can't be built\n");
+        while (1)
+        {
+        }
+    }
+    port_system_timer_init(&p_fsm->load_timer, SYSTEM_EVENT_JUKEBOX, NULL, NULL);
+    port_system_timer_init(&p_fsm->baud_timer, SYSTEM_EVENT_JUKEBOX, NULL, NULL);
+    command_macro_init(&p_fsm->macros);
+    p_fsm->macro_depth = 0;
+    p_fsm->response = NULL;
+    p_fsm->baud_previous = 0;
+    p_fsm->loop_iterations = 0;
+    p_fsm->loop_wakeups = 0;
+    p_fsm->loop_awake_cycles = 0;
+    p_fsm->loop_ms = 0;
 }
 
@@ -14,20 +14,48 @@
 
 #include "fsm_keypad.h"
 #include "port_keypad.h"
+#include "trace.h"
 
 /* State machine output or action functions */
 /**
- * @brief Check if there is a key press.
+ * @brief Check if there is a key press. The keypad is only scanned once a row has interrupted, so there is no work while idle.
  * 
  * @param p_this pointer to a FSM with a FSM keypad in it.
- * @return true if the key read by the method port_keypad_read is different than an empty char (\0).
- * @return false if there is a key being read by the method port_keypad_read.
+ * @return true if the key read by the method port_keypad_read is different than an empty char (\0). It is kept in last_key.
+ * @return false if no row has interrupted, or no key is found by the scan (a bounce).
  */
 static bool check_key_pressed(fsm_t* p_this) {
-    /*fsm_keypad_t* p_fsm = (fsm_keypad_t*)p_this;
-    p_fsm->last_key = port_keypad_read();
-    return (p_fsm->last_key != '\0');*/
-    return(port_keypad_read() != '\0');
+    fsm_keypad_t* p_fsm = (fsm_keypad_t*)p_this;
+    if (!port_keypad_check_woken())
+    {
+        return false;
+    }
+    p_fsm->last_key = port_keypad_read(); // Not seen by the jukebox until key_received is set
+    return (p_fsm->last_key != '\0');
+}
+
+/**
+ * @brief Check if a row has interrupted. Used after check_key_pressed(), so it is only true when the scan has found no key:
+ * a bounce, or two keys held in the same column, which keep their row low so it would interrupt again at once.
+ * 
+ * @param p_this pointer to a FSM with a FSM keypad in it.
+ * @return true if a row has interrupted since the interrupts were enabled.
+ * @return false if it has not.
+ */
+static bool check_keypad_woken(fsm_t* p_this) {
+    return port_keypad_check_woken();
+}
+
+/**
+ * @brief Check if the scan timer has expired after a scan with no key.
+ * 
+ * @param p_this pointer to a FSM with a FSM keypad in it.
+ * @return true if the timer is no longer running.
+ * @return false if it is still running.
+ */
+static bool check_scan_timeout(fsm_t* p_this) {
+    fsm_keypad_t* p_fsm = (fsm_keypad_t*)p_this;
+    return !port_system_timer_is_running(&p_fsm->scan_timer);
 }
 
 /**
@@ -38,34 +66,53 @@ static bool check_key_pressed(fsm_t* p_this) {
  * @return false if there is still a key pressed.
  */
 static bool check_key_unpressed(fsm_t* p_this) {
-    /*fsm_keypad_t* p_fsm = (fsm_keypad_t*)p_this;
-    p_fsm->last_key = port_keypad_read();
-    return (p_fsm->last_key == '\0');*/
     return(port_keypad_read() == '\0');
 }
 
 /**
- * @brief Changes the last_key field to the pressed key and prints in terminal the key.
+ * @brief Marks the key found by check_key_pressed() as received, traces it and scans the keypad periodically until it is let go.
  * 
  * @param p_this pointer to a FSM with a FSM keypad in it.
  */
 static void do_process_key(fsm_t* p_this) {
     fsm_keypad_t* p_fsm = (fsm_keypad_t*)p_this;
     p_fsm->key_received=true;
-    p_fsm->last_key = port_keypad_read();
-    printf("Key pressed: [%c].\n", p_fsm->last_key);
+    port_system_timer_start(&p_fsm->scan_timer, KEYPAD_0_SCAN_PERIOD_MS, KEYPAD_0_SCAN_PERIOD_MS);
+    trace_emit(TRACE_KEY_PRESSED, p_fsm->last_key, 0);
 }
 
 /**
- * @brief Empties the last_key field and prints in terminal an informative message.
+ * @brief Starts the scan timer once after an interrupt with no key found. The rows stay masked until it expires, so a row
+ * held low by two keys is scanned every 20 ms instead of interrupting again at once.
+ * 
+ * @param p_this pointer to a FSM with a FSM keypad in it.
+ */
+static void do_wait_scan(fsm_t* p_this) {
+    fsm_keypad_t* p_fsm = (fsm_keypad_t*)p_this;
+    port_system_timer_start(&p_fsm->scan_timer, KEYPAD_0_SCAN_PERIOD_MS, 0);
+}
+
+/**
+ * @brief Waits again for a key press once the scan timer has expired. A row still low interrupts at once and is scanned again.
+ * 
+ * @param p_this pointer to a FSM with a FSM keypad in it.
+ */
+static void do_wait_key(fsm_t* p_this) {
+    port_keypad_enable_interrupts();
+}
+
+/**
+ * @brief Empties the last_key field, stops the scans and waits for the next press with the interrupts, and traces that the key has been let go.
  * 
  * @param p_this pointer to a FSM with a FSM keypad in it.
  */
 static void do_delete_key(fsm_t* p_this) {
     fsm_keypad_t* p_fsm = (fsm_keypad_t*)p_this;
     p_fsm->key_received=false;
-    p_fsm->last_key = port_keypad_read();
-    printf("Key let go.\n");
+    p_fsm->last_key = '\0';
+    port_system_timer_stop(&p_fsm->scan_timer);
+    port_keypad_enable_interrupts();
+    trace_emit(TRACE_KEY_RELEASED, 0, 0);
 }
 
 /**
@@ -74,6 +121,8 @@ static void do_delete_key(fsm_t* p_this) {
  */
 fsm_trans_t fsm_trans_keypad[] = {
     {STATE_WAIT_KEY, check_key_pressed, STATE_KEY_PRESSED, do_process_key },
+    {STATE_WAIT_KEY, check_keypad_woken, STATE_WAIT_SCAN, do_wait_scan },
+    {STATE_WAIT_SCAN, check_scan_timeout, STATE_WAIT_KEY, do_wait_key },
     {STATE_KEY_PRESSED, check_key_unpressed, STATE_WAIT_KEY, do_delete_key },
     {-1,NULL,-1,NULL}};
 
@@ -90,9 +139,12 @@ void fsm_keypad_init(fsm_t *p_this, uint32_t keypad_id)
 {
     fsm_keypad_t *p_fsm = (fsm_keypad_t *)(p_this);
     fsm_init(p_this, fsm_trans_keypad);
+    fsm_index_init(p_this, fsm_trans_keypad);
 
     p_fsm->keypad_id = keypad_id;
     p_fsm->last_key = '\0';
+    p_fsm->key_received = false;
+    port_system_timer_init(&p_fsm->scan_timer, SYSTEM_EVENT_KEYPAD, NULL, NULL); // Only started while a key is down or a row is low
     port_keypad_init();
 }
 
@@ -109,5 +161,5 @@ char fsm_keypad_get_key(fsm_t *p_this){
 bool fsm_keypad_check_activity(fsm_t * p_this)
 {
     fsm_keypad_t *p_fsm = (fsm_keypad_t *)(p_this);
-    return (p_fsm->f.current_state==STATE_WAIT_KEY);
+    return (p_fsm->f.current_state!=STATE_WAIT_KEY);
 }
\ No newline at end of file
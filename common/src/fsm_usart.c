@@ -12,12 +12,14 @@
 #include <stdlib.h>
 
 /* Other libraries */
+#include "port_system.h"
 #include "port_usart.h"
 #include "fsm_usart.h"
 
 /* State machine input or transition functions */
 /**
- * @brief Check whether data has or hasn't been received
+ * @brief Check whether data has or hasn't been received. A new line is not taken until the previous one has been read,
+ * so it waits in the RX ring instead of overwriting it.
  * 
  * @param p_this pointer to a FSM with a FSM USART in it.
  * @return true Data has been received.
@@ -25,32 +27,30 @@
  */
 static bool check_data_rx(fsm_t *p_this){
     fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
-    return port_usart_rx_done(p_fsm->usart_id);
+    return (!p_fsm->data_received && port_usart_rx_done(p_fsm->usart_id));
 }
 
 /**
- * @brief Get the received data.
+ * @brief Get the received data. The line is not copied: it is read from the RX ring until it is released.
  * 
  * @param p_this pointer to a FSM with a FSM USART in it.
  */
 static void do_get_data_rx(fsm_t *p_this){
     fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
-    port_usart_get_from_input_buffer(p_fsm->usart_id, p_fsm->in_data);
-    port_usart_reset_input_buffer(p_fsm->usart_id); 
     p_fsm->data_received=1;
 }
 
 /* State machine output or action functions */
 /**
- * @brief Check whether there's data ready to be sent or not.
+ * @brief Check whether there's data queued to be sent or not.
  * 
  * @param p_this pointer to a FSM with a FSM USART in it.
- * @return true There is data ready to be sent.
- * @return false There isn't data ready to be sent.
+ * @return true There is data queued to be sent.
+ * @return false There isn't data queued to be sent.
  */
 static bool check_data_tx(fsm_t *p_this	){
     fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
-    return (p_fsm->out_data[0]!=EMPTY_BUFFER_CONSTANT);
+    return !port_usart_tx_done(p_fsm->usart_id);
 }
 
 /**
@@ -66,40 +66,40 @@ static bool check_tx_end(fsm_t *p_this){
 }
 
 /**
- * @brief Set the data that is going to be sent.
+ * @brief Check whether a change of baud rate is waiting for a queue that has already been sent, before the FSM left WAIT_DATA.
  * 
  * @param p_this pointer to a FSM with a FSM USART in it.
+ * @return true The baud rate can be changed.
+ * @return false There is no change waiting, or the queue is not empty.
  */
-static void do_set_data_tx(fsm_t *p_this){
+static bool check_baud_change(fsm_t *p_this){
     fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
-    port_usart_reset_output_buffer(p_fsm->usart_id);
-    port_usart_copy_to_output_buffer(p_fsm->usart_id,p_fsm->out_data,USART_OUTPUT_BUFFER_LENGTH);
-    while (port_usart_get_txr_status(p_fsm->usart_id)!=1)
-    {
-        // Do nothing
-    }
-    port_usart_write_data(p_fsm->usart_id);
-    port_usart_enable_tx_interrupt(p_fsm->usart_id);
+    return (p_fsm->baud_next != 0 && port_usart_tx_done(p_fsm->usart_id));
 }
 
 /**
- * @brief Finish the data tranmition.
+ * @brief Change the baud rate, if a change is waiting for the messages queued to be sent.
  * 
  * @param p_this pointer to a FSM with a FSM USART in it.
  */
 static void do_tx_end(fsm_t *p_this){
     fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
-    port_usart_reset_output_buffer(p_fsm->usart_id);
-    memset(p_fsm->out_data, EMPTY_BUFFER_CONSTANT, USART_OUTPUT_BUFFER_LENGTH);
+    if(p_fsm->baud_next != 0){
+        port_usart_set_baud(p_fsm->usart_id, p_fsm->baud_next);
+        p_fsm->baud_next = 0;
+    }
 }
 
+
 /**
  * @brief Status transitions of the FSM USART.
  * 
  */
 static fsm_trans_t fsm_trans_usart[] = {
     {WAIT_DATA, check_data_rx, WAIT_DATA, do_get_data_rx},
-    {WAIT_DATA, check_data_tx, SEND_DATA, do_set_data_tx},
+    {WAIT_DATA, check_data_tx, SEND_DATA, NULL}, // The PORT sends the queue by DMA
+    {WAIT_DATA, check_baud_change, WAIT_DATA, do_tx_end},
+    {SEND_DATA, check_data_rx, SEND_DATA, do_get_data_rx},
     {SEND_DATA, check_tx_end, WAIT_DATA, do_tx_end},
     {-1, NULL, -1, NULL}
 };
@@ -114,8 +114,9 @@ bool fsm_usart_check_data_received(fsm_t *p_this){
 
 void fsm_usart_reset_input_data(fsm_t *p_this){
     fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
-    memset(p_fsm->in_data, EMPTY_BUFFER_CONSTANT, USART_INPUT_BUFFER_LENGTH);
+    port_usart_reset_input_buffer(p_fsm->usart_id);
     p_fsm->data_received=0;
+    port_system_event_post(SYSTEM_EVENT_USART);     // There may be another line waiting in the RX ring
 }
 
 void fsm_usart_disable_rx_interrupt(fsm_t *p_this){
@@ -123,33 +124,77 @@ void fsm_usart_disable_rx_interrupt(fsm_t *p_this){
     port_usart_disable_rx_interrupt(p_fsm->usart_id);
 }
 
-void fsm_usart_disable_tx_interrupt(fsm_t *p_this){
+void fsm_usart_enable_rx_interrupt(fsm_t *p_this){
     fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
-    port_usart_disable_tx_interrupt(p_fsm->usart_id);
+    port_usart_enable_rx_interrupt(p_fsm->usart_id);
 }
 
-void fsm_usart_enable_rx_interrupt(fsm_t *p_this){
+void fsm_usart_enable_raw_rx(fsm_t *p_this){
     fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
-    port_usart_enable_rx_interrupt(p_fsm->usart_id);
+    port_usart_enable_raw_rx(p_fsm->usart_id);
+}
+
+void fsm_usart_disable_raw_rx(fsm_t *p_this){
+    fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
+    port_usart_disable_raw_rx(p_fsm->usart_id);
+    port_system_event_post(SYSTEM_EVENT_USART);     // The bytes left get no interrupt: they may already hold a command
+}
+
+uint32_t fsm_usart_read_raw(fsm_t *p_this, uint8_t *p_data, uint32_t max_length){
+    fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
+    return port_usart_read_raw(p_fsm->usart_id, p_data, max_length);
+}
+
+void fsm_usart_release_raw(fsm_t *p_this, uint32_t length){
+    fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
+    port_usart_release_raw(p_fsm->usart_id, length);
+}
+
+bool fsm_usart_check_raw_overrun(fsm_t *p_this){
+    fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
+    return port_usart_get_raw_overrun(p_fsm->usart_id);
+}
+
+bool fsm_usart_check_raw_pending(fsm_t *p_this){
+    fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
+    return port_usart_get_raw_pending(p_fsm->usart_id);
+}
+
+uint32_t fsm_usart_get_line(fsm_t *p_this, const char **pp_line)
+{
+    fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
+    return port_usart_get_line(p_fsm->usart_id, pp_line);
+}
+
+bool fsm_usart_set_out_data(fsm_t *p_this, const char *p_data)
+{
+    fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
+    // Only the length of the message is copied, and it is queued after the ones not sent yet
+    bool queued = port_usart_send(p_fsm->usart_id, p_data, strlen(p_data));
+    port_system_event_post(SYSTEM_EVENT_USART);
+    return queued;
 }
 
-void fsm_usart_enable_tx_interrupt(fsm_t *p_this){
+bool fsm_usart_check_tx_room(fsm_t *p_this, uint32_t length)
+{
     fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
-    port_usart_enable_tx_interrupt(p_fsm->usart_id);
+    return port_usart_check_tx_room(p_fsm->usart_id, length);
 }
 
-void fsm_usart_get_in_data(fsm_t *p_this, char *p_data)
+bool fsm_usart_send_data(fsm_t *p_this, const uint8_t *p_data, uint32_t length)
 {
     fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
-    memcpy(p_data, p_fsm->in_data, USART_INPUT_BUFFER_LENGTH);
+    bool queued = port_usart_send(p_fsm->usart_id, (const char *)p_data, length);
+    port_system_event_post(SYSTEM_EVENT_USART);
+    return queued;
 }
 
-void fsm_usart_set_out_data(fsm_t *p_this, char *p_data)
+bool fsm_usart_send_const(fsm_t *p_this, const char *p_data)
 {
     fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
-    // Ensure to reset the output data before setting a new one
-    memset(p_fsm->out_data, EMPTY_BUFFER_CONSTANT, USART_OUTPUT_BUFFER_LENGTH);
-    memcpy(p_fsm->out_data, p_data, USART_OUTPUT_BUFFER_LENGTH);
+    bool queued = port_usart_send_const(p_fsm->usart_id, p_data, strlen(p_data));
+    port_system_event_post(SYSTEM_EVENT_USART);
+    return queued;
 }
 
 
@@ -164,15 +209,54 @@ void fsm_usart_init(fsm_t *p_this, uint32_t usart_id)
 {
     fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
     fsm_init(p_this, fsm_trans_usart);
+    fsm_index_init(p_this, fsm_trans_usart);
     p_fsm->usart_id = usart_id;
     p_fsm->data_received = false;
-    memset(p_fsm->in_data, EMPTY_BUFFER_CONSTANT, USART_INPUT_BUFFER_LENGTH);
-    memset(p_fsm->out_data, EMPTY_BUFFER_CONSTANT, USART_OUTPUT_BUFFER_LENGTH);
+    p_fsm->baud_next = 0;
     port_usart_init(p_fsm->usart_id);
 }
 
 bool fsm_usart_check_activity(fsm_t * p_this)
 {
     fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
-    return (p_fsm->f.current_state == SEND_DATA || p_fsm->data_received);
-}
\ No newline at end of file
+    return (p_fsm->f.current_state == SEND_DATA || p_fsm->data_received || p_fsm->baud_next != 0);
+}
+
+bool fsm_usart_check_baud(fsm_t *p_this, uint32_t baud, uint32_t *p_actual)
+{
+    fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
+    return port_usart_check_baud(p_fsm->usart_id, baud, p_actual);
+}
+
+bool fsm_usart_set_baud(fsm_t *p_this, uint32_t baud)
+{
+    fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
+    if(!port_usart_check_baud(p_fsm->usart_id, baud, NULL)){
+        return false;
+    }
+    if(port_usart_tx_done(p_fsm->usart_id)){
+        p_fsm->baud_next = 0;
+        return port_usart_set_baud(p_fsm->usart_id, baud);
+    }
+    p_fsm->baud_next = baud;                        // Changed by do_tx_end() when the queue is empty
+    port_system_event_post(SYSTEM_EVENT_USART);
+    return true;
+}
+
+uint32_t fsm_usart_get_baud(fsm_t *p_this)
+{
+    fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
+    return (p_fsm->baud_next != 0) ? p_fsm->baud_next : port_usart_get_baud(p_fsm->usart_id);
+}
+
+void fsm_usart_get_tx_stats(fsm_t *p_this, port_usart_tx_stats_t *p_stats)
+{
+    fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
+    port_usart_get_tx_stats(p_fsm->usart_id, p_stats);
+}
+
+void fsm_usart_reset_tx_stats(fsm_t *p_this)
+{
+    fsm_usart_t *p_fsm = (fsm_usart_t *)(p_this);
+    port_usart_reset_tx_stats(p_fsm->usart_id);
+}
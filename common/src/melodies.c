@@ -7,29 +7,88 @@
  */
 
 /* Includes ------------------------------------------------------------------*/
+#include <stddef.h> // NULL
 #include "melodies.h"
+#include "melody_pool.h"
+
+/* Defines and enums ----------------------------------------------------------*/
+/**
+ * @brief Indexes of the durations used by the melodies in `melody_durations`.
+ */
+enum DURATIONS
+{
+  D15,    /*!< 15 ms */
+  D50,    /*!< 50 ms */
+  D100,   /*!< 100 ms */
+  D133,   /*!< 133 ms */
+  D134,   /*!< 134 ms */
+  D140,   /*!< 140 ms */
+  D150,   /*!< 150 ms */
+  D200,   /*!< 200 ms */
+  D250,   /*!< 250 ms */
+  D266,   /*!< 266 ms */
+  D267,   /*!< 267 ms */
+  D280,   /*!< 280 ms */
+  D300,   /*!< 300 ms */
+  D400,   /*!< 400 ms */
+  D420,   /*!< 420 ms */
+  D600,   /*!< 600 ms */
+  D700,   /*!< 700 ms */
+  D785,   /*!< 785 ms */
+  D800,   /*!< 800 ms */
+  D900,   /*!< 900 ms */
+  D1000,  /*!< 1000 ms */
+  D1120,  /*!< 1120 ms */
+  D1200,  /*!< 1200 ms */
+};
+
+/* Global variables ------------------------------------------------------------*/
+/**
+ * @brief Durations in milliseconds shared by all the melodies of this file.
+ */
+static const uint16_t melody_durations[] = {
+    [D15] = 15,
+    [D50] = 50,
+    [D100] = 100,
+    [D133] = 133,
+    [D134] = 134,
+    [D140] = 140,
+    [D150] = 150,
+    [D200] = 200,
+    [D250] = 250,
+    [D266] = 266,
+    [D267] = 267,
+    [D280] = 280,
+    [D300] = 300,
+    [D400] = 400,
+    [D420] = 420,
+    [D600] = 600,
+    [D700] = 700,
+    [D785] = 785,
+    [D800] = 800,
+    [D900] = 900,
+    [D1000] = 1000,
+    [D1120] = 1120,
+    [D1200] = 1200,
+};
 
 /* Melodies ------------------------------------------------------------------*/
 // Melody Happy Birthday
 #define HAPPY_BIRTHDAY_LENGTH 26 /*!< Happy Birthday melody length */
+#define HAPPY_BIRTHDAY_NAME "Happy Birthday" /*!< Happy Birthday melody name */
 
 /**
- * @brief Happy Birthday melody notes.
+ * @brief Happy Birthday melody blob.
  *
- * This array contains the frequencies of the notes for the Happy Birthday song.
- * The notes are defined as frequency values in Hertz, and they are arranged in the order they are played in the song.
+ * This blob contains the notes, the duration indexes (see `enum DURATIONS`) and the name of the Happy Birthday song.
+ * The notes are defined as note numbers (see `enum NOTES`), and they are arranged in the order they are played in the song.
  */
-static const double happy_birthday_notes[HAPPY_BIRTHDAY_LENGTH] = {
-    SILENCE, DO4, DO4, RE4, DO4, FA4, MI4, DO4, DO4, RE4, DO4, SOL4, FA4, DO4, DO4, DO5, LA4, FA4, MI4, RE4, LAs4, LAs4, LA4, FA4, SOL4, FA4};
-
-/**
- * @brief Happy Birthday melody durations in miliseconds.
- *
- * This array contains the duration of each note in the Happy Birthday song.
- * The durations are defined in milliseconds, and they are arranged in the order they are played in the song.
- */
-static const uint16_t happy_birthday_durations[HAPPY_BIRTHDAY_LENGTH] = {
-    100, 300, 100, 400, 400, 400, 800, 300, 100, 400, 400, 400, 800, 300, 100, 400, 400, 400, 400, 400, 300, 100, 400, 400, 400, 800};
+static const MELODY_BLOB_T(HAPPY_BIRTHDAY_LENGTH, HAPPY_BIRTHDAY_NAME) happy_birthday_blob = {
+    .notes = {
+        SILENCE, DO4, DO4, RE4, DO4, FA4, MI4, DO4, DO4, RE4, DO4, SOL4, FA4, DO4, DO4, DO5, LA4, FA4, MI4, RE4, LAs4, LAs4, LA4, FA4, SOL4, FA4},
+    .durations = {
+        D100, D300, D100, D400, D400, D400, D800, D300, D100, D400, D400, D400, D800, D300, D100, D400, D400, D400, D400, D400, D300, D100, D400, D400, D400, D800},
+    .name = HAPPY_BIRTHDAY_NAME};
 
 /**
  * @brief Happy Birthday melody struct.
@@ -37,34 +96,27 @@ static const uint16_t happy_birthday_durations[HAPPY_BIRTHDAY_LENGTH] = {
  * This struct contains the information of the Happy Birthday melody.
  * It is used to play the melody using the buzzer.
  */
-const melody_t happy_birthday_melody = {.p_name = "Happy Birthday",
-                                        .p_notes = (double *)happy_birthday_notes,
-                                        .p_durations = (uint16_t *)happy_birthday_durations,
-                                        .melody_length = HAPPY_BIRTHDAY_LENGTH};
+const melody_t happy_birthday_melody = MELODY_FROM_BLOB(happy_birthday_blob, melody_durations);
 
 // Tetris melody
 #define TETRIS_LENGTH 41 /*!< Tetris melody length */
+#define TETRIS_NAME "Tetris" /*!< Tetris melody name */
 
 /**
- * @brief Tetris melody notes.
- *
- * This array contains the frequencies of the notes for the Tetris song.
- * The notes are defined as frequency values in Hertz, and they are arranged in the order they are played in the song.
- */
-static const double tetris_notes[TETRIS_LENGTH] = {
-    SILENCE, MI5, SI4, DO5, RE5, DO5, SI4, LA4, LA4, DO5, MI5, RE5, DO5, SI4, DO5, RE5, MI5, DO5, LA4,
-    LA4, LA4, SI4, DO5, RE5, FA4, LA5, SOL5, FA5, MI5, DO5, MI5, RE5, DO5, SI4, SI4, LA4, RE5,
-    MI5, DO5, LA4, LA4};
-
-/** 
- * @brief Tetris melody durations in miliseconds.
+ * @brief Tetris melody blob.
  *
- * This array contains the duration of each note in the Tetris song.
- * The durations are defined in milliseconds, and they are arranged in the order they are played in the song.
+ * This blob contains the notes, the duration indexes (see `enum DURATIONS`) and the name of the Tetris song.
+ * The notes are defined as note numbers (see `enum NOTES`), and they are arranged in the order they are played in the song.
  */
-static const uint16_t tetris_durations[TETRIS_LENGTH] = {
-    100, 400, 200, 200, 400, 200, 200, 400, 200, 200, 400, 200, 200, 600, 200, 400, 400, 400, 400, 200, 200, 200, 200,
-    600, 200, 400, 200, 200, 600, 200, 400, 200, 200, 400, 200, 200, 400, 400, 400, 400, 400};
+static const MELODY_BLOB_T(TETRIS_LENGTH, TETRIS_NAME) tetris_blob = {
+    .notes = {
+        SILENCE, MI5, SI4, DO5, RE5, DO5, SI4, LA4, LA4, DO5, MI5, RE5, DO5, SI4, DO5, RE5, MI5, DO5, LA4,
+        LA4, LA4, SI4, DO5, RE5, FA4, LA5, SOL5, FA5, MI5, DO5, MI5, RE5, DO5, SI4, SI4, LA4, RE5,
+        MI5, DO5, LA4, LA4},
+    .durations = {
+        D100, D400, D200, D200, D400, D200, D200, D400, D200, D200, D400, D200, D200, D600, D200, D400, D400, D400, D400, D200, D200, D200, D200,
+        D600, D200, D400, D200, D200, D600, D200, D400, D200, D200, D400, D200, D200, D400, D400, D400, D400, D400},
+    .name = TETRIS_NAME};
 
 /**
  * @brief Tetris melody struct.
@@ -72,31 +124,24 @@ static const uint16_t tetris_durations[TETRIS_LENGTH] = {
  * This struct contains the information of the Tetris melody.
  * It is used to play the melody using the buzzer.
  */
-const melody_t tetris_melody = {.p_name = "Tetris",
-                                .p_notes = (double *)tetris_notes,
-                                .p_durations = (uint16_t *)tetris_durations,
-                                .melody_length = TETRIS_LENGTH};
+const melody_t tetris_melody = MELODY_FROM_BLOB(tetris_blob, melody_durations);
 
 // Scale Melody
 #define SCALE_MELODY_LENGTH 8   /*!< Scale melody length */
+#define SCALE_MELODY_NAME "Scale" /*!< Scale melody name */
 
 /**
- * @brief Scale melody notes.
+ * @brief Scale melody blob.
  *
- * This array contains the frequencies of the notes for the scale song.
- * The notes are defined as frequency values in Hertz, and they are arranged in the order they are played in the song.
+ * This blob contains the notes, the duration indexes (see `enum DURATIONS`) and the name of the scale song.
+ * The notes are defined as note numbers (see `enum NOTES`), and they are arranged in the order they are played in the song.
  */
-static const double scale_melody_notes[SCALE_MELODY_LENGTH] = {
-    DO4, RE4, MI4, FA4, SOL4, LA4, SI4, DO5};
-
-/**
- * @brief Scale melody durations in miliseconds.
- * 
- * This array contains the duration of each note in the scale song.
- * The durations are defined in milliseconds, and they are arranged in the order they are played in the song.
- */
-static const uint16_t scale_melody_durations[SCALE_MELODY_LENGTH] = {
-    250, 250, 250, 250, 250, 250, 250, 250};
+static const MELODY_BLOB_T(SCALE_MELODY_LENGTH, SCALE_MELODY_NAME) scale_melody_blob = {
+    .notes = {
+        DO4, RE4, MI4, FA4, SOL4, LA4, SI4, DO5},
+    .durations = {
+        D250, D250, D250, D250, D250, D250, D250, D250},
+    .name = SCALE_MELODY_NAME};
 
 /**
  * @brief Scale melody struct.
@@ -104,34 +149,27 @@ static const uint16_t scale_melody_durations[SCALE_MELODY_LENGTH] = {
  * This struct contains the information of the scale melody.
  * It is used to play the melody using the buzzer.
  */
-const melody_t scale_melody = {.p_name = "Scale",
-                               .p_notes = (double *)scale_melody_notes,
-                               .p_durations = (uint16_t *)scale_melody_durations,
-                               .melody_length = SCALE_MELODY_LENGTH};
+const melody_t scale_melody = MELODY_FROM_BLOB(scale_melody_blob, melody_durations);
 
 
 ////////////////////////// V5 ////////////////////////////////////////////
 // Outro song
 
 #define OUTRO_LENGTH 15   /*!< Outro melody length */
+#define OUTRO_NAME "Outro" /*!< Outro melody name */
 
 /**
- * @brief Outro notes.
+ * @brief Outro blob.
  *
- * This array contains the frequencies of the notes for the Outro song.
- * The notes are defined as frequency values in Hertz, and they are arranged in the order they are played in the song.
+ * This blob contains the notes, the duration indexes (see `enum DURATIONS`) and the name of the Outro song.
+ * The notes are defined as note numbers (see `enum NOTES`), and they are arranged in the order they are played in the song.
  */
-static const double outro_notes[OUTRO_LENGTH] = {
-    SILENCE, SI4, SILENCE, FA5, SILENCE, FA5, FA5, MI5, RE5, DO5, MI4, SOL3, MI4, DO4, SILENCE};
-
-/**
- * @brief Outro durations in miliseconds.
- * 
- * This array contains the duration of each note in the Outro song.
- * The durations are defined in milliseconds, and they are arranged in the order they are played in the song.
- */
-static const uint16_t outro_durations[OUTRO_LENGTH] = {
-    100, 200, 50, 150, 200, 200, 266, 266, 267, 200, 200, 200, 200, 785, 15};
+static const MELODY_BLOB_T(OUTRO_LENGTH, OUTRO_NAME) outro_blob = {
+    .notes = {
+        SILENCE, SI4, SILENCE, FA5, SILENCE, FA5, FA5, MI5, RE5, DO5, MI4, SOL3, MI4, DO4, SILENCE},
+    .durations = {
+        D100, D200, D50, D150, D200, D200, D266, D266, D267, D200, D200, D200, D200, D785, D15},
+    .name = OUTRO_NAME};
 
 /**
  * @brief Outro struct.
@@ -139,40 +177,33 @@ static const uint16_t outro_durations[OUTRO_LENGTH] = {
  * This struct contains the information of the Outro.
  * It is used to play the melody using the buzzer.
  */
-const melody_t outro = {.p_name = "Outro",
-                               .p_notes = (double *)outro_notes,
-                               .p_durations = (uint16_t *)outro_durations,
-                               .melody_length = OUTRO_LENGTH};
+const melody_t outro = MELODY_FROM_BLOB(outro_blob, melody_durations);
 
 
 
 // March of the Toreadors 
 
 #define MARCH_OF_THE_TOREADORS_LENGTH 21   /*!< March of the Toreadors melody length */
+#define MARCH_OF_THE_TOREADORS_NAME "March of the Toreadors" /*!< March of the Toreadors melody name */
 
 /**
- * @brief March of the Toreadors notes.
+ * @brief March of the Toreadors blob.
  *
- * This array contains the frequencies of the notes for the March of the Toreadors song.
- * The notes are defined as frequency values in Hertz, and they are arranged in the order they are played in the song.
- */
-static const double march_of_the_toreadors_notes[MARCH_OF_THE_TOREADORS_LENGTH] = {
-    SILENCE, DO5, RE5, DO5, LA4, SILENCE, LA4, SILENCE,
-    LA4, SOL4, LA4, LAs4, LA4, 
-    LAs4, SOL4, DO5, LA4,
-    FA4, RE4, SOL4, DO4 };
-
-/**
- * @brief March of the toreadors durations in miliseconds.
- * 
- * This array contains the duration of each note in the March of the toreadors song.
- * The durations are defined in milliseconds, and they are arranged in the order they are played in the song.
- */
-static const uint16_t march_of_the_toreadors_durations[MARCH_OF_THE_TOREADORS_LENGTH] = {
-    100, 400, 300, 100, 150, 100, 150, 100,
-    300, 100, 300, 100, 800, 
-    400, 300, 100, 800,
-    400, 300, 100, 800 };
+ * This blob contains the notes, the duration indexes (see `enum DURATIONS`) and the name of the March of the Toreadors song.
+ * The notes are defined as note numbers (see `enum NOTES`), and they are arranged in the order they are played in the song.
+ */
+static const MELODY_BLOB_T(MARCH_OF_THE_TOREADORS_LENGTH, MARCH_OF_THE_TOREADORS_NAME) march_of_the_toreadors_blob = {
+    .notes = {
+        SILENCE, DO5, RE5, DO5, LA4, SILENCE, LA4, SILENCE,
+        LA4, SOL4, LA4, LAs4, LA4,
+        LAs4, SOL4, DO5, LA4,
+        FA4, RE4, SOL4, DO4},
+    .durations = {
+        D100, D400, D300, D100, D150, D100, D150, D100,
+        D300, D100, D300, D100, D800,
+        D400, D300, D100, D800,
+        D400, D300, D100, D800},
+    .name = MARCH_OF_THE_TOREADORS_NAME};
 
 /**
  * @brief March of the toreadors struct.
@@ -180,50 +211,43 @@ static const uint16_t march_of_the_toreadors_durations[MARCH_OF_THE_TOREADORS_LE
  * This struct contains the information of the March of the toreadors.
  * It is used to play the melody using the buzzer.
  */
-const melody_t march_of_the_toreadors = {.p_name = "March of the Toreadors",
-                               .p_notes = (double *)march_of_the_toreadors_notes,
-                               .p_durations = (uint16_t *)march_of_the_toreadors_durations,
-                               .melody_length = MARCH_OF_THE_TOREADORS_LENGTH};
+const melody_t march_of_the_toreadors = MELODY_FROM_BLOB(march_of_the_toreadors_blob, melody_durations);
 
 
 
 // Careless Whispers
 
 #define CARELESS_WHISPERS_LENGTH 60   /*!< Careless Whispers melody length */
+#define CARELESS_WHISPERS_NAME "Careless Whispers" /*!< Careless Whispers melody name */
 
 /**
- * @brief Careless Whispers notes.
+ * @brief Careless Whispers blob.
  *
- * This array contains the frequencies of the notes for the Careless Whispers song.
- * The notes are defined as frequency values in Hertz, and they are arranged in the order they are played in the song.
- */
-static const double careless_whispers_notes[CARELESS_WHISPERS_LENGTH] = {
-    SILENCE, DOs5, 
-    DOs6, SI5, FAs5, RE5, DOs6, SI5, FAs5, RE5, 
-    LA5, SOL5, RE5, SI4, LA5, SOL5, RE5, 
-    SOL5, FAs5, RE5, SI4, SOL4, LA4, 
-    FAs4, SOL4, LA4, SI4, DOs5, RE5, MI5, FAs5, 
-    DOs6, SI5, FAs5, RE5, DO6, SI5, FAs5, RE5, 
-    LA5, SOL5, RE5, SI4, LA5, SOL5, RE5, 
-    SOL5, FAs5, RE5, SI4, SOL4, LA4, 
-    FAs4, SOL4, LA4, SI4, DOs5, RE5, MI5, FAs5};
-
-/**
- * @brief Careless Whispers durations in miliseconds.
- * 
- * This array contains the duration of each note in the Careless Whispers song.
- * The durations are defined in milliseconds, and they are arranged in the order they are played in the song.
- */
-static const uint16_t careless_whispers_durations[CARELESS_WHISPERS_LENGTH] = {
-    100, 280, 
-    280, 140, 280, 280, 420, 140, 280, 420, 
-    280, 140, 280, 280, 420, 140, 700, 
-    280, 140, 280, 280, 1120, 140, 
-    280, 280, 280, 280, 280, 280, 280, 280, 
-    280, 140, 280, 280, 420, 140, 280, 420, 
-    280, 140, 280, 280, 420, 140, 700, 
-    280, 140, 280, 280, 1120, 140, 
-    280, 280, 280, 280, 280, 280, 280, 280};
+ * This blob contains the notes, the duration indexes (see `enum DURATIONS`) and the name of the Careless Whispers song.
+ * The notes are defined as note numbers (see `enum NOTES`), and they are arranged in the order they are played in the song.
+ */
+static const MELODY_BLOB_T(CARELESS_WHISPERS_LENGTH, CARELESS_WHISPERS_NAME) careless_whispers_blob = {
+    .notes = {
+        SILENCE, DOs5,
+        DOs6, SI5, FAs5, RE5, DOs6, SI5, FAs5, RE5,
+        LA5, SOL5, RE5, SI4, LA5, SOL5, RE5,
+        SOL5, FAs5, RE5, SI4, SOL4, LA4,
+        FAs4, SOL4, LA4, SI4, DOs5, RE5, MI5, FAs5,
+        DOs6, SI5, FAs5, RE5, DO6, SI5, FAs5, RE5,
+        LA5, SOL5, RE5, SI4, LA5, SOL5, RE5,
+        SOL5, FAs5, RE5, SI4, SOL4, LA4,
+        FAs4, SOL4, LA4, SI4, DOs5, RE5, MI5, FAs5},
+    .durations = {
+        D100, D280,
+        D280, D140, D280, D280, D420, D140, D280, D420,
+        D280, D140, D280, D280, D420, D140, D700,
+        D280, D140, D280, D280, D1120, D140,
+        D280, D280, D280, D280, D280, D280, D280, D280,
+        D280, D140, D280, D280, D420, D140, D280, D420,
+        D280, D140, D280, D280, D420, D140, D700,
+        D280, D140, D280, D280, D1120, D140,
+        D280, D280, D280, D280, D280, D280, D280, D280},
+    .name = CARELESS_WHISPERS_NAME};
 
 /**
  * @brief Careless Whispers struct.
@@ -231,56 +255,49 @@ static const uint16_t careless_whispers_durations[CARELESS_WHISPERS_LENGTH] = {
  * This struct contains the information of the Careless Whispers.
  * It is used to play the melody using the buzzer.
  */
-const melody_t careless_whispers = {.p_name = "Careless Whispers",
-                               .p_notes = (double *)careless_whispers_notes,
-                               .p_durations = (uint16_t *)careless_whispers_durations,
-                               .melody_length = CARELESS_WHISPERS_LENGTH};
+const melody_t careless_whispers = MELODY_FROM_BLOB(careless_whispers_blob, melody_durations);
                                
 
 
 // The Legend of Zelda Main Theme 
 
 #define LEGEND_OF_ZELDA_MAIN_LENGTH 85   /*!< The Legend of Zelda Main Theme melody length */
+#define LEGEND_OF_ZELDA_MAIN_NAME "The Legend of Zelda Main Theme" /*!< The Legend of Zelda Main Theme melody name */
 
 /**
- * @brief The Legend of Zelda Main Theme notes.
+ * @brief The Legend of Zelda Main Theme blob.
  *
- * This array contains the frequencies of the notes for the The Legend of Zelda Main Theme song.
- * The notes are defined as frequency values in Hertz, and they are arranged in the order they are played in the song.
- */
-static const double legend_of_zelda_main_notes[LEGEND_OF_ZELDA_MAIN_LENGTH] = {
-    SILENCE, LA4, SILENCE, LA4, LA4, LA4, LA4,
-    LA4, SOL4, LA4, SILENCE, LA4, LA4, LA4, LA4,
-    LA4, SOL4, LA4, SILENCE, LA4, LA4, LA4, LA4,
-    LA4, MI4, MI4, MI4, MI4, MI4, MI4, MI4, MI4, MI4, MI4, 
-    LA4, MI4, LA4, LA4, SI4, DOs5, RE5, 
-    MI5, SILENCE, MI5, MI5, FA5, SOL5, 
-    LA5, SILENCE, LA5, LA5, SOL5, FA5,
-    SOL5, FA5, MI5, MI5, 
-    RE5, RE5, MI5, FA5, MI5, RE5, 
-    DO5, DO5, RE5, MI5, RE5, DO5, 
-    SI4, SI4, DOs5, REs5, FAs5, 
-    MI5, MI4, MI4, MI4, MI4, MI4, MI4, MI4, MI4, MI4, MI4};
-
-/**
- * @brief The Legend of Zelda Main Theme durations in miliseconds.
- * 
- * This array contains the duration of each note in the The Legend of Zelda Main Theme song.
- * The durations are defined in milliseconds, and they are arranged in the order they are played in the song.
- */
-static const uint16_t legend_of_zelda_main_durations[LEGEND_OF_ZELDA_MAIN_LENGTH] = {
-    100, 800, 267, 133, 133, 133, 134,
-    267, 133, 400, 267, 133, 133, 133, 134,
-    267, 133, 400, 267, 133, 133, 133, 134,
-    200, 100, 100, 200, 100, 100, 200, 100, 100, 200, 200, 
-    400, 600, 200, 100, 100, 100, 100, 
-    800, 200, 200, 133, 133, 134,
-    800, 200, 200, 133, 133, 134, 
-    300, 100, 800, 400, 
-    200, 100, 100, 800, 200, 200, 
-    200, 100, 100, 800, 200, 200, 
-    200, 100, 100, 800, 400, 
-    200, 100, 100, 200, 100, 100, 200, 100, 100, 200, 200};
+ * This blob contains the notes, the duration indexes (see `enum DURATIONS`) and the name of the The Legend of Zelda Main Theme song.
+ * The notes are defined as note numbers (see `enum NOTES`), and they are arranged in the order they are played in the song.
+ */
+static const MELODY_BLOB_T(LEGEND_OF_ZELDA_MAIN_LENGTH, LEGEND_OF_ZELDA_MAIN_NAME) legend_of_zelda_main_blob = {
+    .notes = {
+        SILENCE, LA4, SILENCE, LA4, LA4, LA4, LA4,
+        LA4, SOL4, LA4, SILENCE, LA4, LA4, LA4, LA4,
+        LA4, SOL4, LA4, SILENCE, LA4, LA4, LA4, LA4,
+        LA4, MI4, MI4, MI4, MI4, MI4, MI4, MI4, MI4, MI4, MI4,
+        LA4, MI4, LA4, LA4, SI4, DOs5, RE5,
+        MI5, SILENCE, MI5, MI5, FA5, SOL5,
+        LA5, SILENCE, LA5, LA5, SOL5, FA5,
+        SOL5, FA5, MI5, MI5,
+        RE5, RE5, MI5, FA5, MI5, RE5,
+        DO5, DO5, RE5, MI5, RE5, DO5,
+        SI4, SI4, DOs5, REs5, FAs5,
+        MI5, MI4, MI4, MI4, MI4, MI4, MI4, MI4, MI4, MI4, MI4},
+    .durations = {
+        D100, D800, D267, D133, D133, D133, D134,
+        D267, D133, D400, D267, D133, D133, D133, D134,
+        D267, D133, D400, D267, D133, D133, D133, D134,
+        D200, D100, D100, D200, D100, D100, D200, D100, D100, D200, D200,
+        D400, D600, D200, D100, D100, D100, D100,
+        D800, D200, D200, D133, D133, D134,
+        D800, D200, D200, D133, D133, D134,
+        D300, D100, D800, D400,
+        D200, D100, D100, D800, D200, D200,
+        D200, D100, D100, D800, D200, D200,
+        D200, D100, D100, D800, D400,
+        D200, D100, D100, D200, D100, D100, D200, D100, D100, D200, D200},
+    .name = LEGEND_OF_ZELDA_MAIN_NAME};
 
 /**
  * @brief The Legend of Zelda Main Theme struct.
@@ -288,54 +305,47 @@ static const uint16_t legend_of_zelda_main_durations[LEGEND_OF_ZELDA_MAIN_LENGTH
  * This struct contains the information of the The Legend of Zelda Main Theme.
  * It is used to play the melody using the buzzer.
  */
-const melody_t legend_of_zelda_main = {.p_name = "The Legend of Zelda Main Theme",
-                               .p_notes = (double *)legend_of_zelda_main_notes,
-                               .p_durations = (uint16_t *)legend_of_zelda_main_durations,
-                               .melody_length = LEGEND_OF_ZELDA_MAIN_LENGTH};
+const melody_t legend_of_zelda_main = MELODY_FROM_BLOB(legend_of_zelda_main_blob, melody_durations);
 
 // IMPERIAL MARCH
 
 #define IMPERIAL_MARCH_LENGTH 71   /*!< Imperial March melody length */
+#define IMPERIAL_MARCH_NAME "Imperial March" /*!< Imperial March melody name */
 
 /**
- * @brief Imperial March notes.
+ * @brief Imperial March blob.
  *
- * This array contains the frequencies of the notes for the Imperial March song.
- * The notes are defined as frequency values in Hertz, and they are arranged in the order they are played in the song.
- */
-static const double imperial_march_notes[IMPERIAL_MARCH_LENGTH] = {
-    SILENCE, SOL4, SOL4, SOL4, REs4, LAs4, 
-    SOL4, REs4, LAs4, SOL4, 
-    RE5, RE5, RE5, REs5, LAs4, 
-    FAs4, REs4, LAs4, SOL4, 
-    SOL5, SOL4, SOL4, SOL5, FAs5, FA5, 
-    MI5, REs5, MI5, SILENCE, SOLs4, DOs5, DO5, SI4, 
-    LAs4, LA4, LAs4, SILENCE, REs4, FAs4, REs4, FAs4, 
-    LAs4, SOL4, LAs4, RE5, 
-    SOL5, SOL4, SOL4, SOL5, FAs5, FA5, 
-    MI5, REs5, MI5, SILENCE, SOLs4, DOs5, DO5, SI4, 
-    LAs4, LA4, LAs4, SILENCE, REs4, FAs4, REs4, LAs4, 
-    SOL4, REs4, LAs4, SOL4};
-
-/**
- * @brief Imperial March durations in miliseconds.
- * 
- * This array contains the duration of each note in the Imperial March song.
- * The durations are defined in milliseconds, and they are arranged in the order they are played in the song.
- */
-static const uint16_t imperial_march_durations[IMPERIAL_MARCH_LENGTH] = {
-    100, 400, 400, 400, 300, 100, 
-    400, 300, 100, 800, 
-    400, 400, 400, 300, 100,
-    400, 300, 100, 800, 
-    400, 300, 100, 400, 300, 100, 
-    100, 100, 200, 200, 200, 400, 300, 100,
-    100, 100, 200, 200, 200, 400, 300, 100, 
-    400, 300, 100, 800, 
-    400, 300, 100, 400, 300, 100, 
-    100, 100, 200, 200, 200, 400, 300, 100, 
-    100, 100, 200, 200, 200, 400, 300, 100, 
-    400, 300, 100, 800};
+ * This blob contains the notes, the duration indexes (see `enum DURATIONS`) and the name of the Imperial March song.
+ * The notes are defined as note numbers (see `enum NOTES`), and they are arranged in the order they are played in the song.
+ */
+static const MELODY_BLOB_T(IMPERIAL_MARCH_LENGTH, IMPERIAL_MARCH_NAME) imperial_march_blob = {
+    .notes = {
+        SILENCE, SOL4, SOL4, SOL4, REs4, LAs4,
+        SOL4, REs4, LAs4, SOL4,
+        RE5, RE5, RE5, REs5, LAs4,
+        FAs4, REs4, LAs4, SOL4,
+        SOL5, SOL4, SOL4, SOL5, FAs5, FA5,
+        MI5, REs5, MI5, SILENCE, SOLs4, DOs5, DO5, SI4,
+        LAs4, LA4, LAs4, SILENCE, REs4, FAs4, REs4, FAs4,
+        LAs4, SOL4, LAs4, RE5,
+        SOL5, SOL4, SOL4, SOL5, FAs5, FA5,
+        MI5, REs5, MI5, SILENCE, SOLs4, DOs5, DO5, SI4,
+        LAs4, LA4, LAs4, SILENCE, REs4, FAs4, REs4, LAs4,
+        SOL4, REs4, LAs4, SOL4},
+    .durations = {
+        D100, D400, D400, D400, D300, D100,
+        D400, D300, D100, D800,
+        D400, D400, D400, D300, D100,
+        D400, D300, D100, D800,
+        D400, D300, D100, D400, D300, D100,
+        D100, D100, D200, D200, D200, D400, D300, D100,
+        D100, D100, D200, D200, D200, D400, D300, D100,
+        D400, D300, D100, D800,
+        D400, D300, D100, D400, D300, D100,
+        D100, D100, D200, D200, D200, D400, D300, D100,
+        D100, D100, D200, D200, D200, D400, D300, D100,
+        D400, D300, D100, D800},
+    .name = IMPERIAL_MARCH_NAME};
 
 /**
  * @brief Imperial March struct.
@@ -343,98 +353,91 @@ static const uint16_t imperial_march_durations[IMPERIAL_MARCH_LENGTH] = {
  * This struct contains the information of the Imperial March.
  * It is used to play the melody using the buzzer.
  */
-const melody_t imperial_march = {.p_name = "Imperial March",
-                               .p_notes = (double *)imperial_march_notes,
-                               .p_durations = (uint16_t *)imperial_march_durations,
-                               .melody_length = IMPERIAL_MARCH_LENGTH};
+const melody_t imperial_march = MELODY_FROM_BLOB(imperial_march_blob, melody_durations);
 
 // Mario Bros Main Theme 
 
-#define MARIO_BROS_MAIN_LENGTH 192   /*!< Mario Bros Main Theme melody length */
+#define MARIO_BROS_MAIN_LENGTH 194   /*!< Mario Bros Main Theme melody length */
+#define MARIO_BROS_MAIN_NAME "Mario Bros Main Theme" /*!< Mario Bros Main Theme melody name */
 
 /**
- * @brief Mario Bros Main Theme notes.
+ * @brief Mario Bros Main Theme blob.
  *
- * This array contains the frequencies of the notes for the Mario Bros Main Theme song.
- * The notes are defined as frequency values in Hertz, and they are arranged in the order they are played in the song.
- */
-static const double mario_bros_main_notes[MARIO_BROS_MAIN_LENGTH] = {
-    SILENCE, MI5, MI5, SILENCE, MI5, SILENCE, DO5, MI5, 
-    SOL5, SILENCE, SOL4, SILENCE, 
-    DO5, SILENCE, SOL4, SILENCE, MI4, 
-    SILENCE, LA4, SI4, LAs4, LA4, 
-    SOL4, MI5, SOL5, LA5, FA5, SOL5, 
-    SILENCE, MI5, DO5, RE5, SI4, SILENCE, 
-    DO5, SILENCE, SOL4, SILENCE, MI4, 
-    SILENCE, LA4, SI4, LAs4, LA4, 
-    SOL4, MI5, SOL5, LA5, FA5, SOL5, 
-    SILENCE, MI5, DO5, RE5, SI4, SILENCE, //55
-    SILENCE, SOL5, FAs5, FA5, REs5, MI5, 
-    SILENCE, SOLs4, LA4, DO5, SILENCE, LA4, DO5, RE5, 
-    SILENCE, SOL5, FAs5, FA5, REs5, MI5, 
-    SILENCE, DO6, DO6, DO6, SILENCE, 
-    SILENCE, SOL5, FAs5, FA5, REs5, MI5, 
-    SILENCE, SOLs4, LA4, DO5, SILENCE, LA4, DO5, RE5, 
-    SILENCE, REs5, SILENCE, RE5, SILENCE, 
-    DO5, SILENCE,
-    SILENCE, SOL5, FAs5, FA5, REs5, MI5, 
-    SILENCE, SOLs4, LA4, DO5, SILENCE, LA4, DO5, RE5, 
-    SILENCE, SOL5, FAs5, FA5, REs5, MI5, 
-    SILENCE, DO6, DO6, DO6, SILENCE, 
-    SILENCE, SOL5, FAs5, FA5, REs5, MI5, 
-    SILENCE, SOLs4, LA4, DO5, SILENCE, LA4, DO5, RE5, 
-    SILENCE, REs5, SILENCE, RE5, SILENCE, 
-    DO5, SILENCE, //147
-    DO5, DO5, SILENCE, DO5, SILENCE, DO5, RE5, 
-    MI5, DO5, SILENCE, LA4, SOL4, 
-    DO5, DO5, SILENCE, DO5, SILENCE, DO5, RE5, MI5, 
-    SILENCE, 
-    DO5, DO5, SILENCE, DO5, SILENCE, DO5, RE5, 
-    MI5, DO5, SILENCE, LA4, SOL4, 
-    MI5, MI5, SILENCE, MI5, SILENCE, DO5, MI5, 
-    SOL5, SILENCE, SOL4, SILENCE };
-
-/**
- * @brief Mario Bros Main Theme durations in miliseconds.
- * 
- * This array contains the duration of each note in the Mario Bros Main Theme song.
- * The durations are defined in milliseconds, and they are arranged in the order they are played in the song.
- */
-static const uint16_t mario_bros_main_durations[MARIO_BROS_MAIN_LENGTH] = {
-    100, 150, 150, 150, 150, 150, 150, 300, 
-    300, 300, 300, 300, 
-    300, 150, 300, 150, 300, 
-    150, 300, 300, 150, 300, 
-    200, 200, 200, 300, 150, 150, 
-    150, 300, 150, 150, 300, 150, 
-    300, 150, 300, 150, 300, 
-    150, 300, 300, 150, 300, 
-    200, 200, 200, 300, 150, 150, 
-    150, 300, 150, 150, 300, 150, //55
-    300, 150, 150, 150, 300, 150, 
-    150, 150, 150, 150, 150, 150, 150, 150, 
-    300, 150, 150, 150, 300, 150, 
-    150, 300, 150, 300, 300, 
-    300, 150, 150, 150, 300, 150, 
-    150, 150, 150, 150, 150, 150, 150, 150, 
-    300, 300, 150, 300, 150, 
-    300, 900, 
-    300, 150, 150, 150, 300, 150, 
-    150, 150, 150, 150, 150, 150, 150, 150, 
-    300, 150, 150, 150, 300, 150, 
-    150, 300, 150, 300, 300, 
-    300, 150, 150, 150, 300, 150, 
-    150, 150, 150, 150, 150, 150, 150, 150, 
-    300, 300, 150, 300, 150, 
-    300, 900, //147
-    150, 150, 150, 150, 150, 150, 300, 
-    150, 150, 150, 150, 600, 
-    150, 150, 150, 150, 150, 150, 150, 150, 
-    1200, 
-    150, 150, 150, 150, 150, 150, 300, 
-    150, 150, 150, 150, 600, 
-    150, 150, 150, 150, 150, 150, 300, 
-    300, 300, 300, 300 };
+ * This blob contains the notes, the duration indexes (see `enum DURATIONS`) and the name of the Mario Bros Main Theme song.
+ * The notes are defined as note numbers (see `enum NOTES`), and they are arranged in the order they are played in the song.
+ */
+static const MELODY_BLOB_T(MARIO_BROS_MAIN_LENGTH, MARIO_BROS_MAIN_NAME) mario_bros_main_blob = {
+    .notes = {
+        SILENCE, MI5, MI5, SILENCE, MI5, SILENCE, DO5, MI5,
+        SOL5, SILENCE, SOL4, SILENCE,
+        DO5, SILENCE, SOL4, SILENCE, MI4,
+        SILENCE, LA4, SI4, LAs4, LA4,
+        SOL4, MI5, SOL5, LA5, FA5, SOL5,
+        SILENCE, MI5, DO5, RE5, SI4, SILENCE,
+        DO5, SILENCE, SOL4, SILENCE, MI4,
+        SILENCE, LA4, SI4, LAs4, LA4,
+        SOL4, MI5, SOL5, LA5, FA5, SOL5,
+        SILENCE, MI5, DO5, RE5, SI4, SILENCE, //55
+        SILENCE, SOL5, FAs5, FA5, REs5, MI5,
+        SILENCE, SOLs4, LA4, DO5, SILENCE, LA4, DO5, RE5,
+        SILENCE, SOL5, FAs5, FA5, REs5, MI5,
+        SILENCE, DO6, DO6, DO6, SILENCE,
+        SILENCE, SOL5, FAs5, FA5, REs5, MI5,
+        SILENCE, SOLs4, LA4, DO5, SILENCE, LA4, DO5, RE5,
+        SILENCE, REs5, SILENCE, RE5, SILENCE,
+        DO5, SILENCE,
+        SILENCE, SOL5, FAs5, FA5, REs5, MI5,
+        SILENCE, SOLs4, LA4, DO5, SILENCE, LA4, DO5, RE5,
+        SILENCE, SOL5, FAs5, FA5, REs5, MI5,
+        SILENCE, DO6, DO6, DO6, SILENCE,
+        SILENCE, SOL5, FAs5, FA5, REs5, MI5,
+        SILENCE, SOLs4, LA4, DO5, SILENCE, LA4, DO5, RE5,
+        SILENCE, REs5, SILENCE, RE5, SILENCE,
+        DO5, SILENCE, //147
+        DO5, DO5, SILENCE, DO5, SILENCE, DO5, RE5,
+        MI5, DO5, SILENCE, LA4, SOL4,
+        DO5, DO5, SILENCE, DO5, SILENCE, DO5, RE5, MI5,
+        SILENCE,
+        DO5, DO5, SILENCE, DO5, SILENCE, DO5, RE5,
+        MI5, DO5, SILENCE, LA4, SOL4,
+        MI5, MI5, SILENCE, MI5, SILENCE, DO5, MI5,
+        SOL5, SILENCE, SOL4, SILENCE},
+    .durations = {
+        D100, D150, D150, D150, D150, D150, D150, D300,
+        D300, D300, D300, D300,
+        D300, D150, D300, D150, D300,
+        D150, D300, D300, D150, D300,
+        D200, D200, D200, D300, D150, D150,
+        D150, D300, D150, D150, D300, D150,
+        D300, D150, D300, D150, D300,
+        D150, D300, D300, D150, D300,
+        D200, D200, D200, D300, D150, D150,
+        D150, D300, D150, D150, D300, D150, //55
+        D300, D150, D150, D150, D300, D150,
+        D150, D150, D150, D150, D150, D150, D150, D150,
+        D300, D150, D150, D150, D300, D150,
+        D150, D300, D150, D300, D300,
+        D300, D150, D150, D150, D300, D150,
+        D150, D150, D150, D150, D150, D150, D150, D150,
+        D300, D300, D150, D300, D150,
+        D300, D900,
+        D300, D150, D150, D150, D300, D150,
+        D150, D150, D150, D150, D150, D150, D150, D150,
+        D300, D150, D150, D150, D300, D150,
+        D150, D300, D150, D300, D300,
+        D300, D150, D150, D150, D300, D150,
+        D150, D150, D150, D150, D150, D150, D150, D150,
+        D300, D300, D150, D300, D150,
+        D300, D900, //147
+        D150, D150, D150, D150, D150, D150, D300,
+        D150, D150, D150, D150, D600,
+        D150, D150, D150, D150, D150, D150, D150, D150,
+        D1200,
+        D150, D150, D150, D150, D150, D150, D300,
+        D150, D150, D150, D150, D600,
+        D150, D150, D150, D150, D150, D150, D300,
+        D300, D300, D300, D300},
+    .name = MARIO_BROS_MAIN_NAME};
 
 /**
  * @brief Mario Bros Main Theme struct.
@@ -442,53 +445,46 @@ static const uint16_t mario_bros_main_durations[MARIO_BROS_MAIN_LENGTH] = {
  * This struct contains the information of the Mario Bros Main Theme.
  * It is used to play the melody using the buzzer.
  */
-const melody_t mario_bros_main = {.p_name = "Mario Bros Main Theme",
-                               .p_notes = (double *)mario_bros_main_notes,
-                               .p_durations = (uint16_t *)mario_bros_main_durations,
-                               .melody_length = MARIO_BROS_MAIN_LENGTH};
+const melody_t mario_bros_main = MELODY_FROM_BLOB(mario_bros_main_blob, melody_durations);
 
 
 // Pokemon Main
 
 #define POKEMON_MAIN_LENGTH 49   /*!< Pokemon Main melody length */
+#define POKEMON_MAIN_NAME "Pokemon Main" /*!< Pokemon Main melody name */
 
 /**
- * @brief Pokemon Main notes.
+ * @brief Pokemon Main blob.
  *
- * This array contains the frequencies of the notes for the Pokemon Main song.
- * The notes are defined as frequency values in Hertz, and they are arranged in the order they are played in the song.
- */
-static const double pokemon_main_notes[POKEMON_MAIN_LENGTH] = {
-    SILENCE, SOL4, SOL4, SILENCE, SOL4, SOL4, SOL4, 
-    SOL4, SOL4, FA4, FA4, FA4, FA4, FA4, FAs4, 
-    SOL4, SI4, RE5, 
-    SILENCE, LA4, FA5, MI5, REs5, 
-    RE5, FA4, MI4, REs4, 
-    RE4, DO4, SI3, DO4, 
-    SOL4, SI4, RE5, 
-    SILENCE, DO5, LA4, DO5, 
-    RE5, FA4, MI4, DO4, 
-    RE4, SI3, DO4, RE4, 
-    SOL4, SI4, RE5};
-
-/**
- * @brief Pokemon Main durations in miliseconds.
- * 
- * This array contains the duration of each note in the Pokemon Main song.
- * The durations are defined in milliseconds, and they are arranged in the order they are played in the song.
- */
-static const uint16_t pokemon_main_durations[POKEMON_MAIN_LENGTH] = {
-    100, 400, 400, 200, 100, 100, 400, 
-    400, 400, 133, 133, 134, 133, 133, 134, 
-    600, 200, 800, 
-    400, 400, 600, 100, 100, 
-    800, 600, 100, 100, 
-    800, 266, 267, 267, 
-    600, 200, 800, 
-    800, 266, 267, 267, 
-    800, 266, 267, 267, 
-    1000, 200, 200, 200, 
-    600, 200, 800};
+ * This blob contains the notes, the duration indexes (see `enum DURATIONS`) and the name of the Pokemon Main song.
+ * The notes are defined as note numbers (see `enum NOTES`), and they are arranged in the order they are played in the song.
+ */
+static const MELODY_BLOB_T(POKEMON_MAIN_LENGTH, POKEMON_MAIN_NAME) pokemon_main_blob = {
+    .notes = {
+        SILENCE, SOL4, SOL4, SILENCE, SOL4, SOL4, SOL4,
+        SOL4, SOL4, FA4, FA4, FA4, FA4, FA4, FAs4,
+        SOL4, SI4, RE5,
+        SILENCE, LA4, FA5, MI5, REs5,
+        RE5, FA4, MI4, REs4,
+        RE4, DO4, SI3, DO4,
+        SOL4, SI4, RE5,
+        SILENCE, DO5, LA4, DO5,
+        RE5, FA4, MI4, DO4,
+        RE4, SI3, DO4, RE4,
+        SOL4, SI4, RE5},
+    .durations = {
+        D100, D400, D400, D200, D100, D100, D400,
+        D400, D400, D133, D133, D134, D133, D133, D134,
+        D600, D200, D800,
+        D400, D400, D600, D100, D100,
+        D800, D600, D100, D100,
+        D800, D266, D267, D267,
+        D600, D200, D800,
+        D800, D266, D267, D267,
+        D800, D266, D267, D267,
+        D1000, D200, D200, D200,
+        D600, D200, D800},
+    .name = POKEMON_MAIN_NAME};
 
 /**
  * @brief Pokemon Main struct.
@@ -496,78 +492,71 @@ static const uint16_t pokemon_main_durations[POKEMON_MAIN_LENGTH] = {
  * This struct contains the information of the Pokemon Main.
  * It is used to play the melody using the buzzer.
  */
-const melody_t pokemon_main = {.p_name = "Pokemon Main",
-                               .p_notes = (double *)pokemon_main_notes,
-                               .p_durations = (uint16_t *)pokemon_main_durations,
-                               .melody_length = POKEMON_MAIN_LENGTH};
+const melody_t pokemon_main = MELODY_FROM_BLOB(pokemon_main_blob, melody_durations);
 
 // Halloween Theme
 
 #define HALLOWEEN_THEME_LENGTH 241   /*!< Halloween Theme melody length */
+#define HALLOWEEN_THEME_NAME "Halloween Theme" /*!< Halloween Theme melody name */
 
 /**
- * @brief Halloween Theme notes.
+ * @brief Halloween Theme blob.
  *
- * This array contains the frequencies of the notes for the Halloween Theme song.
- * The notes are defined as frequency values in Hertz, and they are arranged in the order they are played in the song.
- */
-static const double halloween_theme_notes[HALLOWEEN_THEME_LENGTH] = {
-    SILENCE, DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5, 
-    DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5, 
-    DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5, 
-    DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5, 
-    DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5, 
-    DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5, 
-    DO6, FA5, FA5, DO6, FA5, FA5, DO6, FA5, DOs6, FA5, 
-    DO6, FA5, FA5, DO6, FA5, FA5, DO6, FA5, DOs6, FA5, 
-    DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5, 
-    DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5, 
-    DO6, FA5, FA5, DO6, FA5, FA5, DO6, FA5, DOs6, FA5, 
-    DO6, FA5, FA5, DO6, FA5, FA5, DO6, FA5, DOs6, FA5, 
-    SI5, MI5, MI5, SI5, MI5, MI5, SI5, MI5, DO6, MI5, 
-    SI5, MI5, MI5, SI5, MI5, MI5, SI5, MI5, DO6, MI5, 
-    LAs5, REs5, REs5, LAs5, REs5, REs5, LAs5, REs5, SI5, REs5, 
-    LAs5, REs5, REs5, LAs5, REs5, REs5, LAs5, REs5, SI5, REs5, 
-    SI5, MI5, MI5, SI5, MI5, MI5, SI5, MI5, DO6, MI5, 
-    SI5, MI5, MI5, SI5, MI5, MI5, SI5, MI5, DO6, MI5, 
-    LAs5, REs5, REs5, LAs5, REs5, REs5, LAs5, REs5, SI5, REs5, 
-    LAs5, REs5, REs5, LAs5, REs5, REs5, LAs5, REs5, SI5, REs5, 
-    FAs5, SI5, SI5, FAs5, SI5, SI5, FAs5, SI5, SOL5, SI5, 
-    FAs5, SI5, SI5, FAs5, SI5, SI5, FAs5, SI5, SOL5, SI5, 
-    FAs5, SI5, SI5, FAs5, SI5, SI5, FAs5, SI5, SOL5, SI5, 
-    FAs5, SI5, SI5, FAs5, SI5, SI5, FAs5, SI5, SOL5, SI5};
-
-/**
- * @brief Halloween Theme durations in miliseconds.
- * 
- * This array contains the duration of each note in the Halloween Theme song.
- * The durations are defined in milliseconds, and they are arranged in the order they are played in the song.
- */
-static const uint16_t halloween_theme_durations[HALLOWEEN_THEME_LENGTH] = {
-    100, 200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 
-    200, 200, 200, 200, 200, 200, 200, 200, 200, 200};
+ * This blob contains the notes, the duration indexes (see `enum DURATIONS`) and the name of the Halloween Theme song.
+ * The notes are defined as note numbers (see `enum NOTES`), and they are arranged in the order they are played in the song.
+ */
+static const MELODY_BLOB_T(HALLOWEEN_THEME_LENGTH, HALLOWEEN_THEME_NAME) halloween_theme_blob = {
+    .notes = {
+        SILENCE, DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5,
+        DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5,
+        DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5,
+        DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5,
+        DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5,
+        DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5,
+        DO6, FA5, FA5, DO6, FA5, FA5, DO6, FA5, DOs6, FA5,
+        DO6, FA5, FA5, DO6, FA5, FA5, DO6, FA5, DOs6, FA5,
+        DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5,
+        DOs6, FAs5, FAs5, DOs6, FAs5, FAs5, DOs6, FAs5, RE6, FAs5,
+        DO6, FA5, FA5, DO6, FA5, FA5, DO6, FA5, DOs6, FA5,
+        DO6, FA5, FA5, DO6, FA5, FA5, DO6, FA5, DOs6, FA5,
+        SI5, MI5, MI5, SI5, MI5, MI5, SI5, MI5, DO6, MI5,
+        SI5, MI5, MI5, SI5, MI5, MI5, SI5, MI5, DO6, MI5,
+        LAs5, REs5, REs5, LAs5, REs5, REs5, LAs5, REs5, SI5, REs5,
+        LAs5, REs5, REs5, LAs5, REs5, REs5, LAs5, REs5, SI5, REs5,
+        SI5, MI5, MI5, SI5, MI5, MI5, SI5, MI5, DO6, MI5,
+        SI5, MI5, MI5, SI5, MI5, MI5, SI5, MI5, DO6, MI5,
+        LAs5, REs5, REs5, LAs5, REs5, REs5, LAs5, REs5, SI5, REs5,
+        LAs5, REs5, REs5, LAs5, REs5, REs5, LAs5, REs5, SI5, REs5,
+        FAs5, SI5, SI5, FAs5, SI5, SI5, FAs5, SI5, SOL5, SI5,
+        FAs5, SI5, SI5, FAs5, SI5, SI5, FAs5, SI5, SOL5, SI5,
+        FAs5, SI5, SI5, FAs5, SI5, SI5, FAs5, SI5, SOL5, SI5,
+        FAs5, SI5, SI5, FAs5, SI5, SI5, FAs5, SI5, SOL5, SI5},
+    .durations = {
+        D100, D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200,
+        D200, D200, D200, D200, D200, D200, D200, D200, D200, D200},
+    .name = HALLOWEEN_THEME_NAME};
 
 /**
  * @brief Halloween Theme struct.
@@ -575,7 +564,102 @@ static const uint16_t halloween_theme_durations[HALLOWEEN_THEME_LENGTH] = {
  * This struct contains the information of the Halloween Theme.
  * It is used to play the melody using the buzzer.
  */
-const melody_t halloween_theme = {.p_name = "Halloween Theme",
-                               .p_notes = (double *)halloween_theme_notes,
-                               .p_durations = (uint16_t *)halloween_theme_durations,
-                               .melody_length = HALLOWEEN_THEME_LENGTH};
\ No newline at end of file
+const melody_t halloween_theme = MELODY_FROM_BLOB(halloween_theme_blob, melody_durations);
+
+/* Catalog ------------------------------------------------------------------*/
+/**
+ * @brief Table of pointers to all the melodies, in the order shown by the jukebox.
+ *
+ * To add a melody to the jukebox, define it above and add it here, or compile it with `tools/melody_compiler.py --catalog`
+ * and link the file: its melodies are listed after these ones.
+ */
+static const melody_t *const catalog_melodies[] = {
+    &scale_melody,
+    &tetris_melody,
+    &happy_birthday_melody,
+    &march_of_the_toreadors,
+    &careless_whispers,
+    &legend_of_zelda_main,
+    &imperial_march,
+    &mario_bros_main,
+    &pokemon_main,
+    &halloween_theme,
+    &outro,
+};
+
+// Weak: if no file generated with --catalog is linked, its address is NULL
+extern const melody_catalog_t melodies_generated __attribute__((weak));
+
+const melody_catalog_t melodies_catalog = {
+    .p_melodies = catalog_melodies,
+    .count = sizeof(catalog_melodies) / sizeof(catalog_melodies[0]),
+    .p_generated = &melodies_generated,
+    .p_pool = &melody_pool,
+};
+
+/* Public functions -----------------------------------------------------------*/
+uint16_t melody_get_length(const melody_t *p_melody)
+{
+    return p_melody->melody_length;
+}
+
+const char *melody_get_name(const melody_t *p_melody)
+{
+    return (const char *)(p_melody->p_data + p_melody->name_offset);
+}
+
+uint8_t melody_get_note(const melody_t *p_melody, uint32_t index)
+{
+    return p_melody->p_data[index];
+}
+
+uint16_t melody_get_duration(const melody_t *p_melody, uint32_t index)
+{
+    return p_melody->p_durations[p_melody->p_data[p_melody->melody_length + index]];
+}
+
+uint32_t melody_catalog_get_flash_count(const melody_catalog_t *p_catalog)
+{
+    if (p_catalog->p_generated == NULL)
+    {
+        return p_catalog->count;
+    }
+    return p_catalog->count + melody_catalog_get_count(p_catalog->p_generated);
+}
+
+uint32_t melody_catalog_get_count(const melody_catalog_t *p_catalog)
+{
+    if (p_catalog->p_pool == NULL)
+    {
+        return melody_catalog_get_flash_count(p_catalog);
+    }
+    return melody_catalog_get_flash_count(p_catalog) + melody_pool_get_count(p_catalog->p_pool);
+}
+
+const melody_t *melody_catalog_get(const melody_catalog_t *p_catalog, uint32_t index)
+{
+    // 1. The table
+    if (index < p_catalog->count)
+    {
+        return p_catalog->p_melodies[index];
+    }
+    index -= p_catalog->count;
+
+    // 2. The generated catalog
+    if (p_catalog->p_generated != NULL)
+    {
+        uint32_t generated_count = melody_catalog_get_count(p_catalog->p_generated);
+        if (index < generated_count)
+        {
+            return melody_catalog_get(p_catalog->p_generated, index);
+        }
+        index -= generated_count;
+    }
+
+    // 3. The pool
+    if (p_catalog->p_pool == NULL)
+    {
+        return NULL;
+    }
+    return melody_pool_get(p_catalog->p_pool, index);
+}
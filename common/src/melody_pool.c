@@ -0,0 +1,248 @@
+/**
+ * @file melody_pool.c
+ * @brief Pool of melodies uploaded at run time.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-03
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C libraries */
+#include <stddef.h> // NULL
+#include <string.h> // memmove, memcpy
+#include <stdio.h>  // snprintf
+
+/* Other libraries */
+#include "melody_pool.h"
+
+/* Defines ------------------------------------------------------------------*/
+#define MELODY_POOL_BYTES_PER_NOTE 3 /*!< Bytes of each note in an upload: note and duration (2 bytes) */
+
+/* Global variables ------------------------------------------------------------*/
+melody_pool_t melody_pool;
+
+/* Private functions */
+/**
+ * @brief Get the address of the first free byte of the arena, where the upload in progress is stored.
+ *
+ * @param p_pool pointer to the pool.
+ * @return uint8_t* pointer to the first free byte.
+ */
+static uint8_t *_get_free_start(melody_pool_t *p_pool)
+{
+    return (uint8_t *)p_pool->arena + p_pool->used;
+}
+
+/**
+ * @brief Get the worst case size of a melody in the arena.
+ *
+ * @param melody_length number of notes of the melody.
+ * @return uint32_t bytes.
+ */
+static uint32_t _get_max_size(uint32_t melody_length)
+{
+    uint32_t durations = melody_length < MELODY_POOL_MAX_DURATIONS ? melody_length : MELODY_POOL_MAX_DURATIONS;
+    return 2 * melody_length + MELODY_POOL_NAME_LENGTH + 1 + 2 * durations;
+}
+
+/**
+ * @brief Get the index of a duration in the table of the upload, adding it if it is new.
+ *
+ * @param p_pool pointer to the pool.
+ * @param duration duration in milliseconds.
+ * @return int32_t index of the duration, or -1 if the table is full.
+ */
+static int32_t _get_duration_index(melody_pool_t *p_pool, uint16_t duration)
+{
+    for (uint32_t i = 0; i < p_pool->load_durations_count; i++)
+    {
+        if (p_pool->load_durations[i] == duration)
+        {
+            return i;
+        }
+    }
+    if (p_pool->load_durations_count >= MELODY_POOL_MAX_DURATIONS)
+    {
+        return -1;
+    }
+    p_pool->load_durations[p_pool->load_durations_count] = duration;
+    return p_pool->load_durations_count++;
+}
+
+/**
+ * @brief Finish the upload: store the name and the table of durations, and add the melody to the pool.
+ *
+ * > 1. Terminate the name, giving a default one if it is empty \n
+ * > 2. Copy the table of durations after the name, aligned to 2 bytes \n
+ * > 3. Fill the header of the melody and take its space from the arena \n
+ *
+ * @param p_pool pointer to the pool.
+ */
+static void _load_end(melody_pool_t *p_pool)
+{
+    uint8_t *p_slot = _get_free_start(p_pool);
+    uint32_t length = p_pool->load_length;
+    char *p_name = (char *)(p_slot + 2 * length);
+
+    // 1.
+    if (p_pool->load_name_length == 0)
+    {
+        p_pool->load_name_length = snprintf(p_name, MELODY_POOL_NAME_LENGTH, "User melody %lu", (unsigned long)p_pool->count);
+    }
+    p_name[p_pool->load_name_length] = '\0';
+
+    // 2.
+    uint32_t durations_offset = (2 * length + p_pool->load_name_length + 1 + 1) & ~1UL;
+    memcpy(p_slot + durations_offset, p_pool->load_durations, 2 * p_pool->load_durations_count);
+
+    // 3.
+    melody_t *p_melody = &p_pool->melodies[p_pool->count];
+    p_melody->melody_length = length;
+    p_melody->name_offset = 2 * length;
+    p_melody->p_data = p_slot;
+    p_melody->p_durations = (const uint16_t *)(p_slot + durations_offset);
+    p_pool->sizes[p_pool->count] = durations_offset + 2 * p_pool->load_durations_count;
+    p_pool->used += p_pool->sizes[p_pool->count];
+    p_pool->count++;
+    p_pool->loading = false;
+}
+
+/* Public functions */
+uint32_t melody_pool_get_count(const melody_pool_t *p_pool)
+{
+    return p_pool->count;
+}
+
+const melody_t *melody_pool_get(const melody_pool_t *p_pool, uint32_t index)
+{
+    if (index >= p_pool->count)
+    {
+        return NULL;
+    }
+    return &p_pool->melodies[index];
+}
+
+uint32_t melody_pool_get_free(const melody_pool_t *p_pool)
+{
+    return MELODY_POOL_SIZE - p_pool->used;
+}
+
+bool melody_pool_load_begin(melody_pool_t *p_pool, uint32_t melody_length)
+{
+    if (p_pool->loading || melody_length == 0 || melody_length > UINT16_MAX / 2 || p_pool->count >= MELODY_POOL_MAX_MELODIES ||
+        _get_max_size(melody_length) > melody_pool_get_free(p_pool))
+    {
+        return false;
+    }
+    p_pool->loading = true;
+    p_pool->load_length = melody_length;
+    p_pool->load_name_done = false;
+    p_pool->load_name_length = 0;
+    p_pool->load_byte_idx = 0;
+    p_pool->load_durations_count = 0;
+    return true;
+}
+
+uint32_t melody_pool_load_data(melody_pool_t *p_pool, const uint8_t *p_data, uint32_t length, uint32_t *p_used)
+{
+    uint8_t *p_slot = _get_free_start(p_pool);
+    uint32_t notes_bytes = MELODY_POOL_BYTES_PER_NOTE * p_pool->load_length;
+    uint32_t i = 0;
+
+    while (i < length && p_pool->loading)
+    {
+        uint8_t byte = p_data[i++];
+
+        // Name
+        if (!p_pool->load_name_done)
+        {
+            if (byte == MELODY_POOL_NAME_END)
+            {
+                p_pool->load_name_done = true;
+            }
+            else if (p_pool->load_name_length < MELODY_POOL_NAME_LENGTH - 1) // Longer names are cut
+            {
+                p_slot[2 * p_pool->load_length + p_pool->load_name_length++] = byte;
+            }
+            continue;
+        }
+
+        // Notes: note, duration low byte, duration high byte
+        uint32_t note_idx = p_pool->load_byte_idx / MELODY_POOL_BYTES_PER_NOTE;
+        switch (p_pool->load_byte_idx % MELODY_POOL_BYTES_PER_NOTE)
+        {
+        case 0:
+            if (byte != SILENCE && (byte < NOTE_LOWEST || byte > NOTE_HIGHEST))
+            {
+                melody_pool_load_abort(p_pool);
+                *p_used = i;
+                return MELODY_POOL_LOAD_ERROR;
+            }
+            p_slot[note_idx] = byte;
+            break;
+        case 1:
+            p_pool->load_duration = byte;
+            break;
+        default:
+        {
+            int32_t duration_idx = _get_duration_index(p_pool, p_pool->load_duration | (byte << 8));
+            if (duration_idx < 0)
+            {
+                melody_pool_load_abort(p_pool);
+                *p_used = i;
+                return MELODY_POOL_LOAD_ERROR;
+            }
+            p_slot[p_pool->load_length + note_idx] = duration_idx;
+            break;
+        }
+        }
+
+        if (++p_pool->load_byte_idx == notes_bytes)
+        {
+            _load_end(p_pool);
+            *p_used = i;
+            return MELODY_POOL_LOAD_DONE;
+        }
+    }
+    *p_used = i;
+    return MELODY_POOL_LOAD_BUSY;
+}
+
+void melody_pool_load_abort(melody_pool_t *p_pool)
+{
+    p_pool->loading = false;
+}
+
+bool melody_pool_is_loading(const melody_pool_t *p_pool)
+{
+    return p_pool->loading;
+}
+
+bool melody_pool_delete(melody_pool_t *p_pool, uint32_t index)
+{
+    // The upload in progress is stored after the last melody, so it would be moved too
+    if (index >= p_pool->count || p_pool->loading)
+    {
+        return false;
+    }
+
+    // 1. Move the bytes of the following melodies over the deleted one
+    uint8_t *p_start = (uint8_t *)p_pool->melodies[index].p_data;
+    uint32_t size = p_pool->sizes[index];
+    uint8_t *p_end = (uint8_t *)p_pool->arena + p_pool->used;
+    memmove(p_start, p_start + size, p_end - (p_start + size));
+
+    // 2. Move the headers down and update their addresses. Sizes are even, so the tables of durations stay aligned
+    for (uint32_t i = index; i + 1 < p_pool->count; i++)
+    {
+        p_pool->melodies[i] = p_pool->melodies[i + 1];
+        p_pool->melodies[i].p_data -= size;
+        p_pool->melodies[i].p_durations = (const uint16_t *)((const uint8_t *)p_pool->melodies[i].p_durations - size);
+        p_pool->sizes[i] = p_pool->sizes[i + 1];
+    }
+
+    // 3.
+    p_pool->count--;
+    p_pool->used -= size;
+    return true;
+}
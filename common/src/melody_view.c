@@ -0,0 +1,116 @@
+/**
+ * @file melody_view.c
+ * @brief Reverse, transposed and tempo scaled views of a melody, read without copying it.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-05
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C libraries */
+#include <stddef.h> // NULL
+
+/* Other libraries */
+#include "melody_view.h"
+
+/* Private functions */
+/**
+ * @brief Transpose a note, moving it back into DO3..SI6 by octaves if needed. Silences are not transposed.
+ *
+ * @param note note (MIDI note number or SILENCE).
+ * @param semitones semitones to add.
+ * @return uint8_t transposed note.
+ */
+static uint8_t _transpose_note(uint8_t note, int32_t semitones)
+{
+    if (note == SILENCE)
+    {
+        return SILENCE;
+    }
+    int32_t transposed = (int32_t)note + semitones;
+    while (transposed < NOTE_LOWEST)
+    {
+        transposed += 12;
+    }
+    while (transposed > NOTE_HIGHEST)
+    {
+        transposed -= 12;
+    }
+    return (uint8_t)transposed;
+}
+
+/* Public functions */
+uint32_t melody_view_get_duration_scale(uint32_t factor)
+{
+    return (uint32_t)(((1ULL << (16 + MELODY_VIEW_SCALE_SHIFT)) + factor / 2) / factor);
+}
+
+uint32_t melody_view_scale_duration(uint32_t duration_us, uint32_t duration_scale)
+{
+    // The product needs 64 bits, but it is a single UMULL. It can't overflow them, but the result can go over 32 bits
+    uint64_t scaled = ((uint64_t)duration_us * duration_scale + (1U << (MELODY_VIEW_SCALE_SHIFT - 1))) >> MELODY_VIEW_SCALE_SHIFT;
+    return (scaled > UINT32_MAX) ? UINT32_MAX : (uint32_t)scaled;
+}
+
+void melody_view_init(melody_view_t *p_view, const melody_t *p_melody)
+{
+    p_view->p_melody = p_melody;
+    p_view->reverse = false;
+    p_view->transpose = 0;
+    melody_view_set_tempo(p_view, MELODY_VIEW_TEMPO_ONE);
+}
+
+void melody_view_set_tempo(melody_view_t *p_view, uint32_t tempo)
+{
+    if (tempo < MELODY_VIEW_TEMPO_MIN)
+    {
+        tempo = MELODY_VIEW_TEMPO_MIN;
+    }
+    if (tempo > MELODY_VIEW_TEMPO_MAX)
+    {
+        tempo = MELODY_VIEW_TEMPO_MAX;
+    }
+    p_view->tempo = tempo;
+    p_view->duration_scale = melody_view_get_duration_scale(tempo);
+}
+
+void melody_view_set_transpose(melody_view_t *p_view, int32_t semitones)
+{
+    if (semitones > MELODY_VIEW_TRANSPOSE_MAX)
+    {
+        semitones = MELODY_VIEW_TRANSPOSE_MAX;
+    }
+    if (semitones < -MELODY_VIEW_TRANSPOSE_MAX)
+    {
+        semitones = -MELODY_VIEW_TRANSPOSE_MAX;
+    }
+    p_view->transpose = (int8_t)semitones;
+}
+
+void melody_iterator_init(melody_iterator_t *p_iterator, const melody_view_t *p_view)
+{
+    p_iterator->p_view = p_view;
+    p_iterator->index = 0;
+}
+
+bool melody_iterator_has_next(const melody_iterator_t *p_iterator)
+{
+    const melody_t *p_melody = p_iterator->p_view->p_melody;
+    return (p_melody != NULL && p_iterator->index < melody_get_length(p_melody));
+}
+
+void melody_iterator_next(melody_iterator_t *p_iterator, uint8_t *p_note, uint32_t *p_duration_us)
+{
+    const melody_view_t *p_view = p_iterator->p_view;
+    uint32_t index = p_iterator->index++;
+    if (p_view->reverse)
+    {
+        index = melody_get_length(p_view->p_melody) - 1 - index;
+    }
+
+    *p_note = _transpose_note(melody_get_note(p_view->p_melody, index), p_view->transpose);
+
+    // ms -> us, then scaled by 1/tempo and rounded
+    uint32_t duration_ms = melody_get_duration(p_view->p_melody, index);
+    *p_duration_us = melody_view_scale_duration(duration_ms * 1000U, p_view->duration_scale);
+}
@@ -0,0 +1,156 @@
+/**
+ * @file packet.c
+ * @brief Binary packets framed with COBS and checked with a CRC16.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-17
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C libraries */
+#include <string.h> // memcpy
+
+/* Other libraries */
+#include "packet.h"
+
+/* Private variables */
+/**
+ * @brief CRC16 of each value of a nibble, so the CRC takes two lookups per byte instead of eight shifts, in 32 bytes of flash.
+ */
+static const uint16_t crc16_nibble_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+/* Public functions */
+uint16_t packet_crc16(const uint8_t *p_data, uint32_t length, uint16_t crc)
+{
+    for (uint32_t i = 0; i < length; i++)
+    {
+        crc = (crc << 4) ^ crc16_nibble_table[(crc >> 12) ^ (p_data[i] >> 4)];
+        crc = (crc << 4) ^ crc16_nibble_table[(crc >> 12) ^ (p_data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+uint32_t packet_cobs_encode(const uint8_t *p_data, uint32_t length, uint8_t *p_out)
+{
+    // Each code is the distance to the next delimiter, or 0xFF for 254 bytes with no delimiter
+    uint32_t code_idx = 0;
+    uint32_t out_idx = 1;
+    uint8_t code = 1;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        if (p_data[i] != PACKET_DELIMITER)
+        {
+            p_out[out_idx++] = p_data[i];
+            code++;
+        }
+        if (p_data[i] == PACKET_DELIMITER || code == 0xFF)
+        {
+            p_out[code_idx] = code;
+            code_idx = out_idx++;
+            code = 1;
+        }
+    }
+    p_out[code_idx] = code;
+    return out_idx;
+}
+
+bool packet_cobs_decode(const uint8_t *p_data, uint32_t length, uint8_t *p_out, uint32_t size, uint32_t *p_length)
+{
+    uint32_t out_idx = 0;
+    uint32_t i = 0;
+    while (i < length)
+    {
+        uint8_t code = p_data[i++];
+        if (code == PACKET_DELIMITER || i + code - 1 > length || out_idx + code - 1 > size)
+        {
+            return false;
+        }
+        memcpy(p_out + out_idx, p_data + i, code - 1);
+        out_idx += code - 1;
+        i += code - 1;
+
+        // The delimiter removed, unless the block was a full one or the last one
+        if (code != 0xFF && i < length)
+        {
+            if (out_idx >= size)
+            {
+                return false;
+            }
+            p_out[out_idx++] = PACKET_DELIMITER;
+        }
+    }
+    *p_length = out_idx;
+    return true;
+}
+
+bool packet_decode(const uint8_t *p_frame, uint32_t length, packet_t *p_packet)
+{
+    uint8_t data[PACKET_MAX_LENGTH];
+    uint32_t data_length;
+    if (!packet_cobs_decode(p_frame, length, data, sizeof(data), &data_length) || data_length < PACKET_HEADER_LENGTH + PACKET_CRC_LENGTH)
+    {
+        return false;
+    }
+    uint32_t crc_idx = data_length - PACKET_CRC_LENGTH;
+    if (packet_crc16(data, crc_idx, PACKET_CRC_INIT) != (data[crc_idx] | (data[crc_idx + 1] << 8)))
+    {
+        return false;
+    }
+    p_packet->opcode = data[0];
+    p_packet->id = data[1];
+    p_packet->length = crc_idx - PACKET_HEADER_LENGTH;
+    memcpy(p_packet->payload, data + PACKET_HEADER_LENGTH, p_packet->length);
+    return true;
+}
+
+uint32_t packet_encode(const packet_t *p_packet, uint8_t *p_frame)
+{
+    uint8_t data[PACKET_MAX_LENGTH];
+    uint32_t length = PACKET_HEADER_LENGTH + p_packet->length;
+    data[0] = p_packet->opcode;
+    data[1] = p_packet->id;
+    memcpy(data + PACKET_HEADER_LENGTH, p_packet->payload, p_packet->length);
+    uint16_t crc = packet_crc16(data, length, PACKET_CRC_INIT);
+    data[length++] = crc & 0xFF;
+    data[length++] = crc >> 8;
+
+    // A delimiter before the frame too, so the receiver drops whatever came before it
+    p_frame[0] = PACKET_DELIMITER;
+    length = 1 + packet_cobs_encode(data, length, p_frame + 1);
+    p_frame[length++] = PACKET_DELIMITER;
+    return length;
+}
+
+bool packet_put_u8(packet_t *p_packet, uint8_t value)
+{
+    if (p_packet->length >= PACKET_MAX_PAYLOAD)
+    {
+        return false;
+    }
+    p_packet->payload[p_packet->length++] = value;
+    return true;
+}
+
+bool packet_put_u16(packet_t *p_packet, uint16_t value)
+{
+    if (p_packet->length + 2 > PACKET_MAX_PAYLOAD)
+    {
+        return false;
+    }
+    p_packet->payload[p_packet->length++] = value & 0xFF;
+    p_packet->payload[p_packet->length++] = value >> 8;
+    return true;
+}
+
+bool packet_get_u16(const packet_t *p_packet, uint32_t offset, uint16_t *p_value)
+{
+    if (offset + 2 > p_packet->length)
+    {
+        return false;
+    }
+    *p_value = p_packet->payload[offset] | (p_packet->payload[offset + 1] << 8);
+    return true;
+}
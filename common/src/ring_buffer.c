@@ -0,0 +1,159 @@
+/**
+ * @file ring_buffer.c
+ * @brief Lock-free ring buffers for one producer and one consumer, to pass data and events from the ISRs to the FSMs.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-12
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C libraries */
+#include <stddef.h> // NULL
+#include <string.h> // memcpy
+
+/* Other libraries */
+#include "ring_buffer.h"
+
+/* Private functions */
+/**
+ * @brief Get the address of the element of a position.
+ *
+ * @param p_ring pointer to the ring buffer.
+ * @param position position counted from the start (`head` or `tail` plus an offset).
+ * @return uint8_t* address of the element in the storage.
+ */
+static uint8_t *_get_element(const ring_buffer_t *p_ring, uint32_t position)
+{
+    return p_ring->p_storage + (position & p_ring->mask) * p_ring->element_size;
+}
+
+/* Public functions */
+bool ring_buffer_init(ring_buffer_t *p_ring, void *p_storage, uint32_t element_size, uint32_t capacity)
+{
+    if (!RING_BUFFER_IS_POWER_OF_TWO(capacity))
+    {
+        return false;
+    }
+    p_ring->p_storage = p_storage;
+    p_ring->element_size = element_size;
+    p_ring->mask = capacity - 1;
+    atomic_init(&p_ring->head, 0);
+    atomic_init(&p_ring->tail, 0);
+    p_ring->dropped = 0;
+    return true;
+}
+
+bool ring_buffer_push(ring_buffer_t *p_ring, const void *p_element)
+{
+    uint32_t head = atomic_load_explicit(&p_ring->head, memory_order_relaxed); // Only written here
+    uint32_t tail = atomic_load_explicit(&p_ring->tail, memory_order_acquire); // The consumer has finished with the element
+    if (head - tail > p_ring->mask)
+    {
+        p_ring->dropped++;
+        return false;
+    }
+    memcpy(_get_element(p_ring, head), p_element, p_ring->element_size);
+    atomic_store_explicit(&p_ring->head, head + 1, memory_order_release); // Publish the element
+    return true;
+}
+
+uint32_t ring_buffer_get_free_span(ring_buffer_t *p_ring, void **pp_element)
+{
+    uint32_t head = atomic_load_explicit(&p_ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&p_ring->tail, memory_order_acquire);
+    uint32_t free = p_ring->mask + 1 - (head - tail);
+    uint32_t first = head & p_ring->mask;
+    uint32_t span = p_ring->mask + 1 - first; // Up to the end of the storage
+    *pp_element = p_ring->p_storage + first * p_ring->element_size;
+    return (free < span) ? free : span;
+}
+
+bool ring_buffer_produce(ring_buffer_t *p_ring, uint32_t count)
+{
+    uint32_t head = atomic_load_explicit(&p_ring->head, memory_order_relaxed) + count;
+    uint32_t tail = atomic_load_explicit(&p_ring->tail, memory_order_acquire);
+    atomic_store_explicit(&p_ring->head, head, memory_order_release);
+    if (head - tail > p_ring->mask + 1)
+    {
+        p_ring->dropped += head - tail - (p_ring->mask + 1);
+        return false;
+    }
+    return true;
+}
+
+bool ring_buffer_peek(ring_buffer_t *p_ring, uint32_t index, void *p_element)
+{
+    uint32_t tail = atomic_load_explicit(&p_ring->tail, memory_order_relaxed); // Only written by the consumer
+    uint32_t head = atomic_load_explicit(&p_ring->head, memory_order_acquire); // The elements are already there
+    if (index >= head - tail)
+    {
+        return false;
+    }
+    memcpy(p_element, _get_element(p_ring, tail + index), p_ring->element_size);
+    return true;
+}
+
+bool ring_buffer_pop(ring_buffer_t *p_ring, void *p_element)
+{
+    uint32_t tail = atomic_load_explicit(&p_ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&p_ring->head, memory_order_acquire);
+    if (head == tail)
+    {
+        return false;
+    }
+    if (p_element != NULL)
+    {
+        memcpy(p_element, _get_element(p_ring, tail), p_ring->element_size);
+    }
+    atomic_store_explicit(&p_ring->tail, tail + 1, memory_order_release); // Give the slot back to the producer
+    return true;
+}
+
+uint32_t ring_buffer_get_span(ring_buffer_t *p_ring, uint32_t index, void **pp_element)
+{
+    uint32_t tail = atomic_load_explicit(&p_ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&p_ring->head, memory_order_acquire);
+    uint32_t count = head - tail;
+    if (index >= count)
+    {
+        return 0;
+    }
+    uint32_t first = (tail + index) & p_ring->mask;
+    uint32_t span = p_ring->mask + 1 - first; // Up to the end of the storage
+    *pp_element = p_ring->p_storage + first * p_ring->element_size;
+    return (count - index < span) ? (count - index) : span;
+}
+
+void ring_buffer_consume(ring_buffer_t *p_ring, uint32_t count)
+{
+    uint32_t tail = atomic_load_explicit(&p_ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&p_ring->head, memory_order_acquire);
+    if (count > head - tail)
+    {
+        count = head - tail;
+    }
+    atomic_store_explicit(&p_ring->tail, tail + count, memory_order_release);
+}
+
+void ring_buffer_discard(ring_buffer_t *p_ring)
+{
+    uint32_t head = atomic_load_explicit(&p_ring->head, memory_order_acquire);
+    atomic_store_explicit(&p_ring->tail, head, memory_order_release);
+}
+
+uint32_t ring_buffer_get_count(ring_buffer_t *p_ring)
+{
+    uint32_t tail = atomic_load_explicit(&p_ring->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&p_ring->head, memory_order_acquire);
+    return head - tail;
+}
+
+bool ring_buffer_is_empty(ring_buffer_t *p_ring)
+{
+    return ring_buffer_get_count(p_ring) == 0;
+}
+
+uint32_t ring_buffer_get_dropped(const ring_buffer_t *p_ring)
+{
+    return p_ring->dropped;
+}
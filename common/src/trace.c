@@ -0,0 +1,76 @@
+/**
+ * @file trace.c
+ * @brief Deferred binary trace: the FSMs store an ID and its arguments in RAM and the main loop sends them through the ITM
+ * when it is idle, instead of formatting text with printf() and waiting for the ITM one character at a time.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-17
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C libraries */
+#include <stddef.h> // NULL
+
+/* Other libraries */
+#include "trace.h"
+#include "ring_buffer.h"
+#include "port_system.h"
+
+/* Global variables -----------------------------------------------------------*/
+static trace_record_t trace_storage[TRACE_RING_LENGTH]; /*!< Storage of the records not sent yet */
+static ring_buffer_t trace_ring;        /*!< Records not sent yet. Produced by trace_emit() and consumed by trace_drain() */
+static uint16_t trace_sequence = 0;     /*!< Sequence number of the next record, also counting the dropped ones */
+static uint32_t trace_dropped = 0;      /*!< Records dropped because the ring was full */
+static uint32_t trace_word_index = 0;   /*!< Words of the oldest record already sent */
+
+/* Public functions */
+void trace_init(void)
+{
+    ring_buffer_init(&trace_ring, trace_storage, sizeof(trace_record_t), TRACE_RING_LENGTH);
+    trace_sequence = 0;
+    trace_dropped = 0;
+    trace_word_index = 0;
+}
+
+bool trace_emit(uint32_t id, uint32_t arg0, uint32_t arg1)
+{
+    trace_record_t *p_record;
+    uint32_t sequence = trace_sequence++;
+    if (ring_buffer_get_free_span(&trace_ring, (void **)&p_record) == 0)
+    {
+        trace_dropped++;
+        return false;
+    }
+
+    // Written in place: the record is only seen by trace_drain() once it is produced
+    p_record->header = (id & 0xFFFF) | (sequence << 16);
+    p_record->cycles = port_system_get_cycles();
+    p_record->args[0] = arg0;
+    p_record->args[1] = arg1;
+    ring_buffer_produce(&trace_ring, 1);
+    return true;
+}
+
+bool trace_drain(uint32_t max_records)
+{
+    trace_record_t *p_record;
+    for (uint32_t i = 0; i < max_records && ring_buffer_get_span(&trace_ring, 0, (void **)&p_record) > 0; i++)
+    {
+        // 1. The words of the record that fit in the FIFO of the ITM
+        trace_word_index += port_system_trace_write(&p_record->header + trace_word_index, TRACE_RECORD_WORDS - trace_word_index);
+        if (trace_word_index < TRACE_RECORD_WORDS)
+        {
+            return false;
+        }
+
+        // 2. The record has been sent completely
+        trace_word_index = 0;
+        ring_buffer_consume(&trace_ring, 1);
+    }
+    return ring_buffer_is_empty(&trace_ring);
+}
+
+uint32_t trace_get_dropped(void)
+{
+    return trace_dropped;
+}
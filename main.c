@@ -21,6 +21,8 @@
 #include "melodies.h"
 #include <string.h>
 #include "fsm_jukebox.h"
+#include "fsm_index.h"
+#include "trace.h"
 
 // v5
 #include "fsm_keypad.h"
@@ -30,6 +32,23 @@
 #define ON_OFF_PRESS_TIME_MS 1000
 #define NEXT_SONG_BUTTON_TIME_MS 500
 
+/* Private functions ---------------------------------------------------------*/
+/**
+ * @brief Fires a FSM. If it changes its state, its event is posted again, because the new state may have a transition ready.
+ * 
+ * @param p_fsm pointer to the FSM
+ * @param event `SYSTEM_EVENT_*` bit of the FSM
+ */
+static void _fire(fsm_t *p_fsm, uint32_t event)
+{
+    int state = p_fsm->current_state;
+    fsm_index_fire(p_fsm);
+    if (p_fsm->current_state != state)
+    {
+        port_system_event_post(event);
+    }
+}
+
 
 /**
  * @brief  The application entry point.
@@ -39,6 +58,7 @@ int main(void)
 {
     /* Init board */
     port_system_init();
+    trace_init();
 
     /* Creation of the button */
     fsm_t *p_fsm_user_button = fsm_button_new(BUTTON_0_DEBOUNCE_TIME_MS, BUTTON_0_ID);
@@ -56,15 +76,46 @@ int main(void)
     fsm_t *p_fsm_jukebox = fsm_jukebox_new(p_fsm_user_button, ON_OFF_PRESS_TIME_MS, p_fsm_usart, p_fsm_buzzer, NEXT_SONG_BUTTON_TIME_MS, /* v5 */ p_fsm_keypad);
 
     /* Infinite loop */
+#if MAIN_EVENT_LOOP
+    /* The ISRs and the FSM actions post events. The jukebox reads the outputs of all the other FSMs, so it is fired
+       whenever any of them is */
+    port_system_event_post(SYSTEM_EVENT_ALL);
+    while (1)
+    {
+        uint32_t events = port_system_event_take();
+        if (events == 0)
+        {
+            /* The trace is only sent when there is nothing else to do, and the CPU sleeps once it has been sent */
+            if (trace_drain(TRACE_DRAIN_RECORDS))
+            {
+                port_system_event_wait();
+            }
+            continue;
+        }
+        if (events & SYSTEM_EVENT_BUTTON)
+            _fire(p_fsm_user_button, SYSTEM_EVENT_BUTTON);
+        if (events & SYSTEM_EVENT_USART)
+            _fire(p_fsm_usart, SYSTEM_EVENT_USART);
+        if (events & SYSTEM_EVENT_BUZZER)
+            _fire(p_fsm_buzzer, SYSTEM_EVENT_BUZZER);
+        if (events & SYSTEM_EVENT_KEYPAD)
+            _fire(p_fsm_keypad, SYSTEM_EVENT_KEYPAD); //v5
+        _fire(p_fsm_jukebox, SYSTEM_EVENT_JUKEBOX);
+
+    } // End of while(1)
+#else
     while (1)
     {
-        fsm_fire(p_fsm_user_button);
-        fsm_fire(p_fsm_usart);
-        fsm_fire(p_fsm_buzzer);
-        fsm_fire(p_fsm_keypad); //v5
-        fsm_fire(p_fsm_jukebox);
+        port_system_event_take(); // Only to count the iterations
+        fsm_index_fire(p_fsm_user_button);
+        fsm_index_fire(p_fsm_usart);
+        fsm_index_fire(p_fsm_buzzer);
+        fsm_index_fire(p_fsm_keypad); //v5
+        fsm_index_fire(p_fsm_jukebox);
+        trace_drain(TRACE_DRAIN_RECORDS);
 
     } // End of while(1)
+#endif
 
     fsm_destroy(p_fsm_user_button);
     fsm_destroy(p_fsm_usart);
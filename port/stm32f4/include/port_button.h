@@ -18,6 +18,9 @@
 
 /* HW dependent includes */
 
+/* Other includes */
+#include "ring_buffer.h"
+
 /* Defines and enums ----------------------------------------------------------*/
 /* Defines */
 
@@ -25,20 +28,37 @@
 #define BUTTON_0_GPIO GPIOC             /*!< Port of Button GPIO*/
 #define BUTTON_0_PIN 13                 /*!< Pin of Button GPIO*/
 #define BUTTON_0_DEBOUNCE_TIME_MS 150   /*!< Debounce time of the Button*/
+#define BUTTON_EDGES_LENGTH 16          /*!< Edges of the button waiting to be read by the FSM. Power of 2 */
 
 /* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Edge of a button, stored by the EXTI interrupt.
+ * 
+ * @param pressed
+ * @param time_ms
+ */
+typedef struct
+{
+    bool pressed;       /*!< Level after the edge: true if the button has been pressed, false if it has been released */
+    uint32_t time_ms;   /*!< System tick (in ms) of the edge */
+} port_button_edge_t;
+
 /**
  * @brief HW structure of button
  * 
  * @param *p_port
  * @param pin
  * @param flag_pressed
+ * @param edges
+ * @param edges_storage
  */
 typedef struct
 {
     GPIO_TypeDef *p_port;
     uint8_t pin;
-    bool flag_pressed;
+    volatile bool flag_pressed;         /*!< Level of the last edge stored */
+    ring_buffer_t edges;                /*!< Edges from the EXTI interrupt to the FSM, in order */
+    port_button_edge_t edges_storage[BUTTON_EDGES_LENGTH];
 } port_button_hw_t;
 
 /* Global variables */
@@ -62,13 +82,46 @@ extern port_button_hw_t buttons_arr[];
 void port_button_init(uint32_t button_id);
 
 /**
- * @brief return if button is pressed or not pressed
+ * @brief return if button is pressed or not pressed, as of the last edge stored
  * 
  * @param button_id ID of button given
  * @return true if button is pressed
  * @return false if button isn't pressed
  */
 bool port_button_is_pressed(uint32_t button_id);
+
+/**
+ * @brief Store an edge of the button with the current System tick. Called from the EXTI interrupt.
+ * 
+ * An edge to the level of the last edge stored (a bounce faster than the interrupt) is not stored, so pressed and released edges
+ * always alternate. If there is no room for the edge it is dropped, and so is the following one, to keep them alternating.
+ * 
+ * @param button_id ID of button given
+ * @param pressed level read after the edge: true if the button is pressed.
+ */
+void port_button_store_edge(uint32_t button_id, bool pressed);
+
+/**
+ * @brief Read an edge of the button without removing it.
+ * 
+ * @param button_id ID of button given
+ * @param index position of the edge: 0 is the oldest one not removed.
+ * @param p_edge pointer to store the edge.
+ * @return true the edge has been read.
+ * @return false there are not so many edges.
+ */
+bool port_button_peek_edge(uint32_t button_id, uint32_t index, port_button_edge_t *p_edge);
+
+/**
+ * @brief Remove the oldest edge of the button.
+ * 
+ * @param button_id ID of button given
+ * @param p_edge pointer to store the edge, or NULL to discard it.
+ * @return true an edge has been removed.
+ * @return false there are no edges.
+ */
+bool port_button_pop_edge(uint32_t button_id, port_button_edge_t *p_edge);
+
 /**
  * @brief return the System tick (in ms)
  * 
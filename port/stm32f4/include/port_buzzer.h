@@ -15,6 +15,10 @@
 
 /* HW dependent includes */
 #include "port_system.h"
+#include "port_buzzer_timing.h"
+
+/* Other includes */
+#include "ring_buffer.h"
 
 /* Defines and enums ----------------------------------------------------------*/
 /* Defines */
@@ -22,24 +26,104 @@
 #define BUZZER_0_ID 0                   /*!< Id of the Buzzer*/
 #define BUZZER_0_GPIO GPIOA             /*!< Port of Buzzer GPIO*/ 
 #define BUZZER_0_PIN 6                  /*!< Pin of Buzzer GPIO*/
-#define BUZZER_PWM_DC 0.5               /*!< Duty Cycle of the Buzzer*/
+#define BUZZER_NOTE_ENDS_LENGTH 4       /*!< Note ends waiting to be read by the FSM. Power of 2 */
+
+/* Sequencer: the notes are fed to the timers by DMA from a RAM buffer of records, refilled by halves */
+#define BUZZER_SEQUENCER_LENGTH 32                                      /*!< Records of the sequencer buffer. Even: it is refilled by halves */
+#define BUZZER_SEQUENCER_HALF_LENGTH (BUZZER_SEQUENCER_LENGTH / 2)      /*!< Records of each half of the sequencer buffer */
+#define BUZZER_SEQUENCER_PAD_US 1000                                    /*!< Duration of the silences that fill the buffer after the last note */
 
 /* Typedefs --------------------------------------------------------------------*/
 
+/**
+ * @brief Values of the TIM3 registers that play a note.
+ *
+ * @param psc
+ * @param arr
+ * @param ccr
+ */
+typedef struct
+{
+    uint16_t psc;
+    uint16_t arr;
+    uint16_t ccr;
+} port_buzzer_note_timing_t;
+
+/**
+ * @brief Statistics of the gaps between consecutive notes, in CPU cycles.
+ * 
+ * A gap goes from the start of the TIM2 interrupt that ends a note to the moment TIM3 starts the next one.
+ * The interrupt entry (12 cycles) is not included.
+ * @param count
+ * @param min_cycles
+ * @param max_cycles
+ * @param total_cycles
+ * @param late_count
+ */
+typedef struct
+{
+    uint32_t count;             /*!< Number of gaps measured */
+    uint32_t min_cycles;        /*!< Shortest gap */
+    uint32_t max_cycles;        /*!< Longest gap */
+    uint64_t total_cycles;      /*!< Sum of all the gaps, for the average */
+    uint32_t late_count;        /*!< Gaps where the next note was not queued in time and was started by the FSM */
+} port_buzzer_gap_stats_t;
+
+/**
+ * @brief TIM3 registers of a note of the sequencer, in the order of a DMA burst from ARR: ARR, RCR and CCR1.
+ * TIM3 has no repetition counter, so `rcr` is only a placeholder.
+ *
+ * @param arr
+ * @param rcr
+ * @param ccr
+ */
+typedef struct
+{
+    uint16_t arr;
+    uint16_t rcr;
+    uint16_t ccr;
+} port_buzzer_sequencer_tone_t;
+
 /**
  * @brief HW structure of buzzer
  * 
  * @param *p_port
  * @param pin
  * @param alt_func
- * @param note_end
+ * @param note_ends
+ * @param note_ends_storage
+ * @param next_queued
+ * @param next_timing
+ * @param measure_gaps
+ * @param gap_pending
+ * @param gap_start_cycles
+ * @param gap_stats
+ * @param seq_running
+ * @param seq_free_halves
+ * @param seq_end_half
+ * @param seq_end
+ * @param seq_tones
+ * @param seq_durations
  */
 typedef struct
 {
     GPIO_TypeDef * p_port;
     uint8_t pin;
     uint8_t alt_func;
-    bool note_end;
+    ring_buffer_t note_ends;                                            /*!< Ends of the notes not followed by a queued note, from the TIM2 interrupt to the FSM */
+    uint32_t note_ends_storage[BUZZER_NOTE_ENDS_LENGTH];                /*!< CPU cycle (DWT) of each note end */
+    volatile bool next_queued;
+    port_buzzer_note_timing_t next_timing;
+    bool measure_gaps;
+    volatile bool gap_pending;
+    volatile uint32_t gap_start_cycles;
+    port_buzzer_gap_stats_t gap_stats;
+    bool seq_running;                                                   /*!< Flag to indicate that the notes are fed by the sequencer */
+    volatile uint8_t seq_free_halves;                                   /*!< Bit mask of the halves of the buffer already played, waiting to be refilled */
+    volatile int8_t seq_end_half;                                       /*!< First half with padding after the last note, or -1 */
+    volatile bool seq_end;                                              /*!< Flag to indicate that the sequencer has played the last note */
+    port_buzzer_sequencer_tone_t seq_tones[BUZZER_SEQUENCER_LENGTH];    /*!< TIM3 values of the notes, read by DMA1 Stream4 */
+    uint32_t seq_durations[BUZZER_SEQUENCER_LENGTH];                    /*!< TIM2 ARR values of the notes, read by DMA1 Stream7 */
 } port_buzzer_hw_t;
 
 /* Global variables */
@@ -61,23 +145,141 @@ extern port_buzzer_hw_t buzzers_arr[];
 void port_buzzer_init(uint32_t buzzer_id);
 
 /**
- * @brief Sets the duration for a note
+ * @brief Sets the duration for a note. TIM2 is a 32-bit timer, so with a fixed 1 us tick
+ * the duration is loaded straight into ARR, with no prescaler search.
+ * 
+ * @param buzzer_id ID of given buzzer
+ * @param duration_us time for the duration (in us)
+ */
+void port_buzzer_set_note_duration(uint32_t buzzer_id, uint32_t duration_us);
+
+/**
+ * @brief Sets the note that a buzzer plays. The PSC, ARR and CCR1 values of the note
+ * are taken from a table built at compile time, so no floating point math is done.
+ * 
+ * @param buzzer_id ID of given buzzer
+ * @param note MIDI note number of the note (see `enum NOTES`). SILENCE or a note out of the table stops the PWM
+ */
+void port_buzzer_set_note(uint32_t buzzer_id, uint8_t note);
+
+/**
+ * @brief Queues the next note while the current one is playing, so that it starts as soon as the current one ends.
  * 
+ * The duration goes to the preload register of TIM2 (ARPE), which keeps counting and takes it at the update event that ends
+ * the current note. The TIM2 interrupt then loads the precomputed PSC, ARR and CCR1 of the note into TIM3 and forces an update.
+ * A silence is played as a note with CCR1 = 0. Only one note can be queued.
+ * @param buzzer_id ID of given buzzer
+ * @param note MIDI note number of the note or SILENCE
+ * @param duration_us duration of the note (in us)
+ * @return true the note has been queued
+ * @return false the current note has already ended or there is already a note queued. Start the note with
+ * `port_buzzer_set_note()` and `port_buzzer_set_note_duration()`
+ */
+bool port_buzzer_queue_note(uint32_t buzzer_id, uint8_t note, uint32_t duration_us);
+
+/**
+ * @brief check if a note can be queued with `port_buzzer_queue_note()`
+ * @param buzzer_id ID of given buzzer
+ * @return true a note is playing and there is no note queued
+ * @return false no note is playing or there is already a note queued
+ */
+bool port_buzzer_get_queue_free(uint32_t buzzer_id);
+
+/**
+ * @brief Ends the current note. Called from the TIM2 update interrupt.
+ * 
+ * If a note is queued, it starts playing. If not, the timers are stopped and the end is pushed to `note_ends`.
+ * @param buzzer_id ID of given buzzer
+ */
+void port_buzzer_next_note(uint32_t buzzer_id);
+
+/**
+ * @brief Enables or disables the measurement of the gaps between notes. Enabling it clears the statistics.
+ * @param buzzer_id ID of given buzzer
+ * @param enable true to measure the gaps
+ */
+void port_buzzer_set_gap_measurement(uint32_t buzzer_id, bool enable);
+
+/**
+ * @brief Gets the statistics of the gaps between notes.
+ * @param buzzer_id ID of given buzzer
+ * @param p_stats pointer to store the statistics
+ */
+void port_buzzer_get_gap_stats(uint32_t buzzer_id, port_buzzer_gap_stats_t *p_stats);
+
+/**
+ * @brief Writes a note in a record of the sequencer buffer.
+ * 
+ * Records are played in order, from the one after the note given to `port_buzzer_sequencer_start()`, and the buffer is
+ * played in a loop. A half of the buffer can only be written before starting or when `port_buzzer_sequencer_get_free_half()`
+ * returns it.
+ * @param buzzer_id ID of given buzzer
+ * @param index index of the record, from 0 to BUZZER_SEQUENCER_LENGTH - 1
+ * @param note MIDI note number of the note or SILENCE
+ * @param duration_us duration of the note (in us)
+ */
+void port_buzzer_sequencer_set_record(uint32_t buzzer_id, uint32_t index, uint8_t note, uint32_t duration_us);
+
+/**
+ * @brief Marks a half of the sequencer buffer as written.
+ * @param buzzer_id ID of given buzzer
+ * @param half half of the buffer (0 or 1)
+ * @param last true if the half has padding after the last note of the melody. The sequencer stops after playing it
+ */
+void port_buzzer_sequencer_set_half_done(uint32_t buzzer_id, uint32_t half, bool last);
+
+/**
+ * @brief Starts playing a note and then the whole sequencer buffer, with no CPU intervention.
+ * 
+ * Every TIM2 update event (end of a note) makes DMA1 Stream7 write the duration of the next record in TIM2 ARR, and
+ * resets TIM3 through its trigger input (TIM2 TRGO), which makes DMA1 Stream4 write its ARR and CCR1 in a burst. Both
+ * timers run without preload, so the values take effect straight away. Stream7 interrupts when a half of the buffer has
+ * been played, to ask for a refill, and stops the timers once the half marked as last is reached.
+ * @param buzzer_id ID of given buzzer
+ * @param note MIDI note number of the first note or SILENCE
+ * @param duration_us duration of the first note (in us)
+ */
+void port_buzzer_sequencer_start(uint32_t buzzer_id, uint8_t note, uint32_t duration_us);
+
+/**
+ * @brief Pauses the sequencer in the middle of the note. The timers are frozen and the DMA waits for them.
+ * @param buzzer_id ID of given buzzer
+ */
+void port_buzzer_sequencer_pause(uint32_t buzzer_id);
+
+/**
+ * @brief Resumes the sequencer where it was paused.
+ * @param buzzer_id ID of given buzzer
+ */
+void port_buzzer_sequencer_resume(uint32_t buzzer_id);
+
+/**
+ * @brief Gets a half of the sequencer buffer that has been played and must be refilled.
+ * @param buzzer_id ID of given buzzer
+ * @return int32_t half of the buffer (0 or 1), or -1 if there is none
+ */
+int32_t port_buzzer_sequencer_get_free_half(uint32_t buzzer_id);
+
+/**
+ * @brief check if the sequencer has played the last note
  * @param buzzer_id ID of given buzzer
- * @param duration_ms time for the duration (in ms)
+ * @return true the last note has ended and the sequencer has stopped
+ * @return false the sequencer is playing, paused or not in use
  */
-void port_buzzer_set_note_duration(uint32_t buzzer_id, uint32_t duration_ms);
+bool port_buzzer_sequencer_get_end(uint32_t buzzer_id);
 
 /**
- * @brief Sets the frequency for a buzzer
+ * @brief Handles the end of a half of the sequencer buffer. Called from the DMA1 Stream7 half transfer (half 0) and
+ * transfer complete (half 1) interrupts.
  * 
+ * If the half is the one marked as last, the sequencer stops. If not, the half is given back to be refilled.
  * @param buzzer_id ID of given buzzer
- * @param frequency_hz frequency for the buzzer (in Hz)
+ * @param half half of the buffer that has been played (0 or 1)
  */
-void port_buzzer_set_note_frequency(uint32_t buzzer_id, double frequency_hz);
+void port_buzzer_sequencer_half_played(uint32_t buzzer_id, uint32_t half);
 
 /**
- * @brief check if a note has ended
+ * @brief check if a note has ended, that is, there is a note end not cleared by port_buzzer_set_note_duration()
  * 
  * @param buzzer_id ID of given buzzer
  * @return true note has ended
@@ -86,7 +288,7 @@ void port_buzzer_set_note_frequency(uint32_t buzzer_id, double frequency_hz);
 bool port_buzzer_get_note_timeout(uint32_t buzzer_id);
 
 /**
- * @brief stop the buzzer with the given ID
+ * @brief stop the buzzer with the given ID. The sequencer is stopped too, and the timers are left ready to play notes one by one.
  * 
  * @param buzzer_id ID of given buzzer
  */
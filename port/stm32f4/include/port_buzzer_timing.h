@@ -0,0 +1,39 @@
+/**
+ * @file port_buzzer_timing.h
+ * @brief Timer values that the buzzer programs for each note. They only depend on `SYSTEM_CORE_CLOCK_HZ`, so this header
+ * has no hardware includes and is shared with the host tools that render the melodies as the buzzer plays them.
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-07
+ */
+#ifndef PORT_BUZZER_TIMING_H_
+#define PORT_BUZZER_TIMING_H_
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C includes */
+#include <stdint.h>
+
+/* Defines and enums ----------------------------------------------------------*/
+/* Defines */
+#ifndef SYSTEM_CORE_CLOCK_HZ
+#error "SYSTEM_CORE_CLOCK_HZ must be defined: include port_system.h first, or define it on the command line of a host tool"
+#endif
+
+#define BUZZER_PWM_DC 0.5               /*!< Duty Cycle of the Buzzer*/
+
+#define BUZZER_DURATION_TICK_HZ 1000000U                                    /*!< Counting frequency of the duration timer (1 us per tick) */
+#define BUZZER_DURATION_PSC (SYSTEM_CORE_CLOCK_HZ / BUZZER_DURATION_TICK_HZ - 1) /*!< Fixed prescaler of the duration timer */
+
+/* Timer values of the PWM for a note of `hz` Hz. They are constant expressions, so they are solved by the compiler */
+#define BUZZER_PWM_TICKS(hz) ((double)SYSTEM_CORE_CLOCK_HZ / (hz))                                    /*!< Timer clock cycles in one period of the note */
+#define BUZZER_PWM_PSC(hz) ((uint32_t)(BUZZER_PWM_TICKS(hz) / 65536.0))                                /*!< Lowest prescaler that keeps the ARR in 16 bits */
+#define BUZZER_PWM_ARR(hz) ((uint32_t)(BUZZER_PWM_TICKS(hz) / (BUZZER_PWM_PSC(hz) + 1) + 0.5) - 1)     /*!< Rounded auto-reload value */
+#define BUZZER_PWM_CCR(hz) ((uint32_t)(BUZZER_PWM_DC * (BUZZER_PWM_ARR(hz) + 1)))                     /*!< Compare value for the duty cycle */
+
+/* Timer values of the DMA sequencer, which keeps the prescaler of TIM3 fixed */
+#define BUZZER_SEQUENCER_MIN_US 10                                      /*!< Shortest note of the sequencer, so that the DMA writes ARR before CNT reaches it */
+#define BUZZER_SEQUENCER_PSC 1                                          /*!< Fixed TIM3 prescaler of the sequencer: DO3 needs 61156 ticks of 8 MHz, so every ARR fits in 16 bits */
+#define BUZZER_SEQUENCER_ARR(hz) ((uint32_t)(BUZZER_PWM_TICKS(hz) / (BUZZER_SEQUENCER_PSC + 1) + 0.5) - 1) /*!< Rounded auto-reload value with the fixed prescaler */
+#define BUZZER_SEQUENCER_CCR(hz) ((uint32_t)(BUZZER_PWM_DC * (BUZZER_SEQUENCER_ARR(hz) + 1)))              /*!< Compare value for the duty cycle with the fixed prescaler */
+
+#endif /* PORT_BUZZER_TIMING_H_ */
@@ -22,6 +22,9 @@
 
 #define KEYPAD_0_ID 0                   /*!< Id of the Keypad*/
 #define KEYPAD_0_GPIO GPIOC             /*!< Port of Keypad GPIO*/
+#define KEYPAD_0_SCAN_PERIOD_MS 20      /*!< Period in ms of the scans of the keypad while a key is down, much shorter than a key press */
+#define KEYPAD_0_ROWS_MASK 0x0FU        /*!< Pins of the rows, PC0 to PC3, which are also the EXTI lines 0 to 3 */
+#define KEYPAD_0_EXTI_PRIO 2            /*!< Priority of the interrupts of the rows, below the button */
 
 /**
  * @brief Initializes a buzzer object given a buzzer ID.
@@ -32,10 +35,35 @@ void port_keypad_init(void);
 /**
  * @brief Reads the Key that is being pressed from an array of posible chars.
  * 
+ * It drives one column low at a time, so the interrupts of the rows must be masked, as they are from the press until
+ * port_keypad_enable_interrupts().
+ * 
  * @return char The key that is being pressed.
  */
 char port_keypad_read(void);
 
+/**
+ * @brief Waits for a key press without scanning: drives all the columns low, so that a key pressed pulls its row down,
+ * and unmasks the falling edge interrupts of the rows. If a row is already low, the press is taken as woken at once.
+ * 
+ */
+void port_keypad_enable_interrupts(void);
+
+/**
+ * @brief Check whether a row has gone low since the last call to port_keypad_enable_interrupts().
+ * 
+ * @return true a key may have been pressed: it must be scanned.
+ * @return false no key has been pressed.
+ */
+bool port_keypad_check_woken(void);
+
+/**
+ * @brief Masks the interrupts of the rows, so that the scans do not trigger them, and marks the keypad as woken.
+ * Called from the EXTI interrupts of the rows.
+ * 
+ */
+void port_keypad_row_interrupt(void);
+
 /**
  * @brief Decodes the char with the column and row.
  * 
@@ -26,7 +26,13 @@
 /* Microcontroller STM32F446RE */
 /* Timer configuration */
 #define RCC_HSI_CALIBRATION_DEFAULT 0x10U            /*!< Default HSI calibration trimming value */
+#define SYSTEM_CORE_CLOCK_HZ 16000000U               /*!< Frequency of the System clock set by system_clock_config() (HSI, AHB and APB not divided) */
 #define TICK_FREQ_1KHZ 1U                            /*!< Freqency in kHz of the System tick */
+#define SYSTEM_TIMEBASE_PSC (SYSTEM_CORE_CLOCK_HZ / 1000U - 1U) /*!< Prescaler of TIM5, so that it counts milliseconds */
+#define SYSTEM_TIMEBASE_IRQ_PRIO 0                   /*!< TIM5 interrupt priority (the highest, as the SysTick had) */
+#define SYSTEM_RUN_CURRENT_UA 5000U                  /*!< Approximate supply current running at 16 MHz with the peripherals of the jukebox on, in uA. Measure the board to refine it */
+#define SYSTEM_SLEEP_CURRENT_UA 1800U                /*!< Approximate supply current in Sleep mode (WFI) at 16 MHz with the same peripherals, in uA */
+#define SYSTEM_TRACE_ITM_PORT 1U                     /*!< Stimulus port of the ITM for the binary trace records. printf() uses port 0 */
 #define NVIC_PRIORITY_GROUP_0 ((uint32_t)0x00000007) /*!< 0 bit  for pre-emption priority, \
                                                          4 bits for subpriority */
 #define NVIC_PRIORITY_GROUP_4 ((uint32_t)0x00000003) /*!< 4 bits for pre-emption priority, \
@@ -55,6 +61,56 @@
 #define TRIGGER_ENABLE_EVENT_REQ 0x04U                                 /*!< Interrupt mask to enable event requests */
 #define TRIGGER_ENABLE_INTERR_REQ 0x08U                                /*!< Interrupt mask to enable interrupt request */
 
+/* Events of the main loop: each bit asks to fire a FSM */
+#ifndef MAIN_EVENT_LOOP
+#define MAIN_EVENT_LOOP 1 /*!< 1 to fire only the FSMs with pending events and sleep when there are none, 0 to fire all of them in every iteration */
+#endif
+#define SYSTEM_EVENT_BUTTON BIT_POS_TO_MASK(0)   /*!< Fire the button FSM */
+#define SYSTEM_EVENT_USART BIT_POS_TO_MASK(1)    /*!< Fire the USART FSM */
+#define SYSTEM_EVENT_BUZZER BIT_POS_TO_MASK(2)   /*!< Fire the buzzer FSM */
+#define SYSTEM_EVENT_KEYPAD BIT_POS_TO_MASK(3)   /*!< Fire the keypad FSM */
+#define SYSTEM_EVENT_JUKEBOX BIT_POS_TO_MASK(4)  /*!< Fire the jukebox FSM */
+#define SYSTEM_EVENT_ALL 0x1FU                   /*!< Fire all the FSMs */
+
+/* Timer wheel */
+#define SYSTEM_TIMER_WHEEL_SLOTS 256U                                   /*!< Slots of the timer wheel, one per millisecond. Power of two */
+#define SYSTEM_TIMER_WHEEL_MASK (SYSTEM_TIMER_WHEEL_SLOTS - 1U)         /*!< Mask to get the slot of a time */
+#define SYSTEM_TIMER_WHEEL_WORDS (SYSTEM_TIMER_WHEEL_SLOTS / 32U)       /*!< Words of the bitmap of the slots in use */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Function called from the TIM5 interrupt when a timer expires.
+ */
+typedef void (*port_system_timer_callback_t)(void *p_arg);
+
+/**
+ * @brief Software timer of the timer wheel. The structure is owned by the user of the timer, so the wheel needs no memory of its own.
+ *
+ * The timers are kept in the slot of their expiry time modulo `SYSTEM_TIMER_WHEEL_SLOTS`, in doubly linked lists, so they are started
+ * and stopped in constant time, whatever the number of timers.
+ */
+typedef struct port_system_timer
+{
+    struct port_system_timer *p_next;       /*!< Next timer of the same slot */
+    struct port_system_timer *p_prev;       /*!< Previous timer of the same slot */
+    uint32_t expiry_ms;                     /*!< Time (as returned by `port_system_get_millis()`) when it expires */
+    uint32_t period_ms;                     /*!< Period to start it again when it expires, 0 if it only expires once */
+    uint32_t events;                        /*!< `SYSTEM_EVENT_*` bits to post when it expires */
+    port_system_timer_callback_t callback;  /*!< Function to call when it expires, or NULL */
+    void *p_arg;                            /*!< Argument of `callback` */
+    volatile bool running;                  /*!< Flag to indicate that the timer is in the wheel */
+} port_system_timer_t;
+
+/**
+ * @brief Counters of the main loop, to compare the polling loop with the event driven one.
+ */
+typedef struct
+{
+    uint32_t iterations;    /*!< Times the pending events have been taken: one per iteration of the loop */
+    uint32_t wakeups;       /*!< Times the CPU has woken up from the WFI of port_system_event_wait() */
+    uint64_t awake_cycles;  /*!< CPU cycles spent awake, counted from each wakeup to the next WFI */
+} port_system_loop_stats_t;
+
 /* Function prototypes and explanation -------------------------------------------------*/
 
 /**
@@ -62,15 +118,13 @@
  *         thing to be executed in the main program (before to call any other
  *          functions), it performs the following:
  *           - Configure the Flash prefetch, instruction and Data caches.
- *           - Configures the SysTick to generate an interrupt each 1 millisecond, which is clocked by the HSI (at this stage, the clock is not yet configured and thus the system is running from the internal HSI at 16 MHz).
+ *           - Starts TIM5 as a free-running millisecond counter. It only interrupts when a timer of the timer wheel may be due, so there is no periodic tick.
  *           - Set NVIC Group Priority to 4.
  *             NVIC_PRIORITYGROUP_4: 4 bits for preemption priority
  *                                    0 bits for subpriority
  *           - Configure the system clock
  *
- * @note   SysTick is used as time base for the delay functions. When using the HAL, the application
- *         needs to ensure that the SysTick time base is always set to 1 millisecond
- *         to have correct HAL operation.
+ * @note   TIM5 is used as time base for the delay functions. SysTick is not used.
  *    When the NVIC_PRIORITYGROUP_0 is selected, IRQ preemption is no more possible.
  *         The pending IRQ priority will be managed only by the subpriority.
  * @retval Init status
@@ -78,25 +132,78 @@
 size_t port_system_init(void);
 
 /**
- * @brief Get the count of the System tick in milliseconds
+ * @brief Get the milliseconds since the system started
  *
  * >
- * > ✅ 1. Return System tick \n
+ * > ✅ 1. Return the counter of TIM5 \n
  *
  * @return uint32_t
  */
 uint32_t port_system_get_millis(void);
 
+/**
+ * @brief Get the CPU cycles counted by the DWT since the system started, to time short pieces of code.
+ *
+ * @return uint32_t cycle count. It wraps around every 2^32 cycles (268 s at 16 MHz).
+ */
+uint32_t port_system_get_cycles(void);
+
 /**
  * @brief Sets the number of milliseconds since the system started.
- * @warning This function must be used only by the SysTick_Handler() ISR in file `interr.c`.
  * >
- * > ✅ 1. Set System tick to the value received \n
+ * > ✅ 1. Set the counter of TIM5 to the value received \n
+ * > ✅ 2. Program the compare of the next timer again \n
+ *
+ * @warning The running timers keep their expiry times: a jump forwards makes them expire at once and a jump backwards delays them.
  *
  * @param ms New number of milliseconds since the system started.
-º */
+ */
 void port_system_set_millis(uint32_t ms);
 
+/**
+ * @brief Initialize a timer of the timer wheel, stopped.
+ *
+ * @param p_timer pointer to the timer.
+ * @param events mask of `SYSTEM_EVENT_*` bits to post to the main loop when it expires (0 for none).
+ * @param callback function to call from the TIM5 interrupt when it expires, or NULL.
+ * @param p_arg argument of `callback`.
+ */
+void port_system_timer_init(port_system_timer_t *p_timer, uint32_t events, port_system_timer_callback_t callback, void *p_arg);
+
+/**
+ * @brief Start a timer, or start it again if it is running. O(1).
+ *
+ * Only the next slot in use of the wheel is programmed in the compare channel of TIM5, so the CPU only wakes up when
+ * a timer may be due. A timer more than `SYSTEM_TIMER_WHEEL_SLOTS` ms away is only looked at once per turn of the wheel.
+ *
+ * @param p_timer pointer to the timer.
+ * @param delay_ms time until it expires, in ms. 0 expires at the next millisecond.
+ * @param period_ms period to start it again when it expires, or 0 to expire only once.
+ */
+void port_system_timer_start(port_system_timer_t *p_timer, uint32_t delay_ms, uint32_t period_ms);
+
+/**
+ * @brief Stop a timer, if it is running. O(1).
+ *
+ * @param p_timer pointer to the timer.
+ */
+void port_system_timer_stop(port_system_timer_t *p_timer);
+
+/**
+ * @brief Check whether a timer is running.
+ *
+ * @param p_timer pointer to the timer.
+ * @return true the timer is running.
+ * @return false the timer is stopped or has expired (and it is not periodic).
+ */
+bool port_system_timer_is_running(const port_system_timer_t *p_timer);
+
+/**
+ * @brief Expire the timers that are due, from the slots the time has gone through, and program the compare of the next slot in use.
+ * @warning This function must be used only by the TIM5_IRQHandler() ISR in file `interr.c`.
+ */
+void port_system_timer_expire(void);
+
 /**
  * @brief Wait for some milliseconds
  *
@@ -262,21 +369,52 @@ void port_system_power_stop(void);
 void port_system_power_sleep(void);
 
 /**
- * @brief Stops the increasing of system ticks, so it basically "stops" the clock that makes it have ticks
+ * @brief Turns on the sleep mode of the system saving power consuption, until the next interrupt.
+ * 
+ * There is no periodic tick, so the next interrupt is an external event or the next timer. It doesn't sleep if there are events pending.
  * 
  */
-void port_system_systick_suspend(void);
+void port_system_sleep(void);
 
 /**
- * @brief Resumes the increasing of system ticks, so it basically "resumes" the clock that makes it have ticks
+ * @brief Adds events to the pending ones, atomically (LDREX/STREX), so it can be called from ISRs and from the main loop.
  * 
+ * @param events mask of `SYSTEM_EVENT_*` bits
  */
-void port_system_systick_resume(void);
+void port_system_event_post(uint32_t events);
 
 /**
- * @brief Turns on the sleep mode of the system saving power consuption
+ * @brief Takes all the pending events, atomically leaving none. Counts an iteration of the main loop.
  * 
+ * @return uint32_t mask of `SYSTEM_EVENT_*` bits that were pending
  */
-void port_system_sleep(void);
+uint32_t port_system_event_take(void);
+
+/**
+ * @brief Sleeps (WFI) until an interrupt comes, unless there are events pending.
+ * 
+ * The check is done with the interrupts masked, so an event posted by an ISR just before the WFI can't be lost:
+ * the pending interrupt wakes the CPU up straight away, and it is served after unmasking.
+ */
+void port_system_event_wait(void);
+
+/**
+ * @brief Gets the counters of the main loop.
+ * 
+ * @param p_stats pointer to store the counters
+ */
+void port_system_get_loop_stats(port_system_loop_stats_t *p_stats);
+
+/**
+ * @brief Writes words to the stimulus port `SYSTEM_TRACE_ITM_PORT` of the ITM while its FIFO has room, without waiting.
+ * 
+ * Each word goes out through the SWO pin as a 4-byte packet of that port, so the host can tell it from the printf() text
+ * of port 0. If no debugger has enabled the ITM and the port, there is nobody to wait for and the words are dropped.
+ * 
+ * @param p_words pointer to the words.
+ * @param count number of words.
+ * @return uint32_t number of words written or dropped. The rest must be written again later, in order.
+ */
+uint32_t port_system_trace_write(const uint32_t *p_words, uint32_t count);
 
 #endif /* PORT_SYSTEM_H_ */
@@ -16,6 +16,9 @@
 /* HW dependent includes */
 #include "stm32f4xx.h"
 
+/* Other includes */
+#include "ring_buffer.h"
+
 /* Defines and enums ----------------------------------------------------------*/
 /* Defines */
 #define USART_0_ID 0                        /*!< Id of the USART*/
@@ -26,14 +29,60 @@
 #define USART_0_PIN_RX 11                   /*!< Pin of RX GPIO*/
 #define USART_0_AF_TX 0x07                  /*!< TX Alternative Function*/
 #define USART_0_AF_RX 0x07                  /*!< RX Alternative Function*/
-#define BRR_9600_8_N_1 0x683                /*!< Dividimos 1000000/9600 y obtenemos 104,167. Pasamos la parte entera a hexadecimal (104 en decimal es 68 en hexadecimal). Convertimos la parte decimal en binario usando el método de la multiplicación sucesiva por 2. Repetimos este proceso cuatro veces y nos queda 0010, lo cual en hexadecimal es 2. 0x682*/
+#define USART_0_BAUD 9600                   /*!< Baud rate of the USART at startup, 8-N-1 */
+
+#define USART_BAUD_MIN 1200                 /*!< Lowest baud rate accepted */
+#define USART_BAUD_MAX 921600               /*!< Highest baud rate accepted */
+#define USART_BAUD_MAX_ERROR_PERMILLE 25    /*!< Maximum difference between the baud rate asked for and the one the divider gives, in per mille */
+
+#define USART_0_RX_DMA_STREAM DMA1_Stream1  /*!< DMA stream that stores the bytes received */
+#define USART_0_RX_DMA_CHANNEL 4            /*!< DMA channel of USART3_RX in DMA1 Stream1 */
+#define USART_0_RX_DMA_IRQ DMA1_Stream1_IRQn /*!< Interrupt of the RX DMA stream */
+#define USART_0_TX_DMA_STREAM DMA1_Stream3  /*!< DMA stream that sends the messages queued */
+#define USART_0_TX_DMA_CHANNEL 4            /*!< DMA channel of USART3_TX in DMA1 Stream3 */
+#define USART_0_TX_DMA_IRQ DMA1_Stream3_IRQn /*!< Interrupt of the TX DMA stream */
 
-#define USART_INPUT_BUFFER_LENGTH 10        /*!< Length for the input buffer*/
-#define USART_OUTPUT_BUFFER_LENGTH 256      /*!< Length for the output buffer*/
-#define EMPTY_BUFFER_CONSTANT 0x0           /*!< Constant that represents en empty buffer*/
+#define USART_LINE_MAX_LENGTH 64            /*!< Maximum length of a line that wraps around the end of the RX ring, and of the lines copied by the FSMs */
+#define USART_OUTPUT_BUFFER_LENGTH 256      /*!< Length for the messages formatted by the FSMs before they are queued*/
 #define END_CHAR_CONSTANT 0xA               /*!< Constant that represents the end of a char*/
+#define USART_FRAME_CHAR 0x00               /*!< Byte that starts and ends a binary frame. A line that starts with it ends with the next one instead of an end of line */
+
+#define USART_RX_RING_LENGTH 256            /*!< Bytes of the ring written by the RX DMA in circular mode. Power of 2 */
+#define USART_RAW_XOFF_LEVEL 96             /*!< Bytes in the RX ring to ask the sender to stop in raw mode. The level is checked at least every half ring */
+#define USART_RAW_XON_LEVEL 32              /*!< Bytes in the RX ring to let the sender go on in raw mode */
+#define USART_XON_CHAR 0x11                 /*!< Software flow control character to resume the transmission (DC1) */
+#define USART_XOFF_CHAR 0x13                /*!< Software flow control character to pause the transmission (DC3) */
+
+#define USART_TX_ARENA_LENGTH 2048          /*!< Bytes of the ring where the messages queued are copied. Power of 2 */
+#define USART_TX_QUEUE_LENGTH 32            /*!< Descriptors of the messages queued. Power of 2 */
 
 /* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Message queued to be sent by the TX DMA.
+ * @param p_data
+ * @param length
+ * @param copied
+ */
+typedef struct
+{
+    const uint8_t *p_data;  /*!< First byte to send */
+    uint16_t length;        /*!< Bytes to send, at most 65535 (NDTR of the DMA) */
+    bool copied;            /*!< Flag to indicate that the bytes are in the TX arena and must be freed once sent */
+} port_usart_tx_descriptor_t;
+
+/**
+ * @brief Statistics of the transmission, to measure the throughput and the CPU load of each baud rate.
+ * @param bytes
+ * @param busy_cycles
+ * @param cpu_cycles
+ */
+typedef struct
+{
+    uint32_t bytes;             /*!< Bytes sent by the TX DMA */
+    uint64_t busy_cycles;       /*!< CPU cycles elapsed while the TX DMA was sending */
+    uint64_t cpu_cycles;        /*!< CPU cycles spent queueing the messages and in the TX DMA interrupt */
+} port_usart_tx_stats_t;
+
 /**
  * @brief PORT USART strutcture
  * @param p_usart 
@@ -43,12 +92,34 @@
  * @param pin_rx
  * @param alt_func_tx
  * @param alt_func_rx
- * @param input_buffer
- * @param i_idx
+ * @param rx_dma_stream
+ * @param rx_dma_channel
+ * @param rx_dma_position
+ * @param line_length
+ * @param line_scanned
+ * @param p_line
+ * @param line_wrap
  * @param read_complete
- * @param output_buffer
- * @param o_idx
- * @param write_complete
+ * @param baud
+ * @param baud_pending
+ * @param tx_dma_stream
+ * @param tx_dma_channel
+ * @param tx_busy
+ * @param tx_flow_char
+ * @param tx_flow_byte
+ * @param tx_flow_sending
+ * @param tx_dropped
+ * @param tx_queue
+ * @param tx_queue_storage
+ * @param tx_arena
+ * @param tx_arena_storage
+ * @param tx_stats
+ * @param tx_busy_start_cycles
+ * @param raw_mode
+ * @param rx_ring
+ * @param rx_storage
+ * @param raw_paused
+ * @param raw_overrun
  *
  */
 typedef struct
@@ -60,12 +131,34 @@ typedef struct
     uint8_t pin_rx;
     uint8_t alt_func_tx;
     uint8_t alt_func_rx;
-    char input_buffer [USART_INPUT_BUFFER_LENGTH];
-    uint8_t i_idx;
+    DMA_Stream_TypeDef *rx_dma_stream;
+    uint8_t rx_dma_channel;
+    uint32_t rx_dma_position;               /*!< Position of the DMA in the RX ring at the last interrupt */
+    uint32_t line_length;                   /*!< Length of the line received, without the end of line */
+    uint32_t line_scanned;                  /*!< Bytes of the RX ring already looked at for the end of line */
+    const char *p_line;                     /*!< Line received: in the RX ring, or in `line_wrap` if it wraps around its end */
+    char line_wrap [USART_LINE_MAX_LENGTH];
     bool read_complete;
-    char output_buffer [USART_OUTPUT_BUFFER_LENGTH];
-    uint8_t o_idx;
-    bool write_complete;
+    uint32_t baud;                          /*!< Baud rate in use */
+    volatile uint32_t baud_pending;         /*!< Baud rate to change to once the last byte has been sent, or 0 */
+    DMA_Stream_TypeDef *tx_dma_stream;
+    uint8_t tx_dma_channel;
+    volatile bool tx_busy;                  /*!< Flag to indicate that the TX DMA is sending the first message of the queue */
+    volatile uint8_t tx_flow_char;          /*!< XON or XOFF to send before the next message of the queue, or 0 */
+    uint8_t tx_flow_byte;                   /*!< XON or XOFF being sent by the TX DMA */
+    volatile bool tx_flow_sending;          /*!< Flag to indicate that the TX DMA is sending `tx_flow_byte` instead of a message */
+    uint32_t tx_dropped;                    /*!< Messages not queued because the queue or the arena were full */
+    ring_buffer_t tx_queue;                 /*!< Messages to send, in order. The FSMs are the producer and the TX DMA interrupt the consumer */
+    port_usart_tx_descriptor_t tx_queue_storage [USART_TX_QUEUE_LENGTH];
+    ring_buffer_t tx_arena;                 /*!< Copies of the messages queued, freed by the TX DMA interrupt once sent */
+    uint8_t tx_arena_storage [USART_TX_ARENA_LENGTH];
+    port_usart_tx_stats_t tx_stats;
+    uint32_t tx_busy_start_cycles;          /*!< Cycle count when the TX DMA started sending after being idle */
+    volatile bool raw_mode;
+    ring_buffer_t rx_ring;                  /*!< Bytes received. The DMA is the producer */
+    uint8_t rx_storage [USART_RX_RING_LENGTH];
+    volatile bool raw_paused;
+    volatile bool raw_overrun;
 } port_usart_hw_t;
 
 /* Global variables */
@@ -84,19 +177,22 @@ extern port_usart_hw_t usart_arr[];
 void port_usart_init(uint32_t usart_id);
 
 /**
- * @brief Checks the value of the write_complete fieldo of the given USART
- * and returns it's value.
+ * @brief Checks whether all the messages queued have been sent.
  * 
  * @param usart_id ID of the USART.
- * @return true write completed. 
+ * @return true write completed: the TX queue is empty.
  * @return false write not completed.
  */
 bool port_usart_tx_done(uint32_t usart_id);
 
 
 /**
- * @brief Checks the value of the read_complete field of the given USART
- * and returns it's value.
+ * @brief Looks for the end of line in the bytes received, and returns the value of the read_complete field of the given USART.
+ * 
+ * The line stays in the RX ring, and so do the bytes after it, until the input buffer is reset, so a line
+ * received while the previous one is being handled is not lost. Nothing is looked for in raw mode.
+ * A binary frame, which starts with `USART_FRAME_CHAR`, ends with the next `USART_FRAME_CHAR` instead of an end of line.
+ * If the ring fills up without an end of line, or the DMA overwrites bytes not read, the bytes received are discarded.
  * 
  * @param usart_id ID of the USART.
  * @return true read completed
@@ -105,16 +201,17 @@ bool port_usart_tx_done(uint32_t usart_id);
 bool port_usart_rx_done(uint32_t usart_id);
 
 /**
- * @brief Using the memcpy function copies the input_buffer field of the given USART 
- * into the buffer.
+ * @brief Gets the line received, without copying it. Valid until the input buffer is reset.
  * 
  * @param usart_id ID of the USART.
- * @param p_buffer pointer to the buffer where the message will be stored.
+ * @param pp_line pointer to store the address of the line. It is not null terminated.
+ * @return uint32_t length of the line, without the end of line. Lines that wrap around the end of the RX ring are cut to `USART_LINE_MAX_LENGTH`.
+ * A binary frame keeps its first `USART_FRAME_CHAR`, so it can be told from a line, and not the last one.
  */
-void port_usart_get_from_input_buffer(uint32_t usart_id, char *p_buffer);
+uint32_t port_usart_get_line(uint32_t usart_id, const char **pp_line);
 
 /**
- * @brief Checks the TXE flag status and returns it's value.
+ * @brief Checks the TXE flag status and returns it's value. Only meaningful while the TX DMA is not sending.
  * 
  * @param usart_id ID of the USART.
  * @return true if TXE flag is set
@@ -123,70 +220,193 @@ void port_usart_get_from_input_buffer(uint32_t usart_id, char *p_buffer);
 bool port_usart_get_txr_status(uint32_t usart_id);
 
 /**
- * @brief Using the memcpy funcion copies the message passed into 
- * the output_buffer field of the given USART.
+ * @brief Queues a copy of a message to be sent by the TX DMA, without waiting.
+ * 
+ * Only `length` bytes are copied, to the TX arena. A message that wraps around the end of the arena takes two descriptors.
  * 
  * @param usart_id ID of the USART.
- * @param p_data pointer to the message to send.
- * @param length length of the message to send
+ * @param p_data pointer to the message to send. It can be reused as soon as the function returns.
+ * @param length length of the message to send.
+ * @return true the message has been queued.
+ * @return false there is no room in the TX queue or in the TX arena. The message is counted as dropped.
  */
-void port_usart_copy_to_output_buffer(uint32_t usart_id, char *p_data, uint32_t length);
+bool port_usart_send(uint32_t usart_id, const char *p_data, uint32_t length);
 
 /**
- * @brief Resets the content of the input buffer.
+ * @brief Queues a message to be sent by the TX DMA from where it is, without copying it and without waiting.
  * 
  * @param usart_id ID of the USART.
+ * @param p_data pointer to the message to send. It must not change until it has been sent, as a string literal.
+ * @param length length of the message to send, at most 65535.
+ * @return true the message has been queued.
+ * @return false there is no room in the TX queue or the message is too long. The message is counted as dropped.
  */
-void port_usart_reset_input_buffer(uint32_t usart_id);
+bool port_usart_send_const(uint32_t usart_id, const char *p_data, uint32_t length);
 
 /**
- * @brief Resets the content of the output buffer.
+ * @brief Checks whether a copy of a message fits in the TX queue now, so that a long answer can be queued as the queue drains instead of being dropped.
  * 
  * @param usart_id ID of the USART.
+ * @param length length of the message.
+ * @return true port_usart_send() would queue the message.
+ * @return false the TX queue or the TX arena are too full.
  */
-void port_usart_reset_output_buffer(uint32_t usart_id);
+bool port_usart_check_tx_room(uint32_t usart_id, uint32_t length);
 
 /**
- * @brief Writes from the USART Data Register (DA) into input buffer.
+ * @brief Gets the number of messages dropped because the TX queue or the TX arena were full.
+ * 
+ * @param usart_id ID of the USART.
+ * @return uint32_t messages dropped since the initialization.
+ */
+uint32_t port_usart_get_tx_dropped(uint32_t usart_id);
+
+/**
+ * @brief Gets the statistics of the transmission since the initialization or the last reset.
+ * 
+ * @param usart_id ID of the USART.
+ * @param p_stats pointer to store the statistics.
+ */
+void port_usart_get_tx_stats(uint32_t usart_id, port_usart_tx_stats_t *p_stats);
+
+/**
+ * @brief Resets the statistics of the transmission.
+ * 
+ * @param usart_id ID of the USART.
+ */
+void port_usart_reset_tx_stats(uint32_t usart_id);
+
+/**
+ * @brief Checks whether a baud rate can be used, and gets the baud rate the divider really gives.
+ * 
+ * The divider is computed from the clock of the USART (`SystemCoreClock` and the APB1 prescaler), with an oversampling of 16,
+ * or of 8 when the divider would be lower than 16 (`OVER8`), which reaches twice the baud rate with less tolerance to noise.
+ * 
+ * @param usart_id ID of the USART.
+ * @param baud baud rate asked for.
+ * @param p_actual pointer to store the baud rate given by the divider. It can be NULL.
+ * @return true the baud rate is within `USART_BAUD_MIN` .. `USART_BAUD_MAX` and its error is at most `USART_BAUD_MAX_ERROR_PERMILLE`.
+ * @return false the baud rate can't be used.
+ */
+bool port_usart_check_baud(uint32_t usart_id, uint32_t baud, uint32_t *p_actual);
+
+/**
+ * @brief Changes the baud rate once the transmitter has sent its last byte. Call it with the TX queue empty.
+ * 
+ * If the transmitter is still sending the last byte, the change is made by the transmission complete interrupt. The messages
+ * queued in the meantime are held and sent at the new baud rate.
+ * 
+ * @param usart_id ID of the USART.
+ * @param baud new baud rate.
+ * @return true the baud rate has been changed or will be changed.
+ * @return false the baud rate can't be used (see port_usart_check_baud()).
+ */
+bool port_usart_set_baud(uint32_t usart_id, uint32_t baud);
+
+/**
+ * @brief Gets the baud rate in use, or the one it is changing to.
+ * 
+ * @param usart_id ID of the USART.
+ * @return uint32_t baud rate.
+ */
+uint32_t port_usart_get_baud(uint32_t usart_id);
+
+/**
+ * @brief Makes the pending change of baud rate and starts sending the messages held. Called from the transmission complete
+ * interrupt of the USART, which is only enabled while a change is pending.
+ * 
+ * @param usart_id ID of the USART.
+ */
+void port_usart_tx_idle(uint32_t usart_id);
+
+/**
+ * @brief Releases the line received, so its bytes can be received again, and looks for the next one.
+ * 
+ * @param usart_id ID of the USART.
+ */
+void port_usart_reset_input_buffer(uint32_t usart_id);
+
+/**
+ * @brief Adds the bytes written by the DMA since the previous call to the RX ring. Called from the
+ * IDLE line interrupt, at the end of each message, and from the half and full transfer interrupts of the DMA.
  * 
  * @param usart_id ID of the USART.
  */
 void port_usart_store_data(uint32_t usart_id);
 
 /**
- * @brief Writes from the output buffer into the USART Data Register (DA).
+ * @brief Frees the message sent by the TX DMA and starts sending the next one. Called from the transfer complete
+ * interrupt of the TX DMA, so there is an interrupt per message instead of per byte.
  * 
  * @param usart_id ID of the USART.
  */
 void port_usart_write_data(uint32_t usart_id);
 
 /**
- * @brief Disable the RX interrupt for the USART.
+ * @brief Stop the reception for the USART: the RX DMA and the IDLE line interrupt.
  * 
  * @param usart_id ID of the USART.
  */
 void port_usart_disable_rx_interrupt(uint32_t usart_id);
 
 /**
- * @brief Disable the TX interrupt for the USART.
+ * @brief Start the reception for the USART, with an empty RX ring: the RX DMA and the IDLE line interrupt.
  * 
  * @param usart_id ID of the USART.
  */
-void port_usart_disable_tx_interrupt(uint32_t usart_id);
+void port_usart_enable_rx_interrupt(uint32_t usart_id);
 
 /**
- * @brief Enable the RX interrupt for the USART.
+ * @brief Stop moving the bytes received to the input buffer, so they are read as they are with port_usart_read_raw().
  * 
+ * Used to receive binary data. The bytes already in the RX ring are kept, because the sender may start right after the command.
+ * The sender is paused with XOFF when the RX ring is getting full, and resumed with XON when it has been read.
  * @param usart_id ID of the USART.
  */
-void port_usart_enable_rx_interrupt(uint32_t usart_id);
+void port_usart_enable_raw_rx(uint32_t usart_id);
+
+/**
+ * @brief Go back to moving the bytes received to the input buffer.
+ * 
+ * The bytes left in the RX ring, such as a command sent right after the raw data, are looked at again for lines.
+ * @param usart_id ID of the USART.
+ */
+void port_usart_disable_raw_rx(uint32_t usart_id);
+
+/**
+ * @brief Copy bytes from the RX ring in raw mode. They stay in the ring until they are released with port_usart_release_raw().
+ * @param usart_id ID of the USART.
+ * @param p_data pointer to store the bytes.
+ * @param max_length maximum number of bytes to read.
+ * @return uint32_t number of bytes read.
+ */
+uint32_t port_usart_read_raw(uint32_t usart_id, uint8_t *p_data, uint32_t max_length);
+
+/**
+ * @brief Remove from the RX ring the first bytes read with port_usart_read_raw(), and resume the sender if it is paused and
+ * the ring has emptied. The bytes not released are read again, or looked at for lines once the raw mode ends.
+ * @param usart_id ID of the USART.
+ * @param length number of bytes used, at most the ones read.
+ */
+void port_usart_release_raw(uint32_t usart_id, uint32_t length);
 
-/** 
- * @brief Enable the TX interrupt for the USART.
+/**
+ * @brief Check whether bytes have been lost because the RX ring was full.
+ * @param usart_id ID of the USART.
+ * @return true bytes have been lost since the raw mode was enabled.
+ * @return false no byte has been lost.
+ */
+bool port_usart_get_raw_overrun(uint32_t usart_id);
+
+/**
+ * @brief Check whether the raw mode needs more reads: bytes left in the RX ring, or a sender paused by XOFF.
  * 
+ * No interrupt comes for them while the sender is paused, so the reader must go on by itself.
  * @param usart_id ID of the USART.
+ * @return true port_usart_read_raw() and port_usart_release_raw() must be called again.
+ * @return false the ring is empty and the sender is not paused.
  */
-void port_usart_enable_tx_interrupt(uint32_t usart_id);
+bool port_usart_get_raw_pending(uint32_t usart_id);
 
 
 #endif
\ No newline at end of file
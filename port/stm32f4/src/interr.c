@@ -9,6 +9,7 @@
 #include "port_button.h"
 #include "port_usart.h"
 #include "port_buzzer.h"
+#include "port_keypad.h"
 
 // Include headers of different port elements:
 
@@ -16,61 +17,142 @@
 // INTERRUPT SERVICE ROUTINES
 //------------------------------------------------------
 /**
- * @brief Interrupt service routine for the System tick timer (SysTick).
+ * @brief Interrupt service routine for the timebase (TIM5).
  *
- * @note This ISR is called when the SysTick timer generates an interrupt.
- * The program flow jumps to this ISR and increments the tick counter by one millisecond.
+ * @note This ISR is called when the compare channel 1 of TIM5 reaches the next slot in use of the timer wheel, instead of every millisecond.
+ * It expires the timers that are due and programs the next slot.
  *
  */
-void SysTick_Handler(void)
+void TIM5_IRQHandler(void)
 {
-    volatile uint32_t msTicks = port_system_get_millis();
-    port_system_set_millis(msTicks+1);
+    TIM5->SR &= ~TIM_SR_CC1IF;
+    port_system_timer_expire();
+}
+
+/**
+ * @brief Handles EXTI line 0 interrupts: row 0 of the keypad (PC0) has gone low, so a key may have been pressed.
+ * The rows are masked until the key is let go, so the scans of the keypad do not interrupt.
+ *
+ */
+void EXTI0_IRQHandler(void)
+{
+    port_keypad_row_interrupt();
+}
+
+/**
+ * @brief Handles EXTI line 1 interrupts: row 1 of the keypad (PC1).
+ *
+ */
+void EXTI1_IRQHandler(void)
+{
+    port_keypad_row_interrupt();
+}
+
+/**
+ * @brief Handles EXTI line 2 interrupts: row 2 of the keypad (PC2).
+ *
+ */
+void EXTI2_IRQHandler(void)
+{
+    port_keypad_row_interrupt();
+}
+
+/**
+ * @brief Handles EXTI line 3 interrupts: row 3 of the keypad (PC3).
+ *
+ */
+void EXTI3_IRQHandler(void)
+{
+    port_keypad_row_interrupt();
 }
 
 /**
  * @brief Handles Px10-Px15 global interrupts.
- * From the button's port and pin, read the GPIO value, then if the value is HIGH
- * it means that the button is no longer pressed so set the value of flag_pressed to false.
- * If value is LOW, the button is pressed so set the value of flag_pressed to true.
+ * From the button's port and pin, read the GPIO value, and store the edge with its time:
+ * if the value is HIGH the button has been released, and if it is LOW it has been pressed.
  * Then, clean in the PR register the indicated bit.
  *
  */
 void EXTI15_10_IRQHandler(void)
 {
-    port_system_systick_resume();
     GPIO_TypeDef* p_port = buttons_arr[BUTTON_0_ID].p_port;
     uint8_t pin = buttons_arr[BUTTON_0_ID].pin;
     /* ISR user button */
     if (EXTI->PR & BIT_POS_TO_MASK(pin))
     {
         bool value = port_system_gpio_read(p_port, pin);
-        if (value)
-            buttons_arr[BUTTON_0_ID].flag_pressed = LOW;
-        else
-            buttons_arr[BUTTON_0_ID].flag_pressed = HIGH;
+        port_button_store_edge(BUTTON_0_ID, !value);       // The button is active low
         EXTI -> PR = BIT_POS_TO_MASK(pin);
+        port_system_event_post(SYSTEM_EVENT_BUTTON);
     }
 }
 /**
  * @brief Handles USART3 global interrupts.
- * Check RXNE flag and RXNEIE bit, to check if there has been new data received, 
- * and if RXNE is set and RXNEIE enabled, call the function port_usart_store_data 
- * to store the new data.
- * Also, checks TXE flag and TXEIE bit to see if there is new data in need to be 
- * transmited, so, if TXE is set and TXEIE enabled, call the function port_usart_write_data 
- * to write the data to the USART Data Register.
+ * Check IDLE flag and IDLEIE bit, to check if a message has ended (the line has been idle for a frame),
+ * and if IDLE is set and IDLEIE enabled, clear it (reading SR and then DR) and call the function port_usart_store_data 
+ * to add the bytes stored by the RX DMA to the RX ring.
+ * The bytes sent are written to the USART Data Register by the TX DMA, so there is no TXE interrupt.
+ * TC is only enabled while a change of baud rate waits for the last byte to be sent: port_usart_tx_idle makes the change.
  * 
  */
 void USART3_IRQHandler(void){
-    port_system_systick_resume();
-    if((USART3 -> SR & USART_SR_RXNE) && (USART3 -> CR1 & USART_CR1_RXNEIE))
+    if((USART3 -> SR & USART_SR_IDLE) && (USART3 -> CR1 & USART_CR1_IDLEIE)){
+        (void)USART3 -> DR;
         port_usart_store_data(USART_0_ID);
-    if((USART3 -> SR & USART_SR_TXE) && (USART3 -> CR1 & USART_CR1_TXEIE))
-        port_usart_write_data(USART_0_ID);
+    }
+    if((USART3 -> SR & USART_SR_TC) && (USART3 -> CR1 & USART_CR1_TCIE)){
+        port_usart_tx_idle(USART_0_ID);
+    }
+    port_system_event_post(SYSTEM_EVENT_USART);
+}
+
+/**
+ * @brief Handles DMA1 Stream1 interrupts, the stream that stores the bytes received by USART3 in its RX ring.
+ * The half and full transfer flags mean that the DMA has filled a half of the ring, so the bytes
+ * are added to the RX ring even if the message has not ended yet.
+ * 
+ */
+void DMA1_Stream1_IRQHandler(void){
+    DMA1->LIFCR = DMA_LIFCR_CHTIF1 | DMA_LIFCR_CTCIF1;
+    port_usart_store_data(USART_0_ID);
+    port_system_event_post(SYSTEM_EVENT_USART);
+}
+
+/**
+ * @brief Handles DMA1 Stream3 interrupts, the stream that sends the messages queued for USART3.
+ * The transfer complete flag means that the first message of the queue has been sent (or dropped, on a transfer error),
+ * so the next one is started straight away.
+ * 
+ */
+void DMA1_Stream3_IRQHandler(void){
+    DMA1->LIFCR = DMA_LIFCR_CTCIF3 | DMA_LIFCR_CTEIF3;
+    port_usart_write_data(USART_0_ID);
+    port_system_event_post(SYSTEM_EVENT_USART);
 }
 
 void TIM2_IRQHandler(void){
     TIM2->SR &= ~TIM_SR_UIF; 
-    buzzers_arr[BUZZER_0_ID].note_end = true;
+    port_buzzer_next_note(BUZZER_0_ID);
+    port_system_event_post(SYSTEM_EVENT_BUZZER);
+}
+
+/**
+ * @brief Handles DMA1 Stream7 interrupts, the stream that feeds the durations of the buzzer sequencer to TIM2.
+ * The half transfer flag means that the first half of the buffer has been played, and the transfer
+ * complete flag that the second half has been played.
+ * 
+ */
+void DMA1_Stream7_IRQHandler(void){
+    if (DMA1->HISR & DMA_HISR_HTIF7)
+    {
+        DMA1->HIFCR = DMA_HIFCR_CHTIF7;
+        port_buzzer_sequencer_half_played(BUZZER_0_ID, 0);
+    }
+    if (DMA1->HISR & DMA_HISR_TCIF7)
+    {
+        DMA1->HIFCR = DMA_HIFCR_CTCIF7;
+        port_buzzer_sequencer_half_played(BUZZER_0_ID, 1);
+    }
+    DMA1->HIFCR = DMA_HIFCR_CTEIF7 | DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7;
+    port_system_event_post(SYSTEM_EVENT_BUZZER);
 }
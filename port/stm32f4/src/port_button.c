@@ -28,6 +28,7 @@ void port_button_init(uint32_t button_id)
     GPIO_TypeDef *p_port = buttons_arr[button_id].p_port;
     uint8_t pin = buttons_arr[button_id].pin;
 
+    ring_buffer_init(&buttons_arr[button_id].edges, buttons_arr[button_id].edges_storage, sizeof(port_button_edge_t), BUTTON_EDGES_LENGTH);
     port_system_gpio_config(p_port, pin, 0x00, GPIO_PUPDR_NOPULL);
     port_system_gpio_config_exti(p_port, pin, TRIGGER_BOTH_EDGE | TRIGGER_ENABLE_INTERR_REQ);
     port_system_gpio_exti_enable(pin, 1, 0);
@@ -39,6 +40,30 @@ bool port_button_is_pressed(uint32_t button_id)
     return flag_pressed;
 }
 
+void port_button_store_edge(uint32_t button_id, bool pressed)
+{
+    port_button_hw_t *p_button = &buttons_arr[button_id];
+    if (pressed == p_button->flag_pressed)
+    {
+        return;
+    }
+    port_button_edge_t edge = {.pressed = pressed, .time_ms = port_system_get_millis()};
+    if (ring_buffer_push(&p_button->edges, &edge))
+    {
+        p_button->flag_pressed = pressed;
+    }
+}
+
+bool port_button_peek_edge(uint32_t button_id, uint32_t index, port_button_edge_t *p_edge)
+{
+    return ring_buffer_peek(&buttons_arr[button_id].edges, index, p_edge);
+}
+
+bool port_button_pop_edge(uint32_t button_id, port_button_edge_t *p_edge)
+{
+    return ring_buffer_pop(&buttons_arr[button_id].edges, p_edge);
+}
+
 uint32_t port_button_get_tick()
 {
     return port_system_get_millis();
@@ -7,13 +7,20 @@
  */
 /* Includes ------------------------------------------------------------------*/
 /* Standard C libraries */
-#include <math.h>
+#include <string.h> // memset
 
 /* HW dependent libraries */
 #include "port_buzzer.h"
 
+/* Other libraries */
+#include "melodies.h"
+
 /* Macros */
 #define ALT_FUNC2_TIM3 0x02 /*!< AFx TIM3_CH1 */
+#define DMA_CHANNEL_TIM2_UP 3       /*!< DMA1 Stream7 channel of TIM2_UP */
+#define DMA_CHANNEL_TIM3_TRIG 5     /*!< DMA1 Stream4 channel of TIM3_TRIG */
+#define TIM_DMA_BURST_ARR 11        /*!< DMA burst base address (DBA) of ARR: offset 0x2C in words */
+#define TIM3_DMA_BURST_LENGTH 2     /*!< DMA burst length (DBL) of a sequencer tone: 3 transfers, ARR, RCR and CCR1 */
 
 /* Global variables */
 
@@ -21,10 +28,103 @@ port_buzzer_hw_t buzzers_arr[] = {
     [BUZZER_0_ID] = {.p_port = BUZZER_0_GPIO,
                      .pin = BUZZER_0_PIN,
                      .alt_func = ALT_FUNC2_TIM3,
-                     .note_end = false},
+                     .next_queued = false,
+                     .measure_gaps = false,
+                     .seq_running = false,
+                     .seq_end_half = -1},
+};
+
+/**
+ * @brief Timer values of every note of `MELODIES_NOTES`, indexed by `note - NOTE_LOWEST`.
+ * The values are computed by the compiler for the `SYSTEM_CORE_CLOCK_HZ` clock.
+ */
+static const port_buzzer_note_timing_t note_timings[NOTES_COUNT] = {
+#define NOTE_TIMING_ENTRY(name, hz) [name - NOTE_LOWEST] = {.psc = BUZZER_PWM_PSC(hz), .arr = BUZZER_PWM_ARR(hz), .ccr = BUZZER_PWM_CCR(hz)},
+    MELODIES_NOTES(NOTE_TIMING_ENTRY)
+#undef NOTE_TIMING_ENTRY
+};
+
+/**
+ * @brief TIM3 values of every note of `MELODIES_NOTES` for the sequencer, which keeps the prescaler fixed.
+ */
+static const port_buzzer_sequencer_tone_t sequencer_tones[NOTES_COUNT] = {
+#define SEQUENCER_TONE_ENTRY(name, hz) [name - NOTE_LOWEST] = {.arr = BUZZER_SEQUENCER_ARR(hz), .rcr = 0, .ccr = BUZZER_SEQUENCER_CCR(hz)},
+    MELODIES_NOTES(SEQUENCER_TONE_ENTRY)
+#undef SEQUENCER_TONE_ENTRY
 };
 
 /* Private functions */
+/**
+ * @brief Gets the TIM3 values of a note for the sequencer. A silence keeps the PWM running with the output always low.
+ * 
+ * @param note MIDI note number of the note or SILENCE
+ * @return port_buzzer_sequencer_tone_t TIM3 values
+ */
+static port_buzzer_sequencer_tone_t _get_sequencer_tone(uint8_t note)
+{
+  if (note < NOTE_LOWEST || note > NOTE_HIGHEST)
+  {
+    port_buzzer_sequencer_tone_t silence = sequencer_tones[0];
+    silence.ccr = 0;
+    return silence;
+  }
+  return sequencer_tones[note - NOTE_LOWEST];
+}
+
+/**
+ * @brief Stops the DMA of the sequencer and gives the timers back their configuration to play notes one by one.
+ * The timers must be stopped.
+ * 
+ * @param buzzer_id ID of the buzzer
+ */
+static void _sequencer_stop(uint32_t buzzer_id)
+{
+  // 1. No more DMA requests, and wait for the streams to finish the transfer in progress
+  TIM2->DIER &= ~TIM_DIER_UDE;
+  TIM3->DIER &= ~TIM_DIER_TDE;
+  DMA1_Stream7->CR &= ~DMA_SxCR_EN;
+  DMA1_Stream4->CR &= ~DMA_SxCR_EN;
+  while ((DMA1_Stream7->CR & DMA_SxCR_EN) || (DMA1_Stream4->CR & DMA_SxCR_EN))
+  {
+  }
+
+  // 2. TIM3 runs on its own again, with preload
+  TIM3->SMCR = 0;
+  TIM3->CR1 |= TIM_CR1_ARPE;
+  TIM3->CCMR1 |= TIM_CCMR1_OC1PE;
+
+  // 3. TIM2 interrupts at the end of the note again. The updates of the sequencer must not be taken as one
+  TIM2->CR2 &= ~TIM_CR2_MMS;
+  TIM2->CR1 |= TIM_CR1_ARPE;
+  TIM2->SR = ~TIM_SR_UIF;
+  TIM2->DIER |= TIM_DIER_UIE;
+
+  buzzers_arr[buzzer_id].seq_running = false;
+}
+
+/**
+ * @brief Adds a gap to the statistics, if they are being measured.
+ * 
+ * @param buzzer_id ID of the buzzer
+ * @param late true if the note was started by the FSM instead of being queued
+ */
+static void _record_gap(uint32_t buzzer_id, bool late)
+{
+  port_buzzer_hw_t *p_buzzer = &buzzers_arr[buzzer_id];
+  if (!p_buzzer->measure_gaps || !p_buzzer->gap_pending)
+  {
+    return;
+  }
+  uint32_t gap = DWT->CYCCNT - p_buzzer->gap_start_cycles;
+  port_buzzer_gap_stats_t *p_stats = &p_buzzer->gap_stats;
+  p_stats->min_cycles = (p_stats->count == 0 || gap < p_stats->min_cycles) ? gap : p_stats->min_cycles;
+  p_stats->max_cycles = (gap > p_stats->max_cycles) ? gap : p_stats->max_cycles;
+  p_stats->total_cycles += gap;
+  p_stats->count++;
+  p_stats->late_count += late;
+  p_buzzer->gap_pending = false;
+}
+
 /**
  * @brief Configures the timer that controls the duration of the note.
  * First enables the clock source, then disable the counter and enables
@@ -98,96 +198,312 @@ static void _timer_pwm_setup(uint32_t buzzer_id)
 
 void port_buzzer_init(uint32_t buzzer_id)
 {
-  port_buzzer_hw_t buzzer = buzzers_arr[buzzer_id];
+  port_buzzer_hw_t *p_buzzer = &buzzers_arr[buzzer_id];
 
-  port_system_gpio_config(buzzer.p_port, buzzer.pin, GPIO_MODE_ALTERNATE, GPIO_PUPDR_NOPULL);
-  port_system_gpio_config_alternate(buzzer.p_port, buzzer.pin, ALT_FUNC2_TIM3);
+  ring_buffer_init(&p_buzzer->note_ends, p_buzzer->note_ends_storage, sizeof(uint32_t), BUZZER_NOTE_ENDS_LENGTH);
+  port_system_gpio_config(p_buzzer->p_port, p_buzzer->pin, GPIO_MODE_ALTERNATE, GPIO_PUPDR_NOPULL);
+  port_system_gpio_config_alternate(p_buzzer->p_port, p_buzzer->pin, ALT_FUNC2_TIM3);
   _timer_duration_setup(buzzer_id);
   _timer_pwm_setup(buzzer_id);
 }
 
-void port_buzzer_set_note_duration(uint32_t buzzer_id, uint32_t duration_ms)
+void port_buzzer_set_note_duration(uint32_t buzzer_id, uint32_t duration_us)
 {
   if (buzzer_id == BUZZER_0_ID)
-  { // creo que esta es la que hay que comprobar
-    // usar timer2 https://moodle.upm.es/titulaciones/oficiales/pluginfile.php/11367877/mod_resource/content/10/2024_SDG2_libro.pdf pagina 78-80
-    //port_buzzer_hw_t buzzer = buzzers_arr[buzzer_id];
+  {
     // 1.
     TIM2->CR1 &= ~TIM_CR1_CEN;
     TIM2->CNT = 0;
 
     // 2.
-    double sysclk_as_double = (double)SystemCoreClock; // Important to cast to double
-    double ms_as_double = (double)duration_ms;         // Important to cast to double
+    TIM2->PSC = BUZZER_DURATION_PSC;
+    TIM2->ARR = (duration_us > 0) ? (duration_us - 1) : 0;
 
-    // 3.
-    double psc = ((sysclk_as_double * ms_as_double / 1000.0) / 65536.0) - 1.0;
+    // 3. Loading the registers must not be taken as the end of a note
+    TIM2->DIER &= ~TIM_DIER_UIE;
+    TIM2->EGR = TIM_EGR_UG;
+    TIM2->SR = ~TIM_SR_UIF;
+    TIM2->DIER |= TIM_DIER_UIE;
 
     // 4.
-    double arr = ((sysclk_as_double * ms_as_double / 1000.0) / (round(psc) + 1.0)) - 1.0;
+    ring_buffer_discard(&buzzers_arr[buzzer_id].note_ends);
+    buzzers_arr[buzzer_id].next_queued = false;
 
     // 5.
-    if (round(arr) > 65535.0)
-    {
-      psc++;
-      arr = ((sysclk_as_double * ms_as_double / 1000.0) / (round(psc) + 1.0)) - 1.0;
-    }
+    TIM2->CR1 |= TIM_CR1_CEN;
+  }
+}
 
-    // 6.
-    TIM2->PSC = (uint32_t)(round(psc));
-    TIM2->ARR = (uint32_t)(round(arr));
+bool port_buzzer_queue_note(uint32_t buzzer_id, uint8_t note, uint32_t duration_us)
+{
+  port_buzzer_hw_t *p_buzzer = &buzzers_arr[buzzer_id];
+  bool queued = false;
 
-    // 7.
-    TIM2->EGR = TIM_EGR_UG;
+  // 1. Precompute the TIM3 values. A silence keeps the PWM running with the output always low
+  port_buzzer_note_timing_t timing = note_timings[0];
+  timing.ccr = 0;
+  if (note >= NOTE_LOWEST && note <= NOTE_HIGHEST)
+  {
+    timing = note_timings[note - NOTE_LOWEST];
+  }
 
-    // 8.
-    buzzers_arr[buzzer_id].note_end = false;
+  // 2. The note must not end while it is being queued, or the interrupt would see half of it. If it has already ended (UIF set,
+  // its interrupt held by the PRIMASK), the preloaded ARR would only be taken at the end of the note after it: refused
+  __disable_irq();
+  if (buzzer_id == BUZZER_0_ID && ring_buffer_is_empty(&p_buzzer->note_ends) && !p_buzzer->next_queued && (TIM2->CR1 & TIM_CR1_CEN) &&
+      !(TIM2->SR & TIM_SR_UIF))
+  {
+    p_buzzer->next_timing = timing;
+    TIM2->ARR = (duration_us > 0) ? (duration_us - 1) : 0; // Preloaded: used from the next update event
+    p_buzzer->next_queued = true;
+    queued = true;
+  }
+  __enable_irq();
+  return queued;
+}
 
-    // 9.
-    TIM2->CR1 |= TIM_CR1_CEN;
+bool port_buzzer_get_queue_free(uint32_t buzzer_id)
+{
+  port_buzzer_hw_t *p_buzzer = &buzzers_arr[buzzer_id];
+  return (ring_buffer_is_empty(&p_buzzer->note_ends) && !p_buzzer->next_queued && (TIM2->CR1 & TIM_CR1_CEN) && !(TIM2->SR & TIM_SR_UIF));
+}
+
+void port_buzzer_next_note(uint32_t buzzer_id)
+{
+  port_buzzer_hw_t *p_buzzer = &buzzers_arr[buzzer_id];
+  uint32_t start_cycles = DWT->CYCCNT;
+
+  if (buzzer_id != BUZZER_0_ID)
+  {
+    return;
   }
+
+  // 1. No note queued: stop, the FSM will decide what to do
+  if (!p_buzzer->next_queued)
+  {
+    TIM3->CR1 &= ~TIM_CR1_CEN;
+    TIM2->CR1 &= ~TIM_CR1_CEN;
+    p_buzzer->gap_start_cycles = start_cycles;
+    p_buzzer->gap_pending = true;
+    ring_buffer_push(&p_buzzer->note_ends, &start_cycles);
+    return;
+  }
+
+  // 2. TIM2 is already counting the duration of the queued note. Load its tone into TIM3 and restart it
+  TIM3->PSC = p_buzzer->next_timing.psc;
+  TIM3->ARR = p_buzzer->next_timing.arr;
+  TIM3->CCR1 = p_buzzer->next_timing.ccr;
+  TIM3->EGR = TIM_EGR_UG;
+  TIM3->CCER |= TIM_CCER_CC1E;
+  TIM3->CR1 |= TIM_CR1_CEN;
+  p_buzzer->next_queued = false;
+
+  // 3.
+  p_buzzer->gap_start_cycles = start_cycles;
+  p_buzzer->gap_pending = true;
+  _record_gap(buzzer_id, false);
 }
 
-bool port_buzzer_get_note_timeout(uint32_t buzzer_id)
+void port_buzzer_set_gap_measurement(uint32_t buzzer_id, bool enable)
 {
-  if (buzzer_id < sizeof(buzzers_arr))
+  port_buzzer_hw_t *p_buzzer = &buzzers_arr[buzzer_id];
+  if (enable)
   {
-    port_buzzer_hw_t buzzer = buzzers_arr[buzzer_id];
-    return buzzer.note_end;
+    // The cycle counter of the DWT is the clock of the measurement
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    memset(&p_buzzer->gap_stats, 0, sizeof(p_buzzer->gap_stats));
   }
-  return false;
+  p_buzzer->gap_pending = false;
+  p_buzzer->measure_gaps = enable;
 }
 
-void port_buzzer_set_note_frequency(uint32_t buzzer_id, double frequency_hz)
-{//meter en if?¿
-  // 1.
-  if (frequency_hz == 0.0)
+void port_buzzer_get_gap_stats(uint32_t buzzer_id, port_buzzer_gap_stats_t *p_stats)
+{
+  __disable_irq();
+  *p_stats = buzzers_arr[buzzer_id].gap_stats;
+  __enable_irq();
+}
+
+void port_buzzer_sequencer_set_record(uint32_t buzzer_id, uint32_t index, uint8_t note, uint32_t duration_us)
+{
+  port_buzzer_hw_t *p_buzzer = &buzzers_arr[buzzer_id];
+  if (index >= BUZZER_SEQUENCER_LENGTH)
   {
-    TIM3->CR1 &= ~TIM_CR1_CEN;
     return;
   }
+  if (duration_us < BUZZER_SEQUENCER_MIN_US)
+  {
+    duration_us = BUZZER_SEQUENCER_MIN_US;
+  }
+  p_buzzer->seq_tones[index] = _get_sequencer_tone(note);
+  p_buzzer->seq_durations[index] = duration_us - 1;
+}
 
-  TIM3->CR1 &= ~TIM_CR1_CEN;
+void port_buzzer_sequencer_set_half_done(uint32_t buzzer_id, uint32_t half, bool last)
+{
+  port_buzzer_hw_t *p_buzzer = &buzzers_arr[buzzer_id];
+  __disable_irq();
+  p_buzzer->seq_free_halves &= ~(1U << half);
+  if (last && p_buzzer->seq_end_half < 0)
+  {
+    p_buzzer->seq_end_half = half;
+  }
+  __enable_irq();
+}
+
+void port_buzzer_sequencer_start(uint32_t buzzer_id, uint8_t note, uint32_t duration_us)
+{
+  port_buzzer_hw_t *p_buzzer = &buzzers_arr[buzzer_id];
+  if (buzzer_id != BUZZER_0_ID)
+  {
+    return;
+  }
+  port_buzzer_sequencer_tone_t tone = _get_sequencer_tone(note);
+
+  // 1. DMA1 Stream7: a duration to TIM2 ARR on every TIM2 update, in a loop, interrupting at each half
+  RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+  DMA1->HIFCR = DMA_HIFCR_CTCIF7 | DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTEIF7 | DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7;
+  DMA1_Stream7->PAR = (uint32_t)&TIM2->ARR;
+  DMA1_Stream7->M0AR = (uint32_t)p_buzzer->seq_durations;
+  DMA1_Stream7->NDTR = BUZZER_SEQUENCER_LENGTH;
+  DMA1_Stream7->CR = (DMA_CHANNEL_TIM2_UP << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_PL_1 | DMA_SxCR_MSIZE_1 | DMA_SxCR_PSIZE_1 |
+                     DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_DIR_0 | DMA_SxCR_HTIE | DMA_SxCR_TCIE;
+
+  // 2. DMA1 Stream4: a tone to TIM3 on every TIM3 trigger, as a burst of halfwords through DMAR
+  DMA1->HIFCR = DMA_HIFCR_CTCIF4 | DMA_HIFCR_CHTIF4 | DMA_HIFCR_CTEIF4 | DMA_HIFCR_CDMEIF4 | DMA_HIFCR_CFEIF4;
+  DMA1_Stream4->PAR = (uint32_t)&TIM3->DMAR;
+  DMA1_Stream4->M0AR = (uint32_t)p_buzzer->seq_tones;
+  DMA1_Stream4->NDTR = BUZZER_SEQUENCER_LENGTH * (sizeof(port_buzzer_sequencer_tone_t) / sizeof(uint16_t));
+  DMA1_Stream4->CR = (DMA_CHANNEL_TIM3_TRIG << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_PL_1 | DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0 |
+                     DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_DIR_0;
+
+  NVIC_SetPriority(DMA1_Stream7_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 3, 0));
+  NVIC_EnableIRQ(DMA1_Stream7_IRQn);
+  DMA1_Stream7->CR |= DMA_SxCR_EN;
+  DMA1_Stream4->CR |= DMA_SxCR_EN;
+
+  // 3. TIM2: first duration, without preload and without interrupt. Loading it must not reach TIM3 nor the DMA
+  TIM2->CR1 &= ~(TIM_CR1_CEN | TIM_CR1_ARPE);
+  TIM2->DIER &= ~TIM_DIER_UIE;
+  TIM2->CNT = 0;
+  TIM2->PSC = BUZZER_DURATION_PSC;
+  TIM2->ARR = ((duration_us > BUZZER_SEQUENCER_MIN_US) ? duration_us : BUZZER_SEQUENCER_MIN_US) - 1;
+  TIM2->EGR = TIM_EGR_UG;
+  TIM2->SR = ~TIM_SR_UIF;
+
+  // 4. TIM3: first tone with the fixed prescaler and without preload
+  TIM3->CR1 &= ~(TIM_CR1_CEN | TIM_CR1_ARPE);
+  TIM3->CCMR1 &= ~TIM_CCMR1_OC1PE;
   TIM3->CNT = 0;
+  TIM3->PSC = BUZZER_SEQUENCER_PSC;
+  TIM3->ARR = tone.arr;
+  TIM3->CCR1 = tone.ccr;
+  TIM3->EGR = TIM_EGR_UG;
+
+  // 5. TIM3 is reset by TIM2 TRGO (ITR1), and the trigger asks for the burst of the next tone
+  TIM3->DCR = (TIM_DMA_BURST_ARR << TIM_DCR_DBA_Pos) | (TIM3_DMA_BURST_LENGTH << TIM_DCR_DBL_Pos);
+  TIM3->SMCR = TIM_SMCR_TS_0 | TIM_SMCR_SMS_2;
+  TIM3->SR = ~TIM_SR_TIF;
+  TIM3->DIER |= TIM_DIER_TDE;
+  TIM2->CR2 = (TIM2->CR2 & ~TIM_CR2_MMS) | TIM_CR2_MMS_1;
+  TIM2->DIER |= TIM_DIER_UDE;
+
+  // 6.
+  p_buzzer->seq_running = true;
+  p_buzzer->seq_end = false;
+  TIM3->CCER |= TIM_CCER_CC1E;
+  TIM3->CR1 |= TIM_CR1_CEN;
+  TIM2->CR1 |= TIM_CR1_CEN;
+}
+
+void port_buzzer_sequencer_pause(uint32_t buzzer_id)
+{
+  if (buzzer_id == BUZZER_0_ID && buzzers_arr[buzzer_id].seq_running)
+  {
+    TIM2->CR1 &= ~TIM_CR1_CEN;
+    TIM3->CR1 &= ~TIM_CR1_CEN;
+  }
+}
+
+void port_buzzer_sequencer_resume(uint32_t buzzer_id)
+{
+  if (buzzer_id == BUZZER_0_ID && buzzers_arr[buzzer_id].seq_running)
+  {
+    TIM3->CR1 |= TIM_CR1_CEN;
+    TIM2->CR1 |= TIM_CR1_CEN;
+  }
+}
+
+int32_t port_buzzer_sequencer_get_free_half(uint32_t buzzer_id)
+{
+  uint8_t free_halves = buzzers_arr[buzzer_id].seq_free_halves;
+  if (free_halves & 0x01)
+  {
+    return 0;
+  }
+  if (free_halves & 0x02)
+  {
+    return 1;
+  }
+  return -1;
+}
+
+bool port_buzzer_sequencer_get_end(uint32_t buzzer_id)
+{
+  return buzzers_arr[buzzer_id].seq_end;
+}
+
+void port_buzzer_sequencer_half_played(uint32_t buzzer_id, uint32_t half)
+{
+  port_buzzer_hw_t *p_buzzer = &buzzers_arr[buzzer_id];
+  if (!p_buzzer->seq_running)
+  {
+    return;
+  }
+
+  // 1. The interrupt comes at the start of the last record of the half, so the padding before it has already
+  // followed the last note
+  if (p_buzzer->seq_end_half == (int8_t)half)
+  {
+    TIM2->CR1 &= ~TIM_CR1_CEN;
+    TIM3->CR1 &= ~TIM_CR1_CEN;
+    _sequencer_stop(buzzer_id);
+    p_buzzer->seq_end = true;
+    return;
+  }
 
   // 2.
-  double sysclk_as_double = (double)SystemCoreClock; // Important to cast to double
-  double s_as_double = 1.0 / frequency_hz;
+  p_buzzer->seq_free_halves |= (1U << half);
+}
 
-  double psc = ((sysclk_as_double * s_as_double) / 65536.0) - 1.0;
-  double arr = ((sysclk_as_double * s_as_double) / (round(psc) + 1.0)) - 1.0;
+bool port_buzzer_get_note_timeout(uint32_t buzzer_id)
+{
+  if (buzzer_id < sizeof(buzzers_arr))
+  {
+    return !ring_buffer_is_empty(&buzzers_arr[buzzer_id].note_ends);
+  }
+  return false;
+}
 
-  if (round(arr) > 65535.0)
+void port_buzzer_set_note(uint32_t buzzer_id, uint8_t note)
+{
+  // 1.
+  TIM3->CR1 &= ~TIM_CR1_CEN;
+  if (note < NOTE_LOWEST || note > NOTE_HIGHEST)
   {
-    psc++;
-    arr = ((sysclk_as_double * s_as_double) / (round(psc) + 1.0)) - 1.0;
+    _record_gap(buzzer_id, true);
+    return;
   }
 
-  TIM3->PSC = (uint32_t)(round(psc));
-  TIM3->ARR = (uint32_t)(round(arr));
+  // 2.
+  const port_buzzer_note_timing_t *p_timing = &note_timings[note - NOTE_LOWEST];
+  TIM3->CNT = 0;
+  TIM3->PSC = p_timing->psc;
+  TIM3->ARR = p_timing->arr;
 
   // 3.
-  TIM3->CCR1 = BUZZER_PWM_DC*(TIM3->ARR+1);
+  TIM3->CCR1 = p_timing->ccr;
 
   // 4.
   TIM3->EGR = TIM_EGR_UG;
@@ -197,6 +513,9 @@ void port_buzzer_set_note_frequency(uint32_t buzzer_id, double frequency_hz)
 
   // 6.
   TIM3->CR1 |= TIM_CR1_CEN;
+
+  // 7. A note that was not queued in time
+  _record_gap(buzzer_id, true);
 }
 
 void port_buzzer_stop(uint32_t buzzer_id)
@@ -206,6 +525,15 @@ void port_buzzer_stop(uint32_t buzzer_id)
     if(buzzer_id == BUZZER_0_ID){
       TIM3->CR1 &= ~TIM_CR1_CEN;/*CCER &= ~TIM_CCER_CC1E;*/ // aqui en realidad estamos activando el output compare, creo que es lo que pide
       TIM2->CR1 &= ~TIM_CR1_CEN;
+      buzzers_arr[buzzer_id].next_queued = false;
+      buzzers_arr[buzzer_id].gap_pending = false; // Pauses and stops are not gaps
+      if (buzzers_arr[buzzer_id].seq_running)
+      {
+        _sequencer_stop(buzzer_id);
+      }
+      buzzers_arr[buzzer_id].seq_free_halves = 0;
+      buzzers_arr[buzzer_id].seq_end_half = -1;
+      buzzers_arr[buzzer_id].seq_end = false;
     }
     
   //}
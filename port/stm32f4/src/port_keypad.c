@@ -35,8 +35,11 @@ const uint32_t clo_state[4]={
 						(GPIO_BSRR_BS4|GPIO_BSRR_BS5|GPIO_BSRR_BS6|GPIO_BSRR_BR7)
 };
 
-
-
+/**
+ * @brief Flag to indicate that a row has gone low since the interrupts were enabled. Set by the EXTI interrupts.
+ * 
+ */
+static volatile bool keypad_woken = false;
 
 void port_keypad_init(void)
 {
@@ -58,6 +61,42 @@ void port_keypad_init(void)
 	/*Set PC4 to PC7 as high*/
 
 	GPIOC->BSRR = GPIO_BSRR_BS4|GPIO_BSRR_BS5|GPIO_BSRR_BS6|GPIO_BSRR_BS7;
+
+	/*A key pressed pulls its row down: falling edge interrupts on PC0 to PC3*/
+	for (uint8_t pin=0;pin<4;pin++)
+	{
+		port_system_gpio_config_exti(GPIOC, pin, TRIGGER_FALLING_EDGE | TRIGGER_ENABLE_INTERR_REQ);
+		port_system_gpio_exti_enable(pin, KEYPAD_0_EXTI_PRIO, 0);
+	}
+	port_keypad_enable_interrupts();
+}
+
+void port_keypad_enable_interrupts(void)
+{
+	/*Set PC4 to PC7 as low: any key pressed pulls its row down*/
+	GPIOC->BSRR = GPIO_BSRR_BR4|GPIO_BSRR_BR5|GPIO_BSRR_BR6|GPIO_BSRR_BR7;
+	keypad_woken = false;
+	EXTI->PR = KEYPAD_0_ROWS_MASK;
+	EXTI->IMR |= KEYPAD_0_ROWS_MASK;
+
+	/*A key still down, or pressed before unmasking, has no edge left to interrupt*/
+	if ((GPIOC->IDR & KEYPAD_0_ROWS_MASK) != KEYPAD_0_ROWS_MASK)
+	{
+		port_keypad_row_interrupt();
+	}
+}
+
+bool port_keypad_check_woken(void)
+{
+	return keypad_woken;
+}
+
+void port_keypad_row_interrupt(void)
+{
+	EXTI->IMR &= ~KEYPAD_0_ROWS_MASK;
+	EXTI->PR = KEYPAD_0_ROWS_MASK;
+	keypad_woken = true;
+	port_system_event_post(SYSTEM_EVENT_KEYPAD);
 }
 
 
@@ -12,7 +12,12 @@
 #define HSI_VALUE ((uint32_t)16000000) /*!< Value of the Internal oscillator in Hz */
 
 /* GLOBAL VARIABLES */
-static volatile uint32_t msTicks = 0; /*!< Variable to store millisecond ticks. @warning **It must be declared volatile!** Just because it is modified in an ISR. **Add it to the definition** after *static*. */
+static port_system_timer_t *p_wheel_slots[SYSTEM_TIMER_WHEEL_SLOTS] = {NULL}; /*!< Lists of the timers of each slot of the wheel. Shared with the TIM5 ISR, so they are changed with the interrupts masked */
+static uint32_t wheel_used[SYSTEM_TIMER_WHEEL_WORDS] = {0}; /*!< Bitmap of the slots with timers, to find the next one without visiting the empty ones */
+static uint32_t wheel_time_ms = 0; /*!< Time up to which the slots of the wheel have been expired */
+static uint32_t awake_start_cycles = 0; /*!< Cycle count of the last wakeup */
+static volatile uint32_t system_events = 0; /*!< Pending events of the main loop (`SYSTEM_EVENT_*`). Posted from ISRs and FSM actions */
+static port_system_loop_stats_t loop_stats = {0}; /*!< Counters of the main loop */
 
 /* These variables are declared extern in CMSIS (system_stm32f4xx.h) */
 uint32_t SystemCoreClock = HSI_VALUE;                                               /*!< Frequency of the System clock */
@@ -46,11 +51,130 @@ void SystemInit(void)
 #endif                                                 /* USER_VECT_TAB_ADDRESS */
 }
 
+/**
+ * @brief Start TIM5 as a free-running millisecond counter. Its compare channel 1 is the interrupt of the timer wheel.
+ *
+ * TIM5 is 32 bits wide, so it wraps around after 49 days, as the SysTick counter did.
+ */
+static void _timebase_setup(void)
+{
+  RCC->APB1ENR |= RCC_APB1ENR_TIM5EN;
+  TIM5->CR1 = 0;
+  TIM5->PSC = SYSTEM_TIMEBASE_PSC;
+  TIM5->ARR = 0xFFFFFFFFU;
+  TIM5->CNT = 0;
+  TIM5->EGR = TIM_EGR_UG; // Load the prescaler
+  TIM5->SR = 0;
+  TIM5->DIER = 0;
+  TIM5->CR1 |= TIM_CR1_CEN;
+
+  NVIC_SetPriority(TIM5_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), SYSTEM_TIMEBASE_IRQ_PRIO, 0));
+  NVIC_EnableIRQ(TIM5_IRQn);
+}
+
+/**
+ * @brief Find the first slot in use of the wheel from a time on, using the bitmap.
+ *
+ * @param from_ms time of the first slot to look at.
+ * @param max_distance number of slots to look at, up to `SYSTEM_TIMER_WHEEL_SLOTS`.
+ * @return uint32_t distance from `from_ms` to the slot found, or `max_distance` if there is none.
+ */
+static uint32_t _wheel_find(uint32_t from_ms, uint32_t max_distance)
+{
+  uint32_t distance = 0;
+  while (distance < max_distance)
+  {
+    uint32_t slot = (from_ms + distance) & SYSTEM_TIMER_WHEEL_MASK;
+    uint32_t bits = wheel_used[slot / 32] >> (slot % 32); // This slot and the next ones of the same word
+    if (bits != 0)
+    {
+      distance += __CLZ(__RBIT(bits)); // Trailing zeros
+      return (distance < max_distance) ? distance : max_distance;
+    }
+    distance += 32 - (slot % 32);
+  }
+  return max_distance;
+}
+
+/**
+ * @brief Add a timer to the slot of its expiry time.
+ *
+ * @param p_timer pointer to the timer.
+ */
+static void _wheel_insert(port_system_timer_t *p_timer)
+{
+  uint32_t slot = p_timer->expiry_ms & SYSTEM_TIMER_WHEEL_MASK;
+  p_timer->p_prev = NULL;
+  p_timer->p_next = p_wheel_slots[slot];
+  if (p_timer->p_next != NULL)
+  {
+    p_timer->p_next->p_prev = p_timer;
+  }
+  p_wheel_slots[slot] = p_timer;
+  wheel_used[slot / 32] |= BIT_POS_TO_MASK(slot % 32);
+}
+
+/**
+ * @brief Remove a timer from its slot.
+ *
+ * @param p_timer pointer to the timer.
+ */
+static void _wheel_remove(port_system_timer_t *p_timer)
+{
+  uint32_t slot = p_timer->expiry_ms & SYSTEM_TIMER_WHEEL_MASK;
+  if (p_timer->p_prev != NULL)
+  {
+    p_timer->p_prev->p_next = p_timer->p_next;
+  }
+  else
+  {
+    p_wheel_slots[slot] = p_timer->p_next;
+  }
+  if (p_timer->p_next != NULL)
+  {
+    p_timer->p_next->p_prev = p_timer->p_prev;
+  }
+  if (p_wheel_slots[slot] == NULL)
+  {
+    wheel_used[slot / 32] &= ~BIT_POS_TO_MASK(slot % 32);
+  }
+}
+
+/**
+ * @brief Program the compare of TIM5 at a time. If it has already passed, the compare interrupt is generated by software, so it can't be missed.
+ *
+ * @param time_ms time of the interrupt.
+ */
+static void _wheel_compare(uint32_t time_ms)
+{
+  TIM5->CCR1 = time_ms;
+  TIM5->DIER |= TIM_DIER_CC1IE;
+  if ((int32_t)(time_ms - TIM5->CNT) <= 0)
+  {
+    TIM5->EGR = TIM_EGR_CC1G;
+  }
+}
+
+/**
+ * @brief Program the compare of TIM5 at the next slot in use after the ones already expired, or disable it if the wheel is empty.
+ * It must be called with the interrupts masked.
+ */
+static void _wheel_program(void)
+{
+  uint32_t distance = _wheel_find(wheel_time_ms + 1, SYSTEM_TIMER_WHEEL_SLOTS);
+  if (distance == SYSTEM_TIMER_WHEEL_SLOTS)
+  {
+    TIM5->DIER &= ~TIM_DIER_CC1IE;
+    return;
+  }
+  _wheel_compare(wheel_time_ms + 1 + distance);
+}
+
 /**
  * @brief System Clock Configuration
  *
  * @attention This function should NOT be accesible from the outside to avoid configuration problems.
- * @note This function starts a system timer that generates a SysTick every 1 ms.
+ * @note This function starts the timebase (TIM5), which counts milliseconds without interrupting every millisecond.
  * @retval None
  */
 void system_clock_config(void)
@@ -83,7 +207,7 @@ void system_clock_config(void)
   SystemCoreClock = HSI_VALUE >> AHBPrescTable[(RCC->CFGR & RCC_CFGR_HPRE) >> RCC_CFGR_HPRE_Pos];
 
   /* Configure the source of time base considering new system clocks settings */
-  SysTick_Config(SystemCoreClock / (1000U / TICK_FREQ_1KHZ)); /* Set Systick to 1 ms */
+  _timebase_setup();
 }
 
 size_t port_system_init()
@@ -102,9 +226,9 @@ size_t port_system_init()
   /* Set Interrupt Group Priority */
   NVIC_SetPriorityGrouping(NVIC_PRIORITY_GROUP_4);
 
-  /* Use systick as time base source and configure 1ms tick (default clock after Reset is HSI) */
-  /* Configure the SysTick IRQ priority. It must be the highest (lower number: 0)*/
-  NVIC_SetPriority(SysTick_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0U, 0U)); /* Tick interrupt priority */
+  /* The cycle counter of the DWT measures the time the CPU is awake */
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 
   /* Init the low level hardware */
   /* Reset and clock control (RCC) */
@@ -125,13 +249,122 @@ size_t port_system_init()
 uint32_t port_system_get_millis()
 {
   // 1.
-  return msTicks;
+  return TIM5->CNT;
+}
+
+uint32_t port_system_get_cycles(void)
+{
+  return DWT->CYCCNT;
 }
 
 void port_system_set_millis(uint32_t ms)
 {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
   // 1.
-  msTicks=ms;
+  TIM5->CNT = ms;
+  // 2.
+  _wheel_program();
+  __set_PRIMASK(primask);
+}
+
+void port_system_timer_init(port_system_timer_t *p_timer, uint32_t events, port_system_timer_callback_t callback, void *p_arg)
+{
+  p_timer->p_next = NULL;
+  p_timer->p_prev = NULL;
+  p_timer->expiry_ms = 0;
+  p_timer->period_ms = 0;
+  p_timer->events = events;
+  p_timer->callback = callback;
+  p_timer->p_arg = p_arg;
+  p_timer->running = false;
+}
+
+void port_system_timer_start(port_system_timer_t *p_timer, uint32_t delay_ms, uint32_t period_ms)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (p_timer->running)
+  {
+    _wheel_remove(p_timer);
+  }
+  p_timer->expiry_ms = TIM5->CNT + ((delay_ms > 0) ? delay_ms : 1); // Always after the slots already expired
+  p_timer->period_ms = period_ms;
+  p_timer->running = true;
+  _wheel_insert(p_timer);
+
+  // The compare is moved only if this timer is earlier than the slot programmed
+  if (!(TIM5->DIER & TIM_DIER_CC1IE) || (int32_t)(p_timer->expiry_ms - TIM5->CCR1) < 0)
+  {
+    _wheel_compare(p_timer->expiry_ms);
+  }
+  __set_PRIMASK(primask);
+}
+
+void port_system_timer_stop(port_system_timer_t *p_timer)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (p_timer->running)
+  {
+    _wheel_remove(p_timer); // The compare is left as it is: at most, one interrupt with nothing to do
+    p_timer->running = false;
+  }
+  __set_PRIMASK(primask);
+}
+
+bool port_system_timer_is_running(const port_system_timer_t *p_timer)
+{
+  return p_timer->running;
+}
+
+void port_system_timer_expire(void)
+{
+  // 1. Slots the time has gone through since the last expiry, all of them after a whole turn
+  uint32_t now = TIM5->CNT;
+  uint32_t span = now - wheel_time_ms;
+  if (span > SYSTEM_TIMER_WHEEL_SLOTS)
+  {
+    span = SYSTEM_TIMER_WHEEL_SLOTS;
+  }
+
+  // 2. Expire the due timers of the slots in use. The ones of later turns stay
+  uint32_t distance = _wheel_find(wheel_time_ms + 1, span);
+  while (distance < span)
+  {
+    uint32_t slot = (wheel_time_ms + 1 + distance) & SYSTEM_TIMER_WHEEL_MASK;
+    port_system_timer_t *p_timer = p_wheel_slots[slot];
+    while (p_timer != NULL)
+    {
+      if ((int32_t)(p_timer->expiry_ms - now) > 0)
+      {
+        p_timer = p_timer->p_next;
+        continue;
+      }
+      _wheel_remove(p_timer);
+      if (p_timer->period_ms > 0)
+      {
+        // Next period after now, without catching up with the ones missed
+        p_timer->expiry_ms += p_timer->period_ms * (1 + (now - p_timer->expiry_ms) / p_timer->period_ms);
+        _wheel_insert(p_timer);
+      }
+      else
+      {
+        p_timer->running = false;
+      }
+      port_system_event_post(p_timer->events);
+      if (p_timer->callback != NULL)
+      {
+        p_timer->callback(p_timer->p_arg);
+      }
+      p_timer = p_wheel_slots[slot]; // The callback may have started or stopped timers of this slot
+    }
+    distance += 1 + _wheel_find(wheel_time_ms + 2 + distance, span - distance - 1);
+  }
+
+  // 3.
+  wheel_time_ms = now;
+  _wheel_program();
 }
 
 void port_system_delay_ms(uint32_t ms)
@@ -154,16 +387,6 @@ void port_system_delay_until_ms(uint32_t *p_t, uint32_t ms)
   *p_t = port_system_get_millis();
 }
 
-void port_system_systick_suspend()
-{
-  SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
-}
-
-void port_system_systick_resume()
-{
-  SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
-}
-
 //------------------------------------------------------
 // GPIO RELATED FUNCTIONS
 //------------------------------------------------------
@@ -310,6 +533,66 @@ void port_system_power_sleep()
 
 void port_system_sleep()
 {
-  port_system_systick_suspend();
-  port_system_power_sleep();
+  port_system_event_wait();
+}
+
+//------------------------------------------------------
+// EVENTS OF THE MAIN LOOP
+//------------------------------------------------------
+void port_system_event_post(uint32_t events)
+{
+  uint32_t pending;
+  do
+  {
+    pending = __LDREXW(&system_events);
+  } while (__STREXW(pending | events, &system_events)); // An interrupt in between makes the store fail, so it is retried
+}
+
+uint32_t port_system_event_take(void)
+{
+  uint32_t pending;
+  do
+  {
+    pending = __LDREXW(&system_events);
+  } while (__STREXW(0, &system_events));
+  loop_stats.iterations++;
+  return pending;
+}
+
+void port_system_event_wait(void)
+{
+  __disable_irq();
+  if (system_events == 0)
+  {
+    loop_stats.awake_cycles += DWT->CYCCNT - awake_start_cycles;
+    __WFI(); // Wakes up with a pending interrupt even if they are masked
+    awake_start_cycles = DWT->CYCCNT;
+    loop_stats.wakeups++;
+  }
+  __enable_irq();
+}
+
+void port_system_get_loop_stats(port_system_loop_stats_t *p_stats)
+{
+  __disable_irq();
+  *p_stats = loop_stats;
+  p_stats->awake_cycles += DWT->CYCCNT - awake_start_cycles; // Including the time awake until now
+  __enable_irq();
+}
+
+//------------------------------------------------------
+// TRACE
+//------------------------------------------------------
+uint32_t port_system_trace_write(const uint32_t *p_words, uint32_t count)
+{
+  uint32_t written = 0;
+  if (!(ITM->TCR & ITM_TCR_ITMENA_Msk) || !(ITM->TER & BIT_POS_TO_MASK(SYSTEM_TRACE_ITM_PORT)))
+  {
+    return count;
+  }
+  while (written < count && ITM->PORT[SYSTEM_TRACE_ITM_PORT].u32 != 0) // Reads 1 while the FIFO has room
+  {
+    ITM->PORT[SYSTEM_TRACE_ITM_PORT].u32 = p_words[written++];
+  }
+  return written;
 }
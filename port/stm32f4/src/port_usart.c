@@ -23,24 +23,200 @@ port_usart_hw_t usart_arr[] = {
                     .pin_rx = USART_0_PIN_RX, 
                     .alt_func_tx = USART_0_AF_TX, 
                     .alt_func_rx = USART_0_AF_RX, 
-                    .input_buffer = {EMPTY_BUFFER_CONSTANT}, 
-                    .i_idx = 0, 
+                    .rx_dma_stream = USART_0_RX_DMA_STREAM,
+                    .rx_dma_channel = USART_0_RX_DMA_CHANNEL,
                     .read_complete = false, 
-                    .output_buffer = {EMPTY_BUFFER_CONSTANT}, 
-                    .o_idx = 0, 
-                    .write_complete = false},
+                    .baud = USART_0_BAUD,
+                    .tx_dma_stream = USART_0_TX_DMA_STREAM,
+                    .tx_dma_channel = USART_0_TX_DMA_CHANNEL,
+                    .tx_busy = false,
+                    .raw_mode = false},
 };
 
 /* Private functions */
 /**
- * @brief Using the function memset set the value of the buffer given 
- * to default with EMPTY_BUFFER_CONSTANT.
+ * @brief Start sending the first message of the TX queue, if any. Called with the TX DMA stopped: from its transfer
+ * complete interrupt, or with the interrupts masked.
  * 
- * @param buffer pointer to the buffer to be reset.
- * @param length length of the buffer.
+ * @param usart_id ID of the USART.
  */
-void _reset_buffer(char *buffer,uint32_t length){
-    memset(buffer, EMPTY_BUFFER_CONSTANT, length);
+static void _tx_start_next(uint32_t usart_id){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    DMA_Stream_TypeDef *p_stream = p_usart->tx_dma_stream;
+    port_usart_tx_descriptor_t descriptor;
+
+    // 1. A flow control character goes before the next message: the sender is paused or resumed without waiting for the queue
+    if(p_usart->baud_pending == 0 && p_usart->tx_flow_char != 0){
+        p_usart->tx_flow_byte = p_usart->tx_flow_char;
+        p_usart->tx_flow_char = 0;
+        p_usart->tx_flow_sending = true;
+        descriptor.p_data = &p_usart->tx_flow_byte;
+        descriptor.length = 1;
+    }
+    // 2. Nothing else to send, or held until the baud rate changes
+    else if(p_usart->baud_pending != 0 || !ring_buffer_peek(&p_usart->tx_queue, 0, &descriptor)){
+        if(p_usart->tx_busy){
+            p_usart->tx_stats.busy_cycles += DWT->CYCCNT - p_usart->tx_busy_start_cycles;
+        }
+        p_usart->tx_busy = false;
+        return;
+    }
+
+    // 3. Only USART_0 (DMA1 Stream3) has a TX DMA, so the flags are the ones of Stream3
+    if(!p_usart->tx_busy){
+        p_usart->tx_busy_start_cycles = DWT->CYCCNT;
+    }
+    p_usart->tx_busy = true;
+    DMA1->LIFCR = DMA_LIFCR_CFEIF3 | DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CTEIF3 | DMA_LIFCR_CHTIF3 | DMA_LIFCR_CTCIF3;
+    p_stream->M0AR = (uint32_t)descriptor.p_data;
+    p_stream->NDTR = descriptor.length;
+    p_usart->p_usart->SR = ~USART_SR_TC;                // rc_w0: cleared before each transfer, as the reference manual asks, so TC only means the end of this one
+    p_stream->CR |= DMA_SxCR_EN;
+}
+
+/**
+ * @brief Start the TX DMA if it is not sending. The message queued is sent after the ones already queued otherwise.
+ * 
+ * @param usart_id ID of the USART.
+ */
+static void _tx_kick(uint32_t usart_id){
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();                                    // The transfer complete interrupt must not start the same message
+    if(!usart_arr[usart_id].tx_busy){
+        _tx_start_next(usart_id);
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Send a flow control character without waiting for the transmitter.
+ * 
+ * The character skips the TX queue: the TX DMA sends it at once if it is idle, or right after the message it is sending.
+ * A character not sent yet is replaced by the new one, which is the one that counts for the sender.
+ * 
+ * @param usart_id ID of the USART.
+ * @param flow_char flow control character to send.
+ */
+static void _send_flow_char(uint32_t usart_id, char flow_char){
+    usart_arr[usart_id].tx_flow_char = flow_char;
+    _tx_kick(usart_id);
+}
+
+/**
+ * @brief Get the frequency of the clock of the USART. USART3 is on APB1.
+ * 
+ * @return uint32_t frequency in Hz.
+ */
+static uint32_t _get_clock_hz(void){
+    return SystemCoreClock >> APBPrescTable[(RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos];
+}
+
+/**
+ * @brief Get the divider of the clock of the USART for a baud rate, in 1/16 (OVER8 = 0) or 1/8 (OVER8 = 1) of bit, which is
+ * the clock divided by the baud rate, rounded, in both cases.
+ * 
+ * @param baud baud rate.
+ * @return uint32_t divider, or 0 if it is lower than 8 (baud rate too high for the clock).
+ */
+static uint32_t _get_divider(uint32_t baud){
+    uint32_t divider = (_get_clock_hz() + baud / 2) / baud;
+    return (divider < 8 || divider > 0xFFFF) ? 0 : divider;
+}
+
+/**
+ * @brief Write the divider of a baud rate to BRR, with OVER8 only if the divider is lower than 16. The USART is disabled while
+ * it is written, so the byte being received, if any, is lost.
+ * 
+ * @param usart_id ID of the USART.
+ * @param baud baud rate, already checked with port_usart_check_baud().
+ */
+static void _write_baud(uint32_t usart_id, uint32_t baud){
+    USART_TypeDef *p_usart = usart_arr[usart_id].p_usart;
+    uint32_t divider = _get_divider(baud);
+    uint32_t enabled = p_usart->CR1 & USART_CR1_UE;
+
+    p_usart->CR1 &= ~USART_CR1_UE;
+    if(divider < 16){
+        p_usart->CR1 |= USART_CR1_OVER8;
+        p_usart->BRR = ((divider & ~0x7UL) << 1) | (divider & 0x7UL);                // Mantissa from bit 4, 3 bits of fraction
+    }else{
+        p_usart->CR1 &= ~USART_CR1_OVER8;
+        p_usart->BRR = divider;                                                     // Mantissa from bit 4, 4 bits of fraction
+    }
+    p_usart->CR1 |= enabled;
+    usart_arr[usart_id].baud = baud;
+}
+
+/**
+ * @brief Empty the RX ring and start the RX DMA from its first byte, in circular mode.
+ * 
+ * The DMA stores each byte received from the Data Register (DR) without waking the CPU. Its half and full transfer
+ * interrupts update the RX ring, so it is updated at least every half ring, besides at the end of each message (IDLE line).
+ * 
+ * @param usart_id ID of the USART.
+ */
+static void _rx_dma_start(uint32_t usart_id){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    DMA_Stream_TypeDef *p_stream = p_usart->rx_dma_stream;
+
+    // 1. Stop the stream. Only USART_0 (DMA1 Stream1) has a RX DMA, so the flags are the ones of Stream1
+    p_stream->CR &= ~DMA_SxCR_EN;
+    while(p_stream->CR & DMA_SxCR_EN){
+        // Wait for the current transfer to end
+    }
+    DMA1->LIFCR = DMA_LIFCR_CFEIF1 | DMA_LIFCR_CDMEIF1 | DMA_LIFCR_CTEIF1 | DMA_LIFCR_CHTIF1 | DMA_LIFCR_CTCIF1;
+
+    // 2. Empty the RX ring and forget the line being received
+    ring_buffer_init(&p_usart->rx_ring, p_usart->rx_storage, sizeof(uint8_t), USART_RX_RING_LENGTH);
+    p_usart->rx_dma_position = 0;
+    p_usart->line_scanned = 0;
+    p_usart->line_length = 0;
+    p_usart->read_complete = false;
+    (void)p_usart->p_usart->SR;                                                     // Clear the RXNE, ORE and IDLE flags of the bytes received while stopped
+    (void)p_usart->p_usart->DR;
+
+    // 3. Bytes from DR to the RX ring, in circular mode, with the half and full transfer interrupts
+    p_stream->PAR = (uint32_t)&p_usart->p_usart->DR;
+    p_stream->M0AR = (uint32_t)p_usart->rx_storage;
+    p_stream->NDTR = USART_RX_RING_LENGTH;
+    p_stream->CR = (p_usart->rx_dma_channel << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_HTIE | DMA_SxCR_TCIE;
+    p_stream->CR |= DMA_SxCR_EN;
+}
+
+/**
+ * @brief Point `p_line` to the line received, of `line_scanned` bytes. It is only copied to `line_wrap` if it wraps around the end of the RX ring.
+ * 
+ * @param usart_id ID of the USART.
+ */
+static void _set_line(uint32_t usart_id){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    void *p_span;
+    uint32_t span = ring_buffer_get_span(&p_usart->rx_ring, 0, &p_span);
+    p_usart->line_length = p_usart->line_scanned;
+    if(span >= p_usart->line_length){
+        p_usart->p_line = p_span;                                                   // Zero copy
+        return;
+    }
+    if(p_usart->line_length > USART_LINE_MAX_LENGTH){
+        p_usart->line_length = USART_LINE_MAX_LENGTH;
+    }
+    memcpy(p_usart->line_wrap, p_span, span);
+    ring_buffer_get_span(&p_usart->rx_ring, span, &p_span);                          // The rest is at the start of the ring
+    memcpy(p_usart->line_wrap + span, p_span, p_usart->line_length - span);
+    p_usart->p_line = p_usart->line_wrap;
+}
+
+/**
+ * @brief Pause the sender if the RX ring is getting full in raw mode.
+ * 
+ * @param usart_id ID of the USART.
+ */
+static void _check_raw_level(uint32_t usart_id){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    if (ring_buffer_get_count(&p_usart->rx_ring) >= USART_RAW_XOFF_LEVEL && !p_usart->raw_paused){
+        _send_flow_char(usart_id, USART_XOFF_CHAR);
+        p_usart->raw_paused = true;
+    }
 }
 
 
@@ -68,15 +244,15 @@ void port_usart_init(uint32_t usart_id)
     p_usart -> CR2 &= ~ USART_CR2_STOP ; // Limpiamos los bits STOP (1 bit)
     /* Configuramos el bit de paridad a no paridad */
     p_usart -> CR1 &= ~ USART_CR1_PCE ; // Limpiamos el bit PCE ( no paridad )
-    /* Aseguramos oversampling de 16 ( por defecto ) */
-    p_usart -> CR1 &= ~ USART_CR1_OVER8 ; // Limpiamos el bit OVER8 (oversampling de 16)
+    /* El oversampling (16 u 8) lo elige _write_baud() segun el baud rate */
 
 
     /* Habilitamos la transmision y la recepcion */
 
     /* No habilitamos las i n t e r r u p c i o n e s de transmision generalmente al inicio ,
     sino solo cuando es necesario */
-    p_usart -> CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_TCIE);                                          // 7. Disable reception and transmission interrupts
+    p_usart -> CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_IDLEIE | USART_CR1_TCIE);                       // 7. Disable reception and transmission interrupts
+    p_usart -> CR3 |= USART_CR3_DMAR | USART_CR3_DMAT;                                               // The bytes are read by the RX DMA and written by the TX DMA
 
     p_usart -> SR &= ~USART_SR_RXNE;                                                                 // 8. Clear the interrupt flags RXNE
 
@@ -88,95 +264,322 @@ void port_usart_init(uint32_t usart_id)
         NVIC_SetPriority(USART3_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 2, 0));       // 9. Interrupcion USART prioridad 2 y subprioridad 0
         
         NVIC_EnableIRQ(USART3_IRQn);                                                                // 10. Activamos las interruciones de USART globalmente
+        // Same priority as USART3: both update the RX ring, so one must not interrupt the other
+        NVIC_SetPriority(USART_0_RX_DMA_IRQ, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 2, 0));
+        NVIC_EnableIRQ(USART_0_RX_DMA_IRQ);
+        NVIC_SetPriority(USART_0_TX_DMA_IRQ, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 2, 0));
+        NVIC_EnableIRQ(USART_0_TX_DMA_IRQ);
+        RCC -> AHB1ENR |= RCC_AHB1ENR_DMA1EN;
         RCC -> APB1ENR |= RCC_APB1ENR_USART3EN;                                                     // 3. Enable the clock for the USART peripheral
     }
 
-    /* Configuramos el baud rate ( ver ejemplo de calculo ) */
-    p_usart -> BRR = BRR_9600_8_N_1; // 9600 baudios                                                 // 5. Configuracion 9600-8-N-1
+    /* Configuramos el baud rate a partir del reloj del bus (SystemCoreClock y el prescaler de APB1) */
+    usart_arr[usart_id].baud_pending = 0;
+    _write_baud(usart_id, usart_arr[usart_id].baud);                                                // 5. Configuracion 8-N-1 a USART_0_BAUD
 
     p_usart -> CR1 |= USART_CR1_TE | USART_CR1_RE ;                                                  // 6. Enable transmission and reception
 
     p_usart -> CR1 |= USART_CR1_UE;                                                                  // 11. Activamos la USART
 
-    _reset_buffer(usart_arr[usart_id].input_buffer, USART_INPUT_BUFFER_LENGTH);                   // 12. Reseteamos el input_buffer
-
-    _reset_buffer(usart_arr[usart_id].output_buffer, USART_OUTPUT_BUFFER_LENGTH);                 // 13. Reseteamos el output_buffer   
+    ring_buffer_init(&usart_arr[usart_id].rx_ring, usart_arr[usart_id].rx_storage, sizeof(uint8_t), USART_RX_RING_LENGTH); // 12. Vaciamos el RX ring
+
+    // 13. Empty TX queue, and TX DMA from memory to DR, one byte per TXE, with an interrupt per message
+    port_usart_hw_t *p_hw = &usart_arr[usart_id];
+    ring_buffer_init(&p_hw->tx_queue, p_hw->tx_queue_storage, sizeof(port_usart_tx_descriptor_t), USART_TX_QUEUE_LENGTH);
+    ring_buffer_init(&p_hw->tx_arena, p_hw->tx_arena_storage, sizeof(uint8_t), USART_TX_ARENA_LENGTH);
+    p_hw->tx_busy = false;
+    p_hw->tx_flow_char = 0;
+    p_hw->tx_flow_sending = false;
+    p_hw->tx_dropped = 0;
+    port_usart_reset_tx_stats(usart_id);
+    p_hw->tx_dma_stream->CR &= ~DMA_SxCR_EN;
+    p_hw->tx_dma_stream->PAR = (uint32_t)&p_usart->DR;
+    p_hw->tx_dma_stream->CR = (p_hw->tx_dma_channel << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_TCIE | DMA_SxCR_TEIE;
 }
 
-void port_usart_get_from_input_buffer(uint32_t usart_id, char *p_buffer){
-    memcpy(p_buffer, usart_arr[usart_id].input_buffer, USART_INPUT_BUFFER_LENGTH);
+uint32_t port_usart_get_line(uint32_t usart_id, const char **pp_line){
+    *pp_line = usart_arr[usart_id].p_line;
+    return usart_arr[usart_id].line_length;
 }
 
 bool port_usart_get_txr_status(uint32_t usart_id){
     return (usart_arr[usart_id].p_usart->SR & USART_SR_TXE);
 }
 
-void port_usart_copy_to_output_buffer(uint32_t usart_id, char *p_data, uint32_t length){
-    memset(usart_arr[usart_id].output_buffer, EMPTY_BUFFER_CONSTANT, USART_OUTPUT_BUFFER_LENGTH);
-    memcpy(usart_arr[usart_id].output_buffer, p_data, length);
+bool port_usart_send(uint32_t usart_id, const char *p_data, uint32_t length){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    uint32_t start_cycles = DWT->CYCCNT;
+    if(length == 0){
+        return true;
+    }
+
+    // 1. Room for the bytes, and for two descriptors in case they wrap around the end of the arena
+    if(!port_usart_check_tx_room(usart_id, length)){
+        p_usart->tx_dropped++;
+        return false;
+    }
+
+    // 2. Copy the bytes, with a descriptor per contiguous span of the arena
+    while(length > 0){
+        void *p_span;
+        uint32_t span = ring_buffer_get_free_span(&p_usart->tx_arena, &p_span);
+        if(span > length){
+            span = length;
+        }
+        memcpy(p_span, p_data, span);
+        ring_buffer_produce(&p_usart->tx_arena, span);
+        port_usart_tx_descriptor_t descriptor = {.p_data = p_span, .length = span, .copied = true};
+        ring_buffer_push(&p_usart->tx_queue, &descriptor);
+        p_data += span;
+        length -= span;
+    }
+
+    // 3.
+    _tx_kick(usart_id);
+    p_usart->tx_stats.cpu_cycles += DWT->CYCCNT - start_cycles;
+    return true;
 }
 
-void port_usart_reset_input_buffer(uint32_t usart_id){
-    _reset_buffer(usart_arr[usart_id].input_buffer, USART_INPUT_BUFFER_LENGTH);
-    usart_arr[usart_id].read_complete = false;
+bool port_usart_send_const(uint32_t usart_id, const char *p_data, uint32_t length){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    uint32_t start_cycles = DWT->CYCCNT;
+    if(length == 0){
+        return true;
+    }
+    port_usart_tx_descriptor_t descriptor = {.p_data = (const uint8_t *)p_data, .length = length, .copied = false};
+    if(length > UINT16_MAX || !ring_buffer_push(&p_usart->tx_queue, &descriptor)){
+        p_usart->tx_dropped++;
+        return false;
+    }
+    _tx_kick(usart_id);
+    p_usart->tx_stats.cpu_cycles += DWT->CYCCNT - start_cycles;
+    return true;
+}
+
+bool port_usart_check_tx_room(uint32_t usart_id, uint32_t length){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    return (length <= USART_TX_ARENA_LENGTH - ring_buffer_get_count(&p_usart->tx_arena) &&
+            USART_TX_QUEUE_LENGTH - ring_buffer_get_count(&p_usart->tx_queue) >= 2);
 }
 
-void port_usart_reset_output_buffer(uint32_t usart_id){
-    _reset_buffer(usart_arr[usart_id].output_buffer, USART_OUTPUT_BUFFER_LENGTH);
-    usart_arr[usart_id].write_complete = false;
+uint32_t port_usart_get_tx_dropped(uint32_t usart_id){
+    return usart_arr[usart_id].tx_dropped;
+}
+
+void port_usart_reset_input_buffer(uint32_t usart_id){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    if(p_usart->read_complete){
+        ring_buffer_consume(&p_usart->rx_ring, p_usart->line_scanned + 1);          // The line and its end
+    }
+    p_usart->line_scanned = 0;
+    p_usart->line_length = 0;
+    p_usart->read_complete = false;
 }
 
 bool port_usart_rx_done(uint32_t usart_id){
-    return usart_arr[usart_id].read_complete;
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    if(p_usart->raw_mode || p_usart->read_complete){
+        return p_usart->read_complete;
+    }
+
+    // 1. The DMA does not wait: if it has overwritten bytes not read, the line is lost
+    if(ring_buffer_get_count(&p_usart->rx_ring) > USART_RX_RING_LENGTH){
+        ring_buffer_discard(&p_usart->rx_ring);
+        p_usart->line_scanned = 0;
+        return false;
+    }
+
+    // 2. A line that starts with USART_FRAME_CHAR is a binary frame: it ends with the next one, since it can have any other byte
+    void *p_span;
+    uint32_t span;
+    uint8_t end_char = END_CHAR_CONSTANT;
+    if(ring_buffer_get_span(&p_usart->rx_ring, 0, &p_span) > 0 && *(const uint8_t *)p_span == USART_FRAME_CHAR){
+        end_char = USART_FRAME_CHAR;
+        p_usart->line_scanned = (p_usart->line_scanned > 0) ? p_usart->line_scanned : 1;
+    }
+
+    // 3. Look for the end of line in the bytes not looked at yet, one span of the ring at a time
+    while((span = ring_buffer_get_span(&p_usart->rx_ring, p_usart->line_scanned, &p_span)) > 0){
+        const char *p_end = memchr(p_span, end_char, span);
+        if(p_end != NULL){
+            p_usart->line_scanned += p_end - (const char *)p_span;
+            _set_line(usart_id);
+            p_usart->read_complete = true;
+            return true;
+        }
+        p_usart->line_scanned += span;
+    }
+
+    // 4. A full ring with no end of line is not a line
+    if(p_usart->line_scanned >= USART_RX_RING_LENGTH){
+        ring_buffer_discard(&p_usart->rx_ring);
+        p_usart->line_scanned = 0;
+    }
+    return false;
 }
 
 bool port_usart_tx_done(uint32_t usart_id){
-    return usart_arr[usart_id].write_complete;
+    return ring_buffer_is_empty(&usart_arr[usart_id].tx_queue);
 }
 
 void port_usart_store_data(uint32_t usart_id){
-    char data = (usart_arr[usart_id].p_usart->DR & USART_DR_DR);                     //Retrieve data in DR register
-    if(data != END_CHAR_CONSTANT){
-        uint8_t i_idx = usart_arr[usart_id].i_idx;              // retrieve input data index
-        if(i_idx >= USART_INPUT_BUFFER_LENGTH){
-            usart_arr[usart_id].i_idx = 0;                      // Reset input buffer index
-        }
-        usart_arr[usart_id].input_buffer[i_idx] = data;         //Load data in input buffer
-        usart_arr[usart_id].i_idx++;                            //update input buffer index
-    }else{
-        usart_arr[usart_id].read_complete = true;               //set usart_arr[usart_id].read_complete
-        usart_arr[usart_id].i_idx = 0;                          // Reset input buffer index
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    uint32_t position = (USART_RX_RING_LENGTH - p_usart->rx_dma_stream->NDTR) & (USART_RX_RING_LENGTH - 1);   // NDTR counts down
+    uint32_t count = (position - p_usart->rx_dma_position) & (USART_RX_RING_LENGTH - 1);                        // Never a whole ring: there is an interrupt every half
+    p_usart->rx_dma_position = position;
+    if(count == 0){
+        return;
+    }
+    if(!ring_buffer_produce(&p_usart->rx_ring, count)){
+        p_usart->raw_overrun = true;                            // Bytes not read overwritten: in raw mode, the sender ignored the XOFF
+    }else if(p_usart->raw_mode){
+        _check_raw_level(usart_id);
     }
 }
 
 void port_usart_write_data(uint32_t usart_id){
-    uint8_t o_idx = usart_arr[usart_id].o_idx;                  // retrieve input data index
-    char data = usart_arr[usart_id].output_buffer[o_idx];
-    if(o_idx == USART_OUTPUT_BUFFER_LENGTH-1 || data == END_CHAR_CONSTANT){
-        (usart_arr[usart_id].p_usart->DR)=data;                 // load data in DR register
-        port_usart_disable_tx_interrupt(usart_id);              // Disable USART TX interrupts
-        usart_arr[usart_id].o_idx = 0;                          // Reset output buffer index
-        usart_arr[usart_id].write_complete = true;              // update write_complete
-    }else{
-        if(data != EMPTY_BUFFER_CONSTANT){
-            (usart_arr[usart_id].p_usart->DR)=data;             // Load data in DR register
-            usart_arr[usart_id].o_idx++;                        // update outputbuffer index
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    port_usart_tx_descriptor_t descriptor;
+    uint32_t start_cycles = DWT->CYCCNT;
+    if(p_usart->tx_flow_sending){
+        p_usart->tx_flow_sending = false;                                           // Not a message of the queue
+        p_usart->tx_stats.bytes += 1 - p_usart->tx_dma_stream->NDTR;
+    }else if(ring_buffer_pop(&p_usart->tx_queue, &descriptor)){
+        p_usart->tx_stats.bytes += descriptor.length - p_usart->tx_dma_stream->NDTR;   // NDTR is not 0 only after a transfer error
+        if(descriptor.copied){
+            ring_buffer_consume(&p_usart->tx_arena, descriptor.length);            // Free the copy of the message sent
         }
     }
+    _tx_start_next(usart_id);
+    p_usart->tx_stats.cpu_cycles += DWT->CYCCNT - start_cycles;
 }
 
-void port_usart_enable_rx_interrupt (uint32_t usart_id) {
-    usart_arr[usart_id].p_usart -> CR1 |= USART_CR1_RXNEIE;
+void port_usart_get_tx_stats(uint32_t usart_id, port_usart_tx_stats_t *p_stats){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();                                    // The TX DMA interrupt updates them
+    *p_stats = p_usart->tx_stats;
+    if(p_usart->tx_busy){
+        p_stats->busy_cycles += DWT->CYCCNT - p_usart->tx_busy_start_cycles;   // Including the time sending until now
+    }
+    __set_PRIMASK(primask);
 }
 
-void port_usart_enable_tx_interrupt (uint32_t usart_id) {
-    usart_arr[usart_id].p_usart -> CR1 |= USART_CR1_TXEIE;
+void port_usart_reset_tx_stats(uint32_t usart_id){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    p_usart->tx_stats.bytes = 0;
+    p_usart->tx_stats.busy_cycles = 0;
+    p_usart->tx_stats.cpu_cycles = 0;
+    p_usart->tx_busy_start_cycles = DWT->CYCCNT;
+    __set_PRIMASK(primask);
+}
+
+bool port_usart_check_baud(uint32_t usart_id, uint32_t baud, uint32_t *p_actual){
+    if(baud < USART_BAUD_MIN || baud > USART_BAUD_MAX){
+        return false;
+    }
+    uint32_t divider = _get_divider(baud);
+    if(divider == 0){
+        return false;
+    }
+    uint32_t actual = _get_clock_hz() / divider;
+    if(p_actual != NULL){
+        *p_actual = actual;
+    }
+    uint32_t error = (actual > baud) ? actual - baud : baud - actual;
+    return ((uint64_t)error * 1000 <= (uint64_t)baud * USART_BAUD_MAX_ERROR_PERMILLE);
+}
+
+bool port_usart_set_baud(uint32_t usart_id, uint32_t baud){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    if(!port_usart_check_baud(usart_id, baud, NULL)){
+        return false;
+    }
+
+    // 1. Hold the messages queued from now on, and wait for the last byte to leave the shift register
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    p_usart->baud_pending = baud;
+    p_usart->p_usart->CR1 |= USART_CR1_TCIE;
+    __set_PRIMASK(primask);
+
+    // 2. If it has already left, TC is set and the interrupt makes the change straight away
+    return true;
+}
+
+uint32_t port_usart_get_baud(uint32_t usart_id){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    return (p_usart->baud_pending != 0) ? p_usart->baud_pending : p_usart->baud;
+}
+
+void port_usart_tx_idle(uint32_t usart_id){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    if(p_usart->tx_busy || p_usart->baud_pending == 0){
+        return;                                         // TC is cleared when each transfer starts, and set again at the end of the message
+    }
+    p_usart->p_usart->CR1 &= ~USART_CR1_TCIE;
+    _write_baud(usart_id, p_usart->baud_pending);
+    p_usart->baud_pending = 0;
+    _tx_start_next(usart_id);
+}
+
+void port_usart_enable_rx_interrupt (uint32_t usart_id) {
+    _rx_dma_start(usart_id);
+    usart_arr[usart_id].p_usart -> CR1 |= USART_CR1_IDLEIE;
 }
 
 void port_usart_disable_rx_interrupt (uint32_t usart_id) {
-    usart_arr[usart_id].p_usart -> CR1 &= ~(USART_CR1_RXNEIE);
+    usart_arr[usart_id].p_usart -> CR1 &= ~(USART_CR1_IDLEIE);
+    usart_arr[usart_id].rx_dma_stream -> CR &= ~DMA_SxCR_HTIE & ~DMA_SxCR_TCIE & ~DMA_SxCR_EN;
+}
+
+void port_usart_enable_raw_rx(uint32_t usart_id){
+    usart_arr[usart_id].raw_paused = false;
+    usart_arr[usart_id].raw_overrun = false;
+    usart_arr[usart_id].raw_mode = true;
+}
+
+void port_usart_disable_raw_rx(uint32_t usart_id){
+    usart_arr[usart_id].raw_mode = false;
+    usart_arr[usart_id].line_scanned = 0;                                           // The bytes left are looked at from the start
+    usart_arr[usart_id].read_complete = false;
+    if(usart_arr[usart_id].raw_paused){
+        _send_flow_char(usart_id, USART_XON_CHAR);                                  // The sender is never left paused
+        usart_arr[usart_id].raw_paused = false;
+    }
+}
+
+uint32_t port_usart_read_raw(uint32_t usart_id, uint8_t *p_data, uint32_t max_length){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    uint32_t length = 0;
+    void *p_span;
+    uint32_t span;
+    while(length < max_length && (span = ring_buffer_get_span(&p_usart->rx_ring, length, &p_span)) > 0){
+        if(span > max_length - length){
+            span = max_length - length;
+        }
+        memcpy(p_data + length, p_span, span);
+        length += span;
+    }
+    return length;
+}
+
+void port_usart_release_raw(uint32_t usart_id, uint32_t length){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    ring_buffer_consume(&p_usart->rx_ring, length);
+    if(p_usart->raw_paused && ring_buffer_get_count(&p_usart->rx_ring) <= USART_RAW_XON_LEVEL){
+        _send_flow_char(usart_id, USART_XON_CHAR);
+        p_usart->raw_paused = false;
+    }
+}
+
+bool port_usart_get_raw_overrun(uint32_t usart_id){
+    return usart_arr[usart_id].raw_overrun;
 }
 
-void port_usart_disable_tx_interrupt (uint32_t usart_id) {
-    usart_arr[usart_id].p_usart -> CR1 &= ~(USART_CR1_TXEIE);
+bool port_usart_get_raw_pending(uint32_t usart_id){
+    port_usart_hw_t *p_usart = &usart_arr[usart_id];
+    return !ring_buffer_is_empty(&p_usart->rx_ring) || p_usart->raw_paused;
 }
@@ -0,0 +1,228 @@
+/**
+ * @file command_fuzz.c
+ * @brief Host fuzz harness of the command parser: the tokenizer, the splitter of `;`, the numbers and the schemas of
+ * `command_table.c`, with the lines that the jukebox parses in place in the RX ring of the USART.
+ *
+ * First a list of lines with their expected results is checked. Then millions of lines, random or made of names, numbers
+ * and quotes, are split and executed. Each line is copied to the very end of its own heap block, so that AddressSanitizer
+ * reports any read past its length, and every slice returned must lie inside the line.
+ *
+ * Build and run from the root of the repository (the sanitizers of GCC or Clang):
+ *
+ *     cc -O1 -g -std=c11 -fsanitize=address,undefined -fno-sanitize-recover=all -Icommon/include \
+ *        tools/command_fuzz.c common/src/command_table.c -o command_fuzz
+ *     ./command_fuzz [lines]
+ *
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-17
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C libraries */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Other libraries */
+#include "command_table.h"
+
+/* Defines ------------------------------------------------------------------*/
+#define FUZZ_DEFAULT_LINES 2000000      /*!< Random lines executed by default */
+#define FUZZ_MAX_LINE 96                /*!< Longest random line */
+
+/* Global variables -----------------------------------------------------------*/
+static uint32_t fuzz_failures = 0;                  /*!< Number of checks failed */
+static uint32_t fuzz_calls = 0;                     /*!< Number of handlers called */
+static command_arg_t fuzz_args[COMMAND_MAX_ARGS];   /*!< Arguments of the last handler called */
+static const char *p_fuzz_line = NULL;              /*!< Line being executed */
+static uint32_t fuzz_line_length = 0;               /*!< Length of the line being executed */
+
+/* Private functions ---------------------------------------------------------*/
+/**
+ * @brief Count and print a failed check.
+ *
+ * @param ok result of the check.
+ * @param p_what description of the check.
+ */
+static void _check(bool ok, const char *p_what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", p_what);
+        fuzz_failures++;
+    }
+}
+
+/**
+ * @brief Check that a slice lies inside the line being executed.
+ */
+static bool _inside(command_slice_t slice)
+{
+    return slice.p_start >= p_fuzz_line && slice.p_start + slice.length <= p_fuzz_line + fuzz_line_length;
+}
+
+/**
+ * @brief Handler of every command: it keeps the arguments and checks that their text is inside the line.
+ */
+static void _handler(void *p_context, const command_arg_t *p_args)
+{
+    (void)p_context;
+    fuzz_calls++;
+    memcpy(fuzz_args, p_args, sizeof(fuzz_args));
+    for (uint32_t i = 0; i < COMMAND_MAX_ARGS; i++)
+    {
+        if (p_args[i].present && !_inside(p_args[i].text))
+        {
+            _check(false, "argument out of the line");
+        }
+    }
+}
+
+/**
+ * @brief Commands with every kind of schema: none, required and optional arguments of each type, and two arguments.
+ */
+static const command_t fuzz_commands[] = {
+    {"play", _handler, {COMMAND_ARG_NONE}, 0, "", ""},
+    {"speed", _handler, {COMMAND_ARG_DOUBLE}, 1, "", ""},
+    {"info", _handler, {COMMAND_ARG_INT}, 0, "", ""},
+    {"macro", _handler, {COMMAND_ARG_STRING, COMMAND_ARG_STRING}, 0, "", ""},
+    {"two", _handler, {COMMAND_ARG_INT, COMMAND_ARG_STRING}, 1, "", ""},
+};
+
+/**
+ * @brief Copy a line to the end of a heap block of its exact length and execute it, checking every slice.
+ *
+ * @param p_table pointer to the table.
+ * @param p_text line, not null terminated in the copy.
+ * @param length length of the line.
+ * @return uint32_t one of `COMMAND_RESULT`.
+ */
+static uint32_t _execute(const command_table_t *p_table, const char *p_text, uint32_t length)
+{
+    char *p_line = malloc(length > 0 ? length : 1);
+    memcpy(p_line, p_text, length);
+    p_fuzz_line = p_line;
+    fuzz_line_length = length;
+
+    // 1. The commands of the line, one by one, as the jukebox runs them
+    command_slice_t rest = {.p_start = p_line, .length = length};
+    command_slice_t command;
+    while (command_split(&rest, &command))
+    {
+        _check(_inside(command) && _inside(rest), "command split out of the line");
+        command_slice_t tokens[COMMAND_MAX_TOKENS];
+        uint32_t count;
+        command_tokenize(command.p_start, command.length, tokens, COMMAND_MAX_TOKENS, &count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            _check(_inside(tokens[i]), "token out of the line");
+        }
+    }
+
+    // 2. The whole line as a single command
+    uint32_t result = command_table_execute(p_table, NULL, p_line, length, NULL);
+    free(p_line);
+    return result;
+}
+
+/**
+ * @brief Execute a null terminated line.
+ */
+static uint32_t _run(const command_table_t *p_table, const char *p_text)
+{
+    return _execute(p_table, p_text, (uint32_t)strlen(p_text));
+}
+
+/**
+ * @brief Check the lines whose result is known.
+ *
+ * @param p_table pointer to the table.
+ */
+static void _check_known_lines(const command_table_t *p_table)
+{
+    _check(_run(p_table, "") == COMMAND_EMPTY && _run(p_table, " \t\r") == COMMAND_EMPTY, "empty lines");
+    _check(_run(p_table, "play") == COMMAND_OK && _run(p_table, "\"play\"") == COMMAND_OK, "play");
+    _check(_run(p_table, "play 1") == COMMAND_WRONG_ARGS, "play with an argument");
+    _check(_run(p_table, "pla") == COMMAND_NOT_FOUND && _run(p_table, "playx") == COMMAND_NOT_FOUND, "names not found");
+    _check(_run(p_table, "speed 1.5") == COMMAND_OK && fuzz_args[0].double_value == 1.5, "speed 1.5");
+    _check(_run(p_table, "speed -.5") == COMMAND_OK && fuzz_args[0].double_value == -0.5, "speed -.5");
+    _check(_run(p_table, "speed .") == COMMAND_WRONG_ARGS && _run(p_table, "speed 1.2.3") == COMMAND_WRONG_ARGS, "wrong numbers");
+    _check(_run(p_table, "speed") == COMMAND_WRONG_ARGS, "required argument missing");
+    _check(_run(p_table, "info -2147483648") == COMMAND_OK && fuzz_args[0].int_value == INT32_MIN, "smallest integer");
+    _check(_run(p_table, "info 2147483647") == COMMAND_OK && fuzz_args[0].int_value == INT32_MAX, "largest integer");
+    _check(_run(p_table, "info 2147483648") == COMMAND_WRONG_ARGS && _run(p_table, "info -") == COMMAND_WRONG_ARGS, "integers out of range");
+    _check(_run(p_table, "info 12a") == COMMAND_WRONG_ARGS, "integer with letters");
+    _check(_run(p_table, "info") == COMMAND_OK && !fuzz_args[0].present, "optional argument missing");
+    _check(_run(p_table, "two 3 \"a b\"") == COMMAND_OK && fuzz_args[1].text.length == 3, "quoted argument");
+    _check(_run(p_table, "two 3 \"\"") == COMMAND_OK && fuzz_args[1].text.length == 0, "empty quoted argument");
+    _check(_run(p_table, "two 3 \"a b") == COMMAND_WRONG_QUOTES && _run(p_table, "two 3 \"a\"b") == COMMAND_WRONG_QUOTES, "quotes not closed");
+    _check(_run(p_table, "two 3 a\"b") == COMMAND_WRONG_QUOTES, "quote in a word");
+    _check(_run(p_table, "two 1 2 3") == COMMAND_TOO_MANY_TOKENS, "too many tokens");
+    _check(_run(p_table, "macro m \"play; speed 2\"") == COMMAND_OK && fuzz_args[1].text.length == 13, "separator between quotes");
+}
+
+/* Main -----------------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    static const char alphabet[] = " \t\r\";;--+..0123456789playspeedinfomacrotwo";
+    static const char *p_words[] = {"play", "speed", "info", "macro", "two", "1", "-3", "2.5", "\"a b\"", "\"", "x", " ", "\t", ";", "\"a;b\""};
+    uint32_t lines = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 10) : FUZZ_DEFAULT_LINES;
+    command_table_t table;
+
+    // 1.
+    if (!command_table_init(&table, fuzz_commands, sizeof(fuzz_commands) / sizeof(fuzz_commands[0])))
+    {
+        printf("FAIL: no seed for the commands\n");
+        return 1;
+    }
+    _check_known_lines(&table);
+
+    // 2. Random lines: characters of the alphabet, or words of the commands joined with and without spaces
+    uint32_t random = 1, executed = 0;
+    for (uint32_t line = 0; line < lines; line++)
+    {
+        char text[FUZZ_MAX_LINE];
+        uint32_t length = 0;
+        random = random * 1103515245U + 12345U;
+        if ((random >> 16) & 1)
+        {
+            random = random * 1103515245U + 12345U;
+            for (uint32_t i = (random >> 16) % FUZZ_MAX_LINE; i > 0; i--)
+            {
+                random = random * 1103515245U + 12345U;
+                text[length++] = alphabet[(random >> 16) % (sizeof(alphabet) - 1)];
+            }
+        }
+        else
+        {
+            random = random * 1103515245U + 12345U;
+            for (uint32_t i = (random >> 16) % 8; i > 0; i--)
+            {
+                random = random * 1103515245U + 12345U;
+                const char *p_word = p_words[(random >> 16) % (sizeof(p_words) / sizeof(p_words[0]))];
+                uint32_t word_length = (uint32_t)strlen(p_word);
+                if (length + word_length + 1 > FUZZ_MAX_LINE)
+                {
+                    break;
+                }
+                memcpy(&text[length], p_word, word_length);
+                length += word_length;
+                if ((random >> 20) % 4 != 0)
+                {
+                    text[length++] = ' ';
+                }
+            }
+        }
+        executed += (_execute(&table, text, length) == COMMAND_OK);
+    }
+
+    if (fuzz_failures > 0)
+    {
+        printf("%lu checks failed\n", (unsigned long)fuzz_failures);
+        return 1;
+    }
+    printf("OK: %lu lines, %lu executed, %lu handlers called\n", (unsigned long)lines, (unsigned long)executed, (unsigned long)fuzz_calls);
+    return 0;
+}
@@ -0,0 +1,172 @@
+/**
+ * @file command_table_check.c
+ * @brief Host check of the perfect hash of the command table: a seed with no collisions is found for the commands of the
+ * jukebox, and for tables of every size up to `COMMAND_TABLE_MAX_COMMANDS`.
+ *
+ * The names of the jukebox are read from the `jukebox_commands` table of `common/src/fsm_jukebox.c`, which can't be built
+ * on the computer, so the check always uses the commands of the firmware it comes with. `fsm_jukebox_init()` stops the
+ * jukebox if its table has no seed; this check finds it before flashing.
+ *
+ * Build and run from the root of the repository:
+ *
+ *     cc -O2 -std=c11 -Icommon/include tools/command_table_check.c common/src/command_table.c -o command_table_check
+ *     ./command_table_check [common/src/fsm_jukebox.c]
+ *
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-17
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C libraries */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Other libraries */
+#include "command_table.h"
+
+/* Defines ------------------------------------------------------------------*/
+#define CHECK_SOURCE "common/src/fsm_jukebox.c"    /*!< Default file with the `jukebox_commands` table */
+#define CHECK_TABLE_START "jukebox_commands[] = {"  /*!< Start of the table in the source */
+#define CHECK_MAX_NAME 16                           /*!< Longest name of a command, including the terminator */
+#define CHECK_RANDOM_TABLES 1000                    /*!< Tables of random names tried for each size */
+
+/* Global variables -----------------------------------------------------------*/
+static char check_names[COMMAND_TABLE_MAX_COMMANDS][CHECK_MAX_NAME];   /*!< Names of the commands being checked */
+static command_t check_commands[COMMAND_TABLE_MAX_COMMANDS];           /*!< Commands being checked */
+
+/* Private functions ---------------------------------------------------------*/
+/**
+ * @brief Handler of the commands of the check. It is never called.
+ */
+static void _handler(void *p_context, const command_arg_t *p_args)
+{
+    (void)p_context;
+    (void)p_args;
+}
+
+/**
+ * @brief Read the names of the `jukebox_commands` table: the first string of each row `{"name", ...`.
+ *
+ * @param p_path path of fsm_jukebox.c.
+ * @return uint32_t number of names read, or 0 if the table is not found.
+ */
+static uint32_t _read_jukebox_names(const char *p_path)
+{
+    char line[512];
+    uint32_t count = 0;
+    bool in_table = false;
+    FILE *p_file = fopen(p_path, "r");
+    if (p_file == NULL)
+    {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), p_file) != NULL && count < COMMAND_TABLE_MAX_COMMANDS)
+    {
+        const char *p = line + strspn(line, " \t");
+        if (!in_table)
+        {
+            in_table = (strstr(line, CHECK_TABLE_START) != NULL);
+        }
+        else if (!strncmp(p, "};", 2))
+        {
+            break;
+        }
+        else if (!strncmp(p, "{\"", 2))
+        {
+            size_t length = strcspn(p + 2, "\"");
+            if (length > 0 && length < CHECK_MAX_NAME)
+            {
+                memcpy(check_names[count], p + 2, length);
+                check_names[count][length] = '\0';
+                count++;
+            }
+        }
+    }
+    fclose(p_file);
+    return count;
+}
+
+/**
+ * @brief Build a table with the first `count` names and check that every name is found, and only its command.
+ *
+ * @param count number of commands.
+ * @param p_seed pointer to store the seed found.
+ * @return true the table has been built and every lookup is right.
+ * @return false there is no seed, or a lookup is wrong.
+ */
+static bool _check_table(uint32_t count, uint32_t *p_seed)
+{
+    command_table_t table;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        command_t command = {.p_name = check_names[i], .handler = _handler, .arg_types = {COMMAND_ARG_NONE}, .required_args = 0, .p_summary = "", .p_help = ""};
+        check_commands[i] = command;
+    }
+    if (!command_table_init(&table, check_commands, count))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        command_slice_t name = {.p_start = check_names[i], .length = strlen(check_names[i])};
+        if (command_table_find(&table, name) != &check_commands[i])
+        {
+            return false;
+        }
+    }
+    *p_seed = table.seed;
+    return true;
+}
+
+/* Main -----------------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    const char *p_path = (argc > 1) ? argv[1] : CHECK_SOURCE;
+    uint32_t seed;
+
+    // 1. The commands of the jukebox
+    uint32_t count = _read_jukebox_names(p_path);
+    if (count == 0)
+    {
+        printf("FAIL: no commands found in %s\n", p_path);
+        return 1;
+    }
+    if (!_check_table(count, &seed))
+    {
+        printf("FAIL: no seed for the %lu commands of the jukebox\n", (unsigned long)count);
+        return 1;
+    }
+    printf("%lu commands of the jukebox: seed %lu\n", (unsigned long)count, (unsigned long)seed);
+
+    // 2. Random names of 2 to 9 letters, for every size up to the limit. The largest seed shows the margin left
+    uint32_t random = 1, max_seed = 0;
+    for (uint32_t size = 1; size <= COMMAND_TABLE_MAX_COMMANDS; size++)
+    {
+        for (uint32_t t = 0; t < CHECK_RANDOM_TABLES; t++)
+        {
+            for (uint32_t i = 0; i < size; i++)
+            {
+                random = random * 1103515245U + 12345U;
+                uint32_t length = 2 + (random >> 16) % 8;
+                for (uint32_t k = 0; k < length; k++)
+                {
+                    random = random * 1103515245U + 12345U;
+                    check_names[i][k] = (char)('a' + (random >> 16) % 26);
+                }
+                snprintf(check_names[i] + length, CHECK_MAX_NAME - length, "%lu", (unsigned long)i); // Different names
+            }
+            if (!_check_table(size, &seed))
+            {
+                printf("FAIL: no seed for a table of %lu random commands\n", (unsigned long)size);
+                return 1;
+            }
+            max_seed = (seed > max_seed) ? seed : max_seed;
+        }
+    }
+    printf("%d random tables of 1 to %d commands: largest seed %lu of %d\n", CHECK_RANDOM_TABLES, COMMAND_TABLE_MAX_COMMANDS,
+           (unsigned long)max_seed, COMMAND_TABLE_MAX_SEEDS);
+    printf("OK\n");
+    return 0;
+}
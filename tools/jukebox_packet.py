@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""
+@file jukebox_packet.py
+@brief Host client of the binary packets of the jukebox (COBS framing and CRC16).
+
+A packet is the opcode, a request ID, the payload and the CRC16 (CCITT, polynomial
+0x1021, initial value 0xFFFF, little endian) of the three, encoded with COBS and sent
+between two zero bytes. The reply has the opcode with bit 0x80 set and the same ID;
+its first byte is the result, followed by the status of the player:
+
+    action (u8), state (u8), melody (u16), next note (u16), notes (u16), speed x100 (u16)
+
+See JUKEBOX_OPCODE and JUKEBOX_PACKET_RESULT in common/include/fsm_jukebox.h. Text
+commands keep working on the same port: bytes outside frames are printed as text.
+
+Usage:
+    python3 tools/jukebox_packet.py --port /dev/ttyACM0 [--baud 9600] OP [ARG]
+    python3 tools/jukebox_packet.py --hex OP [ARG]          (only print the frame)
+
+OP is status, play, stop, pause, next, select N, speed X (1.5), info N or command TEXT.
+
+Only the Python standard library is used.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+
+OPCODES = {'status': 0x01, 'play': 0x02, 'stop': 0x03, 'pause': 0x04, 'next': 0x05,
+           'select': 0x06, 'speed': 0x07, 'info': 0x08, 'command': 0x09}
+RESULTS = ['ok', 'wrong opcode', 'wrong payload', 'not found', 'wrong frame']
+ACTIONS = ['stop', 'play', 'pause']
+STATES = ['off', 'start up', 'wait command', 'sleep while off', 'sleep while on', 'load melody']
+REPLY = 0x80
+
+
+class PacketError(Exception):
+    """Frame that can't be decoded."""
+
+
+# ----------------------------------------------------------------------------
+# Framing
+# ----------------------------------------------------------------------------
+def crc16(data, crc=0xFFFF):
+    """CRC16 CCITT, as packet_crc16()."""
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_encode(data):
+    """COBS, as packet_cobs_encode()."""
+    out = bytearray([0])
+    code_idx, code = 0, 1
+    for byte in data:
+        if byte:
+            out.append(byte)
+            code += 1
+        if not byte or code == 0xFF:
+            out[code_idx] = code
+            code_idx, code = len(out), 1
+            out.append(0)
+    out[code_idx] = code
+    return bytes(out)
+
+
+def cobs_decode(data):
+    """Inverse of cobs_encode()."""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise PacketError('not COBS')
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def encode(opcode, request_id, payload=b''):
+    """Frame of a packet, with both delimiters."""
+    data = bytes([opcode, request_id]) + payload
+    return b'\0' + cobs_encode(data + struct.pack('<H', crc16(data))) + b'\0'
+
+
+def decode(frame):
+    """(opcode, id, payload) of a frame without delimiters."""
+    data = cobs_decode(frame)
+    if len(data) < 4 or crc16(data[:-2]) != struct.unpack('<H', data[-2:])[0]:
+        raise PacketError('wrong CRC')
+    return data[0], data[1], data[2:-2]
+
+
+def describe(opcode, payload):
+    """Text of the payload of a reply."""
+    if not payload:
+        return 'empty reply'
+    result = RESULTS[payload[0]] if payload[0] < len(RESULTS) else 'result %d' % payload[0]
+    if opcode == OPCODES['info'] | REPLY and payload[0] == 0 and len(payload) >= 3:
+        return '%s: %d notes, "%s"' % (result, struct.unpack('<H', payload[1:3])[0], payload[3:].decode('latin-1'))
+    if len(payload) >= 11:
+        action, state, melody, note, notes, speed = struct.unpack('<BBHHHH', payload[1:11])
+        return '%s: %s, %s, melody %d, note %d of %d, speed %.2f' % (
+            result, ACTIONS[action] if action < len(ACTIONS) else action,
+            STATES[state] if state < len(STATES) else state, melody, note, notes, speed / 100)
+    return result
+
+
+# ----------------------------------------------------------------------------
+# Serial port
+# ----------------------------------------------------------------------------
+def open_port(path, baud):
+    """Open a serial port raw, 8N1."""
+    import termios
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    attrs = termios.tcgetattr(fd)
+    speed = getattr(termios, 'B%d' % baud)
+    attrs[0] = 0                                                   # iflag
+    attrs[1] = 0                                                   # oflag
+    attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL        # cflag
+    attrs[3] = 0                                                   # lflag
+    attrs[4] = attrs[5] = speed
+    attrs[6][termios.VMIN] = 0
+    attrs[6][termios.VTIME] = 1
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def transact(fd, opcode, request_id, frame, timeout):
+    """Send a frame and wait for its reply, printing the text received meanwhile."""
+    os.write(fd, frame)
+    buffer = b''
+    end = time.time() + timeout
+    while time.time() < end:
+        buffer += os.read(fd, 256)
+        while b'\0' in buffer:
+            segment, buffer = buffer.split(b'\0', 1)
+            if not segment:
+                continue
+            try:
+                reply_opcode, reply_id, payload = decode(segment)
+            except PacketError:
+                sys.stdout.write(segment.decode('latin-1'))    # Text between frames
+                continue
+            if reply_id == request_id and reply_opcode in (opcode | REPLY, REPLY):
+                return reply_opcode, payload
+    raise PacketError('no reply')
+
+
+def build_payload(op, arg):
+    """Payload of an operation."""
+    if op in ('select', 'info'):
+        return struct.pack('<H', int(arg))
+    if op == 'speed':
+        return struct.pack('<H', int(round(float(arg) * 100)))
+    if op == 'command':
+        return arg.encode('latin-1')
+    return b''
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description='Send a binary packet to the jukebox and show its reply.')
+    parser.add_argument('op', choices=sorted(OPCODES), help='operation')
+    parser.add_argument('arg', nargs='?', help='melody, speed or text commands')
+    parser.add_argument('--port', help='serial port of the jukebox')
+    parser.add_argument('--baud', type=int, default=9600, help='baud rate (default 9600)')
+    parser.add_argument('--id', type=int, default=1, help='request ID, 0 to 255 (default 1)')
+    parser.add_argument('--timeout', type=float, default=2.0, help='seconds to wait for the reply (default 2)')
+    parser.add_argument('--hex', action='store_true', help='print the frame instead of sending it')
+    args = parser.parse_args(argv)
+    if args.op in ('select', 'info', 'speed', 'command') and args.arg is None:
+        parser.error('%s needs an argument' % args.op)
+    if not args.hex and not args.port:
+        parser.error('--port or --hex is needed')
+
+    opcode = OPCODES[args.op]
+    frame = encode(opcode, args.id & 0xFF, build_payload(args.op, args.arg))
+    if args.hex:
+        print(frame.hex(' '))
+        return 0
+    try:
+        fd = open_port(args.port, args.baud)
+        reply_opcode, payload = transact(fd, opcode, args.id & 0xFF, frame, args.timeout)
+    except (OSError, PacketError) as e:
+        print('error: %s' % e, file=sys.stderr)
+        return 1
+    print(describe(reply_opcode, payload))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+"""
+@file jukebox_upload.py
+@brief Host client that uploads melodies to the RAM pool of the jukebox with the `load` command, and test of the uploads.
+
+After `load N` and its answer, the name ended by a new line is sent, and then 3 bytes per
+note: the MIDI note number (0 for a silence) and the duration in ms, little endian. The
+bytes are sent a few at a time, waiting for each group to leave the port, and the client
+stops on XOFF and goes on on XON, as the jukebox asks when its RX ring fills up.
+
+With --test a melody of NOTES notes is uploaded, long enough to fill the RX ring several
+times, and then unloaded. The test fails if the jukebox never sent XOFF, if it did not
+send XON within --max-pause seconds of an XOFF, or if the melody was not loaded. Leave
+the keypad and the button alone while it runs: their timers wake the jukebox and would
+hide an upload that only goes on when something else happens.
+
+Usage:
+    python3 tools/jukebox_upload.py --port /dev/ttyACM0 songs.rtttl     (upload every tune)
+    python3 tools/jukebox_upload.py --port /dev/ttyACM0 --test 300      (upload test)
+
+Only the Python standard library is used.
+"""
+
+import argparse
+import os
+import re
+import select
+import struct
+import sys
+import termios
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from jukebox_packet import open_port                           # noqa: E402
+from melody_compiler import MelodyError, load_rtttl_file, quantize, NOTE_LOWEST  # noqa: E402
+
+XON = 0x11
+XOFF = 0x13
+SEND_GROUP = 8           # Bytes written before waiting for them to leave: few in flight when XOFF comes
+ANSWER_TIMEOUT = 3.0     # Seconds to wait for an answer, longer than JUKEBOX_LOAD_TIMEOUT_MS
+
+
+class UploadError(Exception):
+    """Upload refused or not finished by the jukebox."""
+
+
+class Link:
+    """Serial port to the jukebox: lines of text, with XON and XOFF taken out of them."""
+
+    def __init__(self, fd, max_pause):
+        self.fd = fd
+        self.max_pause = max_pause
+        self.text = b''
+        self.paused = False
+        self.xoffs = 0
+        self.pause_start = 0.0
+        self.longest_pause = 0.0
+
+    def poll(self, timeout):
+        """Read what has arrived, waiting up to `timeout` seconds for the first byte."""
+        ready, _, _ = select.select([self.fd], [], [], timeout)
+        if not ready:
+            return
+        for byte in os.read(self.fd, 256):
+            if byte == XOFF and not self.paused:
+                self.paused, self.pause_start = True, time.time()
+                self.xoffs += 1
+            elif byte == XON and self.paused:
+                self.paused = False
+                self.longest_pause = max(self.longest_pause, time.time() - self.pause_start)
+            elif byte not in (XON, XOFF):
+                self.text += bytes([byte])
+
+    def check_pause(self):
+        """A pause longer than `max_pause` seconds is an error: the jukebox stopped reading the bytes already sent."""
+        if self.paused and time.time() - self.pause_start > self.max_pause:
+            raise UploadError('no XON %.1f s after XOFF' % (time.time() - self.pause_start))
+
+    def write(self, data):
+        """Send bytes honouring XON/XOFF."""
+        for i in range(0, len(data), SEND_GROUP):
+            self.poll(0)
+            while self.paused:
+                self.check_pause()
+                self.poll(0.01)
+            os.write(self.fd, data[i:i + SEND_GROUP])
+            termios.tcdrain(self.fd)
+
+    def expect(self, pattern, timeout=ANSWER_TIMEOUT):
+        """Wait for a line that matches `pattern` or an error line; return the match."""
+        end = time.time() + timeout
+        while time.time() < end:
+            while b'\n' in self.text:
+                line, self.text = self.text.split(b'\n', 1)
+                line = line.decode('latin-1').strip()
+                if line.startswith('Error'):
+                    raise UploadError(line)
+                match = re.search(pattern, line)
+                if match:
+                    return match
+            self.check_pause()              # An XOFF can also come after the last byte
+            self.poll(0.05)
+        raise UploadError('no answer matching "%s"' % pattern)
+
+
+def encode_notes(name, notes):
+    """Bytes of an upload after the `load` command: the name, its end and the notes."""
+    data = name.encode('latin-1') + b'\n'
+    for note, ms in notes:
+        data += struct.pack('<BH', note, ms)
+    return data
+
+
+def upload(link, name, notes):
+    """Upload a melody and return its id."""
+    os.write(link.fd, b'load %d\n' % len(notes))
+    link.expect(r'^Load: send')
+    link.write(encode_notes(name, notes))
+    return int(link.expect(r'^Loaded \[(\d+)\]').group(1))
+
+
+def test_notes(count):
+    """Notes of the test melody: a scale up and down with silences, with a few durations."""
+    return [(0 if i % 8 == 7 else NOTE_LOWEST + 12 + (i % 24), 100 + 50 * (i % 3)) for i in range(count)]
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description='Upload melodies to the jukebox, or test the uploads.')
+    parser.add_argument('inputs', nargs='*', help='.rtttl/.txt files, one RTTTL per line')
+    parser.add_argument('--port', required=True, help='serial port of the jukebox')
+    parser.add_argument('--baud', type=int, default=9600, help='baud rate (default 9600)')
+    parser.add_argument('--test', type=int, metavar='NOTES', help='upload and unload a test melody of NOTES notes')
+    parser.add_argument('--max-pause', type=float,
+                        help='longest wait for XON after XOFF, in seconds (default 0.5 in the test, 2 otherwise)')
+    args = parser.parse_args(argv)
+    if not args.inputs and args.test is None:
+        parser.error('give files to upload or --test')
+    if args.max_pause is None:
+        args.max_pause = 0.5 if args.test is not None else 2.0
+
+    try:
+        link = Link(open_port(args.port, args.baud), args.max_pause)
+        if args.test is not None:
+            print('Test upload of %d notes: do not touch the keypad or the button' % args.test)
+            start = time.time()
+            melody_id = upload(link, 'Upload test', test_notes(args.test))
+            print('Loaded [%d] in %.2f s, %d XOFF, longest pause %.3f s'
+                  % (melody_id, time.time() - start, link.xoffs, link.longest_pause))
+            os.write(link.fd, b'unload %d\n' % melody_id)
+            link.expect(r'^Unloaded')
+            if link.xoffs == 0:
+                raise UploadError('no XOFF: use more notes to fill the RX ring')
+            print('OK')
+            return 0
+        for path in args.inputs:
+            for name, tune in load_rtttl_file(path):
+                notes = quantize(tune, 1)
+                print('%s: [%d] %s' % (path, upload(link, name, notes), name))
+    except (OSError, MelodyError, UploadError) as e:
+        print('error: %s' % e, file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,426 @@
+#!/usr/bin/env python3
+"""
+@file melody_compiler.py
+@brief Host tool that compiles RTTTL and MIDI files into melody tables for the jukebox.
+
+The output is a C source file in the same format as `common/src/melodies.c`: one
+MELODY_BLOB_T blob per tune (note numbers, duration indexes and name), one shared
+table with every distinct duration, and a `const melody_t` header per tune. The
+lengths come from the blobs themselves, so they can never get out of sync.
+
+Usage:
+    python3 tools/melody_compiler.py [options] INPUT... -o OUTPUT.c
+
+INPUT can be:
+    *.rtttl / *.txt   one RTTTL string per line ("name:d=4,o=5,b=120:8c,8d,...")
+    *.mid / *.midi    Standard MIDI File, type 0 or 1
+
+The buzzer is monophonic, so MIDI files are reduced to their highest sounding note
+(drums on channel 10 are ignored). Notes out of DO3..SI6 are moved by octaves into it.
+
+Every symbol starts with --prefix and is made unique, also against the melodies of
+common/include/melodies.h, so several outputs can be linked with melodies.c. A tune
+longer than melody_t can hold (32767 notes) is split into parts "Name (1/n)", ...
+
+With --catalog the file also defines `melodies_generated`, which melodies.c picks up
+when it is linked: its melodies are shown after the built-in ones, with no edits.
+
+Only the Python standard library is used.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+NOTE_LOWEST = 48   # DO3, see NOTE_MIDI_DO3 in melodies.h
+NOTE_HIGHEST = 95  # SI6
+SILENCE = 0
+NOTE_NAMES = ['DO', 'DOs', 'RE', 'REs', 'MI', 'FA', 'FAs', 'SOL', 'SOLs', 'LA', 'LAs', 'SI']
+MAX_DURATION_MS = 0xFFFF
+MAX_DURATIONS = 256  # Durations are indexed with one byte
+MAX_NOTES = 0x7FFF   # melody_length and name_offset (2 * length) of melody_t are uint16_t
+HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'common', 'include', 'melodies.h')
+
+
+class MelodyError(Exception):
+    """Error in an input file."""
+
+
+# ----------------------------------------------------------------------------
+# Notes
+# ----------------------------------------------------------------------------
+def fold_note(note):
+    """Move a MIDI note into DO3..SI6 by whole octaves."""
+    if note == SILENCE:
+        return SILENCE
+    while note < NOTE_LOWEST:
+        note += 12
+    while note > NOTE_HIGHEST:
+        note -= 12
+    return note
+
+
+def note_name(note):
+    """C name of a note, as defined in melodies.h."""
+    if note == SILENCE:
+        return 'SILENCE'
+    return '%s%d' % (NOTE_NAMES[note % 12], note // 12 - 1)
+
+
+# ----------------------------------------------------------------------------
+# RTTTL
+# ----------------------------------------------------------------------------
+RTTTL_NOTE_RE = re.compile(r'^(\d*)([cdfga]#?|[bep])(\.?)(\d*)(\.?)$')   # E, B and pauses have no sharp
+RTTTL_SEMITONES = {'c': 0, 'c#': 1, 'd': 2, 'd#': 3, 'e': 4, 'f': 5, 'f#': 6,
+                   'g': 7, 'g#': 8, 'a': 9, 'a#': 10, 'b': 11}
+
+
+def parse_rtttl(text):
+    """Parse one RTTTL string. Returns (name, [(note, duration_ms), ...])."""
+    parts = text.strip().split(':')
+    if len(parts) != 3:
+        raise MelodyError('RTTTL needs 3 sections separated by ":"')
+    name, defaults, body = parts
+    default_dur, default_oct, bpm = 4, 6, 63
+    for item in filter(None, (x.strip().lower() for x in defaults.split(','))):
+        key, _, value = item.partition('=')
+        if not value.isdigit():
+            raise MelodyError('bad RTTTL default "%s"' % item)
+        if key == 'd':
+            default_dur = int(value)
+        elif key == 'o':
+            default_oct = int(value)
+        elif key == 'b':
+            bpm = int(value)
+    if bpm <= 0 or default_dur <= 0:
+        raise MelodyError('bad RTTTL tempo or duration')
+    whole_ms = 4 * 60000.0 / bpm
+
+    notes = []
+    for position, token in enumerate(filter(None, (x.strip().lower() for x in body.split(','))), 1):
+        m = RTTTL_NOTE_RE.match(token)
+        if not m:
+            raise MelodyError('bad RTTTL note %d "%s"' % (position, token))
+        dur_s, pitch, dot1, oct_s, dot2 = m.groups()
+        duration = whole_ms / (int(dur_s) if dur_s else default_dur)
+        if dot1 or dot2:
+            duration *= 1.5
+        if pitch == 'p':
+            note = SILENCE
+        else:
+            octave = int(oct_s) if oct_s else default_oct
+            note = (octave + 1) * 12 + RTTTL_SEMITONES[pitch]
+        notes.append((note, duration))
+    return name.strip(), notes
+
+
+def load_rtttl_file(path):
+    tunes = []
+    with open(path, encoding='utf-8', errors='replace') as f:
+        for line_no, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith('#'):
+                continue
+            try:
+                tunes.append(parse_rtttl(line))
+            except MelodyError as e:
+                raise MelodyError('%s:%d: %s' % (path, line_no, e))
+    return tunes
+
+
+# ----------------------------------------------------------------------------
+# MIDI
+# ----------------------------------------------------------------------------
+def _read_varlen(data, pos):
+    value = 0
+    while True:
+        if pos >= len(data):
+            raise MelodyError('truncated variable length value')
+        byte = data[pos]
+        pos += 1
+        value = (value << 7) | (byte & 0x7F)
+        if not byte & 0x80:
+            return value, pos
+
+
+def _parse_track(data, track_index):
+    """Return the events of a track as (tick, order, kind, a, b) tuples."""
+    events = []
+    pos, tick, status, order = 0, 0, None, 0
+    while pos < len(data):
+        delta, pos = _read_varlen(data, pos)
+        tick += delta
+        if data[pos] & 0x80:
+            status = data[pos]
+            pos += 1
+        elif status is None:
+            raise MelodyError('running status without status byte')
+        order += 1
+        if status == 0xFF:
+            meta = data[pos]
+            length, pos = _read_varlen(data, pos + 1)
+            payload = data[pos:pos + length]
+            pos += length
+            if meta == 0x51 and length == 3:
+                events.append((tick, order, 'tempo', (payload[0] << 16) | (payload[1] << 8) | payload[2], 0))
+            elif meta == 0x03 and track_index <= 1:
+                events.append((tick, order, 'name', payload.decode('latin-1').strip(), 0))
+            elif meta == 0x2F:
+                break
+            status = None
+        elif status in (0xF0, 0xF7):
+            length, pos = _read_varlen(data, pos)
+            pos += length
+            status = None
+        else:
+            kind, channel = status & 0xF0, status & 0x0F
+            size = 1 if kind in (0xC0, 0xD0) else 2
+            args = data[pos:pos + size]
+            pos += size
+            if channel == 9 or kind not in (0x80, 0x90):
+                continue
+            note, velocity = args[0], args[1]
+            if kind == 0x90 and velocity > 0:
+                events.append((tick, order, 'on', note, (track_index << 4) | channel))
+            else:
+                events.append((tick, order, 'off', note, (track_index << 4) | channel))
+    return events
+
+
+def load_midi_file(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:4] != b'MThd':
+        raise MelodyError('%s: not a MIDI file' % path)
+    header_len = struct.unpack('>I', data[4:8])[0]
+    fmt, ntracks, division = struct.unpack('>HHH', data[8:14])
+    if fmt not in (0, 1):
+        raise MelodyError('%s: MIDI type %d is not supported (only 0 and 1)' % (path, fmt))
+    if division & 0x8000:
+        raise MelodyError('%s: SMPTE time division is not supported' % path)
+    pos = 8 + header_len
+    events = []
+    for track_index in range(ntracks):
+        if data[pos:pos + 4] != b'MTrk':
+            raise MelodyError('%s: missing track %d' % (path, track_index))
+        length = struct.unpack('>I', data[pos + 4:pos + 8])[0]
+        try:
+            track_events = _parse_track(data[pos + 8:pos + 8 + length], track_index)
+        except (IndexError, MelodyError) as e:
+            raise MelodyError('%s: track %d: %s' % (path, track_index, e or 'truncated'))
+        events.extend((t, track_index, o, k, a, b) for t, o, k, a, b in track_events)
+        pos += 8 + length
+
+    # Offs before ons at the same tick, so that repeated notes are re-attacked
+    events.sort(key=lambda e: (e[0], 0 if e[3] in ('tempo', 'off') else 1, e[1], e[2]))
+    name = next((e[4] for e in events if e[3] == 'name' and e[4]), None)
+    name = name or os.path.splitext(os.path.basename(path))[0]
+
+    # Skyline: the highest sounding note is the one the buzzer plays
+    tempo_us, last_tick, now_ms = 500000, 0, 0.0
+    active = {}  # (note, source) -> count
+    segments = []  # [note, start_ms]
+    current = SILENCE
+    for tick, _, _, kind, a, b in events:
+        now_ms += (tick - last_tick) * tempo_us / 1000.0 / division
+        last_tick = tick
+        if kind == 'tempo':
+            tempo_us = a
+            continue
+        if kind == 'name':
+            continue
+        key = (a, b)
+        if kind == 'on':
+            active[key] = active.get(key, 0) + 1
+        elif active.get(key):
+            active[key] -= 1
+            if not active[key]:
+                del active[key]
+        top = max((n for n, _ in active), default=SILENCE)
+        if top != current or (kind == 'on' and a == top):
+            segments.append([top, now_ms])
+            current = top
+
+    notes = []
+    for i, (note, start) in enumerate(segments):
+        end = segments[i + 1][1] if i + 1 < len(segments) else start
+        if end > start:
+            notes.append((note, end - start))
+    # Leading silence is kept (like the hand-written tunes), trailing silence is not
+    while notes and notes[-1][0] == SILENCE:
+        notes.pop()
+    return [(name, notes)]
+
+
+# ----------------------------------------------------------------------------
+# Encoding
+# ----------------------------------------------------------------------------
+def quantize(tune, quantum):
+    """Fold notes into range, quantize durations, split long ones and merge silences."""
+    out = []
+    for note, duration in tune:
+        note = fold_note(note)
+        ms = int(round(duration / quantum)) * quantum
+        if ms <= 0:
+            continue
+        if out and note == SILENCE and out[-1][0] == SILENCE and out[-1][1] + ms <= MAX_DURATION_MS:
+            out[-1] = (SILENCE, out[-1][1] + ms)
+            continue
+        while ms > MAX_DURATION_MS:
+            out.append((note, MAX_DURATION_MS))
+            ms -= MAX_DURATION_MS
+        out.append((note, ms))
+    return out
+
+
+def split_long(name, notes):
+    """Split a tune longer than MAX_NOTES into parts that fit the length of melody_t."""
+    if len(notes) <= MAX_NOTES:
+        return [(name, notes)]
+    parts = [notes[i:i + MAX_NOTES] for i in range(0, len(notes), MAX_NOTES)]
+    return [('%s (%d/%d)' % (name, i + 1, len(parts)), part) for i, part in enumerate(parts)]
+
+
+def reserved_symbols(path=HEADER):
+    """Melodies declared in melodies.h, such as scale_melody and outro, whose names can't be reused."""
+    try:
+        with open(path, encoding='utf-8') as f:
+            return set(re.findall(r'extern\s+const\s+melody_t\s+(\w+)\s*;', f.read()))
+    except OSError:
+        return set()
+
+
+def c_identifier(name, used):
+    ident = re.sub(r'[^0-9a-zA-Z]+', '_', name).strip('_').lower() or 'melody'
+    if ident[0].isdigit():
+        ident = 'melody_' + ident
+    base, i = ident, 2
+    while ident in used:
+        ident = '%s_%d' % (base, i)
+        i += 1
+    used.add(ident)
+    return ident
+
+
+def c_string(text):
+    return '"%s"' % ''.join(c if 32 <= ord(c) < 127 and c not in '"\\' else '\\%03o' % (ord(c) & 0xFF) for c in text)
+
+
+def wrap(items, indent='        ', per_line=16):
+    lines = [', '.join(items[i:i + per_line]) for i in range(0, len(items), per_line)]
+    return (',\n' + indent).join(lines)
+
+
+def emit_c(tunes, prefix, source_names, catalog=False):
+    durations = sorted({ms for _, notes in tunes for _, ms in notes})
+    if len(durations) > MAX_DURATIONS:
+        raise MelodyError('%d distinct durations, the format allows %d. Use a bigger --quantum'
+                          % (len(durations), MAX_DURATIONS))
+    index = {ms: i for i, ms in enumerate(durations)}
+
+    out = []
+    out.append('/**\n * @file %s.c\n * @brief Melodies generated by tools/melody_compiler.py. Do not edit.\n *\n' % prefix)
+    out.append(' * Sources: %s\n */\n\n' % ', '.join(source_names))
+    out.append('/* Includes ------------------------------------------------------------------*/\n')
+    out.append('#include "melodies.h"\n\n')
+    out.append('/* Global variables ------------------------------------------------------------*/\n')
+    out.append('/**\n * @brief Durations in milliseconds shared by all the melodies of this file.\n */\n')
+    out.append('static const uint16_t %s_durations[] = {\n        %s};\n\n'
+               % (prefix, wrap([str(ms) for ms in durations])))
+    out.append('/* Melodies ------------------------------------------------------------------*/\n')
+
+    # Every symbol has the prefix of the file, and the same name is never given twice, nor the name of a melody of melodies.h
+    used = reserved_symbols() | {'%s_durations' % prefix, '%s_melodies' % prefix, '%s_melodies_count' % prefix,
+                                 'melodies_generated'}
+    blobs, symbols = {}, []
+    for name, notes in tunes:
+        ident = c_identifier('%s_%s' % (prefix, name), used)
+        while '%s_blob' % ident in used:
+            ident = c_identifier('%s_%s' % (prefix, name), used)
+        used.add('%s_blob' % ident)
+        key = (name, tuple(notes))
+        if key in blobs:  # Same tune twice: share the blob
+            blob = blobs[key]
+        else:
+            blob = blobs[key] = '%s_blob' % ident
+            out.append('// %s\n' % name)
+            out.append('static const MELODY_BLOB_T(%d, %s) %s = {\n' % (len(notes), c_string(name), blob))
+            out.append('    .notes = {\n        %s},\n' % wrap([note_name(n) for n, _ in notes]))
+            out.append('    .durations = {\n        %s},\n' % wrap([str(index[ms]) for _, ms in notes], per_line=24))
+            out.append('    .name = %s};\n\n' % c_string(name))
+        out.append('const melody_t %s = MELODY_FROM_BLOB(%s, %s_durations);\n\n' % (ident, blob, prefix))
+        symbols.append(ident)
+
+    out.append('/**\n * @brief Melodies of this file, in input order.\n */\n')
+    out.append('const melody_t *const %s_melodies[] = {\n%s};\n\n'
+               % (prefix, ''.join('    &%s,\n' % s for s in symbols)))
+    out.append('const uint32_t %s_melodies_count = sizeof(%s_melodies) / sizeof(%s_melodies[0]);\n'
+               % (prefix, prefix, prefix))
+    if catalog:
+        out.append('\n/**\n * @brief Catalog of this file. melodies_catalog lists its melodies after the ones of melodies.c.\n */\n')
+        out.append('const melody_catalog_t melodies_generated = {\n    .p_melodies = %s_melodies,\n'
+                   '    .count = sizeof(%s_melodies) / sizeof(%s_melodies[0]),\n};\n' % (prefix, prefix, prefix))
+    return ''.join(out), symbols, len(durations)
+
+
+def emit_h(prefix, symbols):
+    guard = '%s_H_' % prefix.upper()
+    out = ['/**\n * @file %s.h\n * @brief Melodies generated by tools/melody_compiler.py. Do not edit.\n */\n\n' % prefix,
+           '#ifndef %s\n#define %s\n\n#include "melodies.h"\n\n' % (guard, guard)]
+    out += ['extern const melody_t %s;\n' % s for s in symbols]
+    out.append('\nextern const melody_t *const %s_melodies[];\nextern const uint32_t %s_melodies_count;\n' % (prefix, prefix))
+    out.append('\n#endif /* %s */\n' % guard)
+    return ''.join(out)
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description='Compile RTTTL and MIDI files into jukebox melody tables.')
+    parser.add_argument('inputs', nargs='+', help='.rtttl/.txt (one RTTTL per line) or .mid/.midi files')
+    parser.add_argument('-o', '--output', required=True, help='C file to write')
+    parser.add_argument('--header', help='also write a header with the extern declarations')
+    parser.add_argument('--prefix', default=None, help='prefix of the generated symbols (default: output file name)')
+    parser.add_argument('--catalog', action='store_true',
+                        help='add the melodies to the catalog of the jukebox, after the ones of melodies.c (one file at most)')
+    parser.add_argument('--quantum', type=int, default=5, help='durations are rounded to multiples of this many ms (default 5)')
+    args = parser.parse_args(argv)
+    if args.quantum <= 0:
+        parser.error('--quantum must be positive')
+    prefix = args.prefix or c_identifier(os.path.splitext(os.path.basename(args.output))[0], set())
+
+    tunes, sources = [], []
+    try:
+        for path in args.inputs:
+            ext = os.path.splitext(path)[1].lower()
+            loaded = load_midi_file(path) if ext in ('.mid', '.midi') else load_rtttl_file(path)
+            for name, notes in loaded:
+                notes = quantize(notes, args.quantum)
+                if not notes:
+                    print('warning: %s: "%s" has no notes, skipped' % (path, name), file=sys.stderr)
+                    continue
+                if len(notes) > MAX_NOTES:
+                    print('warning: %s: "%s" has %d notes, split into parts of %d' % (path, name, len(notes), MAX_NOTES),
+                          file=sys.stderr)
+                tunes.extend(split_long(name, notes))
+            sources.append(os.path.basename(path))
+        if not tunes:
+            raise MelodyError('no melodies found')
+        text, symbols, n_durations = emit_c(tunes, prefix, sources, args.catalog)
+    except (OSError, MelodyError) as e:
+        print('error: %s' % e, file=sys.stderr)
+        return 1
+
+    with open(args.output, 'w') as f:
+        f.write(text)
+    if args.header:
+        with open(args.header, 'w') as f:
+            f.write(emit_h(prefix, symbols))
+    total = sum(len(n) for _, n in tunes)
+    print('%d melodies, %d notes, %d durations -> %s (%d bytes of melody data)'
+          % (len(tunes), total, n_durations, args.output, 2 * total + 2 * n_durations + 12 * len(tunes)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""
+@file melody_compiler_check.py
+@brief Host check of the RTTTL parser of the melody compiler: notes, octaves and durations of valid tunes, and a clean
+`MelodyError` with the position of the note for the ones that are not.
+
+Run from the root of the repository:
+    python3 tools/melody_compiler_check.py
+
+Only the Python standard library is used.
+"""
+
+import os
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from melody_compiler import MelodyError, SILENCE, load_rtttl_file, parse_rtttl  # noqa: E402
+
+failures = 0
+
+
+def check(ok, what):
+    """Count and print a failed check."""
+    global failures
+    if not ok:
+        print('FAIL: %s' % what)
+        failures += 1
+
+
+def error_of(text):
+    """Message of the MelodyError raised by parse_rtttl(), or None. Any other exception is a failure of the check."""
+    try:
+        parse_rtttl(text)
+    except MelodyError as e:
+        return str(e)
+    except Exception as e:                  # noqa: BLE001 - a traceback is what the check looks for
+        return 'uncaught %s' % type(e).__name__
+    return None
+
+
+def main():
+    # 1. Valid tunes: defaults, sharps, silences, dots and octaves
+    name, notes = parse_rtttl('Test:d=4,o=5,b=120:c,8d#6,p,2a#.,16b4')
+    check(name == 'Test', 'name')
+    check([n for n, _ in notes] == [72, 87, SILENCE, 82, 71], 'notes %s' % [n for n, _ in notes])
+    check([round(d) for _, d in notes] == [500, 250, 500, 1500, 125], 'durations %s' % [round(d) for _, d in notes])
+    check(parse_rtttl('X:d=8,o=6,b=63:f#.')[1][0][0] == 90, 'dot before the octave')
+
+    # 2. Sharps that do not exist, and other bad notes: MelodyError with the position of the note
+    for token, position in (('e#', 2), ('b#', 2), ('p#', 2), ('h', 2), ('4c9x', 2)):
+        message = error_of('Bad:d=4,o=5,b=120:c,%s,d' % token)
+        check(message == 'bad RTTTL note %d "%s"' % (position, token), '%s: %s' % (token, message))
+    check(error_of('Bad:d=4,o=5,b=120') is not None, 'missing section')
+    check(error_of('Bad:d=x,o=5,b=120:c') is not None, 'bad default')
+    check(error_of('Bad:d=4,o=5,b=0:c') is not None, 'tempo 0')
+
+    # 3. The file and line of the error
+    with tempfile.NamedTemporaryFile('w', suffix='.rtttl', delete=False) as f:
+        f.write('# comment\nOne:d=4,o=5,b=120:c\nTwo:d=4,o=5,b=120:c,e#\n')
+    try:
+        load_rtttl_file(f.name)
+        check(False, 'file with a bad note loaded')
+    except MelodyError as e:
+        check(str(e) == '%s:3: bad RTTTL note 2 "e#"' % f.name, 'file error: %s' % e)
+    finally:
+        os.unlink(f.name)
+
+    if failures:
+        print('%d checks failed' % failures)
+        return 1
+    print('OK')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
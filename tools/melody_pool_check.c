@@ -0,0 +1,191 @@
+/**
+ * @file melody_pool_check.c
+ * @brief Host check of the pool of uploaded melodies: uploads in small chunks, deletion with compaction and the errors
+ * that `unload` and `load` report.
+ *
+ * The melodies are uploaded with the same stream of bytes that the jukebox receives (name, then note and duration in
+ * little endian), a few bytes at a time as the USART delivers them, and every note is read back through the catalog.
+ *
+ * Build and run from the root of the repository:
+ *
+ *     cc -O2 -std=c11 -DSYSTEM_CORE_CLOCK_HZ=16000000U -Icommon/include -Iport/stm32f4/include \
+ *        tools/melody_pool_check.c common/src/melodies.c common/src/melody_view.c common/src/melody_pool.c -o melody_pool_check
+ *     ./melody_pool_check
+ *
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-17
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C libraries */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Other libraries */
+#include "melody_pool.h"
+
+/* Defines ------------------------------------------------------------------*/
+#define CHECK_CHUNK_LENGTH 7            /*!< Bytes fed to the upload at a time: odd, so that the durations are split */
+#define CHECK_MAX_STREAM 2048           /*!< Longest upload stream of the check */
+
+/* Global variables -----------------------------------------------------------*/
+static uint32_t check_failures = 0;     /*!< Number of checks failed */
+
+/* Private functions ---------------------------------------------------------*/
+/**
+ * @brief Count and print a failed check.
+ *
+ * @param ok result of the check.
+ * @param p_what description of the check.
+ */
+static void _check(bool ok, const char *p_what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", p_what);
+        check_failures++;
+    }
+}
+
+/**
+ * @brief Note `index` of the test melody `seed`. Every fifth note is a silence.
+ */
+static uint8_t _note(uint32_t seed, uint32_t index)
+{
+    return (index % 5 == 0) ? SILENCE : (uint8_t)(NOTE_MIDI_DO3 + (seed * 7 + index) % 48);
+}
+
+/**
+ * @brief Duration in ms of the note `index` of the test melody `seed`. Only a few different values, as in real melodies.
+ */
+static uint16_t _duration(uint32_t seed, uint32_t index)
+{
+    return (uint16_t)(100 + ((seed + index) % 7) * 25);
+}
+
+/**
+ * @brief Upload a test melody in chunks of `CHECK_CHUNK_LENGTH` bytes.
+ *
+ * @param p_name name of the melody.
+ * @param length number of notes.
+ * @param seed seed of the notes and durations.
+ * @param p_bad_note if not NULL, note that replaces the last one, to force an error.
+ * @return uint32_t result of the last chunk: one of `MELODY_POOL_LOAD`, or `MELODY_POOL_LOAD_ERROR` if it can't begin.
+ */
+static uint32_t _upload(const char *p_name, uint32_t length, uint32_t seed, const uint8_t *p_bad_note)
+{
+    static uint8_t stream[CHECK_MAX_STREAM];
+    uint32_t size = 0;
+
+    // 1. The stream: name, end of the name and the notes
+    for (const char *p = p_name; *p != '\0'; p++)
+    {
+        stream[size++] = (uint8_t)*p;
+    }
+    stream[size++] = MELODY_POOL_NAME_END;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        uint16_t duration = _duration(seed, i);
+        stream[size++] = (p_bad_note != NULL && i == length - 1) ? *p_bad_note : _note(seed, i);
+        stream[size++] = (uint8_t)(duration & 0xFF);
+        stream[size++] = (uint8_t)(duration >> 8);
+    }
+
+    // 2. Fed a few bytes at a time
+    if (!melody_pool_load_begin(&melody_pool, length))
+    {
+        return MELODY_POOL_LOAD_ERROR;
+    }
+    uint32_t result = MELODY_POOL_LOAD_BUSY;
+    for (uint32_t position = 0; position < size && result == MELODY_POOL_LOAD_BUSY;)
+    {
+        uint32_t used;
+        uint32_t chunk = (size - position < CHECK_CHUNK_LENGTH) ? size - position : CHECK_CHUNK_LENGTH;
+        result = melody_pool_load_data(&melody_pool, &stream[position], chunk, &used);
+        position += used;
+    }
+    return result;
+}
+
+/**
+ * @brief Check that a melody has the notes, durations and name of the test melody `seed`.
+ */
+static bool _matches(const melody_t *p_melody, const char *p_name, uint32_t length, uint32_t seed)
+{
+    if (p_melody == NULL || melody_get_length(p_melody) != length || strcmp(melody_get_name(p_melody), p_name) != 0)
+    {
+        return false;
+    }
+    if (((uintptr_t)p_melody->p_durations & 1) != 0)
+    {
+        return false; // The table of durations is read by halfwords
+    }
+    for (uint32_t i = 0; i < length; i++)
+    {
+        if (melody_get_note(p_melody, i) != _note(seed, i) || melody_get_duration(p_melody, i) != _duration(seed, i))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Main -----------------------------------------------------------------------*/
+int main(void)
+{
+    uint32_t first = melody_catalog_get_flash_count(&melodies_catalog);
+    uint32_t free_empty = melody_pool_get_free(&melody_pool);
+
+    // 1. Three uploads, listed after the melodies in flash
+    _check(_upload("One", 10, 1, NULL) == MELODY_POOL_LOAD_DONE, "upload of One");
+    _check(_upload("Second melody", 33, 2, NULL) == MELODY_POOL_LOAD_DONE, "upload of Second melody");
+    _check(_upload("Third", 101, 3, NULL) == MELODY_POOL_LOAD_DONE, "upload of Third");
+    _check(melody_catalog_get_count(&melodies_catalog) == first + 3, "catalog count after the uploads");
+    _check(_matches(melody_catalog_get(&melodies_catalog, first + 1), "Second melody", 33, 2), "Second melody in the catalog");
+
+    // 2. Deleting the first one moves the others down, with their notes, names and durations
+    _check(melody_pool_delete(&melody_pool, 0), "delete of One");
+    _check(melody_pool_get_count(&melody_pool) == 2, "count after the delete");
+    _check(_matches(melody_pool_get(&melody_pool, 0), "Second melody", 33, 2), "Second melody moved down");
+    _check(_matches(melody_pool_get(&melody_pool, 1), "Third", 101, 3), "Third moved down");
+
+    // 3. Indexes out of the pool, and deletes during an upload, which is stored after the last melody, fail and change nothing
+    _check(!melody_pool_delete(&melody_pool, 2), "delete out of the pool");
+    _check(melody_pool_load_begin(&melody_pool, 4), "begin of an upload");
+    _check(!melody_pool_delete(&melody_pool, 0), "delete during an upload");
+    melody_pool_load_abort(&melody_pool);
+    _check(_matches(melody_pool_get(&melody_pool, 0), "Second melody", 33, 2), "Second melody after the refused delete");
+
+    // 4. An invalid note aborts the upload and leaves the pool as it was
+    uint32_t free_before = melody_pool_get_free(&melody_pool);
+    uint8_t bad_note = NOTE_MIDI_DO3 - 1;
+    _check(_upload("Bad", 5, 4, &bad_note) == MELODY_POOL_LOAD_ERROR, "upload with an invalid note");
+    _check(!melody_pool_is_loading(&melody_pool) && melody_pool_get_free(&melody_pool) == free_before, "pool after the invalid upload");
+
+    // 5. The free space after compaction is the whole rest of the arena: deleting everything gives it back
+    _check(melody_pool_delete(&melody_pool, 1) && melody_pool_delete(&melody_pool, 0), "delete of the rest");
+    _check(melody_pool_get_free(&melody_pool) == free_empty, "free space of the empty pool");
+
+    // 6. Slots and space run out, and a melody too long never begins
+    uint32_t loaded = 0;
+    while (_upload("Filler", 60, loaded, NULL) == MELODY_POOL_LOAD_DONE)
+    {
+        loaded++;
+    }
+    _check(loaded > 0 && loaded <= MELODY_POOL_MAX_MELODIES, "pool filled");
+    _check(!melody_pool_load_begin(&melody_pool, MELODY_POOL_SIZE), "begin of a melody longer than the arena");
+    for (uint32_t i = 0; i < loaded; i++)
+    {
+        _check(_matches(melody_pool_get(&melody_pool, i), "Filler", 60, i), "fillers intact");
+    }
+
+    if (check_failures > 0)
+    {
+        printf("%lu checks failed\n", (unsigned long)check_failures);
+        return 1;
+    }
+    printf("OK: %lu melodies fill the pool, %lu bytes free when empty\n", (unsigned long)loaded, (unsigned long)free_empty);
+    return 0;
+}
@@ -0,0 +1,409 @@
+/**
+ * @file melody_render.c
+ * @brief Host tool that renders the melodies of the catalog to 16-bit PCM WAV files, as the buzzer would play them.
+ *
+ * The melodies are read with the same code as the jukebox (`melodies.c` and `melody_view.c`), so speed, tempo,
+ * transposition and reverse are applied exactly as on the board. Each note is played with the frequency and duty
+ * cycle of the PSC, ARR and CCR1 values that `port_buzzer` programs (`port_buzzer_timing.h`), not with the ideal ones.
+ *
+ * The square wave is band-limited by filtering it with a triangle of two samples, which is computed as the second
+ * difference of the square wave integrated twice. That integral has a closed form, so the kernel is two loops over
+ * blocks of samples with no branches, that the compiler vectorizes (`-fno-trapping-math` lets it turn the selects
+ * into min/max instructions).
+ *
+ * Build from the root of the repository:
+ *
+ *     cc -O3 -fno-trapping-math -std=c11 -DSYSTEM_CORE_CLOCK_HZ=16000000U -Icommon/include -Iport/stm32f4/include \
+ *        tools/melody_render.c common/src/melodies.c common/src/melody_view.c common/src/melody_pool.c -lm -o melody_render
+ *
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-07
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+
+/* Other libraries */
+#include "melodies.h"
+#include "melody_view.h"
+#include "port_buzzer_timing.h"
+
+/* Defines ------------------------------------------------------------------*/
+#define RENDER_SAMPLE_RATE_HZ 44100                  /*!< Default sample rate */
+#define RENDER_BLOCK_LENGTH 1024                     /*!< Samples rendered by each call to the kernel */
+#define RENDER_AMPLITUDE 0.5f                        /*!< Peak amplitude of the notes, from 0 to 1 */
+#define RENDER_SPEED_ONE (1UL << 16)                 /*!< Speed 1.0 in Q16.16, as BUZZER_SPEED_ONE in fsm_buzzer.h */
+#define RENDER_PATH_LENGTH 512                       /*!< Maximum length of the path of a WAV file */
+
+/* Typedefs --------------------------------------------------------------------*/
+/**
+ * @brief Frequency and duty cycle of a note as played by TIM3.
+ */
+typedef struct
+{
+    double hz;      /*!< Frequency of the timer values, not the nominal one */
+    double duty;    /*!< CCR1 / (ARR + 1). 0 for a silence */
+} render_tone_t;
+
+/**
+ * @brief Options of the command line.
+ */
+typedef struct
+{
+    uint32_t sample_rate;   /*!< Sample rate in Hz */
+    uint32_t speed;         /*!< Player speed in Q16.16 */
+    uint32_t tempo;         /*!< Tempo of the melodies in Q16.16 */
+    int32_t transpose;      /*!< Semitones */
+    bool reverse;           /*!< Play the melodies backwards */
+    bool sequencer;         /*!< Use the timer values of the DMA sequencer */
+} render_options_t;
+
+/* Private variables ------------------------------------------------------------*/
+/**
+ * @brief Nominal frequency of every note of `MELODIES_NOTES`, indexed by `note - NOTE_LOWEST`.
+ */
+static const double note_hz[NOTES_COUNT] = {
+#define NOTE_HZ_ENTRY(name, hz) [name - NOTE_LOWEST] = (hz),
+    MELODIES_NOTES(NOTE_HZ_ENTRY)
+#undef NOTE_HZ_ENTRY
+};
+
+/* Private functions */
+/**
+ * @brief Gets the frequency and duty cycle that the buzzer plays for a note, from the quantized timer values.
+ *
+ * @param note MIDI note number or SILENCE.
+ * @param sequencer true to use the values of the DMA sequencer.
+ * @return render_tone_t tone played.
+ */
+static render_tone_t _get_tone(uint8_t note, bool sequencer)
+{
+    render_tone_t tone = {.hz = 1.0, .duty = 0.0};
+    if (note < NOTE_LOWEST || note > NOTE_HIGHEST)
+    {
+        return tone;
+    }
+    double hz = note_hz[note - NOTE_LOWEST];
+    uint32_t psc = sequencer ? BUZZER_SEQUENCER_PSC : BUZZER_PWM_PSC(hz);
+    uint32_t arr = sequencer ? BUZZER_SEQUENCER_ARR(hz) : BUZZER_PWM_ARR(hz);
+    uint32_t ccr = sequencer ? BUZZER_SEQUENCER_CCR(hz) : BUZZER_PWM_CCR(hz);
+    tone.hz = (double)SYSTEM_CORE_CLOCK_HZ / ((double)(psc + 1) * (arr + 1));
+    tone.duty = (double)ccr / (arr + 1);
+    return tone;
+}
+
+/**
+ * @brief Renders a block of a note: a square wave that starts high at time 0, filtered by a triangle of 2 samples.
+ *
+ * > 1. Integrate the square wave twice at every sample time from `t0 - 1` to `t0 + length`. Times are moved back by
+ * a whole number of periods first: that only adds a straight line to the integral, which the second difference removes,
+ * and keeps the numbers small \n
+ * > 2. The second difference of the integral is the filtered square wave. The mean (duty) is subtracted so that a
+ * note has no DC \n
+ *
+ * @param p_out pointer to the samples.
+ * @param p_work pointer to `length + 2` doubles of work space.
+ * @param length number of samples.
+ * @param t0 time of the first sample from the start of the note, in samples. It is not negative.
+ * @param period period of the square wave, in samples.
+ * @param duty fraction of the period that the square wave is high.
+ */
+static void _render_square_block(float *p_out, double *p_work, uint32_t length, double t0, double period, double duty)
+{
+    double high = duty * period;
+    double origin = floor(t0 / period) * period;
+    double full = high * high * 0.5 + high * (period - high); // Double integral of one whole period
+
+    // 1.
+    for (uint32_t i = 0; i < length + 2; i++)
+    {
+        double t = t0 - origin - 1.0 + i;
+        t = (t > 0.0) ? t : 0.0;
+        double k = (double)(int32_t)(t / period); // t >= 0, so truncating is floor()
+        double u = t - k * period;
+        double h = (u < high) ? u : high;
+        double l = (u > high) ? u - high : 0.0;
+        p_work[i] = period * high * k * (k - 1.0) * 0.5 + k * full + k * high * u + 0.5 * h * h + high * l;
+    }
+
+    // 2.
+    for (uint32_t i = 0; i < length; i++)
+    {
+        p_out[i] = (float)(2.0 * (p_work[i + 2] - 2.0 * p_work[i + 1] + p_work[i] - duty)) * RENDER_AMPLITUDE;
+    }
+}
+
+/**
+ * @brief Renders a whole melody view into a buffer of samples.
+ *
+ * Notes follow each other with no gap, as with the notes queued by the FSM. Their start and end are kept in
+ * microseconds, like TIM2, so the rounding to samples does not accumulate.
+ *
+ * @param p_view pointer to the view.
+ * @param p_options pointer to the options.
+ * @param p_length pointer to store the number of samples.
+ * @return float* samples, to be freed by the caller, or NULL if there is no memory.
+ */
+static float *_render_melody(const melody_view_t *p_view, const render_options_t *p_options, uint32_t *p_length)
+{
+    melody_iterator_t iterator;
+    uint8_t note;
+    uint32_t duration_us;
+    uint64_t total_us = 0;
+    uint32_t duration_scale = melody_view_get_duration_scale(p_options->speed);
+
+    // 1. Length of the melody, with the durations of the timer
+    melody_iterator_init(&iterator, p_view);
+    while (melody_iterator_has_next(&iterator))
+    {
+        melody_iterator_next(&iterator, &note, &duration_us);
+        total_us += melody_view_scale_duration(duration_us, duration_scale); // _scale_duration() of fsm_buzzer.c
+    }
+    uint32_t length = (uint32_t)((total_us * p_options->sample_rate + 999999) / 1000000);
+    float *p_samples = calloc(length + RENDER_BLOCK_LENGTH, sizeof(float));
+    double *p_work = malloc((RENDER_BLOCK_LENGTH + 2) * sizeof(double));
+    if (p_samples == NULL || p_work == NULL)
+    {
+        free(p_samples);
+        free(p_work);
+        return NULL;
+    }
+
+    // 2. Each note covers the samples whose time is inside it
+    uint64_t start_us = 0;
+    melody_iterator_init(&iterator, p_view);
+    while (melody_iterator_has_next(&iterator))
+    {
+        melody_iterator_next(&iterator, &note, &duration_us);
+        duration_us = melody_view_scale_duration(duration_us, duration_scale);
+        if (p_options->sequencer && duration_us < BUZZER_SEQUENCER_MIN_US)
+        {
+            duration_us = BUZZER_SEQUENCER_MIN_US;
+        }
+        uint64_t end_us = start_us + duration_us;
+        uint32_t first = (uint32_t)((start_us * p_options->sample_rate + 999999) / 1000000);
+        uint32_t last = (uint32_t)((end_us * p_options->sample_rate + 999999) / 1000000);
+        if (last > length)
+        {
+            last = length;
+        }
+
+        render_tone_t tone = _get_tone(note, p_options->sequencer);
+        if (tone.duty > 0.0)
+        {
+            double period = p_options->sample_rate / tone.hz;
+            double offset = first - (double)start_us * p_options->sample_rate / 1000000.0;
+            for (uint32_t i = first; i < last; i += RENDER_BLOCK_LENGTH)
+            {
+                uint32_t block = (last - i < RENDER_BLOCK_LENGTH) ? last - i : RENDER_BLOCK_LENGTH;
+                _render_square_block(&p_samples[i], p_work, block, offset + (i - first), period, tone.duty);
+            }
+        }
+        start_us = end_us;
+    }
+
+    free(p_work);
+    *p_length = length;
+    return p_samples;
+}
+
+/**
+ * @brief Writes a little endian value of `bytes` bytes.
+ *
+ * @param p_file file.
+ * @param value value.
+ * @param bytes number of bytes.
+ */
+static void _write_le(FILE *p_file, uint32_t value, uint32_t bytes)
+{
+    for (uint32_t i = 0; i < bytes; i++)
+    {
+        fputc((value >> (8 * i)) & 0xFF, p_file);
+    }
+}
+
+/**
+ * @brief Writes samples as a mono 16-bit PCM WAV file.
+ *
+ * @param p_path path of the file.
+ * @param p_samples samples, from -1 to 1.
+ * @param length number of samples.
+ * @param sample_rate sample rate in Hz.
+ * @return true the file has been written.
+ * @return false the file could not be written.
+ */
+static bool _write_wav(const char *p_path, const float *p_samples, uint32_t length, uint32_t sample_rate)
+{
+    FILE *p_file = fopen(p_path, "wb");
+    if (p_file == NULL)
+    {
+        return false;
+    }
+    fwrite("RIFF", 1, 4, p_file);
+    _write_le(p_file, 36 + 2 * length, 4);
+    fwrite("WAVEfmt ", 1, 8, p_file);
+    _write_le(p_file, 16, 4);              // Size of the format chunk
+    _write_le(p_file, 1, 2);               // PCM
+    _write_le(p_file, 1, 2);               // Mono
+    _write_le(p_file, sample_rate, 4);
+    _write_le(p_file, 2 * sample_rate, 4); // Bytes per second
+    _write_le(p_file, 2, 2);               // Bytes per sample
+    _write_le(p_file, 16, 2);              // Bits per sample
+    fwrite("data", 1, 4, p_file);
+    _write_le(p_file, 2 * length, 4);
+    for (uint32_t i = 0; i < length; i++)
+    {
+        float sample = fminf(fmaxf(p_samples[i], -1.0f), 1.0f);
+        _write_le(p_file, (uint32_t)(int32_t)lrintf(sample * 32767.0f), 2);
+    }
+    return (fclose(p_file) == 0);
+}
+
+/**
+ * @brief Prints the usage of the tool.
+ *
+ * @param p_name name of the program.
+ */
+static void _print_usage(const char *p_name)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -m <id>        render only the melody with this id (default: the whole catalog)\n"
+            "  -o <file>      output file for -m (default: <id>.wav)\n"
+            "  -d <dir>       output directory for the whole catalog (default: .)\n"
+            "  -s <speed>     player speed, 0.1 to 10 (default: 1)\n"
+            "  -T <tempo>     tempo of the melodies, 0.1 to 10 (default: 1)\n"
+            "  -t <semitones> transposition, -24 to 24 (default: 0)\n"
+            "  -r             play the melodies backwards\n"
+            "  -q             use the timer values of the DMA sequencer\n"
+            "  -f <hz>        sample rate (default: %d)\n"
+            "  -l             list the melodies of the catalog\n",
+            p_name, RENDER_SAMPLE_RATE_HZ);
+}
+
+/* Main function ---------------------------------------------------------------*/
+/**
+ * @brief Renders the melodies given on the command line and prints the time it took.
+ *
+ * @param argc number of arguments.
+ * @param argv arguments.
+ * @return int 0 if everything was written, 1 if not.
+ */
+int main(int argc, char **argv)
+{
+    render_options_t options = {.sample_rate = RENDER_SAMPLE_RATE_HZ, .speed = RENDER_SPEED_ONE, .tempo = MELODY_VIEW_TEMPO_ONE,
+                                .transpose = 0, .reverse = false, .sequencer = false};
+    const char *p_dir = ".";
+    const char *p_output = NULL;
+    int32_t melody_id = -1;
+    uint32_t count = melody_catalog_get_count(&melodies_catalog);
+
+    // 1. Options
+    for (int i = 1; i < argc; i++)
+    {
+        const char *p_arg = argv[i];
+        const char *p_value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!strcmp(p_arg, "-l"))
+        {
+            for (uint32_t id = 0; id < count; id++)
+            {
+                printf("%u: %s\n", id, melody_get_name(melody_catalog_get(&melodies_catalog, id)));
+            }
+            return 0;
+        }
+        else if (!strcmp(p_arg, "-r"))
+        {
+            options.reverse = true;
+        }
+        else if (!strcmp(p_arg, "-q"))
+        {
+            options.sequencer = true;
+        }
+        else if (p_value == NULL)
+        {
+            _print_usage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            i++;
+            if (!strcmp(p_arg, "-m"))
+                melody_id = atoi(p_value);
+            else if (!strcmp(p_arg, "-o"))
+                p_output = p_value;
+            else if (!strcmp(p_arg, "-d"))
+                p_dir = p_value;
+            else if (!strcmp(p_arg, "-s"))
+                options.speed = (uint32_t)(fmin(fmax(atof(p_value), 0.1), 10.0) * RENDER_SPEED_ONE);
+            else if (!strcmp(p_arg, "-T"))
+                options.tempo = (uint32_t)(atof(p_value) * MELODY_VIEW_TEMPO_ONE);
+            else if (!strcmp(p_arg, "-t"))
+                options.transpose = atoi(p_value);
+            else if (!strcmp(p_arg, "-f") && atoi(p_value) > 0)
+                options.sample_rate = atoi(p_value);
+            else
+            {
+                _print_usage(argv[0]);
+                return 1;
+            }
+        }
+    }
+    if (melody_id >= (int32_t)count)
+    {
+        fprintf(stderr, "Melody %d not found, there are %u\n", melody_id, count);
+        return 1;
+    }
+
+    // 2. Render. Only the rendering is timed, not the writing of the files
+    uint32_t first = (melody_id < 0) ? 0 : melody_id;
+    uint32_t last = (melody_id < 0) ? count : (uint32_t)melody_id + 1;
+    uint64_t total_samples = 0;
+    double render_s = 0.0;
+    for (uint32_t id = first; id < last; id++)
+    {
+        melody_view_t view;
+        melody_view_init(&view, melody_catalog_get(&melodies_catalog, id));
+        view.reverse = options.reverse;
+        melody_view_set_transpose(&view, options.transpose);
+        melody_view_set_tempo(&view, options.tempo);
+
+        uint32_t length;
+        clock_t start = clock();
+        float *p_samples = _render_melody(&view, &options, &length);
+        render_s += (double)(clock() - start) / CLOCKS_PER_SEC;
+        if (p_samples == NULL)
+        {
+            fprintf(stderr, "Out of memory rendering melody %u\n", id);
+            return 1;
+        }
+
+        char path[RENDER_PATH_LENGTH];
+        if (p_output != NULL)
+            snprintf(path, sizeof(path), "%s", p_output);
+        else if (melody_id >= 0)
+            snprintf(path, sizeof(path), "%u.wav", id);
+        else
+            snprintf(path, sizeof(path), "%s/%02u.wav", p_dir, id);
+        bool written = _write_wav(path, p_samples, length, options.sample_rate);
+        free(p_samples);
+        if (!written)
+        {
+            fprintf(stderr, "Can't write %s\n", path);
+            return 1;
+        }
+        printf("%s: %s, %.2f s\n", path, melody_get_name(view.p_melody), (double)length / options.sample_rate);
+        total_samples += length;
+    }
+
+    // 3.
+    fprintf(stderr, "Rendered %.1f s of audio in %.1f ms\n", (double)total_samples / options.sample_rate, render_s * 1000.0);
+    return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file speed_accuracy.c
+ * @brief Host check of the note durations of the player speed: the Q16.16 path of the jukebox against the old double formula.
+ *
+ * For every speed from 0.1x to 10x in steps of 0.01 and every note from 1 ms to 2000 ms (and the longest one, 65535 ms),
+ * the duration that TIM2 times is computed in three ways:
+ *
+ * - Q16.16: the speed converted (rounded) as `speed` does, and the duration scaled with `melody_view_scale_duration()`, as `fsm_buzzer` does.
+ * - Old: the double division of the speed, truncated to milliseconds, and the PSC/ARR of TIM2 rounded, as the jukebox did before.
+ * - Ideal: the exact duration, with the speed as typed and with the speed in Q16.16.
+ *
+ * It fails if a Q16.16 duration is more than 1 us away from the exact one of its Q16.16 speed (the rounding), or if the
+ * longest note at the slowest tempo and speed (100 times longer, more than 32 bits of us) does not saturate, and it prints
+ * the largest errors of both paths against the speed as typed.
+ *
+ * Build and run from the root of the repository:
+ *
+ *     cc -O2 -std=c11 -DSYSTEM_CORE_CLOCK_HZ=16000000U -Icommon/include -Iport/stm32f4/include \
+ *        tools/speed_accuracy.c common/src/melodies.c common/src/melody_view.c common/src/melody_pool.c -lm -o speed_accuracy
+ *     ./speed_accuracy
+ *
+ * @author David Fuentes Martín
+ * @author Pablo de la Cruz Gómez
+ * @date 2024-06-17
+ */
+
+/* Includes ------------------------------------------------------------------*/
+/* Standard C libraries */
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+/* Other libraries */
+#include "melody_view.h"
+
+/* Defines ------------------------------------------------------------------*/
+#define ACCURACY_SPEED_ONE (1UL << 16)              /*!< Speed 1.0 in Q16.16, as BUZZER_SPEED_ONE in fsm_buzzer.h */
+#define ACCURACY_MAX_ROUNDING_US 1.0                /*!< Largest error allowed against the exact duration of the Q16.16 speed */
+#define ACCURACY_LONGEST_NOTE_MS 65535U             /*!< Longest duration of a note of the melodies */
+
+/* Private functions ---------------------------------------------------------*/
+/**
+ * @brief Duration timed by TIM2 with the old formula: the double division, truncated to ms by `port_buzzer_set_note_duration()`, and its PSC and ARR.
+ *
+ * @param duration_ms duration of the note at speed 1.
+ * @param speed player speed.
+ * @return double duration in microseconds.
+ */
+static double _old_duration_us(uint32_t duration_ms, double speed)
+{
+    double clock = (double)SYSTEM_CORE_CLOCK_HZ;
+    double ms = (double)(uint32_t)((double)duration_ms / speed);
+    double psc = ((clock * ms / 1000.0) / 65536.0) - 1.0;
+    double arr = ((clock * ms / 1000.0) / (round(psc) + 1.0)) - 1.0;
+    if (round(arr) > 65535.0)
+    {
+        psc++;
+        arr = ((clock * ms / 1000.0) / (round(psc) + 1.0)) - 1.0;
+    }
+    return (round(psc) + 1.0) * (round(arr) + 1.0) * 1e6 / clock;
+}
+
+/**
+ * @brief Duration timed by TIM2 with the Q16.16 path: `speed` converts the number, and `fsm_buzzer` scales the note by its reciprocal.
+ *
+ * @param duration_ms duration of the note at speed 1.
+ * @param speed_q16 player speed in Q16.16.
+ * @return uint32_t duration in microseconds.
+ */
+static uint32_t _q16_duration_us(uint32_t duration_ms, uint32_t speed_q16)
+{
+    return melody_view_scale_duration(duration_ms * 1000U, melody_view_get_duration_scale(speed_q16));
+}
+
+/**
+ * @brief Compare both paths for a note and keep the largest errors.
+ *
+ * @param duration_ms duration of the note at speed 1.
+ * @param speed player speed.
+ * @param p_max pointer to the largest errors: rounding of Q16.16 (us), Q16.16 against the ideal one (us and ppm), old against the ideal one (us and ppm).
+ */
+static void _compare(uint32_t duration_ms, double speed, double *p_max)
+{
+    uint32_t speed_q16 = (uint32_t)(speed * ACCURACY_SPEED_ONE + 0.5);
+    double ideal_us = duration_ms * 1000.0 / speed;
+    double exact_q16_us = duration_ms * 1000.0 * ACCURACY_SPEED_ONE / speed_q16;
+    double q16_us = (double)_q16_duration_us(duration_ms, speed_q16);
+    double old_us = _old_duration_us(duration_ms, speed);
+    double errors[] = {fabs(q16_us - exact_q16_us), fabs(q16_us - ideal_us), fabs(q16_us - ideal_us) * 1e6 / ideal_us,
+                       fabs(old_us - ideal_us), fabs(old_us - ideal_us) * 1e6 / ideal_us};
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        p_max[i] = fmax(p_max[i], errors[i]);
+    }
+}
+
+/* Main -----------------------------------------------------------------------*/
+int main(void)
+{
+    double max[5] = {0.0, 0.0, 0.0, 0.0, 0.0};
+    for (uint32_t hundredths = 10; hundredths <= 1000; hundredths++)
+    {
+        double speed = hundredths / 100.0;
+        for (uint32_t duration_ms = 1; duration_ms <= 2000; duration_ms++)
+        {
+            _compare(duration_ms, speed, max);
+        }
+        _compare(ACCURACY_LONGEST_NOTE_MS, speed, max);
+    }
+
+    printf("Speeds 0.10x-10.00x, notes 1-2000 ms and %u ms\n", ACCURACY_LONGEST_NOTE_MS);
+    printf("Q16.16 against its exact duration: %.3f us (rounding)\n", max[0]);
+    printf("Q16.16 against the speed typed:    %.3f us, %.1f ppm (the speed in Q16.16)\n", max[1], max[2]);
+    printf("Old double formula against it:     %.3f us, %.1f ppm\n", max[3], max[4]);
+    if (max[0] > ACCURACY_MAX_ROUNDING_US)
+    {
+        printf("FAIL: more than %.1f us of rounding\n", ACCURACY_MAX_ROUNDING_US);
+        return 1;
+    }
+
+    // The tempo of the view and then the speed of the buzzer: the second scale goes over 32 bits
+    uint32_t slowest_scale = melody_view_get_duration_scale(MELODY_VIEW_TEMPO_MIN);
+    uint32_t slowest_us = melody_view_scale_duration(melody_view_scale_duration(ACCURACY_LONGEST_NOTE_MS * 1000U, slowest_scale), slowest_scale);
+    printf("%u ms at tempo and speed 0.1:   %lu us\n", ACCURACY_LONGEST_NOTE_MS, (unsigned long)slowest_us);
+    if (slowest_us != UINT32_MAX)
+    {
+        printf("FAIL: the duration does not saturate\n");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+"""
+@file trace_decode.py
+@brief Host decoder of the binary trace of the jukebox, sent through the SWO pin by the ITM.
+
+The firmware stores each trace message as a record of four 32-bit words and sends them,
+when the main loop is idle, through the stimulus port 1 of the ITM (SYSTEM_TRACE_ITM_PORT):
+
+    header (ID in the low half, sequence number in the high half), DWT cycles, arg0, arg1
+
+The formats are read from the TRACE_FORMATS list of common/include/trace.h, in whose
+order the IDs are numbered, so the decoder always matches the firmware it is built with.
+The printf() text of port 0 is printed as it comes. A gap in the sequence numbers means
+that the firmware dropped records because its ring was full.
+
+Usage:
+    python3 tools/trace_decode.py swo.bin               (raw SWO capture, for example from
+                                                         OpenOCD: tpiu config internal swo.bin uart off 16000000)
+    python3 tools/trace_decode.py -                     (read the capture from stdin)
+
+Only the Python standard library is used.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+TRACE_PORT = 1
+TEXT_PORT = 0
+RECORD_WORDS = 4
+CORE_CLOCK_HZ = 16000000
+DEFAULT_HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'common', 'include', 'trace.h')
+
+
+# ----------------------------------------------------------------------------
+# Formats
+# ----------------------------------------------------------------------------
+def read_formats(path):
+    """List of (name, format) of TRACE_FORMATS, in the order of their IDs."""
+    with open(path, encoding='utf-8') as f:
+        text = f.read()
+    match = re.search(r'#define\s+TRACE_FORMATS\(X\)((?:.*\\\n)*.*)', text)
+    if not match:
+        raise ValueError('no TRACE_FORMATS in %s' % path)
+    formats = []
+    for name, fmt in re.findall(r'X\(\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)', match.group(1)):
+        formats.append((name, fmt.encode('latin-1').decode('unicode_escape')))
+    return formats
+
+
+def format_record(fmt, args):
+    """Text of a record: the C format with its arguments, signed where the conversion is."""
+    values = iter(args)
+
+    def convert(spec):
+        conversion = spec.group(2)
+        if conversion == '%':
+            return '%'
+        value = next(values, 0)
+        if conversion in 'di' and value & 0x80000000:
+            value -= 1 << 32
+        return ('%' + spec.group(1) + conversion) % value
+
+    return re.sub(r'%([-+ #0-9.]*)(?:hh|h|ll|l|z)?([diouxXc%])', convert, fmt)
+
+
+# ----------------------------------------------------------------------------
+# ITM packets
+# ----------------------------------------------------------------------------
+def itm_packets(data):
+    """(port, payload) of each software source packet of a raw ITM stream; the other packets are skipped."""
+    i = 0
+    while i < len(data):
+        header = data[i]
+        i += 1
+        size = header & 0x03
+        if header in (0x00, 0x80, 0x70):                # Synchronization (zeros and 0x80) or overflow
+            continue
+        if size:
+            payload = data[i:i + (4 if size == 3 else size)]
+            i += len(payload)
+            if not header & 0x04:                       # Software source: the stimulus ports
+                yield header >> 3, payload
+            continue
+        if header & 0x80:                               # Protocol packet (timestamps, extension) with more bytes
+            while i < len(data) and data[i] & 0x80:
+                i += 1
+            i += 1
+
+
+class Decoder:
+    """Records of the trace port built from its words, and the text of the printf() port."""
+
+    def __init__(self, formats, out):
+        self.formats = formats
+        self.out = out
+        self.words = []
+        self.sequence = None
+        self.last_cycles = None
+        self.elapsed = 0
+
+    def feed(self, port, payload):
+        if port == TEXT_PORT:
+            self.out.write(payload.decode('latin-1'))
+        elif port == TRACE_PORT and len(payload) == 4:
+            self.words.append(struct.unpack('<I', payload)[0])
+            if len(self.words) == RECORD_WORDS:
+                self.record(*self.words)
+                self.words = []
+
+    def record(self, header, cycles, arg0, arg1):
+        trace_id, sequence = header & 0xFFFF, header >> 16
+        if self.sequence is not None and sequence != (self.sequence + 1) & 0xFFFF:
+            self.out.write('[trace] %d records dropped\n' % ((sequence - self.sequence - 1) & 0xFFFF))
+        self.sequence = sequence
+
+        # The cycle counter wraps around every 2^32 cycles: the records are in order, so the time only grows
+        if self.last_cycles is not None:
+            self.elapsed += (cycles - self.last_cycles) & 0xFFFFFFFF
+        self.last_cycles = cycles
+
+        if trace_id < len(self.formats):
+            text = format_record(self.formats[trace_id][1], (arg0, arg1))
+        else:
+            text = 'unknown ID %d (%d, %d)\n' % (trace_id, arg0, arg1)
+        self.out.write('[%12.6f] %s' % (self.elapsed / CORE_CLOCK_HZ, text))
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description='Print the binary trace of the jukebox from a raw SWO capture.')
+    parser.add_argument('capture', help='raw SWO capture, or - for stdin')
+    parser.add_argument('--formats', default=DEFAULT_HEADER, help='header with TRACE_FORMATS (default common/include/trace.h)')
+    args = parser.parse_args(argv)
+
+    try:
+        formats = read_formats(args.formats)
+        if args.capture == '-':
+            data = sys.stdin.buffer.read()
+        else:
+            with open(args.capture, 'rb') as f:
+                data = f.read()
+    except (OSError, ValueError) as e:
+        print('error: %s' % e, file=sys.stderr)
+        return 1
+
+    decoder = Decoder(formats, sys.stdout)
+    for port, payload in itm_packets(data):
+        decoder.feed(port, payload)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())